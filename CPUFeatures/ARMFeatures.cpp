@@ -0,0 +1,46 @@
+//
+// Checking the AArch64 (ARM64) features of the executing processor, as reported by the operating
+// system: The hardware capability bits (HWCAP and HWCAP2) on Linux, Android and FreeBSD, the
+// hw.optional sysctl values on Apple, and IsProcessorFeaturePresent on Windows.
+//
+// The features are all the ones in the ARM registry (Common/ARMFeatures.h), listed by name,
+// followed by the SVE vector length when SVE is supported. Since the operating system only
+// reports features it supports, there is no separate operating system support as in the
+// Microsoft mode. On other processors all features are reported as not supported.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <string>
+#include "../Common/ARMFeatures.h"
+#include "Output.h"
+
+void print_arm_features(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format)
+{
+	const ArmFeatureSnapshot snapshot = get_arm_feature_snapshot();
+	FeatureListWriter writer(stream, format, print_supported, print_unsupported, false);
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<features>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"features\":[";
+	}
+	for (int i = 0; i < ArmFeatureCount; ++i) {
+		const ArmFeature feature = static_cast<ArmFeature>(i);
+		const std::wstring name(arm_feature_table[i].name, arm_feature_table[i].name + strlen(arm_feature_table[i].name));
+		const bool supported = arm_feature_supported(snapshot, feature);
+		writer.feature(name.c_str(), supported, supported);
+	}
+	if (format == OutputXML) {
+		stream << L"</features>" << L'\n';
+		if (snapshot.sve_vector_length)
+			stream << L"<sve vector_length=\"" << snapshot.sve_vector_length << L"\"/>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"\n],\"sve_vector_length\":" << snapshot.sve_vector_length << L'}' << L'\n';
+	} else if (format == OutputHex) {
+		writer.write_bitmask();
+		stream << L' ' << std::hex << snapshot.sve_vector_length << std::dec << L'\n';
+	} else if (snapshot.sve_vector_length) {
+		stream << L"SVE vector length " << snapshot.sve_vector_length << L" bits" << L'\n';
+	}
+}
@@ -9,7 +9,16 @@
 // information returned with various values of function_id is processor-dependent.
 //
 // This implementation is detecting all AVX-related features, from Intel and AMD processors,
-// but can only be compiled by Microsoft (Visual C++) compiler.
+// and builds with GCC and Clang through the portable shim in Intrinsics.h.
+//
+// The features are the ones in the AVX group of the shared registry (FeatureRegistry.h), followed
+// by the related extensions: The vector AES, carry-less multiplication and Galois field
+// instructions, the Advanced Matrix Extensions (AMX) and the Advanced Performance Extensions (APX).
+// After the features the AVX10 version and maximum vector length are reported (see ISALevel.h),
+// and the AMX tile palettes and TMUL limits of function ids 0x1D and 0x1E (see AMX.h).
+// In addition to the processor hardware support, the operating system support for the
+// extended processor state (YMM and ZMM registers) is checked, since the features can only
+// be used when both are supported.
 //
 // Based on source code from the Microsoft Docs article about the __cpuid/__cpuidex
 // intrinsic, with information about newer AVX features from Wikipedia article about CPUID.
@@ -45,103 +54,99 @@
 // Part 5 (Introduced in Knights Mill):
 //     AVX-512 Vector Neural Network Instructions Word variable precision (4VNNIW) - vector instructions for deep learning, enhanced word, variable precision.
 //     AVX-512 Fused Multiply Accumulation Packed Single precision (4FMAPS) - vector instructions for deep learning, floating point, single precision.
+// Part 6 (Introduced in Tiger Lake, Cooper Lake and Sapphire Rapids):
+//     AVX-512 VP2INTERSECT - compute intersection between pairs of mask registers.
+//     AVX-512 BFloat16 instructions (BF16) - conversion and dot product of bfloat16 values, for deep learning.
+//     AVX-512 Half-precision floating point (FP16) - arithmetic on IEEE 754 half-precision values.
 // Only the core extension AVX-512F (AVX-512 Foundation) is required by all implementations.
 // For example desktop processors will additionally support CD, VL, and BW/DQ, while computing coprocessors will support CD, ER and PF.
 //
+// VEX-encoded extensions for processors without AVX-512, e.g. the Alder Lake client parts:
+//   AVX-VNNI - the AVX-512 VNNI dot products on 128-bit and 256-bit vectors (Alder Lake).
+//   AVX-IFMA, AVX-VNNI-INT8 and AVX-NE-CONVERT - integer fused multiply add, dot products of signed and unsigned bytes, and bfloat16 and half-precision conversion (Sierra Forest).
+//   AVX-VNNI-INT16 - dot products of signed and unsigned words (Lunar Lake and Arrow Lake).
+//
+// AVX10 - the converged vector instruction set, all AVX-512 extensions of Sapphire Rapids as version 1, with the supported vector lengths and version in function id 0x24 (Granite Rapids).
+//
 #include "Targetver.h"
 #include <iostream>
-#include <intrin.h>
+#include <string>
+#include "../Common/FeatureSnapshot.h"
+#include "../Common/ISALevel.h"
+#include "../Common/AMX.h"
+#include "Output.h"
 
-struct AVXFeatures {
-	bool avx=false, avx2=false, avx512f=false, avx512pf=false, avx512er=false, avx512cd=false,
-		 avx512bw=false, avx512dq=false, avx512vl=false,
-		 avx512ifma=false, avx512vbmi=false,
-		 avx512vnni=false, avx512vbmi2=false, avx512popcntdq=false, avx512bitalg=false,
-		 avx5124vnniw=false, avx5124fmaps=false;
-};
-
-static AVXFeatures _get_avx_features()
+// Print all features in group FeatureGroupAVX of the registry, then those in FeatureGroupAVXRelated, in table order, using their labels.
+static void _print_avx_features(FeatureListWriter& writer, const FeatureSnapshot& snapshot)
 {
-	AVXFeatures features;
-	int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
-	__cpuid(cpu_info, 0x0); // First request function id 0 to get the number of the highest valid function ID
-	const int nIds = cpu_info[0];
-	if (nIds >= 1) {
-		__cpuid(cpu_info, 0x1); // Request function id 1 which contains bitset with flags for main features
-		// Detect AVX (introduced in Sandy Bridge)
-		features.avx = (cpu_info[2] & 1<<28) != 0; // Bit 28 of the ECX register function indicates AVX
-		if (nIds >= 7) {
-			__cpuid(cpu_info, 0x7); // Request function id 7 which contains bitset with flags for some extended features
-			// Detect AVX-2 (introduced in Haswell)
-			features.avx2 = (cpu_info[1] & 1<<5) != 0; // Bit 5 of the EBX register indicates AVX-2
-			// Detect AVX-512
-			features.avx512f = (cpu_info[1] & 1<<16) != 0; // Bit 16 of the EBX register indicates AVX-512-F (AVX-512 Foundation, the core extension required by all imiplementations of AVX-512)
-			// Detect AVX-512 feature extension set 1 (Introduced in Knights Landing, together with the main foundation extension)
-			features.avx512pf = (cpu_info[1] & 1<<26) != 0; // Bit 26 of the EBX register indicates AVX-512-PF (AVX-512 Prefetch)
-			features.avx512er = (cpu_info[1] & 1<<27) != 0; // Bit 27 of the EBX register indicates AVX-512-ER (AVX-512 Exponential and Reciprocal)
-			features.avx512cd = (cpu_info[1] & 1<<28) != 0; // Bit 28 of the EBX register indicates AVX-512-CD (AVX-512 Conflict Detection)
-			// Detect AVX-512 feature extension set 2 (Introduced in Skylake X)
-			features.avx512bw = (cpu_info[1] & 1<<30) != 0; // Bit 30 of the EBX register indicates AVX-512-BW (AVX-512 Byte and Word)
-			features.avx512dq = (cpu_info[1] & 1<<17) != 0; // Bit 17 of the EBX register indicates AVX-512-DQ (AVX-512 Doubleword and Quadword)
-			features.avx512vl = (cpu_info[1] & 1<<31) != 0; // Bit 31 of the EBX register indicates AVX-512-VL (AVX-512 Vector Length)
-			// Detect AVX-512 feature extension set 3 (Introduced with Cannonlake)
-			features.avx512ifma = (cpu_info[1] & 1<<21) != 0; // Bit 21 of the EBX register indicates AVX-512-IFMA (AVX-512 Integer Fused Multiply-Add)
-			features.avx512vbmi = (cpu_info[2] & 1<<1) != 0; // Bit 1 of the ECX register indicates AVX-512-VBMI (AVX-512 Vector Byte Manipulation)
-			// Detect AVX-512 feature extension set 4 (Introduced with Ice Lake)
-			features.avx512vnni = (cpu_info[2] & 1<<11) != 0; // Bit 11 of the ECX register indicates AVX-512-VNNI (AVX-512 Vector Neural Network Instructions)
-			features.avx512vbmi2 = (cpu_info[2] & 1<<6) != 0; // Bit 6 of the ECX register indicates AVX-512-VBMI2 (AVX-512 Vector Bit Manipulation Instructions 2)
-			features.avx512popcntdq = (cpu_info[2] & 1<<14) != 0; // Bit 14 of the ECX register indicates AVX-512-POPCNTDQ (AVX-512 Vector Population Count D/Q)
-			features.avx512bitalg = (cpu_info[2] & 1<<12) != 0; // Bit 12 of the ECX register indicates AVX-512-BITALG (AVX-512 BITALG)
-			// Detect AVX-512 feature extension set 5 (Introduced with Knights Mill)
-			features.avx5124vnniw = (cpu_info[3] & 1<<2) != 0; // Bit 2 of the EDX register indicates AVX-512-4VNNIW (AVX-512 4-register Vector Neural Network Instructions Word variable precision)
-			features.avx5124fmaps = (cpu_info[3] & 1<<3) != 0; // Bit 3 of the EDX register indicates AVX-512-4FMAPS (AVX-512 4-register Fused Multiply Accumulation Packed Single precision)
+	for (unsigned int group : { FeatureGroupAVX, FeatureGroupAVXRelated }) {
+		for (int i = 0; i < FeatureCount; ++i) {
+			const Feature feature = static_cast<Feature>(i);
+			const FeatureInfo& info = feature_table[feature];
+			if ((info.groups & group) == 0)
+				continue;
+			const std::wstring label(info.label, info.label + strlen(info.label));
+			writer.feature(label.c_str(), feature_hardware(snapshot, feature), feature_usable(snapshot, feature));
 		}
 	}
-	return features;
 }
 
-static void _print_feature_support(std::wostream& stream, const wchar_t* feature_name, bool is_supported, bool print_if_supported, bool print_if_unsupported, bool print_xml) {
-    if ((is_supported && print_if_supported) || (!is_supported && print_if_unsupported)) {
-        if (print_xml) {
-            stream << L"<feature name=\"" << feature_name << L"\" supported=\"" << (is_supported ? "true" : "false") << "\"/>" << std::endl;
-        } else {
-            stream << feature_name << (is_supported ? " supported" : " not supported") << std::endl;
-        }
-    }
-};
-
-static void _print_avx_features(std::wostream& stream, const AVXFeatures& features, bool print_supported, bool print_unsupported, bool print_xml)
+// Print the AVX10 version and vector length, and the AMX tile geometry, when supported.
+static void _print_avx_details(std::wostream& stream, OutputFormat format, const FeatureSnapshot& snapshot, const AMXInfo& amx)
 {
-	_print_feature_support(std::wcout, L"AVX", features.avx, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX2", features.avx2, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 (F)", features.avx512f, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 CD", features.avx512cd, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 ER", features.avx512er, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 PF", features.avx512pf, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 VL", features.avx512vl, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 BW", features.avx512bw, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 DQ", features.avx512dq, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 IFMA", features.avx512ifma, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 VBMI", features.avx512vbmi, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 VNNI", features.avx512vnni, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 VBMI2", features.avx512vbmi2, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 POPCNTDQ", features.avx512popcntdq, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 BITALG", features.avx512bitalg, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 4VNNIW", features.avx5124vnniw, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"AVX-512 4FMAPS", features.avx5124fmaps, print_supported, print_unsupported, print_xml);
+	const unsigned int avx10 = avx10_version(snapshot);
+	const unsigned int vector_length = avx10_vector_length(snapshot);
+	if (format == OutputXML) {
+		stream << L"<avx10 version=\"" << avx10 << L"\" vector_length=\"" << vector_length << L"\"/>" << L'\n';
+		stream << L"<amx tmul_max_k=\"" << amx.tmul_max_k << L"\" tmul_max_n=\"" << amx.tmul_max_n << L"\">" << L'\n';
+		for (unsigned int i = 0; i < amx.palette_count; ++i) {
+			const AMXTilePalette& palette = amx.palettes[i];
+			stream << L"<palette id=\"" << i + 1 << L"\" total_tile_bytes=\"" << palette.total_tile_bytes << L"\" bytes_per_tile=\"" << palette.bytes_per_tile
+				<< L"\" bytes_per_row=\"" << palette.bytes_per_row << L"\" max_names=\"" << palette.max_names << L"\" max_rows=\"" << palette.max_rows << L"\"/>" << L'\n';
+		}
+		stream << L"</amx>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"\n],\"avx10\":{\"version\":" << avx10 << L",\"vector_length\":" << vector_length << L'}';
+		stream << L",\"amx\":{\"tmul_max_k\":" << amx.tmul_max_k << L",\"tmul_max_n\":" << amx.tmul_max_n << L",\"palettes\":[";
+		for (unsigned int i = 0; i < amx.palette_count; ++i) {
+			const AMXTilePalette& palette = amx.palettes[i];
+			stream << (i ? L",{" : L"{") << L"\"id\":" << i + 1 << L",\"total_tile_bytes\":" << palette.total_tile_bytes << L",\"bytes_per_tile\":" << palette.bytes_per_tile
+				<< L",\"bytes_per_row\":" << palette.bytes_per_row << L",\"max_names\":" << palette.max_names << L",\"max_rows\":" << palette.max_rows << L'}';
+		}
+		stream << L"]}";
+	} else if (format == OutputText) {
+		if (avx10)
+			stream << L"AVX10 version " << avx10 << L", maximum vector length " << vector_length << L" bits" << L'\n';
+		for (unsigned int i = 0; i < amx.palette_count; ++i) {
+			const AMXTilePalette& palette = amx.palettes[i];
+			stream << L"AMX palette " << i + 1 << L": " << palette.max_names << L" tiles of " << palette.max_rows << L" rows of " << palette.bytes_per_row
+				<< L" bytes (" << palette.bytes_per_tile << L" bytes per tile, " << palette.total_tile_bytes << L" bytes total)" << L'\n';
+		}
+		if (amx.palette_count)
+			stream << L"AMX TMUL maximum K " << amx.tmul_max_k << L", maximum N " << amx.tmul_max_n << L" bytes" << L'\n';
+	}
 }
 
-void print_avx_features(std::wostream& stream, bool print_supported, bool print_unsupported, bool print_xml)
+void print_avx_features(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format)
 {
-	AVXFeatures features = _get_avx_features();
-	if (print_xml) {
-		stream << L"<cpu>" << std::endl;
-		stream << L"<features>" << std::endl;
+	const FeatureSnapshot snapshot = get_feature_snapshot();
+	FeatureListWriter writer(stream, format, print_supported, print_unsupported, true);
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<features>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"features\":[";
 	}
-	_print_avx_features(std::wcout, features, print_supported, print_unsupported, print_xml);
-	if (print_xml) {
-		stream << L"</features>" << std::endl;
-		stream << L"</cpu>" << std::endl;
+	_print_avx_features(writer, snapshot);
+	if (format == OutputXML)
+		stream << L"</features>" << L'\n';
+	_print_avx_details(stream, format, snapshot, get_amx_info());
+	if (format == OutputXML) {
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"}" << L'\n';
+	} else if (format == OutputHex) {
+		writer.write_bitmask();
+		stream << L'\n';
 	}
-
-}
\ No newline at end of file
+}
@@ -0,0 +1,353 @@
+//
+// Measuring the actual throughput of 128, 256 and 512-bit vector instructions on the executing
+// processor, and the frequency drop they cause.
+//
+// That a processor supports AVX-512 does not mean that using 512-bit vectors is faster
+// than using 256-bit vectors. Many Intel processors, e.g. Skylake-SP and Cascade Lake, have
+// frequency licenses: When executing "heavy" 256-bit instructions (floating point and integer
+// multiplication), and any 512-bit instructions, the core lowers its frequency to stay within
+// the power budget. The lower frequency also affects all other code running on the core,
+// and it is kept for some time (around 2 ms) after the last wide instruction.
+//
+// For each vector width supported by both processor and operating system, this runs short
+// calibrated loops of independent FMA and integer multiply-add operations, timed with rdtsc,
+// and then immediately measures the core frequency while it is still in the license level
+// reached. The frequency is measured by timing a dependent chain with a known number of core
+// cycles (see Common/CycleCounter.h). The time stamp counter itself runs at a constant rate,
+// independent of the core frequency, and is calibrated against the system clock.
+//
+// Based on the results a preferred vector width is recommended: The widest width is only
+// recommended if its throughput gain is larger than the frequency loss, since loss of
+// frequency slows down any scalar code executing in between.
+//
+// Uses the Microsoft-specific intrinsics, through the portable shim Intrinsics.h, with the loops
+// for each width marked with CPUFEATURES_TARGET so that GCC and Clang can compile them too.
+//
+#include "Targetver.h"
+#include "Runtime.h"
+#include "../Common/FeatureSnapshot.h"
+#include "../Common/CycleCounter.h"
+#include <iostream>
+#include <chrono>
+#include <stdint.h>
+#include "../Common/Intrinsics.h"
+#ifdef _WIN32
+#define STRICT // Enable STRICT Type Checking in Windows headers
+#define WIN32_LEAN_AND_MEAN // To speed the build process exclude rarely-used services from Windows headers
+#define NOMINMAX // Exclude min/max macros from Windows header
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+enum VectorWidth { Width128, Width256, Width512, WidthCount };
+static const wchar_t* const vector_width_names[WidthCount] = { L"128", L"256", L"512" };
+
+struct WidthResult {
+	bool supported = false; // Supported by processor and operating system
+	double fp_gflops = 0; // Sustained single precision FMA throughput, in billion floating point operations per second
+	double int_gops = 0; // Sustained 32-bit integer multiply and add throughput, in billion operations per second
+	double frequency_mhz = 0; // Core frequency measured immediately after the loops
+	double frequency_drop = 0; // Relative to the scalar baseline, 0.1 means 10% lower frequency
+};
+
+struct ThroughputResult {
+	double tsc_mhz = 0; // Time stamp counter frequency
+	double baseline_mhz = 0; // Core frequency after running scalar code only
+	WidthResult widths[WidthCount];
+	VectorWidth recommended = Width128;
+};
+
+// Measure the core frequency in MHz, from the ratio of core cycles to time stamp counter ticks.
+static double _measure_frequency(double tsc_mhz)
+{
+	return tsc_mhz * core_cycles_per_tick();
+}
+
+// The throughput loops, one floating point and one integer for each width. Each iteration
+// performs a fixed number of independent operations on separate accumulators, enough to
+// cover the latency and keep all execution ports busy. Returns a value derived from the
+// accumulators, to prevent the compiler from removing the computation.
+
+static const int accumulators = 10;
+
+CPUFEATURES_TARGET("avx,fma") static float _fp_loop_128(uint64_t iterations)
+{
+	__m128 acc[accumulators];
+	for (int i = 0; i < accumulators; ++i)
+		acc[i] = _mm_set1_ps(1.0f + i);
+	const __m128 a = _mm_set1_ps(0.999999f), b = _mm_set1_ps(0.000001f);
+	for (uint64_t n = 0; n < iterations; ++n) {
+		for (int i = 0; i < accumulators; ++i)
+			acc[i] = _mm_fmadd_ps(acc[i], a, b);
+	}
+	for (int i = 1; i < accumulators; ++i)
+		acc[0] = _mm_add_ps(acc[0], acc[i]);
+	return _mm_cvtss_f32(acc[0]);
+}
+
+CPUFEATURES_TARGET("avx,fma") static float _fp_loop_256(uint64_t iterations)
+{
+	__m256 acc[accumulators];
+	for (int i = 0; i < accumulators; ++i)
+		acc[i] = _mm256_set1_ps(1.0f + i);
+	const __m256 a = _mm256_set1_ps(0.999999f), b = _mm256_set1_ps(0.000001f);
+	for (uint64_t n = 0; n < iterations; ++n) {
+		for (int i = 0; i < accumulators; ++i)
+			acc[i] = _mm256_fmadd_ps(acc[i], a, b);
+	}
+	for (int i = 1; i < accumulators; ++i)
+		acc[0] = _mm256_add_ps(acc[0], acc[i]);
+	const float result = _mm256_cvtss_f32(acc[0]);
+	_mm256_zeroupper();
+	return result;
+}
+
+CPUFEATURES_TARGET("avx512f") static float _fp_loop_512(uint64_t iterations)
+{
+	__m512 acc[accumulators];
+	for (int i = 0; i < accumulators; ++i)
+		acc[i] = _mm512_set1_ps(1.0f + i);
+	const __m512 a = _mm512_set1_ps(0.999999f), b = _mm512_set1_ps(0.000001f);
+	for (uint64_t n = 0; n < iterations; ++n) {
+		for (int i = 0; i < accumulators; ++i)
+			acc[i] = _mm512_fmadd_ps(acc[i], a, b);
+	}
+	for (int i = 1; i < accumulators; ++i)
+		acc[0] = _mm512_add_ps(acc[0], acc[i]);
+	const float result = _mm512_cvtss_f32(acc[0]);
+	_mm256_zeroupper();
+	return result;
+}
+
+CPUFEATURES_TARGET("sse4.1") static int _int_loop_128(uint64_t iterations)
+{
+	__m128i acc[accumulators];
+	for (int i = 0; i < accumulators; ++i)
+		acc[i] = _mm_set1_epi32(1 + i);
+	const __m128i a = _mm_set1_epi32(3), b = _mm_set1_epi32(7);
+	for (uint64_t n = 0; n < iterations; ++n) {
+		for (int i = 0; i < accumulators; ++i)
+			acc[i] = _mm_add_epi32(_mm_mullo_epi32(acc[i], a), b);
+	}
+	for (int i = 1; i < accumulators; ++i)
+		acc[0] = _mm_add_epi32(acc[0], acc[i]);
+	return _mm_cvtsi128_si32(acc[0]);
+}
+
+CPUFEATURES_TARGET("avx2") static int _int_loop_256(uint64_t iterations)
+{
+	__m256i acc[accumulators];
+	for (int i = 0; i < accumulators; ++i)
+		acc[i] = _mm256_set1_epi32(1 + i);
+	const __m256i a = _mm256_set1_epi32(3), b = _mm256_set1_epi32(7);
+	for (uint64_t n = 0; n < iterations; ++n) {
+		for (int i = 0; i < accumulators; ++i)
+			acc[i] = _mm256_add_epi32(_mm256_mullo_epi32(acc[i], a), b);
+	}
+	for (int i = 1; i < accumulators; ++i)
+		acc[0] = _mm256_add_epi32(acc[0], acc[i]);
+	const int result = _mm256_cvtsi256_si32(acc[0]);
+	_mm256_zeroupper();
+	return result;
+}
+
+CPUFEATURES_TARGET("avx512f") static int _int_loop_512(uint64_t iterations)
+{
+	__m512i acc[accumulators];
+	for (int i = 0; i < accumulators; ++i)
+		acc[i] = _mm512_set1_epi32(1 + i);
+	const __m512i a = _mm512_set1_epi32(3), b = _mm512_set1_epi32(7);
+	for (uint64_t n = 0; n < iterations; ++n) {
+		for (int i = 0; i < accumulators; ++i)
+			acc[i] = _mm512_add_epi32(_mm512_mullo_epi32(acc[i], a), b);
+	}
+	for (int i = 1; i < accumulators; ++i)
+		acc[0] = _mm512_add_epi32(acc[0], acc[i]);
+	const int result = _mm512_cvtsi512_si32(acc[0]);
+	_mm256_zeroupper();
+	return result;
+}
+
+static double _run_fp_loop(VectorWidth width, uint64_t iterations)
+{
+	switch (width) {
+	case Width128: return _fp_loop_128(iterations);
+	case Width256: return _fp_loop_256(iterations);
+	default: return _fp_loop_512(iterations);
+	}
+}
+
+static double _run_int_loop(VectorWidth width, uint64_t iterations)
+{
+	switch (width) {
+	case Width128: return _int_loop_128(iterations);
+	case Width256: return _int_loop_256(iterations);
+	default: return _int_loop_512(iterations);
+	}
+}
+
+// Number of 32-bit lanes in each width
+static int _lanes(VectorWidth width)
+{
+	return width == Width128 ? 4 : width == Width256 ? 8 : 16;
+}
+
+// Run a loop for at least the specified duration, doubling the iteration count until reached.
+// Returns the measured ticks, and the number of iterations executed in the last (measured) run.
+template <typename Loop>
+static uint64_t _run_calibrated(Loop loop, uint64_t min_ticks, uint64_t& iterations)
+{
+	static volatile double sink;
+	iterations = 1024;
+	for (;;) {
+		const uint64_t start = __rdtsc();
+		sink = loop(iterations);
+		const uint64_t ticks = __rdtsc() - start;
+		(void)sink; // Read back outside the measurement, the result is only stored to keep the loop from being optimized away
+		if (ticks >= min_ticks)
+			return ticks;
+		iterations *= 2;
+	}
+}
+
+static void _measure_width(VectorWidth width, double tsc_mhz, double baseline_mhz, WidthResult& result)
+{
+	const uint64_t warmup_ticks = static_cast<uint64_t>(tsc_mhz * 10000); // 10 ms, license transitions take up to about 0.5 ms
+	const uint64_t measure_ticks = static_cast<uint64_t>(tsc_mhz * 50000); // 50 ms
+	uint64_t iterations;
+	// Warm up, to reach the license level of the width before measuring
+	_run_calibrated([width](uint64_t n) { return _run_fp_loop(width, n); }, warmup_ticks, iterations);
+	// Floating point: Each FMA is two floating point operations per lane
+	uint64_t ticks = _run_calibrated([width](uint64_t n) { return _run_fp_loop(width, n); }, measure_ticks, iterations);
+	result.fp_gflops = 2.0 * accumulators * _lanes(width) * iterations * tsc_mhz / ticks / 1000.0;
+	result.frequency_mhz = _measure_frequency(tsc_mhz);
+	// Integer: Each multiply and add is two operations per lane
+	ticks = _run_calibrated([width](uint64_t n) { return _run_int_loop(width, n); }, measure_ticks, iterations);
+	result.int_gops = 2.0 * accumulators * _lanes(width) * iterations * tsc_mhz / ticks / 1000.0;
+	const double int_frequency_mhz = _measure_frequency(tsc_mhz);
+	if (int_frequency_mhz < result.frequency_mhz)
+		result.frequency_mhz = int_frequency_mhz;
+	result.frequency_drop = baseline_mhz > 0 ? 1.0 - result.frequency_mhz / baseline_mhz : 0;
+}
+
+// Recommend the widest vector width whose throughput gain over the next narrower supported
+// width is worth its additional frequency drop: The throughput must increase by at least
+// 20%, and the frequency must not drop by more than 15% relative to the narrower width.
+static VectorWidth _recommend_width(const ThroughputResult& result)
+{
+	VectorWidth recommended = Width128;
+	for (int w = Width256; w < WidthCount; ++w) {
+		const WidthResult& wider = result.widths[w];
+		const WidthResult& current = result.widths[recommended];
+		if (!wider.supported)
+			continue;
+		const double throughput_gain = wider.fp_gflops / current.fp_gflops;
+		const double frequency_loss = 1.0 - wider.frequency_mhz / current.frequency_mhz;
+		if (throughput_gain >= 1.2 && frequency_loss <= 0.15)
+			recommended = static_cast<VectorWidth>(w);
+	}
+	return recommended;
+}
+
+static ThroughputResult _measure_throughput()
+{
+	ThroughputResult result;
+	const bool fma = feature_usable(get_feature_snapshot(), Feature_FMA);
+	// The loops use VEX encoded FMA for all widths, and 32-bit integer multiplication from SSE4.1, AVX2 and AVX-512F
+	result.widths[Width128].supported = fma && runtime_has_avx() && runtime_has_sse41();
+	result.widths[Width256].supported = fma && runtime_has_avx2();
+	result.widths[Width512].supported = runtime_has_avx512f(); // Includes operating system support for ZMM state
+	if (!result.widths[Width128].supported)
+		return result;
+
+	// Pin the thread to the processor it is currently running on, so that all measurements are from the same core
+#ifdef _WIN32
+	const DWORD_PTR previous_affinity = SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << GetCurrentProcessorNumber());
+#elif defined(__linux__)
+	cpu_set_t previous_affinity, affinity;
+	const bool pinned = sched_getaffinity(0, sizeof(previous_affinity), &previous_affinity) == 0 && sched_getcpu() >= 0;
+	if (pinned) {
+		CPU_ZERO(&affinity);
+		CPU_SET(sched_getcpu(), &affinity);
+		sched_setaffinity(0, sizeof(affinity), &affinity);
+	}
+#endif
+
+	result.tsc_mhz = measure_tsc_frequency();
+	// Warm up with scalar code only, then measure the baseline frequency
+	const auto start = std::chrono::steady_clock::now();
+	while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(20))
+		_measure_frequency(result.tsc_mhz);
+	result.baseline_mhz = _measure_frequency(result.tsc_mhz);
+
+	for (int w = Width128; w < WidthCount; ++w) {
+		if (result.widths[w].supported)
+			_measure_width(static_cast<VectorWidth>(w), result.tsc_mhz, result.baseline_mhz, result.widths[w]);
+	}
+	result.recommended = _recommend_width(result);
+
+#ifdef _WIN32
+	if (previous_affinity)
+		SetThreadAffinityMask(GetCurrentThread(), previous_affinity);
+#elif defined(__linux__)
+	if (pinned)
+		sched_setaffinity(0, sizeof(previous_affinity), &previous_affinity);
+#endif
+	return result;
+}
+
+int runtime_preferred_vector_width(void)
+{
+	static const int preferred_vector_width = [] {
+		const ThroughputResult result = _measure_throughput();
+		if (!result.widths[Width128].supported)
+			return 0;
+		return 128 << result.recommended;
+	}();
+	return preferred_vector_width;
+}
+
+int runtime_prefer_avx512(void)
+{
+	return runtime_has_avx512f() && runtime_preferred_vector_width() >= 512;
+}
+
+void print_avx_throughput(std::wostream& stream, bool print_xml)
+{
+	const ThroughputResult result = _measure_throughput();
+	const std::streamsize precision = stream.precision(4);
+	if (print_xml) {
+		stream << L"<cpu>" << std::endl;
+		stream << L"<throughput tsc_mhz=\"" << result.tsc_mhz << L"\" baseline_mhz=\"" << result.baseline_mhz << L"\">" << std::endl;
+		for (int w = Width128; w < WidthCount; ++w) {
+			const WidthResult& width = result.widths[w];
+			stream << L"<width bits=\"" << vector_width_names[w] << L"\" supported=\"" << (width.supported ? L"true" : L"false") << L"\"";
+			if (width.supported) {
+				stream << L" fp_gflops=\"" << width.fp_gflops << L"\" int_gops=\"" << width.int_gops
+					<< L"\" frequency_mhz=\"" << width.frequency_mhz << L"\" frequency_drop=\"" << width.frequency_drop << L"\"";
+			}
+			stream << L"/>" << std::endl;
+		}
+		stream << L"</throughput>" << std::endl;
+		if (result.widths[Width128].supported)
+			stream << L"<recommended_width>" << vector_width_names[result.recommended] << L"</recommended_width>" << std::endl;
+		stream << L"</cpu>" << std::endl;
+	} else if (!result.widths[Width128].supported) {
+		stream << L"Measurement requires FMA and AVX support" << std::endl;
+	} else {
+		stream << L"TSC frequency " << result.tsc_mhz << L" MHz, baseline core frequency " << result.baseline_mhz << L" MHz" << std::endl;
+		for (int w = Width128; w < WidthCount; ++w) {
+			const WidthResult& width = result.widths[w];
+			stream << vector_width_names[w] << L"-bit";
+			if (width.supported) {
+				stream << L": FMA " << width.fp_gflops << L" GFLOPS, integer " << width.int_gops << L" GOPS, frequency "
+					<< width.frequency_mhz << L" MHz (" << (width.frequency_drop * 100) << L"% drop)" << std::endl;
+			} else {
+				stream << L" not supported" << std::endl;
+			}
+		}
+		stream << L"Recommended vector width " << vector_width_names[result.recommended] << L"-bit" << std::endl;
+	}
+	stream.precision(precision);
+}
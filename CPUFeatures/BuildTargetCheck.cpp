@@ -0,0 +1,13 @@
+//
+// The startup check of the build target (see Common/BuildTarget.h), in a translation unit compiled for
+// the baseline whatever the rest of the program is built for, so that on a processor lacking the build
+// target the snapshot and the check run, and print their message, instead of faulting themselves. The
+// options are set for this file alone in CMakeLists.txt and CPUFeatures.vcxproj.
+//
+#include "Targetver.h"
+#include "../Common/BuildTarget.h"
+
+void require_build_target_baseline(const Feature* features, size_t count)
+{
+	require_build_target(build_target_mask(features, count));
+}
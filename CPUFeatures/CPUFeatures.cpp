@@ -3,6 +3,8 @@
 //
 // This implementation is detecting only the most relevant features, and from both
 // Intel/AMD as well as ARM processors, and can be compiled on Microsoft, Apple and Android.
+// On AArch64 the features added to the libsodium set (SVE, SVE2, LSE, DOTPROD, I8MM and BF16)
+// are from the ARM registry, Common/ARMFeatures.h.
 // On Microsoft it mainly uses the Microsoft-specific __cpuid intrinsic, on other platforms
 // it resort to inline assembly code, generating the cpuid instruction, available on x86 and x64,
 // that queries the processor for information.
@@ -13,6 +15,8 @@
 // See also: https://docs.microsoft.com/en-us/cpp/intrinsics/cpuid-cpuidex
 //
 #include "Targetver.h"
+#include "Runtime.h"
+#include "Output.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <iostream>
@@ -70,48 +74,26 @@
 # include <intrin.h>
 #endif
 
-typedef struct CPUFeatures_ {
-    int has_neon; // ARM specific (Advanced SIMD extension for ARM)
-    int has_armcrypto;
-    int has_sse2;
-    int has_sse3;
-    int has_ssse3;
-    int has_sse41;
-    int has_avx;
-    int has_avx2;
-    int has_avx512f;
-    int has_pclmul;
-    int has_aesni;
-    int has_rdrand;
-} CPUFeatures;
-
-
-#define CPUID_EBX_AVX2    0x00000020
-#define CPUID_EBX_AVX512F 0x00010000
-
-#define CPUID_ECX_SSE3    0x00000001
-#define CPUID_ECX_PCLMUL  0x00000002
-#define CPUID_ECX_SSSE3   0x00000200
-#define CPUID_ECX_SSE41   0x00080000
-#define CPUID_ECX_AESNI   0x02000000
-#define CPUID_ECX_XSAVE   0x04000000
-#define CPUID_ECX_OSXSAVE 0x08000000
-#define CPUID_ECX_AVX     0x10000000
-#define CPUID_ECX_RDRAND  0x40000000
-
-#define CPUID_EDX_SSE2    0x04000000
-
-#define XCR0_SSE       0x00000002
-#define XCR0_AVX       0x00000004
-#define XCR0_OPMASK    0x00000020
-#define XCR0_ZMM_HI256 0x00000040
-#define XCR0_HI16_ZMM  0x00000080
+
+
+// Bit positions of the features, and XCR0 state components, from the shared registry
+#include "../Common/FeatureRegistry.h"
+#include "../Common/ARMFeatures.h"
 
 static int _arm_cpu_features(CPUFeatures * const cpu_features)
 {
     cpu_features->has_neon = 0;
     cpu_features->has_armcrypto = 0;
 
+    const ArmFeatureSnapshot arm_features = get_arm_feature_snapshot();
+    cpu_features->has_sve = arm_feature_supported(arm_features, ArmFeature_SVE);
+    cpu_features->has_sve2 = arm_feature_supported(arm_features, ArmFeature_SVE2);
+    cpu_features->has_lse = arm_feature_supported(arm_features, ArmFeature_LSE);
+    cpu_features->has_dotprod = arm_feature_supported(arm_features, ArmFeature_DOTPROD);
+    cpu_features->has_i8mm = arm_feature_supported(arm_features, ArmFeature_I8MM);
+    cpu_features->has_bf16 = arm_feature_supported(arm_features, ArmFeature_BF16);
+    cpu_features->sve_vector_length = static_cast<int>(arm_features.sve_vector_length);
+
 #ifndef __ARM_ARCH
     return -1; /* LCOV_EXCL_LINE */
 #endif
@@ -251,25 +233,25 @@ static int _intel_cpu_features(CPUFeatures * const cpu_features)
     }
     _cpuid(cpu_info, 0x00000001);
 #ifdef HAVE_EMMINTRIN_H
-    cpu_features->has_sse2 = ((cpu_info[3] & CPUID_EDX_SSE2) != 0x0);
+    cpu_features->has_sse2 = feature_in_registers(cpu_info, Feature_SSE2);
 #else
     cpu_features->has_sse2   = 0;
 #endif
 
 #ifdef HAVE_PMMINTRIN_H
-    cpu_features->has_sse3 = ((cpu_info[2] & CPUID_ECX_SSE3) != 0x0);
+    cpu_features->has_sse3 = feature_in_registers(cpu_info, Feature_SSE3);
 #else
     cpu_features->has_sse3   = 0;
 #endif
 
 #ifdef HAVE_TMMINTRIN_H
-    cpu_features->has_ssse3 = ((cpu_info[2] & CPUID_ECX_SSSE3) != 0x0);
+    cpu_features->has_ssse3 = feature_in_registers(cpu_info, Feature_SSSE3);
 #else
     cpu_features->has_ssse3  = 0;
 #endif
 
 #ifdef HAVE_SMMINTRIN_H
-    cpu_features->has_sse41 = ((cpu_info[2] & CPUID_ECX_SSE41) != 0x0);
+    cpu_features->has_sse41 = feature_in_registers(cpu_info, Feature_SSE41);
 #else
     cpu_features->has_sse41  = 0;
 #endif
@@ -278,8 +260,8 @@ static int _intel_cpu_features(CPUFeatures * const cpu_features)
 
     (void) xcr0;
 #ifdef HAVE_AVXINTRIN_H
-    if ((cpu_info[2] & (CPUID_ECX_AVX | CPUID_ECX_XSAVE | CPUID_ECX_OSXSAVE)) ==
-        (CPUID_ECX_AVX | CPUID_ECX_XSAVE | CPUID_ECX_OSXSAVE)) {
+    if (feature_in_registers(cpu_info, Feature_AVX) && feature_in_registers(cpu_info, Feature_XSAVE) &&
+        feature_in_registers(cpu_info, Feature_OSXSAVE)) {
         xcr0 = 0U;
 # if defined(HAVE__XGETBV) || \
         (defined(_MSC_VER) && defined(_XCR_XFEATURE_ENABLED_MASK) && _MSC_FULL_VER >= 160040219)
@@ -307,7 +289,7 @@ static int _intel_cpu_features(CPUFeatures * const cpu_features)
                              : "c"((uint32_t) 0U)
                              : "%edx");
 # endif
-        if ((xcr0 & (XCR0_SSE | XCR0_AVX)) == (XCR0_SSE | XCR0_AVX)) {
+        if ((xcr0 & feature_table[Feature_AVX].xcr0) == feature_table[Feature_AVX].xcr0) {
             cpu_features->has_avx = 1;
         }
     }
@@ -319,7 +301,7 @@ static int _intel_cpu_features(CPUFeatures * const cpu_features)
         unsigned int cpu_info7[4];
 
         _cpuid(cpu_info7, 0x00000007);
-        cpu_features->has_avx2 = ((cpu_info7[1] & CPUID_EBX_AVX2) != 0x0);
+        cpu_features->has_avx2 = feature_in_registers(cpu_info7, Feature_AVX2);
     }
 #endif
 
@@ -330,9 +312,8 @@ static int _intel_cpu_features(CPUFeatures * const cpu_features)
 
         _cpuid(cpu_info7, 0x00000007);
         /* LCOV_EXCL_START */
-        if ((cpu_info7[1] & CPUID_EBX_AVX512F) == CPUID_EBX_AVX512F &&
-            (xcr0 & (XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM))
-            == (XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM)) {
+        if (feature_in_registers(cpu_info7, Feature_AVX512F) &&
+            (xcr0 & feature_table[Feature_AVX512F].xcr0) == feature_table[Feature_AVX512F].xcr0) {
             cpu_features->has_avx512f = 1;
         }
         /* LCOV_EXCL_STOP */
@@ -340,15 +321,15 @@ static int _intel_cpu_features(CPUFeatures * const cpu_features)
 #endif
 
 #ifdef HAVE_WMMINTRIN_H
-    cpu_features->has_pclmul = ((cpu_info[2] & CPUID_ECX_PCLMUL) != 0x0);
-    cpu_features->has_aesni  = ((cpu_info[2] & CPUID_ECX_AESNI) != 0x0);
+    cpu_features->has_pclmul = feature_in_registers(cpu_info, Feature_PCLMULQDQ);
+    cpu_features->has_aesni  = feature_in_registers(cpu_info, Feature_AES);
 #else
     cpu_features->has_pclmul = 0;
     cpu_features->has_aesni  = 0;
 #endif
 
 #ifdef HAVE_RDRAND
-    cpu_features->has_rdrand = ((cpu_info[2] & CPUID_ECX_RDRAND) != 0x0);
+    cpu_features->has_rdrand = feature_in_registers(cpu_info, Feature_RDRAND);
 #else
     cpu_features->has_rdrand = 0;
 #endif
@@ -365,47 +346,96 @@ static int _get_cpu_features(CPUFeatures * const cpu_features)
     return ret;
 }
 
-static void _print_feature_support(std::wostream& stream, const wchar_t* feature_name, bool is_supported, bool print_if_supported, bool print_if_unsupported, bool print_xml) {
-    if ((is_supported && print_if_supported) || (!is_supported && print_if_unsupported)) {
-        if (print_xml) {
-            stream << L"<feature name=\"" << feature_name << L"\" supported=\"" << (is_supported ? "true" : "false") << "\"/>" << std::endl;
-        } else {
-            if (print_if_supported && print_if_unsupported) {
-                stream << feature_name << (is_supported ? " supported" : " not supported") << std::endl;
-            } else {
-                stream << feature_name << std::endl;
-            }
-        }
-    }
-};
+typedef struct RuntimeCPUFeatures_ {
+    CPUFeatures features;
+    int         result; // Return value from _get_cpu_features
+} RuntimeCPUFeatures;
+
+static const RuntimeCPUFeatures& _runtime_get_cpu_features(void)
+{
+    static const RuntimeCPUFeatures runtime = [] { // Initialized once, thread-safe
+        RuntimeCPUFeatures detected = {};
+        detected.result = _get_cpu_features(&detected.features);
+        return detected;
+    }();
+    return runtime;
+}
+
+static const CPUFeatures& _runtime_cpu_features(void)
+{
+    return _runtime_get_cpu_features().features;
+}
+
+int runtime_get_cpu_features(void)
+{
+    return _runtime_get_cpu_features().result;
+}
 
-static void _print_cpu_features(std::wostream& stream, CPUFeatures * const cpu_features, bool print_supported, bool print_unsupported, bool print_xml)
+const CPUFeatures* runtime_cpu_features(void)
 {
-    _print_feature_support(std::wcout, L"NEON", cpu_features->has_neon, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"ARMCRYPTO", cpu_features->has_armcrypto, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"SSE2", cpu_features->has_sse2, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"SSE3", cpu_features->has_sse3, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"SSSE3", cpu_features->has_ssse3, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"SSE4.1", cpu_features->has_sse41, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"AVX", cpu_features->has_avx, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"AVX2", cpu_features->has_avx2, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"AVX512F", cpu_features->has_avx512f, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"PCLMUL", cpu_features->has_pclmul, print_supported, print_unsupported, print_xml);
-    _print_feature_support(std::wcout, L"AES-NI", cpu_features->has_aesni, print_supported, print_unsupported, print_xml);
-	_print_feature_support(std::wcout, L"RDRAND", cpu_features->has_rdrand, print_supported, print_unsupported, print_xml);
+    return &_runtime_cpu_features();
 }
 
-void print_cpu_features(std::wostream& stream, bool print_supported, bool print_unsupported, bool print_xml)
+int runtime_has_neon(void) { return _runtime_cpu_features().has_neon; }
+int runtime_has_armcrypto(void) { return _runtime_cpu_features().has_armcrypto; }
+int runtime_has_sve(void) { return _runtime_cpu_features().has_sve; }
+int runtime_has_sve2(void) { return _runtime_cpu_features().has_sve2; }
+int runtime_has_lse(void) { return _runtime_cpu_features().has_lse; }
+int runtime_has_dotprod(void) { return _runtime_cpu_features().has_dotprod; }
+int runtime_has_i8mm(void) { return _runtime_cpu_features().has_i8mm; }
+int runtime_has_bf16(void) { return _runtime_cpu_features().has_bf16; }
+int runtime_sve_vector_length(void) { return _runtime_cpu_features().sve_vector_length; }
+int runtime_has_sse2(void) { return _runtime_cpu_features().has_sse2; }
+int runtime_has_sse3(void) { return _runtime_cpu_features().has_sse3; }
+int runtime_has_ssse3(void) { return _runtime_cpu_features().has_ssse3; }
+int runtime_has_sse41(void) { return _runtime_cpu_features().has_sse41; }
+int runtime_has_avx(void) { return _runtime_cpu_features().has_avx; }
+int runtime_has_avx2(void) { return _runtime_cpu_features().has_avx2; }
+int runtime_has_avx512f(void) { return _runtime_cpu_features().has_avx512f; }
+int runtime_has_pclmul(void) { return _runtime_cpu_features().has_pclmul; }
+int runtime_has_aesni(void) { return _runtime_cpu_features().has_aesni; }
+int runtime_has_rdrand(void) { return _runtime_cpu_features().has_rdrand; }
+
+static void _print_cpu_features(FeatureListWriter& writer, const CPUFeatures * const cpu_features)
 {
-    CPUFeatures cpu_features;
-    _get_cpu_features(&cpu_features);
-    if (print_xml) {
-        stream << L"<cpu>" << std::endl;
-        stream << L"<features>" << std::endl;
+    writer.feature(L"NEON", cpu_features->has_neon, cpu_features->has_neon);
+    writer.feature(L"ARMCRYPTO", cpu_features->has_armcrypto, cpu_features->has_armcrypto);
+    writer.feature(L"SVE", cpu_features->has_sve, cpu_features->has_sve);
+    writer.feature(L"SVE2", cpu_features->has_sve2, cpu_features->has_sve2);
+    writer.feature(L"LSE", cpu_features->has_lse, cpu_features->has_lse);
+    writer.feature(L"DOTPROD", cpu_features->has_dotprod, cpu_features->has_dotprod);
+    writer.feature(L"I8MM", cpu_features->has_i8mm, cpu_features->has_i8mm);
+    writer.feature(L"BF16", cpu_features->has_bf16, cpu_features->has_bf16);
+    writer.feature(L"SSE2", cpu_features->has_sse2, cpu_features->has_sse2);
+    writer.feature(L"SSE3", cpu_features->has_sse3, cpu_features->has_sse3);
+    writer.feature(L"SSSE3", cpu_features->has_ssse3, cpu_features->has_ssse3);
+    writer.feature(L"SSE4.1", cpu_features->has_sse41, cpu_features->has_sse41);
+    writer.feature(L"AVX", cpu_features->has_avx, cpu_features->has_avx);
+    writer.feature(L"AVX2", cpu_features->has_avx2, cpu_features->has_avx2);
+    writer.feature(L"AVX512F", cpu_features->has_avx512f, cpu_features->has_avx512f);
+    writer.feature(L"PCLMUL", cpu_features->has_pclmul, cpu_features->has_pclmul);
+    writer.feature(L"AES-NI", cpu_features->has_aesni, cpu_features->has_aesni);
+	writer.feature(L"RDRAND", cpu_features->has_rdrand, cpu_features->has_rdrand);
+}
+
+void print_cpu_features(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format)
+{
+    const CPUFeatures* cpu_features = runtime_cpu_features();
+    FeatureListWriter writer(stream, format, print_supported, print_unsupported, false);
+    if (format == OutputXML) {
+        stream << L"<cpu>" << L'\n';
+        stream << L"<features>" << L'\n';
+    } else if (format == OutputJSON) {
+        stream << L"{\"features\":[";
     }
-    _print_cpu_features(std::wcout, &cpu_features, print_supported, print_unsupported, print_xml);
-    if (print_xml) {
-        stream << L"</features>" << std::endl;
-        stream << L"</cpu>" << std::endl;
+    _print_cpu_features(writer, cpu_features);
+    if (format == OutputXML) {
+        stream << L"</features>" << L'\n';
+        stream << L"</cpu>" << L'\n';
+    } else if (format == OutputJSON) {
+        stream << L"\n]}" << L'\n';
+    } else if (format == OutputHex) {
+        writer.write_bitmask();
+        stream << L'\n';
     }
-}
\ No newline at end of file
+}
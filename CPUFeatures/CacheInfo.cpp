@@ -0,0 +1,99 @@
+//
+// Reporting cache and translation lookaside buffer (TLB) parameters of the executing processor:
+// Size, associativity, line size and number of logical processors sharing each cache level,
+// and number of entries, associativity and page sizes of each TLB. The decoding is done in
+// the shared header CacheInfo.h, from Intel function ids 4, 0x18 and 2, and AMD function ids
+// 0x8000001D, 0x80000005, 0x80000006 and 0x80000019.
+//
+// Uses the Microsoft-specific intrinsics, which build with GCC and Clang through the portable shim Intrinsics.h.
+//
+#include "Targetver.h"
+#include "../Common/CacheInfo.h"
+#include <iostream>
+
+static const wchar_t* cache_type_names[] = { L"null", L"data", L"instruction", L"unified" };
+static const wchar_t* tlb_type_names[] = { L"null", L"data", L"instruction", L"unified", L"load", L"store" };
+
+static void _print_page_sizes(std::wostream& stream, unsigned int page_sizes)
+{
+	static const struct { unsigned int page_size; const wchar_t* name; } names[] = {
+		{ TLB_PAGE_4K, L"4K" }, { TLB_PAGE_2M, L"2M" }, { TLB_PAGE_4M, L"4M" }, { TLB_PAGE_1G, L"1G" } };
+	bool first = true;
+	for (const auto& name : names) {
+		if (page_sizes & name.page_size) {
+			stream << (first ? L"" : L",") << name.name;
+			first = false;
+		}
+	}
+}
+
+static void _print_size(std::wostream& stream, unsigned int size)
+{
+	if (size >= 1024 * 1024 && size % (1024 * 1024) == 0)
+		stream << size / (1024 * 1024) << L" MB";
+	else if (size >= 1024 && size % 1024 == 0)
+		stream << size / 1024 << L" KB";
+	else
+		stream << size << L" bytes";
+}
+
+void print_cache_info(std::wostream& stream, bool print_xml)
+{
+	const CacheInfo info = get_cache_info();
+	if (print_xml) {
+		stream << L"<cpu>" << std::endl;
+		stream << L"<caches>" << std::endl;
+		for (unsigned int i = 0; i < info.cache_count; ++i) {
+			const CacheDescriptor& cache = info.caches[i];
+			stream << L"<cache level=\"" << cache.level << L"\" type=\"" << cache_type_names[cache.type & 3] << L"\" size=\"" << cache.size
+				<< L"\" ways=\"" << cache.ways << L"\" line_size=\"" << cache.line_size << L"\" partitions=\"" << cache.partitions
+				<< L"\" sets=\"" << cache.sets << L"\" shared_by=\"" << cache.shared_by
+				<< L"\" fully_associative=\"" << (cache.fully_associative ? L"true" : L"false")
+				<< L"\" inclusive=\"" << (cache.inclusive ? L"true" : L"false") << L"\"/>" << std::endl;
+		}
+		stream << L"</caches>" << std::endl;
+		stream << L"<tlbs>" << std::endl;
+		for (unsigned int i = 0; i < info.tlb_count; ++i) {
+			const TLBDescriptor& tlb = info.tlbs[i];
+			stream << L"<tlb level=\"" << tlb.level << L"\" type=\"" << (tlb.type <= TLBTypeStore ? tlb_type_names[tlb.type] : L"unknown") << L"\" page_sizes=\"";
+			_print_page_sizes(stream, tlb.page_sizes);
+			stream << L"\" entries=\"" << tlb.entries << L"\" ways=\"" << tlb.ways << L"\" shared_by=\"" << tlb.shared_by
+				<< L"\" fully_associative=\"" << (tlb.fully_associative ? L"true" : L"false") << L"\"/>" << std::endl;
+		}
+		stream << L"</tlbs>" << std::endl;
+		if (info.prefetch_size)
+			stream << L"<prefetch_size>" << info.prefetch_size << L"</prefetch_size>" << std::endl;
+		stream << L"</cpu>" << std::endl;
+	} else {
+		for (unsigned int i = 0; i < info.cache_count; ++i) {
+			const CacheDescriptor& cache = info.caches[i];
+			stream << L"L" << cache.level << L" " << cache_type_names[cache.type & 3] << L" cache: ";
+			_print_size(stream, cache.size);
+			if (cache.fully_associative)
+				stream << L", fully associative";
+			else
+				stream << L", " << cache.ways << L"-way";
+			stream << L", " << cache.line_size << L" byte line, " << cache.sets << L" sets";
+			if (cache.shared_by)
+				stream << L", shared by " << cache.shared_by << L" logical processors";
+			if (cache.inclusive)
+				stream << L", inclusive";
+			stream << std::endl;
+		}
+		for (unsigned int i = 0; i < info.tlb_count; ++i) {
+			const TLBDescriptor& tlb = info.tlbs[i];
+			stream << L"L" << tlb.level << L" " << (tlb.type <= TLBTypeStore ? tlb_type_names[tlb.type] : L"unknown") << L" TLB: ";
+			_print_page_sizes(stream, tlb.page_sizes);
+			stream << L" pages, " << tlb.entries << L" entries";
+			if (tlb.fully_associative)
+				stream << L", fully associative";
+			else if (tlb.ways)
+				stream << L", " << tlb.ways << L"-way";
+			if (tlb.shared_by)
+				stream << L", shared by " << tlb.shared_by << L" logical processors";
+			stream << std::endl;
+		}
+		if (info.prefetch_size)
+			stream << L"Prefetch size: " << info.prefetch_size << L" bytes" << std::endl;
+	}
+}
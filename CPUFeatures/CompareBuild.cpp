@@ -0,0 +1,110 @@
+//
+// Comparing a build target with the executing processor: The instruction set extensions of the build
+// that are not usable, which means a binary built for it can not run, and the headroom, the ones
+// usable that the build leaves unused, the difference in x86-64 level and in vector width.
+// See Common/BuildTarget.h.
+//
+// The build target is the one this program is compiled for, recorded from the predefined macros of
+// the compiler, or an x86-64 level, e.g. x86-64-v3 for binaries built with -march=x86-64-v3 or
+// approximately /arch:AVX2. Returns false when the build target can not run on the processor.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <string>
+#include <string.h>
+#include "../Common/BuildTarget.h"
+#include "Output.h"
+
+static std::wstring _widen(const char* text)
+{
+	return std::wstring(text, text + strlen(text));
+}
+
+// The features of a mask, as XML elements, JSON strings or a line of text.
+static void _print_features(std::wostream& stream, const FeatureMask& mask, OutputFormat format)
+{
+	bool first = true;
+	for (int i = 0; i < FeatureCount; ++i) {
+		if (!feature_mask_test(mask, static_cast<Feature>(i)))
+			continue;
+		if (format == OutputXML)
+			stream << L"<feature name=\"" << _widen(feature_table[i].name) << L"\"/>" << L'\n';
+		else if (format == OutputJSON)
+			stream << (first ? L"\"" : L",\"") << _widen(feature_table[i].name) << L'"';
+		else
+			stream << L' ' << _widen(feature_table[i].name);
+		first = false;
+	}
+}
+
+bool print_compare_build(std::wostream& stream, const std::string& level_name, OutputFormat format)
+{
+	FeatureMask build = build_target_features();
+	if (!level_name.empty()) {
+		int level = X86LevelV1;
+		while (level < X86LevelCount && level_name != x86_level_names[level])
+			++level;
+		if (level == X86LevelCount) {
+			std::wcerr << L"Unknown x86-64 level " << _widen(level_name.c_str()) << L", expected x86-64-v1, x86-64-v2, x86-64-v3 or x86-64-v4" << std::endl;
+			return false;
+		}
+		build = build_target_features_of_level(static_cast<X86Level>(level));
+	}
+	const FeatureSnapshot snapshot = get_feature_snapshot();
+	FeatureMask missing, unused;
+	const bool compatible = check_build_target(build, snapshot, &missing, &unused);
+	const FeatureMask host = build_target_host_features(snapshot);
+	const std::wstring target = level_name.empty() ? L"this program" : _widen(level_name.c_str());
+	const X86Level build_level = build_target_level(build);
+	const X86Level host_level = isa_level(snapshot);
+	const unsigned int build_width = build_target_vector_width(build);
+	const unsigned int host_width = build_target_vector_width(host);
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<compare_build target=\"" << target << L"\" compatible=\"" << (compatible ? L"true" : L"false")
+			<< L"\" build_level=\"" << x86_level_names[build_level] << L"\" host_level=\"" << x86_level_names[host_level]
+			<< L"\" build_vector_width=\"" << build_width << L"\" host_vector_width=\"" << host_width << L"\">" << L'\n';
+		stream << L"<build>" << L'\n';
+		_print_features(stream, build, format);
+		stream << L"</build>" << L'\n';
+		stream << L"<missing>" << L'\n';
+		_print_features(stream, missing, format);
+		stream << L"</missing>" << L'\n';
+		stream << L"<unused>" << L'\n';
+		_print_features(stream, unused, format);
+		stream << L"</unused>" << L'\n';
+		stream << L"</compare_build>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"compare_build\":{\"target\":\"" << target << L"\",\"compatible\":" << (compatible ? L"true" : L"false")
+			<< L",\"build_level\":\"" << x86_level_names[build_level] << L"\",\"host_level\":\"" << x86_level_names[host_level]
+			<< L"\",\"build_vector_width\":" << build_width << L",\"host_vector_width\":" << host_width << L",\"build\":[";
+		_print_features(stream, build, format);
+		stream << L"],\"missing\":[";
+		_print_features(stream, missing, format);
+		stream << L"],\"unused\":[";
+		_print_features(stream, unused, format);
+		stream << L"]}}" << L'\n';
+	} else {
+		stream << L"Build target (" << target << L"): " << x86_level_names[build_level] << L", " << build_width << L"-bit vectors" << L'\n';
+		stream << L"Instruction sets:";
+		_print_features(stream, build, format);
+		stream << L'\n';
+		stream << L"Processor: " << x86_level_names[host_level] << L", " << host_width << L"-bit vectors" << L'\n';
+		if (!compatible) {
+			stream << L"Not usable on this processor, the build can not run:";
+			_print_features(stream, missing, format);
+			stream << L'\n';
+		}
+		if (host_level > build_level)
+			stream << L"Unused: " << host_level - build_level << (host_level - build_level == 1 ? L" level" : L" levels") << L", -march=" << x86_level_names[host_level] << L" can run" << L'\n';
+		if (host_width > build_width)
+			stream << L"Unused: " << host_width - build_width << L" bits of vector width" << L'\n';
+		stream << L"Unused: " << feature_mask_count(unused) << L" instruction set extensions";
+		if (feature_mask_count(unused))
+			stream << L':';
+		_print_features(stream, unused, format);
+		stream << L'\n';
+	}
+	return compatible;
+}
@@ -0,0 +1,144 @@
+//
+// Reporting whether all logical processors report the same features: The features usable on all of
+// them, which are the only ones safe for threads that are not pinned, the features usable on only some
+// of them, and each class of logical processors with the same features, signature and core type,
+// with the features it lacks. The capture on each logical processor, in parallel across all processor
+// groups, is done in the shared header Consistency.h.
+//
+// Returns false when the features are not consistent, or could not be checked on every logical
+// processor, for use as a check in scripts.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <string>
+#include <string.h>
+#include "../Common/Consistency.h"
+#include "Output.h"
+
+static const wchar_t* _core_type_name(CoreType core_type)
+{
+	switch (core_type) {
+	case CoreTypePerformance: return L"performance";
+	case CoreTypeEfficiency: return L"efficiency";
+	default: return L"unknown";
+	}
+}
+
+static std::wstring _feature_label(int feature)
+{
+	const char* label = feature_table[feature].label;
+	return std::wstring(label, label + strlen(label));
+}
+
+// The features of a mask, as XML elements, JSON strings or a line of text.
+static void _print_features(std::wostream& stream, const FeatureMask& mask, OutputFormat format)
+{
+	bool first = true;
+	for (int i = 0; i < FeatureCount; ++i) {
+		if (!feature_mask_test(mask, static_cast<Feature>(i)))
+			continue;
+		if (format == OutputXML)
+			stream << L"<feature name=\"" << _feature_label(i) << L"\"/>" << L'\n';
+		else if (format == OutputJSON)
+			stream << (first ? L"\"" : L",\"") << _feature_label(i) << L'"';
+		else
+			stream << L' ' << _feature_label(i);
+		first = false;
+	}
+}
+
+static void _print_processors(std::wostream& stream, const FeatureConsistency& consistency, const ProcessorClass& processor_class, OutputFormat format)
+{
+	for (size_t i = 0; i < processor_class.processors.size(); ++i) {
+		const ProcessorFeatures& processor = consistency.processors[processor_class.processors[i]];
+		if (format == OutputJSON)
+			stream << (i ? L",\"" : L"\"") << processor.group << L':' << processor.number << L'"';
+		else
+			stream << (i ? L" " : L"") << processor.group << L':' << processor.number;
+	}
+}
+
+bool print_consistency(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format)
+{
+	const FeatureConsistency consistency = get_feature_consistency();
+	const bool consistent = features_consistent(consistency);
+	FeatureListWriter writer(stream, format, print_supported, print_unsupported, false);
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<consistency logical_processors=\"" << consistency.processors.size() << L"\" consistent=\"" << (consistent ? L"true" : L"false")
+			<< L"\" mixed_signatures=\"" << (consistency.mixed_signatures ? L"true" : L"false") << L"\" unpinned=\"" << consistency.unpinned << L"\">" << L'\n';
+		stream << L"<intersection>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"consistency\":{\"logical_processors\":" << consistency.processors.size() << L",\"consistent\":" << (consistent ? L"true" : L"false")
+			<< L",\"mixed_signatures\":" << (consistency.mixed_signatures ? L"true" : L"false") << L",\"unpinned\":" << consistency.unpinned << L",\"intersection\":[";
+	} else {
+		stream << consistency.processors.size() << L" logical processors in " << consistency.classes.size() << (consistency.classes.size() == 1 ? L" class" : L" classes") << L", "
+			<< (consistent ? L"all with the same features" : feature_mask_count(consistency.asymmetric) ? L"with asymmetric features, only the intersection is safe for threads that are not pinned"
+				: L"not verified on all logical processors") << L'\n';
+		if (consistency.unpinned)
+			stream << consistency.unpinned << L" logical processors could not be pinned and were not checked" << L'\n';
+		if (consistency.mixed_signatures)
+			stream << L"Processors of different family, model or stepping" << L'\n';
+		stream << L"Features usable on all logical processors:" << L'\n';
+	}
+	for (int i = 0; i < FeatureCount; ++i) {
+		const bool usable = feature_mask_test(consistency.intersection, static_cast<Feature>(i));
+		writer.feature(_feature_label(i).c_str(), usable, usable);
+	}
+	if (format == OutputXML) {
+		stream << L"</intersection>" << L'\n';
+		stream << L"<asymmetric>" << L'\n';
+		_print_features(stream, consistency.asymmetric, format);
+		stream << L"</asymmetric>" << L'\n';
+		stream << L"<classes>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"\n],\"asymmetric\":[";
+		_print_features(stream, consistency.asymmetric, format);
+		stream << L"],\"classes\":[";
+	} else if (!consistent) {
+		stream << L"Asymmetric features:";
+		_print_features(stream, consistency.asymmetric, format);
+		stream << L'\n';
+	}
+	for (size_t c = 0; c < consistency.classes.size(); ++c) {
+		const ProcessorClass& processor_class = consistency.classes[c];
+		if (format == OutputXML) {
+			stream << L"<class signature=\"0x" << std::hex << processor_class.signature << std::dec << L"\" core_type=\"" << _core_type_name(processor_class.core_type)
+				<< L"\" logical_processors=\"" << processor_class.processors.size() << L"\" packages=\"" << processor_class.packages.size() << L"\">" << L'\n';
+			stream << L"<processors>";
+			_print_processors(stream, consistency, processor_class, format);
+			stream << L"</processors>" << L'\n';
+			stream << L"<missing>" << L'\n';
+			_print_features(stream, processor_class.missing, format);
+			stream << L"</missing>" << L'\n';
+			stream << L"</class>" << L'\n';
+		} else if (format == OutputJSON) {
+			stream << (c ? L",\n{" : L"\n{") << L"\"signature\":" << processor_class.signature << L",\"core_type\":\"" << _core_type_name(processor_class.core_type)
+				<< L"\",\"packages\":" << processor_class.packages.size() << L",\"processors\":[";
+			_print_processors(stream, consistency, processor_class, format);
+			stream << L"],\"missing\":[";
+			_print_features(stream, processor_class.missing, format);
+			stream << L"]}";
+		} else {
+			stream << L"Class " << c + 1 << L": " << processor_class.processors.size() << L" logical processors in " << processor_class.packages.size()
+				<< (processor_class.packages.size() == 1 ? L" package" : L" packages") << L", signature 0x" << std::hex << processor_class.signature << std::dec
+				<< L", core type " << _core_type_name(processor_class.core_type) << L'\n';
+			stream << L"Logical processors (group:number): ";
+			_print_processors(stream, consistency, processor_class, format);
+			stream << L'\n';
+			if (feature_mask_count(processor_class.missing)) {
+				stream << L"Missing:";
+				_print_features(stream, processor_class.missing, format);
+				stream << L'\n';
+			}
+		}
+	}
+	if (format == OutputXML) {
+		stream << L"</classes>" << L'\n';
+		stream << L"</consistency>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"\n]}}" << L'\n';
+	}
+	return consistent;
+}
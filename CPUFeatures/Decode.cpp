@@ -0,0 +1,306 @@
+//
+// Decoding features, ISA level and caches of many hosts from a file of raw cpuid data collected
+// elsewhere, e.g. from a whole fleet, without executing cpuid. The decoders are the same as for the
+// executing processor, reading the registers from a dump source instead (see CPUIDSource.h).
+//
+// The input is either of:
+// - Binary: Feature files (see FeatureFile.h, written with -dump), one or more concatenated, e.g.
+//   with "cat *.bin > fleet.bin". The features, vendor, brand and caches are decoded from the raw
+//   cpuid records in each file, not from the decoded snapshot it also contains.
+// - Text: One host per line in the hex format of the Microsoft mode (-microsoft -hex), the hash of the
+//   word layout, the feature flag words and XCR0, optionally preceded by a host name. Lines with
+//   another layout hash, from a build with a different CPU_FEATURE_WORD_LIST, are invalid. Only features and the ISA level can be
+//   decoded, and since the line has no vendor, all vendor-specific features are decoded.
+//
+// The input is read and decoded in chunks of a bounded number of hosts, so that fleets of any size can
+// be streamed through. The hosts of a chunk are decoded in parallel, one thread for each logical processor, each
+// thread formatting the output of a contiguous range of hosts, which is then written in input order
+// and flushed before the next chunk is read. The totals follow the hosts.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <stdio.h>
+#include "../Common/FeatureFile.h"
+#include "../Common/ISALevel.h"
+#include "Output.h"
+
+// One host of the input: A feature file record in the binary input, or a line in the text input.
+struct DecodeRecord {
+	const char* data;
+	size_t size;
+	size_t index; // Position in the input, from 0
+};
+
+struct DecodedHost {
+	std::wstring name;
+	bool valid;
+	bool has_caches;
+	CachedFeatureSnapshot snapshot;
+	CacheInfo cache_info;
+};
+
+static const wchar_t* const decode_cache_type_names[] = { L"null", L"data", L"instruction", L"unified" };
+
+static std::wstring _widen(const char* text)
+{
+	return std::wstring(text, text + strlen(text));
+}
+
+static void _decode_binary(const DecodeRecord& record, FeatureFile& file, DecodedHost& host)
+{
+	host.name = L"#" + std::to_wstring(record.index);
+	host.valid = record.size == sizeof(file);
+	if (!host.valid)
+		return;
+	memcpy(&file, record.data, sizeof(file)); // Copied for alignment, the input buffer is not aligned to a cache line
+	host.valid = feature_file_intact(file);
+	if (!host.valid)
+		return;
+	const CPUIDDumpSource source = { file.records, file.dump.record_count, file.dump.xcr0_low | static_cast<unsigned long long>(file.dump.xcr0_high) << 32 };
+	decode_cached_feature_snapshot(source, host.snapshot);
+	host.cache_info = decode_cache_info(source);
+	host.has_caches = true;
+}
+
+// Line of hexadecimal words: [name] layout: words... xcr0. Invalid unless the layout hash is the one of
+// this build, since words in another order would silently decode as other features.
+static void _decode_text(const DecodeRecord& record, DecodedHost& host)
+{
+	std::istringstream line(std::string(record.data, record.size));
+	std::vector<std::string> tokens;
+	for (std::string token; line >> token;)
+		tokens.push_back(token);
+	const size_t values = FeatureWordCount + 1;
+	host.name = tokens.size() == values + 2 ? _widen(tokens[0].c_str()) : L"#" + std::to_wstring(record.index);
+	host.valid = tokens.size() == values + 1 || tokens.size() == values + 2;
+	if (!host.valid)
+		return;
+	const size_t first = tokens.size() - values;
+	const std::string& layout = tokens[first - 1];
+	char* layout_end = nullptr;
+	const unsigned long long layout_hash = strtoull(layout.c_str(), &layout_end, 16);
+	host.valid = layout.size() == 9 && layout_end == layout.c_str() + 8 && *layout_end == ':' && layout_hash == feature_word_layout_hash();
+	for (size_t i = 0; i < values && host.valid; ++i) {
+		char* end = nullptr;
+		const unsigned long long value = strtoull(tokens[first + i].c_str(), &end, 16);
+		host.valid = end && *end == '\0';
+		if (i < FeatureWordCount)
+			host.snapshot.features.words[i] = static_cast<unsigned int>(value);
+		else
+			host.snapshot.features.xcr0 = value;
+	}
+	host.snapshot.features.vendor = FeatureVendorAny; // Not in the hex format
+}
+
+static void _print_host(std::wostream& stream, OutputFormat format, const DecodedHost& host, bool first)
+{
+	const FeatureSnapshot& snapshot = host.snapshot.features;
+	const X86Level level = host.valid ? isa_level(snapshot) : X86LevelNone;
+	const unsigned int avx10 = host.valid ? avx10_version(snapshot) : 0;
+	if (format == OutputXML) {
+		stream << L"<host name=\"" << host.name << L"\" valid=\"" << (host.valid ? L"true" : L"false") << L"\"";
+		if (!host.valid) {
+			stream << L"/>" << L'\n';
+			return;
+		}
+		if (host.has_caches)
+			stream << L" vendor=\"" << _widen(host.snapshot.vendor) << L"\" brand=\"" << _widen(host.snapshot.brand) << L"\"";
+		stream << L" isa_level=\"" << level << L"\" avx10_version=\"" << avx10 << L"\">" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << (first ? L"\n" : L",\n") << L"{\"name\":\"";
+		write_json_string(stream, host.name.c_str());
+		stream << L"\",\"valid\":" << (host.valid ? L"true" : L"false");
+		if (!host.valid) {
+			stream << L'}';
+			return;
+		}
+		if (host.has_caches) {
+			stream << L",\"vendor\":\"";
+			write_json_string(stream, _widen(host.snapshot.vendor).c_str());
+			stream << L"\",\"brand\":\"";
+			write_json_string(stream, _widen(host.snapshot.brand).c_str());
+			stream << L'"';
+		}
+		stream << L",\"isa_level\":" << level << L",\"avx10_version\":" << avx10 << L",\"caches\":[";
+	} else {
+		stream << host.name << L'\t';
+		if (!host.valid) {
+			stream << L"invalid" << L'\n';
+			return;
+		}
+		stream << (host.has_caches ? _widen(host.snapshot.vendor) : std::wstring(L"-")) << L'\t' << _widen(x86_level_names[level]) << L'\t' << avx10 << L'\t';
+	}
+	if (host.has_caches) {
+		for (unsigned int i = 0; i < host.cache_info.cache_count; ++i) {
+			const CacheDescriptor& cache = host.cache_info.caches[i];
+			if (format == OutputXML)
+				stream << L"<cache level=\"" << cache.level << L"\" type=\"" << decode_cache_type_names[cache.type & 3] << L"\" size=\"" << cache.size << L"\"/>" << L'\n';
+			else if (format == OutputJSON)
+				stream << (i ? L",{" : L"{") << L"\"level\":" << cache.level << L",\"type\":\"" << decode_cache_type_names[cache.type & 3] << L"\",\"size\":" << cache.size << L'}';
+			else
+				stream << (i ? L" L" : L"L") << cache.level << decode_cache_type_names[cache.type & 3][0] << L' ' << cache.size / 1024 << L'K';
+		}
+	} else if (format == OutputText) {
+		stream << L'-';
+	}
+	if (format == OutputJSON)
+		stream << L"],\"features\":[";
+	else if (format == OutputText)
+		stream << L'\t';
+	bool first_feature = true;
+	for (int i = 0; i < FeatureCount; ++i) {
+		const Feature feature = static_cast<Feature>(i);
+		if (!feature_usable(snapshot, feature))
+			continue;
+		const std::wstring name = _widen(feature_table[feature].name);
+		if (format == OutputXML)
+			stream << L"<feature name=\"" << name << L"\"/>" << L'\n';
+		else if (format == OutputJSON)
+			stream << (first_feature ? L"\"" : L",\"") << name << L'"';
+		else
+			stream << (first_feature ? L"" : L" ") << name;
+		first_feature = false;
+	}
+	if (format == OutputXML)
+		stream << L"</host>" << L'\n';
+	else if (format == OutputJSON)
+		stream << L"]}";
+	else
+		stream << L'\n';
+}
+
+// Hosts decoded at a time, so that the memory used for the input and the output does not grow with the
+// size of the fleet.
+#define DECODE_CHUNK_HOSTS 1024
+// Bytes of text input read at a time, grown for longer lines
+#define DECODE_TEXT_BUFFER_SIZE (256 << 10)
+
+// Split lines of text into at most max_records records, skipping empty lines and comments. index is the
+// number of the first line. Returns the number of bytes used.
+static size_t _split_lines(const char* data, size_t size, size_t& index, std::vector<DecodeRecord>& records, size_t max_records)
+{
+	size_t begin = 0;
+	for (; begin < size && records.size() < max_records; ++index) {
+		size_t end = begin;
+		while (end < size && data[end] != '\n')
+			++end;
+		size_t content = begin;
+		while (content < end && (data[content] == ' ' || data[content] == '\t' || data[content] == '\r'))
+			++content;
+		if (content < end && data[content] != '#')
+			records.push_back({ data + begin, end - begin, index });
+		begin = end + 1;
+	}
+	return std::min(begin, size);
+}
+
+// Decode and format the records in parallel, each thread a contiguous range of them, and write the output in
+// input order. first is whether no host was written before. Returns the number of valid hosts.
+static size_t _decode_records(std::wostream& stream, OutputFormat format, const std::vector<DecodeRecord>& records, bool binary, bool first, size_t max_threads)
+{
+	const size_t threads = std::max<size_t>(1, std::min<size_t>(max_threads, (records.size() + 63) / 64));
+	const size_t chunk = (records.size() + threads - 1) / threads;
+	std::vector<std::wstring> outputs(threads);
+	std::vector<size_t> valid(threads);
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			std::wostringstream output;
+			std::unique_ptr<FeatureFile> file(binary ? new FeatureFile : nullptr);
+			std::unique_ptr<DecodedHost> host(new DecodedHost);
+			const size_t begin = t * chunk, end = std::min(records.size(), begin + chunk);
+			for (size_t i = begin; i < end; ++i) {
+				memset(&host->snapshot, 0, sizeof(host->snapshot));
+				host->has_caches = false;
+				if (binary)
+					_decode_binary(records[i], *file, *host);
+				else
+					_decode_text(records[i], *host);
+				valid[t] += host->valid;
+				_print_host(output, format, *host, first && i == 0);
+			}
+			outputs[t] = output.str();
+		});
+	}
+	size_t valid_total = 0;
+	for (size_t t = 0; t < threads; ++t) {
+		workers[t].join();
+		stream << outputs[t];
+		valid_total += valid[t];
+	}
+	stream.flush();
+	return valid_total;
+}
+
+bool print_decode(std::wostream& stream, const std::string& path, OutputFormat format)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) {
+		std::wcerr << L"Failed to read " << _widen(path.c_str()) << std::endl;
+		return false;
+	}
+	const size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	if (format == OutputXML) {
+		stream << L"<hosts>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"hosts\":[";
+	} else {
+		stream << L"Host\tVendor\tISA level\tAVX10\tCaches\tUsable features" << L'\n';
+	}
+
+	// Read and decode a chunk at a time: Whole feature files in the binary input, whole lines in the text input
+	std::vector<char> buffer(std::max<size_t>(DECODE_TEXT_BUFFER_SIZE, sizeof(feature_file_magic)));
+	std::vector<DecodeRecord> records;
+	size_t filled = 0, count = 0, valid = 0, line = 0;
+	bool binary = false, detected = false;
+	for (;;) {
+		filled += fread(buffer.data() + filled, 1, buffer.size() - filled, file);
+		const bool end = filled < buffer.size(); // At end of file, or a read error
+		if (!detected) {
+			binary = filled >= sizeof(feature_file_magic) && memcmp(buffer.data(), feature_file_magic, sizeof(feature_file_magic)) == 0;
+			detected = true;
+			if (binary && buffer.size() != DECODE_CHUNK_HOSTS * sizeof(FeatureFile)) {
+				buffer.resize(DECODE_CHUNK_HOSTS * sizeof(FeatureFile));
+				continue;
+			}
+		}
+		size_t used = filled;
+		records.clear();
+		if (binary) {
+			for (size_t offset = 0; offset < filled; offset += sizeof(FeatureFile)) // A truncated last file is an invalid host
+				records.push_back({ buffer.data() + offset, std::min(sizeof(FeatureFile), filled - offset), count + records.size() });
+		} else {
+			size_t complete = filled;
+			if (!end) {
+				while (complete > 0 && buffer[complete - 1] != '\n')
+					--complete;
+				if (complete == 0) { // A line longer than the buffer
+					buffer.resize(buffer.size() * 2);
+					continue;
+				}
+			}
+			used = _split_lines(buffer.data(), complete, line, records, DECODE_CHUNK_HOSTS);
+		}
+		valid += _decode_records(stream, format, records, binary, count == 0, threads);
+		count += records.size();
+		memmove(buffer.data(), buffer.data() + used, filled - used); // Lines left for the next chunk
+		filled -= used;
+		if (end && filled == 0)
+			break;
+	}
+	fclose(file);
+
+	if (format == OutputXML)
+		stream << L"<summary count=\"" << count << L"\" valid=\"" << valid << L"\"/>" << L'\n' << L"</hosts>" << L'\n';
+	else if (format == OutputJSON)
+		stream << L"\n],\"count\":" << count << L",\"valid\":" << valid << L'}' << L'\n';
+	else
+		stream << count << L" hosts, " << valid << L" valid, decoded with " << threads << L" threads" << L'\n';
+	return valid == count;
+}
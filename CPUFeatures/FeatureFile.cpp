@@ -0,0 +1,99 @@
+//
+// Writing and inspecting the feature file, a snapshot of the features of the executing processor
+// persisted once per boot so that short-lived processes using the library can map it instead of
+// executing cpuid (see the shared header FeatureFile.h). With -dump the file is captured and
+// written, and with -load it is mapped, validated against the executing processor and the current
+// boot, and its contents shown, with whether it is trusted, which the library also requires to use it.
+//
+// Uses the Microsoft-specific intrinsics, which build with GCC and Clang through the portable shim Intrinsics.h.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <memory>
+#include <string>
+#include "../Common/FeatureFile.h"
+
+static std::wstring _widen(const char* text)
+{
+	return std::wstring(text, text + strlen(text));
+}
+
+// Family, model and stepping from the signature in function id 1 EAX, with the extended family and model.
+static void _decode_signature(uint32_t signature, unsigned int& family, unsigned int& model, unsigned int& stepping)
+{
+	family = (signature >> 8) & 0xF;
+	model = (signature >> 4) & 0xF;
+	stepping = signature & 0xF;
+	if (family == 0x6 || family == 0xF)
+		model |= ((signature >> 16) & 0xF) << 4;
+	if (family == 0xF)
+		family += (signature >> 20) & 0xFF;
+}
+
+bool print_dump_feature_file(std::wostream& stream, const std::string& path, bool print_xml)
+{
+	const std::unique_ptr<FeatureFile> file(new FeatureFile); // Too large for the stack on some platforms
+	capture_feature_file(*file);
+	const bool written = write_feature_file(path.c_str(), *file);
+	if (print_xml) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<feature_file path=\"" << _widen(path.c_str()) << L"\" written=\"" << (written ? L"true" : L"false") << L"\" size=\"" << sizeof(FeatureFile)
+			<< L"\" records=\"" << file->dump.record_count << L"\"/>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (written) {
+		stream << L"Wrote " << _widen(path.c_str()) << L" (" << sizeof(FeatureFile) << L" bytes, " << file->dump.record_count << L" cpuid records)" << L'\n';
+	} else {
+		stream << L"Failed to write " << _widen(path.c_str()) << L'\n';
+	}
+	return written;
+}
+
+bool print_load_feature_file(std::wostream& stream, const std::string& path, bool print_xml)
+{
+	bool trusted = false;
+	const FeatureFile* file = map_feature_file(path.c_str(), &trusted);
+	const FeatureFileStatus status = file ? validate_feature_file(*file) : FeatureFileMissing;
+	const bool readable = status != FeatureFileMissing && status != FeatureFileCorrupt; // The contents can be shown
+	if (print_xml) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<feature_file path=\"" << _widen(path.c_str()) << L"\" status=\"" << _widen(feature_file_status_names[status]) << L"\" trusted=\""
+			<< (trusted ? L"true" : L"false") << L"\"";
+	} else {
+		stream << L"Feature file " << _widen(path.c_str()) << L": " << _widen(feature_file_status_names[status]) << L'\n';
+		if (file && !trusted)
+			stream << L"Not owned by the system or writable by other users, the library does not use it" << L'\n';
+	}
+	if (readable) {
+		const FeatureFileHeader& header = file->header;
+		unsigned int family, model, stepping;
+		_decode_signature(header.signature, family, model, stepping);
+		if (print_xml) {
+			stream << L" version=\"" << header.version << L"\" created=\"" << header.created << L"\" boot_id=\"" << _widen(header.boot_id)
+				<< L"\" signature=\"0x" << std::hex << header.signature << L"\" family=\"0x" << family << L"\" model=\"0x" << model << std::dec
+				<< L"\" stepping=\"" << stepping << L"\" microcode=\"0x" << std::hex << header.microcode << L"\" registry_hash=\"0x" << header.registry_hash << std::dec
+				<< L"\" vendor=\"" << _widen(file->snapshot.vendor) << L"\" records=\"" << file->dump.record_count << L"\">" << L'\n';
+		} else {
+			stream << L"Version " << header.version << L", created " << header.created << L", boot id " << (header.boot_id[0] ? _widen(header.boot_id) : std::wstring(L"unknown")) << L'\n';
+			stream << L"Signature 0x" << std::hex << header.signature << L" (family 0x" << family << L", model 0x" << model << std::dec << L", stepping " << stepping
+				<< L"), microcode 0x" << std::hex << header.microcode << L", registry 0x" << header.registry_hash << std::dec << L'\n';
+			stream << _widen(file->snapshot.vendor) << L" " << _widen(file->snapshot.brand) << L'\n';
+			stream << file->dump.record_count << L" cpuid records, " << file->cache_info.cache_count << L" caches, " << file->cache_info.tlb_count << L" TLBs" << L'\n';
+			stream << L"Usable features:";
+		}
+		for (int i = 0; i < FeatureCount; ++i) {
+			if (!feature_mask_test(file->usable, static_cast<Feature>(i)))
+				continue;
+			if (print_xml)
+				stream << L"<feature name=\"" << _widen(feature_table[i].name) << L"\"/>" << L'\n';
+			else
+				stream << L' ' << _widen(feature_table[i].name);
+		}
+		stream << (print_xml ? L"</feature_file>" : L"") << L'\n';
+	} else if (print_xml) {
+		stream << L"/>" << L'\n';
+	}
+	if (print_xml)
+		stream << L"</cpu>" << L'\n';
+	unmap_feature_file(file);
+	return status == FeatureFileValid;
+}
@@ -0,0 +1,102 @@
+//
+// Reporting the core types of hybrid processors, such as Intel Alder Lake, Raptor Lake and
+// Meteor Lake, with performance cores (P-cores) and efficient cores (E-cores): Which logical
+// processors are of each core type, and the features and cache sizes of each of them.
+//
+// The core type of each logical processor is read from function id 0x1A, by pinning the
+// thread to each logical processor in turn (see Topology.h), and the features and caches
+// of each core type are captured on the first logical processor of that type, and decoded
+// with the shared feature registry (see FeatureRegistry.h). Processors
+// that are not hybrid, as reported by function id 7 EDX bit 15, are reported as a single
+// class of cores with unknown core type.
+//
+// Uses the Microsoft-specific intrinsics, which build with GCC and Clang through the portable shim Intrinsics.h.
+//
+#include "Targetver.h"
+#include "../Common/Topology.h"
+#include <iostream>
+#include <string>
+
+static const wchar_t* _core_type_name(CoreType core_type)
+{
+	switch (core_type) {
+	case CoreTypePerformance: return L"performance";
+	case CoreTypeEfficiency: return L"efficiency";
+	default: return L"unknown";
+	}
+}
+
+// The features most relevant for selecting code paths, which could differ between core types
+static const Feature hybrid_features[] = {
+	Feature_SSE42, Feature_POPCNT, Feature_AES, Feature_AVX, Feature_FMA, Feature_F16C, Feature_RDRAND,
+	Feature_AVX2, Feature_BMI1, Feature_BMI2, Feature_AVX512F, Feature_SHA,
+	Feature_GFNI, Feature_VAES, Feature_VPCLMULQDQ, Feature_MOVDIRI, Feature_SERIALIZE, Feature_AMXTILE,
+};
+
+static std::wstring _feature_label(Feature feature)
+{
+	const char* label = feature_table[feature].label;
+	return std::wstring(label, label + strlen(label));
+}
+
+void print_hybrid(std::wostream& stream, bool print_supported, bool print_unsupported, bool print_xml)
+{
+	const Topology topology = get_topology();
+	const std::vector<CoreClass> classes = get_core_classes(topology);
+	if (print_xml) {
+		stream << L"<cpu>" << std::endl;
+		stream << L"<hybrid>" << (topology.hybrid ? L"true" : L"false") << L"</hybrid>" << std::endl;
+		stream << L"<core_classes>" << std::endl;
+		for (const CoreClass& core_class : classes) {
+			stream << L"<core_class type=\"" << _core_type_name(core_class.core_type) << L"\" native_model_id=\"" << core_class.native_model_id
+				<< L"\" logical_processors=\"" << core_class.processors.size() << L"\">" << std::endl;
+			stream << L"<processors>";
+			for (size_t i = 0; i < core_class.processors.size(); ++i) {
+				const LogicalProcessor& processor = topology.processors[core_class.processors[i]];
+				stream << (i ? L" " : L"") << processor.group << L":" << processor.number;
+			}
+			stream << L"</processors>" << std::endl;
+			stream << L"<features>" << std::endl;
+			for (const Feature feature : hybrid_features) {
+				const bool supported = feature_hardware(core_class.features, feature);
+				if ((supported && print_supported) || (!supported && print_unsupported))
+					stream << L"<feature name=\"" << _feature_label(feature) << L"\" supported=\"" << (supported ? L"true" : L"false") << L"\"/>" << std::endl;
+			}
+			stream << L"</features>" << std::endl;
+			stream << L"<caches>" << std::endl;
+			for (unsigned int level = 1; level <= 3; ++level) {
+				const CacheDescriptor* cache = find_cache(core_class.cache_info, level);
+				if (cache)
+					stream << L"<cache level=\"" << level << L"\" size=\"" << cache->size << L"\" shared_by=\"" << cache->shared_by << L"\"/>" << std::endl;
+			}
+			stream << L"</caches>" << std::endl;
+			stream << L"</core_class>" << std::endl;
+		}
+		stream << L"</core_classes>" << std::endl;
+		stream << L"</cpu>" << std::endl;
+	} else {
+		stream << (topology.hybrid ? L"Hybrid processor" : L"Not a hybrid processor") << L", " << classes.size() << L" core " << (classes.size() == 1 ? L"class" : L"classes") << std::endl;
+		for (const CoreClass& core_class : classes) {
+			stream << std::endl;
+			stream << L"Core type " << _core_type_name(core_class.core_type);
+			if (core_class.native_model_id)
+				stream << L" (native model ID " << core_class.native_model_id << L")";
+			stream << L": " << core_class.processors.size() << L" logical processors:";
+			for (unsigned int index : core_class.processors)
+				stream << L" " << topology.processors[index].group << L":" << topology.processors[index].number;
+			stream << std::endl;
+			for (const Feature feature : hybrid_features) {
+				const bool supported = feature_hardware(core_class.features, feature);
+				if (supported && print_supported)
+					stream << L"  " << _feature_label(feature) << L" supported" << std::endl;
+				else if (!supported && print_unsupported)
+					stream << L"  " << _feature_label(feature) << L" not supported" << std::endl;
+			}
+			for (unsigned int level = 1; level <= 3; ++level) {
+				const CacheDescriptor* cache = find_cache(core_class.cache_info, level);
+				if (cache)
+					stream << L"  L" << level << L" cache " << cache->size / 1024 << L" KB, shared by " << cache->shared_by << L" logical processors" << std::endl;
+			}
+		}
+	}
+}
@@ -0,0 +1,140 @@
+//
+// Reporting the hypervisor the executing processor runs under: The vendor and signature from the
+// hypervisor function ids 0x40000000 and up, the Hyper-V enlightenments or KVM paravirtual features,
+// the TSC frequency reported by the hypervisor, whether the TSC is reliable for timing, and the
+// measured cost of a cpuid instruction, which tells if results should be cached. The features that
+// hypervisors commonly mask are listed with their support, since they are the ones most likely to
+// differ from the host processor. The decoding is done in the shared header Hypervisor.h.
+//
+// Uses the Microsoft-specific intrinsics, which build with GCC and Clang through the portable shim Intrinsics.h.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <string>
+#include "../Common/Hypervisor.h"
+#include "../Common/FeatureSnapshot.h"
+#include "../Common/CycleCounter.h"
+#include "Output.h"
+
+// Features commonly masked by hypervisors, according to the registry
+static const Feature hypervisor_masked_features[] = {
+	Feature_HLE, Feature_RTM, Feature_AVX512F, Feature_RDSEED, Feature_RDRAND, Feature_INVPCID, Feature_VMX,
+};
+
+static std::wstring _widen(const char* text)
+{
+	return std::wstring(text, text + strlen(text));
+}
+
+// Write the names of the flags set in value, as a list of names in XML and JSON.
+template<size_t count>
+static void _print_flags(std::wostream& stream, OutputFormat format, const wchar_t* name, const HypervisorFlag (&flags)[count], unsigned int value)
+{
+	if (format == OutputXML)
+		stream << L"<" << name << L" value=\"0x" << std::hex << value << std::dec << L"\">" << L'\n';
+	else if (format == OutputJSON)
+		stream << L",\"" << name << L"\":[";
+	else
+		stream << name << L':';
+	bool first = true;
+	for (const HypervisorFlag& flag : flags) {
+		if (((value >> flag.bit) & 1) == 0)
+			continue;
+		if (format == OutputXML)
+			stream << L"<flag name=\"" << _widen(flag.name) << L"\"/>" << L'\n';
+		else if (format == OutputJSON)
+			stream << (first ? L"\"" : L",\"") << _widen(flag.name) << L'"';
+		else
+			stream << L' ' << _widen(flag.name);
+		first = false;
+	}
+	if (format == OutputXML)
+		stream << L"</" << name << L">" << L'\n';
+	else if (format == OutputJSON)
+		stream << L']';
+	else
+		stream << L'\n';
+}
+
+void print_hypervisor(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format)
+{
+	const HypervisorInfo info = get_hypervisor_info();
+	const FeatureSnapshot snapshot = get_feature_snapshot();
+	const uint64_t cpuid_ticks = measure_cpuid_cost();
+	const double tsc_mhz = measure_tsc_frequency();
+	const double cpuid_ns = tsc_mhz > 0 ? cpuid_ticks * 1000.0 / tsc_mhz : 0;
+	const bool cpuid_trapped = cpuid_ticks >= CPUID_TRAPPED_TICKS;
+	const bool tsc_reliable = hypervisor_tsc_reliable(info);
+	const std::wstring vendor = _widen(hypervisor_vendor_names[info.vendor]);
+	std::wstring signature = _widen(info.signature);
+	for (wchar_t& c : signature) {
+		if (c < 0x20 || c > 0x7e || c == L'"' || c == L'\\' || c == L'<' || c == L'&')
+			c = L'.'; // Unknown signatures may contain any bytes, replaced to be valid in both XML and JSON
+	}
+	FeatureListWriter writer(stream, format, print_supported, print_unsupported, true);
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<hypervisor present=\"" << (info.present ? L"true" : L"false") << L"\" vendor=\"" << vendor << L"\" signature=\"";
+		stream << signature << L"\" max_function_id=\"0x" << std::hex << info.max_function_id << std::dec << L"\">" << L'\n';
+		if (info.hyperv_interface) {
+			stream << L"<hyperv version=\"" << (info.hyperv_version >> 16) << L'.' << (info.hyperv_version & 0xffff) << L"\" build=\"" << info.hyperv_build
+				<< L"\" max_virtual_processors=\"" << info.hyperv_max_virtual_processors << L"\" max_logical_processors=\"" << info.hyperv_max_logical_processors
+				<< L"\" spinlock_retries=\"0x" << std::hex << info.hyperv_spinlock_retries << std::dec << L"\">" << L'\n';
+			_print_flags(stream, format, L"privileges", hyperv_feature_flags, info.hyperv_features[0]);
+			_print_flags(stream, format, L"recommendations", hyperv_recommendation_flags, info.hyperv_recommendations);
+			stream << L"</hyperv>" << L'\n';
+		}
+		if (info.kvm_features)
+			_print_flags(stream, format, L"kvm_features", kvm_feature_flags, info.kvm_features);
+		if (info.tsc_khz)
+			stream << L"<tsc_khz>" << info.tsc_khz << L"</tsc_khz>" << L'\n' << L"<bus_khz>" << info.bus_khz << L"</bus_khz>" << L'\n';
+		stream << L"</hypervisor>" << L'\n';
+		stream << L"<tsc invariant=\"" << (info.invariant_tsc ? L"true" : L"false") << L"\" reliable=\"" << (tsc_reliable ? L"true" : L"false") << L"\"/>" << L'\n';
+		stream << L"<cpuid_cost ticks=\"" << cpuid_ticks << L"\" ns=\"" << static_cast<unsigned int>(cpuid_ns + 0.5) << L"\" trapped=\"" << (cpuid_trapped ? L"true" : L"false") << L"\"/>" << L'\n';
+		stream << L"<features>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"hypervisor\":{\"present\":" << (info.present ? L"true" : L"false") << L",\"vendor\":\"" << vendor << L"\",\"signature\":\"";
+		stream << signature << L"\",\"max_function_id\":" << info.max_function_id;
+		if (info.hyperv_interface) {
+			stream << L",\"hyperv\":{\"version\":\"" << (info.hyperv_version >> 16) << L'.' << (info.hyperv_version & 0xffff) << L"\",\"build\":" << info.hyperv_build
+				<< L",\"max_virtual_processors\":" << info.hyperv_max_virtual_processors << L",\"max_logical_processors\":" << info.hyperv_max_logical_processors
+				<< L",\"spinlock_retries\":" << info.hyperv_spinlock_retries;
+			_print_flags(stream, format, L"privileges", hyperv_feature_flags, info.hyperv_features[0]);
+			_print_flags(stream, format, L"recommendations", hyperv_recommendation_flags, info.hyperv_recommendations);
+			stream << L'}';
+		}
+		if (info.kvm_features)
+			_print_flags(stream, format, L"kvm_features", kvm_feature_flags, info.kvm_features);
+		stream << L",\"tsc_khz\":" << info.tsc_khz << L",\"bus_khz\":" << info.bus_khz << L'}';
+		stream << L",\"tsc\":{\"invariant\":" << (info.invariant_tsc ? L"true" : L"false") << L",\"reliable\":" << (tsc_reliable ? L"true" : L"false") << L'}';
+		stream << L",\"cpuid_cost\":{\"ticks\":" << cpuid_ticks << L",\"ns\":" << static_cast<unsigned int>(cpuid_ns + 0.5) << L",\"trapped\":" << (cpuid_trapped ? L"true" : L"false") << L'}';
+		stream << L",\"features\":[";
+	} else {
+		if (info.present)
+			stream << L"Hypervisor " << vendor << L" (signature \"" << signature << L"\", max function id 0x" << std::hex << info.max_function_id << std::dec << L")" << L'\n';
+		else
+			stream << L"No hypervisor" << L'\n';
+		if (info.hyperv_interface) {
+			stream << L"Hyper-V interface version " << (info.hyperv_version >> 16) << L'.' << (info.hyperv_version & 0xffff) << L" build " << info.hyperv_build
+				<< L", max " << info.hyperv_max_virtual_processors << L" virtual and " << info.hyperv_max_logical_processors << L" logical processors" << L'\n';
+			_print_flags(stream, format, L"Hyper-V features", hyperv_feature_flags, info.hyperv_features[0]);
+			_print_flags(stream, format, L"Hyper-V recommendations", hyperv_recommendation_flags, info.hyperv_recommendations);
+		}
+		if (info.kvm_features)
+			_print_flags(stream, format, L"KVM features", kvm_feature_flags, info.kvm_features);
+		if (info.tsc_khz)
+			stream << L"TSC frequency " << info.tsc_khz << L" kHz, bus frequency " << info.bus_khz << L" kHz (reported by hypervisor)" << L'\n';
+		stream << L"TSC " << (info.invariant_tsc ? L"invariant" : L"not invariant") << L", " << (tsc_reliable ? L"reliable for timing" : L"not reliable for timing") << L'\n';
+		stream << L"cpuid cost " << cpuid_ticks << L" ticks (" << static_cast<unsigned int>(cpuid_ns + 0.5) << L" ns)"
+			<< (cpuid_trapped ? L", trapped by hypervisor: cache results" : L"") << L'\n';
+		stream << L"Features commonly masked by hypervisors:" << L'\n';
+	}
+	for (const Feature feature : hypervisor_masked_features)
+		writer.feature(_widen(feature_table[feature].name).c_str(), feature_hardware(snapshot, feature), feature_usable(snapshot, feature));
+	if (format == OutputXML) {
+		stream << L"</features>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"\n]}" << L'\n';
+	}
+}
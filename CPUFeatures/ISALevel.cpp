@@ -0,0 +1,56 @@
+//
+// Reporting the x86-64 microarchitecture level (x86-64-v1 to x86-64-v4) of the executing processor,
+// meaning the highest -march=x86-64-v<n> build that can run on it, and the AVX10 version.
+// See Common/ISALevel.h for the features required by each level.
+//
+// In addition to the level, the features required by the next level that are not usable are
+// listed, which tells why a processor is not at a higher level, e.g. AVX-512 not enabled by the
+// hypervisor of a virtual machine.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../Common/FeatureSnapshot.h"
+#include "../Common/ISALevel.h"
+#include "Output.h"
+
+void print_isa_level(std::wostream& stream, OutputFormat format)
+{
+	const FeatureSnapshot snapshot = get_feature_snapshot();
+	const X86Level level = isa_level(snapshot);
+	const unsigned int avx10 = avx10_version(snapshot);
+	const std::wstring name(x86_level_names[level], x86_level_names[level] + strlen(x86_level_names[level]));
+	std::vector<std::wstring> missing; // Features of the next level that are not usable
+	for (size_t i = 0; i < x86_level_feature_count; ++i) {
+		if (x86_level_features[i].level == level + 1 && !x86_level_feature_usable(snapshot, x86_level_features[i].feature)) {
+			const char* feature_name = feature_table[x86_level_features[i].feature].name;
+			missing.push_back(std::wstring(feature_name, feature_name + strlen(feature_name)));
+		}
+	}
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<isa_level level=\"" << level << L"\" name=\"" << name << L"\" avx10_version=\"" << avx10 << L"\">" << L'\n';
+		for (const std::wstring& feature : missing)
+			stream << L"<missing name=\"" << feature << L"\"/>" << L'\n';
+		stream << L"</isa_level>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"isa_level\":" << level << L",\"name\":\"" << name << L"\",\"avx10_version\":" << avx10 << L",\"missing\":[";
+		for (size_t i = 0; i < missing.size(); ++i)
+			stream << (i ? L",\"" : L"\"") << missing[i] << L'"';
+		stream << L"]}" << L'\n';
+	} else {
+		stream << L"ISA level " << name << L'\n';
+		if (avx10)
+			stream << L"AVX10." << avx10 << L" supported" << L'\n';
+		else
+			stream << L"AVX10 not supported" << L'\n';
+		if (!missing.empty()) {
+			stream << L"Missing for " << x86_level_names[level + 1] << L':';
+			for (const std::wstring& feature : missing)
+				stream << L' ' << feature;
+			stream << L'\n';
+		}
+	}
+}
@@ -1,10 +1,37 @@
 #include "Targetver.h"
 #include "Version.h"
+#include "Output.h"
+#include "../Common/WMain.h"
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <stdlib.h>
+#include "../Common/FeatureFile.h"
+#include "../Common/BuildTarget.h"
 
-extern void print_cpu_features_microsoft(std::wostream& stream, bool print_supported, bool print_unsupported, bool print_xml);
-extern void print_cpu_features(std::wostream& stream, bool print_supported, bool print_unsupported, bool print_xml);
-extern void print_avx_features(std::wostream& stream, bool print_supported, bool print_unsupported, bool print_xml);
+// Fail with a clear message, instead of an illegal instruction, when built for more than the processor has.
+CPUFEATURES_REQUIRE_BUILD_TARGET();
+
+extern void print_cpu_features_microsoft(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format);
+extern void print_cpu_features(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format);
+extern void print_avx_features(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format);
+extern void print_arm_features(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format);
+extern void print_avx_throughput(std::wostream& stream, bool print_xml);
+extern void print_cache_info(std::wostream& stream, bool print_xml);
+extern void print_topology(std::wostream& stream, bool print_xml);
+extern void print_hybrid(std::wostream& stream, bool print_supported, bool print_unsupported, bool print_xml);
+extern void print_isa_level(std::wostream& stream, OutputFormat format);
+extern void print_hypervisor(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format);
+extern void print_tsc(std::wostream& stream, OutputFormat format);
+extern void print_memory(std::wostream& stream, OutputFormat format);
+extern void print_xsave(std::wostream& stream, OutputFormat format);
+extern void print_speculation(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format);
+extern bool print_consistency(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format);
+extern bool print_compare_build(std::wostream& stream, const std::string& level_name, OutputFormat format);
+extern bool run_monitor(const std::string& path, unsigned int interval_ms, unsigned int count);
+extern bool print_dump_feature_file(std::wostream& stream, const std::string& path, bool print_xml);
+extern bool print_load_feature_file(std::wostream& stream, const std::string& path, bool print_xml);
+extern bool print_decode(std::wostream& stream, const std::string& path, OutputFormat format);
 
 bool is_option(const wchar_t* arg)
 {
@@ -19,10 +46,24 @@ bool match_option(const wchar_t* arg, const wchar_t* option_full = nullptr, cons
 	return is_option(arg) && (match_option_name(arg, option_full) || match_option_name(arg, option_short) || match_option_name(arg, option_alternative));
 }
 
+// Convert a wide argument to the multibyte encoding of the current locale, e.g. a file path.
+std::string narrow(const wchar_t* arg)
+{
+	const size_t length = wcstombs(nullptr, arg, 0);
+	if (length == static_cast<size_t>(-1))
+		return std::string();
+	std::string result(length + 1, '\0');
+	wcstombs(&result[0], arg, length + 1);
+	result.resize(length);
+	return result;
+}
+
 int wmain(int argc, wchar_t *argv[], wchar_t *envp[])
 {
 	if (argc > 1 && match_option(argv[1], L"help", L"h", L"?")) {
 		wchar_t* exeName = wcsrchr(argv[0], L'\\');
+		if (!exeName)
+			exeName = wcsrchr(argv[0], L'/');
 		if (exeName)
 			++exeName;
 		else
@@ -38,36 +79,186 @@ int wmain(int argc, wchar_t *argv[], wchar_t *envp[])
 		std::wcout << L"variant instead, which reports a more complete set of features. Then there is" << std::endl;
 		std::wcout << L"a special variant for showing complete set of AVX features (but nothing else)," << std::endl;
 		std::wcout << L"triggered with argument -avx (-a). This is also a Microsoft-specific variant." << std::endl;
+		std::wcout << L"On ARM64 processors, argument -arm reports the complete set of features, as" << std::endl;
+		std::wcout << L"reported by the operating system, and the SVE vector length." << std::endl;
+		std::wcout << L"With argument -avx-throughput (-at) it instead measures the throughput of 128," << std::endl;
+		std::wcout << L"256 and 512-bit vector instructions, and the frequency drop they cause, and" << std::endl;
+		std::wcout << L"recommends a preferred vector width." << std::endl;
+		std::wcout << L"With argument -cache (-c) it reports the cache and TLB parameters instead, and" << std::endl;
+		std::wcout << L"with argument -topology (-t) the package, die, core and SMT thread of each" << std::endl;
+		std::wcout << L"logical processor. On hybrid processors, argument -hybrid (-y) reports the" << std::endl;
+		std::wcout << L"logical processors, features and caches of each core type (P-cores and E-cores)." << std::endl;
+		std::wcout << L"With argument -isa-level (-l) it reports the x86-64 microarchitecture level" << std::endl;
+		std::wcout << L"(x86-64-v1 to x86-64-v4), the features missing for the next level, and the" << std::endl;
+		std::wcout << L"AVX10 version. With argument -hypervisor (-v) it reports the hypervisor it runs" << std::endl;
+		std::wcout << L"under, its enlightenments, whether the TSC is reliable for timing, the cost of" << std::endl;
+		std::wcout << L"executing cpuid, and the support of the features hypervisors commonly mask." << std::endl;
+		std::wcout << L"With argument -tsc it reports the time stamp counter: If it is invariant, if" << std::endl;
+		std::wcout << L"rdtscp is supported, and its frequency, as reported by cpuid or else measured." << std::endl;
+		std::wcout << L"With argument -memory it measures the latency and the read, write, copy and" << std::endl;
+		std::wcout << L"non-temporal write bandwidth of each cache level and of main memory, and of" << std::endl;
+		std::wcout << L"main memory of each NUMA node, using the widest usable vector width." << std::endl;
+		std::wcout << L"With argument -xsave it reports the extended state (XSAVE) components, with" << std::endl;
+		std::wcout << L"their sizes and offsets, and the size of the area saved on context switches." << std::endl;
+		std::wcout << L"With argument -speculation it reports the speculation control features, the" << std::endl;
+		std::wcout << L"mitigations of speculative execution vulnerabilities reported by the operating" << std::endl;
+		std::wcout << L"system, and the instruction classes the mitigations are known to slow down." << std::endl;
+		std::wcout << L"With argument -consistency it checks that all logical processors report the" << std::endl;
+		std::wcout << L"same features, by executing cpuid on each of them, and reports the features" << std::endl;
+		std::wcout << L"usable on all of them, and those usable on only some. Fails if there are any." << std::endl;
+		std::wcout << L"With argument -compare-build it compares the instruction set extensions this" << std::endl;
+		std::wcout << L"program is compiled for, or those of an x86-64 level given as argument, with" << std::endl;
+		std::wcout << L"the processor: Which ones are not usable, and the headroom left unused." << std::endl;
+		std::wcout << L"With argument -monitor it runs until interrupted, sampling the features, and the" << std::endl;
+		std::wcout << L"effective frequency and throttling of each core with a thread pinned to it, at" << std::endl;
+		std::wcout << L"an interval in milliseconds (default 10000), and writes them as Prometheus metrics" << std::endl;
+		std::wcout << L"to standard output, or to a file replaced at each sample, e.g. for the textfile" << std::endl;
+		std::wcout << L"collector of the node exporter. Optionally for a number of samples only." << std::endl;
+		std::wcout << L"With argument -dump it writes a feature file, a snapshot of the features and" << std::endl;
+		std::wcout << L"caches that the library reads instead of executing cpuid, valid until the next" << std::endl;
+		std::wcout << L"boot, and with argument -load it validates a feature file and shows its contents." << std::endl;
+		std::wcout << L"The default path is /run/cpufeatures.bin, or %ProgramData%\\CPUFeatures.bin on" << std::endl;
+		std::wcout << L"Windows, unless set by environment variable CPUFEATURES_FILE." << std::endl;
+		std::wcout << L"With argument -decode it decodes the features, ISA level and caches of each" << std::endl;
+		std::wcout << L"host in a file of feature files or of lines in the -microsoft -hex format, in" << std::endl;
+		std::wcout << L"parallel, without executing cpuid." << std::endl;
 		std::wcout << L"By default all known features are listed and marked as supported or unsupported" << std::endl;
 		std::wcout << L"but can instead list only the supported or unsupported by specifying either" << std::endl;
 		std::wcout << L"argument -supported (-s) or -unsupported (-u). Optionally the result can be" << std::endl;
 		std::wcout << L"presented as XML instead of the default human readable format, by specifying" << std::endl;
 		std::wcout << L"argument -xml (-x). This can be useful when called from for example PowerShell." << std::endl;
+		std::wcout << L"The feature listings (default, -microsoft, -avx and -arm) can also be presented as" << std::endl;
+		std::wcout << L"JSON, with argument -json (-j), or as a single line of hexadecimal numbers, with" << std::endl;
+		std::wcout << L"argument -hex: The raw feature flag registers and XCR0 in Microsoft mode, and" << std::endl;
+		std::wcout << L"a bitmask of usable features, in the order listed, in the other modes. The level" << std::endl;
+		std::wcout << L"(-isa-level), hypervisor (-hypervisor), TSC (-tsc), memory (-memory), XSAVE" << std::endl;
+		std::wcout << L"(-xsave), speculation (-speculation), consistency (-consistency), compare build" << std::endl;
+		std::wcout << L"(-compare-build) and decode (-decode) modes can also be presented as JSON." << std::endl;
 		std::wcout << L"has suffix 32 or 64 according to platform architecture, and debug builds have" << std::endl;
 		std::wcout << L"additional suffix d." << std::endl;
 		std::wcout << std::endl;
 		std::wcout << L"Usage:" << std::endl;
 		std::wcout << L"  CPUFeatures[32|64][d] [-help|-h|-?]" << std::endl;
-		std::wcout << L"  CPUFeatures[32|64][d] [[-microsoft|-ms|-m]|[-avx|-a]] [[-supported|-s]|[-unsupported|-u]] [-xml|-x]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] [[-microsoft|-ms|-m]|[-avx|-a]|-arm] [[-supported|-s]|[-unsupported|-u]] [-xml|-x|-json|-j|-hex]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -avx-throughput|-at [-xml|-x]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -cache|-c [-xml|-x]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -topology|-t [-xml|-x]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -hybrid|-y [[-supported|-s]|[-unsupported|-u]] [-xml|-x]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -isa-level|-l [-xml|-x|-json|-j]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -hypervisor|-v [[-supported|-s]|[-unsupported|-u]] [-xml|-x|-json|-j]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -tsc [-xml|-x|-json|-j]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -memory [-xml|-x|-json|-j]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -xsave [-xml|-x|-json|-j]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -speculation [[-supported|-s]|[-unsupported|-u]] [-xml|-x|-json|-j]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -consistency [[-supported|-s]|[-unsupported|-u]] [-xml|-x|-json|-j]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -compare-build [x86-64-v1|x86-64-v2|x86-64-v3|x86-64-v4] [-xml|-x|-json|-j]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -monitor [path] [-interval milliseconds] [-count samples]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -dump|-load [path] [-xml|-x]" << std::endl;
+		std::wcout << L"  CPUFeatures[32|64][d] -decode path [-xml|-x|-json|-j]" << std::endl;
 		return EXIT_SUCCESS;
 	}
 	enum Method {
-		Default, Microsoft, AVX
+		Default, Microsoft, AVX, ARM, AVXThroughput, Cache, Topology, Hybrid, ISALevel, Hypervisor, TSC, Memory, XSave, Speculation, Consistency, CompareBuild, Monitor, Dump, Load, Decode
 	};
 	Method method = Default;
 	bool print_supported = false;
 	bool print_unsupported = false;
-	bool print_xml = false;
+	OutputFormat format = OutputText;
+	std::string file_path;
+	std::string level_name; // Build target of the compare build mode, if not this program
+	std::string metrics_path; // Metrics file of the monitor mode, standard output if empty
+	unsigned int interval_ms = 10000;
+	unsigned int sample_count = 0; // Samples of the monitor mode, 0 until interrupted
 	if (argc > 1) {
 		int argi = 1;
 		if (match_option(argv[argi], L"microsoft", L"m", L"ms")) {
 			method = Microsoft;
 			++argi;
 		}
+		else if (match_option(argv[argi], L"avx-throughput", L"at")) {
+			method = AVXThroughput;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"cache", L"c")) {
+			method = Cache;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"topology", L"t")) {
+			method = Topology;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"hybrid", L"y")) {
+			method = Hybrid;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"isa-level", L"l")) {
+			method = ISALevel;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"hypervisor", L"v")) {
+			method = Hypervisor;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"tsc")) {
+			method = TSC;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"memory")) {
+			method = Memory;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"xsave")) {
+			method = XSave;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"speculation")) {
+			method = Speculation;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"consistency")) {
+			method = Consistency;
+			++argi;
+		}
+		else if (match_option(argv[argi], L"compare-build")) {
+			method = CompareBuild;
+			++argi;
+			if (argc > argi && !is_option(argv[argi]))
+				level_name = narrow(argv[argi++]);
+		}
+		else if (match_option(argv[argi], L"monitor")) {
+			method = Monitor;
+			++argi;
+			if (argc > argi && argv[argi][0] != L'-' && !match_option(argv[argi], L"interval") && !match_option(argv[argi], L"count")) // Optional path, which may start with '/'
+				metrics_path = narrow(argv[argi++]);
+			for (; argc > argi + 1; argi += 2) {
+				if (match_option(argv[argi], L"interval"))
+					interval_ms = static_cast<unsigned int>(wcstoul(argv[argi + 1], nullptr, 10));
+				else if (match_option(argv[argi], L"count"))
+					sample_count = static_cast<unsigned int>(wcstoul(argv[argi + 1], nullptr, 10));
+				else
+					break;
+			}
+		}
+		else if (match_option(argv[argi], L"dump") || match_option(argv[argi], L"load")) {
+			method = match_option(argv[argi], L"dump") ? Dump : Load;
+			++argi;
+			if (argc > argi && argv[argi][0] != L'-' && !match_option(argv[argi], L"xml", L"x")) // Optional path, which may start with '/'
+				file_path = narrow(argv[argi++]);
+		}
+		else if (match_option(argv[argi], L"decode")) {
+			method = Decode;
+			++argi;
+			if (argc > argi)
+				file_path = narrow(argv[argi++]);
+		}
 		else if (match_option(argv[argi], L"avx", L"a")) {
 			method = AVX;
 			++argi;
 		}
+		else if (match_option(argv[argi], L"arm")) {
+			method = ARM;
+			++argi;
+		}
 		if (argc > argi && match_option(argv[argi], L"supported", L"s")) {
 			print_supported = true;
 			++argi;
@@ -77,21 +268,101 @@ int wmain(int argc, wchar_t *argv[], wchar_t *envp[])
 			++argi;
 		}
 		if (argc > argi && match_option(argv[argi], L"xml", L"x")) {
-			print_xml = true;
+			format = OutputXML;
+			++argi;
+		}
+		else if (argc > argi && match_option(argv[argi], L"json", L"j")) {
+			format = OutputJSON;
 			++argi;
 		}
+		else if (argc > argi && match_option(argv[argi], L"hex")) {
+			format = OutputHex;
+			++argi;
+		}
+	}
+	const bool is_feature_listing = method == Default || method == Microsoft || method == AVX || method == ARM;
+	if ((format == OutputJSON && !is_feature_listing && method != ISALevel && method != Hypervisor && method != TSC && method != Memory && method != XSave && method != Speculation && method != Consistency && method != CompareBuild && method != Decode) || (format == OutputHex && !is_feature_listing)) {
+		std::wcerr << L"Output format " << (format == OutputJSON ? L"-json" : L"-hex") << L" is only supported by the feature listings (default, -microsoft, -avx and -arm)"
+			<< (format == OutputJSON ? L", -isa-level, -hypervisor, -tsc, -memory, -xsave, -speculation, -consistency, -compare-build and -decode" : L"") << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (method == Monitor && interval_ms == 0) {
+		std::wcerr << L"Argument -interval requires a number of milliseconds" << std::endl;
+		return EXIT_FAILURE;
 	}
+	if (method == Decode && file_path.empty()) {
+		std::wcerr << L"Argument -decode requires the path of the file to decode" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const bool print_xml = format == OutputXML;
 	if (!print_supported && !print_unsupported)
 		print_supported = print_unsupported = true;
+	// Build the output in a buffer, and write it in one operation
+	std::wostringstream stream;
+	bool success = true;
+	if (file_path.empty())
+		file_path = default_feature_file_path();
 	switch (method) {
 	case Microsoft:
-		print_cpu_features_microsoft(std::wcout, print_supported, print_unsupported, print_xml);
+		print_cpu_features_microsoft(stream, print_supported, print_unsupported, format);
 		break;
 	case AVX:
-		print_avx_features(std::wcout, print_supported, print_unsupported, print_xml);
+		print_avx_features(stream, print_supported, print_unsupported, format);
+		break;
+	case ARM:
+		print_arm_features(stream, print_supported, print_unsupported, format);
+		break;
+	case AVXThroughput:
+		print_avx_throughput(stream, print_xml);
+		break;
+	case Cache:
+		print_cache_info(stream, print_xml);
+		break;
+	case Topology:
+		print_topology(stream, print_xml);
+		break;
+	case Hybrid:
+		print_hybrid(stream, print_supported, print_unsupported, print_xml);
+		break;
+	case ISALevel:
+		print_isa_level(stream, format);
+		break;
+	case Hypervisor:
+		print_hypervisor(stream, print_supported, print_unsupported, format);
+		break;
+	case TSC:
+		print_tsc(stream, format);
+		break;
+	case Memory:
+		print_memory(stream, format);
+		break;
+	case XSave:
+		print_xsave(stream, format);
+		break;
+	case Speculation:
+		print_speculation(stream, print_supported, print_unsupported, format);
+		break;
+	case Consistency:
+		success = print_consistency(stream, print_supported, print_unsupported, format);
+		break;
+	case CompareBuild:
+		success = print_compare_build(stream, level_name, format);
+		break;
+	case Monitor:
+		success = run_monitor(metrics_path, interval_ms, sample_count);
+		break;
+	case Dump:
+		success = print_dump_feature_file(stream, file_path, print_xml);
+		break;
+	case Load:
+		success = print_load_feature_file(stream, file_path, print_xml);
+		break;
+	case Decode:
+		success = print_decode(std::wcout, file_path, format); // Streamed instead, the output for a fleet is not buffered
 		break;
 	default:
-		print_cpu_features(std::wcout, print_supported, print_unsupported, print_xml);
+		print_cpu_features(stream, print_supported, print_unsupported, format);
 	}
-	return EXIT_SUCCESS;
+	std::wcout << stream.str() << std::flush;
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
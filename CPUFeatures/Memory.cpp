@@ -0,0 +1,360 @@
+//
+// Measuring the memory latency and bandwidth of the executing processor, for each cache level and
+// for main memory (DRAM), and for main memory of each NUMA node.
+//
+// The working set of each cache level is half of its size, as decoded in the shared header
+// CacheInfo.h, so that it fits in that level but not in the level below. Main memory is measured
+// with a working set of four times the size of the last level cache, and at least 64 MB.
+//
+// Latency is measured by pointer chasing: Each cache line of the working set holds a pointer to the
+// next, in a random cyclic order, so that every load depends on the previous one and the hardware
+// prefetchers cannot predict the address. Bandwidth is measured by streaming reads, writes, copies
+// (half of the working set to the other half, counting both the bytes read and written) and
+// non-temporal writes, which bypass the caches, using the widest vector width usable: 512-bit with
+// AVX-512, 256-bit with AVX and 128-bit with SSE2. Each bandwidth figure is the best of a few
+// repeats, each of a number of passes over the working set.
+//
+// On systems with more than one NUMA node, main memory is also measured on each node, by running
+// on the first logical processor of the node from the topology enumeration (Topology.h), and
+// allocating the memory there, relying on the first touch policy of the operating system to place
+// it on that node.
+//
+// Uses the Microsoft-specific intrinsics, through the portable shim Intrinsics.h, with the loops
+// for each width marked with CPUFEATURES_TARGET so that GCC and Clang can compile them too.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+#include "../Common/Intrinsics.h"
+#include "../Common/FeatureSnapshot.h"
+#include "../Common/CacheInfo.h"
+#include "../Common/Topology.h"
+#include "../Common/TSC.h"
+#include "Output.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MEMORY_X86
+#endif
+
+enum MemoryWidth { MemoryWidthScalar, MemoryWidth128, MemoryWidth256, MemoryWidth512 };
+static const wchar_t* const memory_width_names[] = { L"64", L"128", L"256", L"512" };
+
+struct MemoryResult {
+	size_t size = 0;        // Working set in bytes
+	double latency_ns = 0;  // Average latency of a dependent load
+	double read_gbps = 0;   // Bandwidth in GB/s (10^9 bytes per second)
+	double write_gbps = 0;
+	double copy_gbps = 0;   // Bytes read and written
+	double nt_write_gbps = 0; // Non-temporal writes, 0 if not available
+};
+
+struct MemoryLevel {
+	unsigned int level; // Cache level, 0 for main memory
+	MemoryResult result;
+};
+
+struct MemoryNode {
+	unsigned int node;
+	unsigned int group, number; // Logical processor measured on
+	MemoryResult result;
+};
+
+// The streaming loops for each width: Read returns a value derived from all loaded data, to prevent the
+// compiler from removing the loads. The sizes are multiples of 256 bytes, and the buffers aligned to
+// the cache line size.
+
+static uint64_t _read_scalar(const char* data, size_t size)
+{
+	const uint64_t* p = reinterpret_cast<const uint64_t*>(data);
+	uint64_t a = 0, b = 0, c = 0, d = 0;
+	for (size_t i = 0; i < size / 8; i += 4) {
+		a ^= p[i]; b ^= p[i + 1]; c ^= p[i + 2]; d ^= p[i + 3];
+	}
+	return a ^ b ^ c ^ d;
+}
+static void _write_scalar(char* data, size_t size)
+{
+	uint64_t* p = reinterpret_cast<uint64_t*>(data);
+	for (size_t i = 0; i < size / 8; ++i)
+		p[i] = i;
+}
+static void _copy_scalar(char* destination, const char* source, size_t size)
+{
+	memcpy(destination, source, size);
+}
+
+#ifdef MEMORY_X86
+#define MEMORY_KERNELS(suffix, instruction_sets, vector, width, load, store, stream, set, xor_, finish) \
+	CPUFEATURES_TARGET(instruction_sets) static uint64_t _read_##suffix(const char* data, size_t size) \
+	{ \
+		const vector* p = reinterpret_cast<const vector*>(data); \
+		vector a = set(0), b = set(0), c = set(0), d = set(0); \
+		for (size_t i = 0; i < size / width; i += 4) { \
+			a = xor_(a, load(p + i)); b = xor_(b, load(p + i + 1)); c = xor_(c, load(p + i + 2)); d = xor_(d, load(p + i + 3)); \
+		} \
+		alignas(64) uint64_t result[width / 8]; \
+		store(reinterpret_cast<vector*>(result), xor_(xor_(a, b), xor_(c, d))); \
+		finish(); \
+		return result[0]; \
+	} \
+	CPUFEATURES_TARGET(instruction_sets) static void _write_##suffix(char* data, size_t size) \
+	{ \
+		vector* p = reinterpret_cast<vector*>(data); \
+		const vector value = set(1); \
+		for (size_t i = 0; i < size / width; ++i) \
+			store(p + i, value); \
+		finish(); \
+	} \
+	CPUFEATURES_TARGET(instruction_sets) static void _copy_##suffix(char* destination, const char* source, size_t size) \
+	{ \
+		vector* q = reinterpret_cast<vector*>(destination); \
+		const vector* p = reinterpret_cast<const vector*>(source); \
+		for (size_t i = 0; i < size / width; ++i) \
+			store(q + i, load(p + i)); \
+		finish(); \
+	} \
+	CPUFEATURES_TARGET(instruction_sets) static void _stream_##suffix(char* data, size_t size) \
+	{ \
+		vector* p = reinterpret_cast<vector*>(data); \
+		const vector value = set(1); \
+		for (size_t i = 0; i < size / width; ++i) \
+			stream(p + i, value); \
+		_mm_sfence(); \
+		finish(); \
+	}
+
+static inline void _memory_no_finish() {}
+// The 256-bit loads and stores of AVX take float pointers, and the integer xor requires AVX2
+CPUFEATURES_TARGET("avx") static inline __m256 _avx_load(const __m256* p) { return _mm256_load_ps(reinterpret_cast<const float*>(p)); }
+CPUFEATURES_TARGET("avx") static inline void _avx_store(__m256* p, __m256 value) { _mm256_store_ps(reinterpret_cast<float*>(p), value); }
+CPUFEATURES_TARGET("avx") static inline void _avx_stream(__m256* p, __m256 value) { _mm256_stream_ps(reinterpret_cast<float*>(p), value); }
+
+MEMORY_KERNELS(128, "sse2", __m128i, 16, _mm_load_si128, _mm_store_si128, _mm_stream_si128, _mm_set1_epi32, _mm_xor_si128, _memory_no_finish)
+MEMORY_KERNELS(256, "avx", __m256, 32, _avx_load, _avx_store, _avx_stream, _mm256_set1_ps, _mm256_xor_ps, _mm256_zeroupper)
+MEMORY_KERNELS(512, "avx512f", __m512i, 64, _mm512_load_si512, _mm512_store_si512, _mm512_stream_si512, _mm512_set1_epi32, _mm512_xor_si512, _mm256_zeroupper)
+#undef MEMORY_KERNELS
+#endif
+
+class MemoryProbe
+{
+public:
+	MemoryProbe(MemoryWidth width, const TSCInfo& tsc) : width_(width), tsc_(tsc) {}
+
+	MemoryResult measure(size_t size) const
+	{
+		MemoryResult result;
+		size = std::max<size_t>(size & ~static_cast<size_t>(255), 4096);
+		result.size = size;
+		std::unique_ptr<char[]> allocation(new char[size + 64]);
+		char* data = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(allocation.get()) + 63) & ~static_cast<uintptr_t>(63));
+		memset(data, 0, size); // Commit the pages before timing
+		result.latency_ns = _latency(data, size);
+		const size_t passes = std::max<size_t>(1, (256u << 20) / size); // About 256 MB per repeat
+		result.read_gbps = _bandwidth(size * passes, [&]() { for (size_t i = 0; i < passes; ++i) sink_ ^= _read(data, size); });
+		result.write_gbps = _bandwidth(size * passes, [&]() { for (size_t i = 0; i < passes; ++i) _write(data, size); });
+		result.copy_gbps = _bandwidth(size * passes, [&]() { for (size_t i = 0; i < passes; ++i) _copy(data + size / 2, data, size / 2); });
+		if (width_ != MemoryWidthScalar)
+			result.nt_write_gbps = _bandwidth(size * passes, [&]() { for (size_t i = 0; i < passes; ++i) _stream(data, size); });
+		return result;
+	}
+
+private:
+	// Average latency in ns of a dependent load, chasing a random cycle through all cache lines of the buffer.
+	double _latency(char* data, size_t size) const
+	{
+		const size_t lines = size / 64;
+		std::vector<size_t> order(lines);
+		for (size_t i = 0; i < lines; ++i)
+			order[i] = i;
+		uint64_t random = 0x9E3779B97F4A7C15ull;
+		for (size_t i = lines - 1; i > 0; --i) {
+			random ^= random << 13; random ^= random >> 7; random ^= random << 17; // xorshift64
+			std::swap(order[i], order[random % (i + 1)]);
+		}
+		for (size_t i = 0; i < lines; ++i)
+			*reinterpret_cast<char**>(data + order[i] * 64) = data + order[(i + 1) % lines] * 64;
+		const size_t loads = std::max<size_t>(lines * 2, 1u << 20);
+		char* p = data;
+		for (size_t i = 0; i < lines; ++i) // Warm up, loading the working set into the level measured
+			p = *reinterpret_cast<char**>(p);
+		const uint64_t start = __rdtsc();
+		for (size_t i = 0; i < loads; ++i)
+			p = *reinterpret_cast<char**>(p);
+		const uint64_t ticks = __rdtsc() - start;
+		sink_ ^= reinterpret_cast<uintptr_t>(p);
+		return static_cast<double>(tsc_ticks_to_ns(tsc_, ticks)) / loads;
+	}
+
+	// Best bandwidth in GB/s of a few repeats of function, each transferring bytes.
+	template<typename Function>
+	double _bandwidth(size_t bytes, Function function) const
+	{
+		function(); // Warm up
+		double best = 0;
+		for (int repeat = 0; repeat < 3; ++repeat) {
+			const uint64_t start = __rdtsc();
+			function();
+			const uint64_t ns = tsc_ticks_to_ns(tsc_, __rdtsc() - start);
+			best = std::max(best, ns ? static_cast<double>(bytes) / ns : 0.0);
+		}
+		return best;
+	}
+
+	uint64_t _read(const char* data, size_t size) const
+	{
+		switch (width_) {
+#ifdef MEMORY_X86
+		case MemoryWidth512: return _read_512(data, size);
+		case MemoryWidth256: return _read_256(data, size);
+		case MemoryWidth128: return _read_128(data, size);
+#endif
+		default: return _read_scalar(data, size);
+		}
+	}
+	void _write(char* data, size_t size) const
+	{
+		switch (width_) {
+#ifdef MEMORY_X86
+		case MemoryWidth512: _write_512(data, size); break;
+		case MemoryWidth256: _write_256(data, size); break;
+		case MemoryWidth128: _write_128(data, size); break;
+#endif
+		default: _write_scalar(data, size);
+		}
+	}
+	void _copy(char* destination, const char* source, size_t size) const
+	{
+		switch (width_) {
+#ifdef MEMORY_X86
+		case MemoryWidth512: _copy_512(destination, source, size); break;
+		case MemoryWidth256: _copy_256(destination, source, size); break;
+		case MemoryWidth128: _copy_128(destination, source, size); break;
+#endif
+		default: _copy_scalar(destination, source, size);
+		}
+	}
+	void _stream(char* data, size_t size) const
+	{
+		switch (width_) {
+#ifdef MEMORY_X86
+		case MemoryWidth512: _stream_512(data, size); break;
+		case MemoryWidth256: _stream_256(data, size); break;
+		case MemoryWidth128: _stream_128(data, size); break;
+#endif
+		default: (void)data; (void)size;
+		}
+	}
+
+	const MemoryWidth width_;
+	const TSCInfo& tsc_;
+	mutable uint64_t sink_ = 0;
+};
+
+static MemoryWidth _memory_width()
+{
+	const FeatureSnapshot snapshot = get_feature_snapshot();
+	if (feature_usable(snapshot, Feature_AVX512F))
+		return MemoryWidth512;
+	if (feature_usable(snapshot, Feature_AVX))
+		return MemoryWidth256;
+	if (feature_usable(snapshot, Feature_SSE2))
+		return MemoryWidth128;
+	return MemoryWidthScalar;
+}
+
+static void _print_result(std::wostream& stream, OutputFormat format, const MemoryResult& result)
+{
+	if (format == OutputXML)
+		stream << L" size=\"" << result.size << L"\" latency_ns=\"" << result.latency_ns << L"\" read_gbps=\"" << result.read_gbps << L"\" write_gbps=\"" << result.write_gbps
+			<< L"\" copy_gbps=\"" << result.copy_gbps << L"\" nt_write_gbps=\"" << result.nt_write_gbps << L"\"";
+	else if (format == OutputJSON)
+		stream << L",\"size\":" << result.size << L",\"latency_ns\":" << result.latency_ns << L",\"read_gbps\":" << result.read_gbps << L",\"write_gbps\":" << result.write_gbps
+			<< L",\"copy_gbps\":" << result.copy_gbps << L",\"nt_write_gbps\":" << result.nt_write_gbps;
+	else
+		stream << result.size / 1024 << L" KB\t" << result.latency_ns << L"\t" << result.read_gbps << L"\t" << result.write_gbps << L"\t" << result.copy_gbps << L"\t" << result.nt_write_gbps;
+}
+
+void print_memory(std::wostream& stream, OutputFormat format)
+{
+	const TSCInfo tsc = get_tsc_info();
+	const MemoryWidth width = _memory_width();
+	const MemoryProbe probe(width, tsc);
+	const CacheInfo cache_info = get_cache_info();
+
+	std::vector<MemoryLevel> levels;
+	size_t last_level_size = 0;
+	for (unsigned int level = 1; level <= 4; ++level) {
+		const CacheDescriptor* cache = find_cache(cache_info, level);
+		if (!cache || !cache->size)
+			continue;
+		levels.push_back({ level, probe.measure(cache->size / 2) });
+		last_level_size = cache->size;
+	}
+	const size_t memory_size = std::max<size_t>(last_level_size * 4, 64u << 20);
+	levels.push_back({ 0, probe.measure(memory_size) });
+
+	std::vector<MemoryNode> nodes;
+	const Topology topology = get_topology();
+	if (topology.numa_nodes > 1) {
+		for_each_logical_processor([&](unsigned int group, unsigned int number) {
+			const auto processor = std::find_if(topology.processors.begin(), topology.processors.end(),
+				[group, number](const LogicalProcessor& p) { return p.group == group && p.number == number; });
+			if (processor == topology.processors.end())
+				return;
+			const unsigned int node = processor->numa_node;
+			if (std::any_of(nodes.begin(), nodes.end(), [node](const MemoryNode& n) { return n.node == node; }))
+				return;
+			nodes.push_back({ node, group, number, probe.measure(memory_size) }); // Allocated and touched while pinned to the node
+		});
+	}
+
+	stream << std::fixed << std::setprecision(2);
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<memory vector_width=\"" << memory_width_names[width] << L"\" tsc_mhz=\"" << tsc.frequency_mhz << L"\">" << L'\n';
+		for (const MemoryLevel& level : levels) {
+			stream << L"<level name=\"" << (level.level ? L"L" + std::to_wstring(level.level) : std::wstring(L"DRAM")) << L"\"";
+			_print_result(stream, format, level.result);
+			stream << L"/>" << L'\n';
+		}
+		for (const MemoryNode& node : nodes) {
+			stream << L"<node id=\"" << node.node << L"\" group=\"" << node.group << L"\" number=\"" << node.number << L"\"";
+			_print_result(stream, format, node.result);
+			stream << L"/>" << L'\n';
+		}
+		stream << L"</memory>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"memory\":{\"vector_width\":" << memory_width_names[width] << L",\"tsc_mhz\":" << tsc.frequency_mhz << L",\"levels\":[";
+		for (size_t i = 0; i < levels.size(); ++i) {
+			stream << (i ? L",\n" : L"\n") << L"{\"name\":\"" << (levels[i].level ? L"L" + std::to_wstring(levels[i].level) : std::wstring(L"DRAM")) << L"\"";
+			_print_result(stream, format, levels[i].result);
+			stream << L'}';
+		}
+		stream << L"\n],\"nodes\":[";
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			stream << (i ? L",\n" : L"\n") << L"{\"id\":" << nodes[i].node << L",\"group\":" << nodes[i].group << L",\"number\":" << nodes[i].number;
+			_print_result(stream, format, nodes[i].result);
+			stream << L'}';
+		}
+		stream << L"\n]}}" << L'\n';
+	} else {
+		stream << L"Vector width " << memory_width_names[width] << L" bits, bandwidth in GB/s" << L'\n';
+		stream << L"Level\tSize\tLatency (ns)\tRead\tWrite\tCopy\tNT write" << L'\n';
+		for (const MemoryLevel& level : levels) {
+			stream << (level.level ? L"L" + std::to_wstring(level.level) : std::wstring(L"DRAM")) << L"\t";
+			_print_result(stream, format, level.result);
+			stream << L'\n';
+		}
+		for (const MemoryNode& node : nodes) {
+			stream << L"Node " << node.node << L"\t";
+			_print_result(stream, format, node.result);
+			stream << L"\t(processor " << node.group << L":" << node.number << L")" << L'\n';
+		}
+	}
+}
@@ -0,0 +1,277 @@
+//
+// Monitoring the processor continuously, as metrics in the Prometheus text exposition format: The usable
+// features and the ISA level, re-captured at each sample so that changes, e.g. after a live migration of
+// a virtual machine, show up as a changed feature set, the thermal and power management capabilities, and
+// for each core its effective frequency and throttling (see Common/Monitor.h).
+//
+// Each core is sampled by a thread pinned to its first logical processor, started once and kept for the
+// lifetime of the monitor, across all processor groups on Windows, all woken at the same time for each
+// sample, waiting only for the threads that could be pinned. Each sample is tagged with its round, so a
+// thread that misses a round and samples late is not counted for the next one. The metrics are written to
+// standard output, or to a file that is replaced atomically at each sample, the way the textfile collector of the Prometheus node exporter and the Windows exporter reads
+// them. Runs until interrupted (SIGINT or SIGTERM), or for the given number of samples.
+//
+#include "Targetver.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <csignal>
+#include <string.h>
+#include "../Common/FeatureCache.h"
+#include "../Common/FeatureMask.h"
+#include "../Common/ISALevel.h"
+#include "../Common/TSC.h"
+#include "../Common/Topology.h"
+#include "../Common/Monitor.h"
+
+static volatile sig_atomic_t _monitor_stop = 0;
+
+static void _monitor_signal(int)
+{
+	_monitor_stop = 1;
+}
+
+// A core, sampled on its first logical processor.
+struct MonitorCore {
+	unsigned int group;
+	unsigned int number;
+	unsigned int package;
+	unsigned int die;
+	unsigned int module;
+	unsigned int core;
+	CoreSampler sampler;
+	CoreSample sample;
+	unsigned int round; // Of the sample, 0 before the first
+};
+
+// A label value, with backslash, double quote and line feed escaped.
+static std::string _label(const char* value)
+{
+	std::string label;
+	for (; *value; ++value) {
+		if (*value == '\\' || *value == '"')
+			label += '\\';
+		if (*value == '\n')
+			label += "\\n";
+		else
+			label += *value;
+	}
+	return label;
+}
+
+static void _header(std::ostream& out, const char* name, const char* type, const char* help)
+{
+	out << "# HELP " << name << ' ' << help << '\n';
+	out << "# TYPE " << name << ' ' << type << '\n';
+}
+
+// Sleep for the interval, waking up to check for interruption.
+static void _sleep(unsigned int interval_ms)
+{
+	const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval_ms);
+	while (!_monitor_stop) {
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= end)
+			break;
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(end - now, std::chrono::milliseconds(100)));
+	}
+}
+
+// Write the metrics, replacing the file atomically: Written to a temporary file next to it and renamed.
+static bool _write_file(const std::string& path, const std::string& text)
+{
+	const std::string temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+	if (!file)
+		return false;
+	const bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+	if (fclose(file) != 0 || !written) {
+		remove(temporary.c_str());
+		return false;
+	}
+#ifdef _WIN32
+	return MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+}
+
+bool run_monitor(const std::string& path, unsigned int interval_ms, unsigned int count)
+{
+	const Topology topology = get_topology();
+	const TSCInfo tsc = get_tsc_info();
+	const PowerManagementInfo power = get_power_management_info();
+	std::vector<MonitorCore> cores;
+	for (const LogicalProcessor& processor : topology.processors) {
+		if (std::none_of(cores.begin(), cores.end(), [&processor](const MonitorCore& core) {
+				return core.package == processor.package && core.die == processor.die && core.module == processor.module && core.core == processor.core; })) {
+			MonitorCore core = {};
+			core.group = processor.group;
+			core.number = processor.number;
+			core.package = processor.package;
+			core.die = processor.die;
+			core.module = processor.module;
+			core.core = processor.core;
+			cores.push_back(core);
+		}
+	}
+
+	// The sampler threads, each waiting for the next round of sampling. Registered once pinned, a core
+	// whose thread could not be pinned is not waited for.
+	std::mutex mutex;
+	std::condition_variable requested, completed;
+	unsigned int round = 0, done = 0, registered = 0;
+	bool stopping = false;
+	std::thread samplers([&]() {
+		for_each_logical_processor_parallel([&](unsigned int group, unsigned int number) {
+			auto it = std::find_if(cores.begin(), cores.end(), [group, number](const MonitorCore& core) { return core.group == group && core.number == number; });
+			if (it == cores.end())
+				return;
+			MonitorCore& core = *it;
+			core_sampler_start(core.sampler, number, tsc.frequency_mhz, power);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				++registered;
+			}
+			completed.notify_one();
+			unsigned int last_round = 0;
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					requested.wait(lock, [&]() { return stopping || round != last_round; });
+					if (stopping)
+						break;
+					last_round = round;
+				}
+				const CoreSample sample = core_sampler_sample(core.sampler);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					core.sample = sample;
+					core.round = last_round;
+					if (last_round == round) // Not a late sample of a round already completed
+						++done;
+				}
+				completed.notify_one();
+			}
+			core_sampler_stop(core.sampler);
+		});
+	});
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		completed.wait_for(lock, std::chrono::seconds(1), [&]() { return registered == cores.size(); });
+	}
+
+	std::signal(SIGINT, _monitor_signal);
+	std::signal(SIGTERM, _monitor_signal);
+	bool success = true;
+	FeatureMask previous_features = {};
+	uint64_t feature_changes = 0, sample_count = 0;
+	double sampling_seconds = 0;
+	for (unsigned int i = 0; (!count || i < count) && !_monitor_stop; ++i) {
+		_sleep(interval_ms);
+		if (_monitor_stop)
+			break;
+		std::vector<MonitorCore> sampled;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			done = 0;
+			++round;
+			requested.notify_all();
+			completed.wait_for(lock, std::chrono::milliseconds(interval_ms) + std::chrono::seconds(1), [&]() { return done >= registered; });
+			for (const MonitorCore& core : cores) {
+				if (core.round == round)
+					sampled.push_back(core);
+			}
+		}
+		CachedFeatureSnapshot snapshot;
+		capture_cached_feature_snapshot(snapshot);
+		const FeatureMask features = feature_mask_from_snapshot(snapshot.features);
+		if (i && memcmp(&features, &previous_features, sizeof(features)) != 0)
+			++feature_changes;
+		previous_features = features;
+		++sample_count;
+		for (const MonitorCore& core : sampled)
+			sampling_seconds += core.sample.seconds;
+		char mask_text[FEATURE_MASK_TEXT_LENGTH + 1];
+		feature_mask_serialize(features, mask_text);
+		const X86Level level = isa_level(snapshot.features);
+
+		std::ostringstream out;
+		_header(out, "cpufeatures_info", "gauge", "Identification of the processor, and its usable features as a serialized feature mask.");
+		out << "cpufeatures_info{vendor=\"" << _label(snapshot.vendor) << "\",brand=\"" << _label(snapshot.brand) << "\",isa_level=\"" << x86_level_names[level]
+			<< "\",feature_mask=\"" << mask_text << "\"} 1" << '\n';
+		_header(out, "cpufeatures_feature_usable", "gauge", "Whether a feature is usable, supported by the processor and enabled by the operating system.");
+		for (int f = 0; f < FeatureCount; ++f)
+			out << "cpufeatures_feature_usable{feature=\"" << _label(feature_table[f].name) << "\"} " << (feature_mask_test(features, static_cast<Feature>(f)) ? 1 : 0) << '\n';
+		_header(out, "cpufeatures_isa_level", "gauge", "The x86-64 microarchitecture level, 0 to 4.");
+		out << "cpufeatures_isa_level " << level << '\n';
+		_header(out, "cpufeatures_feature_set_changes_total", "counter", "Changes of the usable features between samples, e.g. after a live migration.");
+		out << "cpufeatures_feature_set_changes_total " << feature_changes << '\n';
+		_header(out, "cpufeatures_tsc_frequency_hertz", "gauge", "Frequency of the time stamp counter.");
+		out << "cpufeatures_tsc_frequency_hertz " << static_cast<uint64_t>(tsc.frequency_mhz * 1e6) << '\n';
+		_header(out, "cpufeatures_power_management", "gauge", "Thermal and power management capabilities reported by cpuid function id 6.");
+		const struct { const char* name; bool value; } capabilities[] = {
+			{ "digital_thermal_sensor", power.digital_thermal_sensor }, { "turbo", power.turbo }, { "power_limit_notification", power.power_limit_notification },
+			{ "package_thermal", power.package_thermal }, { "hwp", power.hwp }, { "hardware_feedback", power.hardware_feedback }, { "effective_frequency", power.effective_frequency },
+		};
+		for (const auto& capability : capabilities)
+			out << "cpufeatures_power_management{capability=\"" << capability.name << "\"} " << (capability.value ? 1 : 0) << '\n';
+		_header(out, "cpufeatures_core_frequency_hertz", "gauge", "Effective core frequency: Average while running since the previous sample (aperf), or when woken up (probe).");
+		for (const MonitorCore& core : sampled) {
+			if (core.sample.frequency_source != CoreFrequencyNone)
+				out << "cpufeatures_core_frequency_hertz{cpu=\"" << core.group << ':' << core.number << "\",package=\"" << core.package << "\",source=\""
+					<< core_frequency_source_names[core.sample.frequency_source] << "\"} " << static_cast<uint64_t>(core.sample.frequency_mhz * 1e6) << '\n';
+		}
+		_header(out, "cpufeatures_core_throttling", "gauge", "Whether the core is currently throttled, from IA32_THERM_STATUS.");
+		for (const MonitorCore& core : sampled) {
+			if (core.sample.thermal_status) {
+				out << "cpufeatures_core_throttling{cpu=\"" << core.group << ':' << core.number << "\",package=\"" << core.package << "\",reason=\"thermal\"} " << (core.sample.thermal_throttling ? 1 : 0) << '\n';
+				out << "cpufeatures_core_throttling{cpu=\"" << core.group << ':' << core.number << "\",package=\"" << core.package << "\",reason=\"power_limit\"} " << (core.sample.power_limit_throttling ? 1 : 0) << '\n';
+			}
+		}
+		_header(out, "cpufeatures_core_throttle_events_total", "counter", "Throttling events of the core since boot, counted by the operating system.");
+		for (const MonitorCore& core : sampled) {
+			if (core.sample.throttle_counts.available) {
+				out << "cpufeatures_core_throttle_events_total{cpu=\"" << core.group << ':' << core.number << "\",package=\"" << core.package << "\",reason=\"thermal\"} " << core.sample.throttle_counts.core_thermal << '\n';
+				out << "cpufeatures_core_throttle_events_total{cpu=\"" << core.group << ':' << core.number << "\",package=\"" << core.package << "\",reason=\"power_limit\"} " << core.sample.throttle_counts.core_power_limit << '\n';
+			}
+		}
+		_header(out, "cpufeatures_package_throttle_events_total", "counter", "Throttling events of the package since boot, counted by the operating system.");
+		std::vector<unsigned int> packages;
+		for (const MonitorCore& core : sampled) {
+			if (core.sample.throttle_counts.available && std::find(packages.begin(), packages.end(), core.package) == packages.end()) {
+				packages.push_back(core.package);
+				out << "cpufeatures_package_throttle_events_total{package=\"" << core.package << "\",reason=\"thermal\"} " << core.sample.throttle_counts.package_thermal << '\n';
+				out << "cpufeatures_package_throttle_events_total{package=\"" << core.package << "\",reason=\"power_limit\"} " << core.sample.throttle_counts.package_power_limit << '\n';
+			}
+		}
+		_header(out, "cpufeatures_monitor_samples_total", "counter", "Samples taken by the monitor.");
+		out << "cpufeatures_monitor_samples_total " << sample_count << '\n';
+		_header(out, "cpufeatures_monitor_sampled_cores", "gauge", "Cores sampled in the last sample.");
+		out << "cpufeatures_monitor_sampled_cores " << sampled.size() << '\n';
+		_header(out, "cpufeatures_monitor_sampling_seconds_total", "counter", "Time spent sampling by the sampler threads, the overhead of the monitor.");
+		out << "cpufeatures_monitor_sampling_seconds_total " << sampling_seconds << '\n';
+
+		const std::string text = out.str();
+		if (path.empty()) {
+			std::wcout << std::wstring(text.begin(), text.end()) << std::endl;
+		} else if (!_write_file(path, text)) {
+			std::wcerr << L"Failed to write the metrics to " << std::wstring(path.begin(), path.end()) << std::endl;
+			success = false;
+			break;
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	requested.notify_all();
+	samplers.join();
+	return success;
+}
@@ -0,0 +1,102 @@
+//
+// Output formats of the feature listing modes (default, Microsoft and AVX), and a writer for
+// the list of features shared by them.
+//
+// Text and XML are the original formats. JSON is the same content as XML, for consumers that
+// do not want to depend on an XML parser. Hex is a single line meant for collecting from many
+// hosts, where each mode decides the content: The feature listing writer produces a packed
+// bitmask with one bit for each feature in the order listed, set when the feature is usable.
+// Filtering on supported or unsupported does not apply to the bitmask, since a cleared bit
+// already means not supported.
+//
+// The modes write to a buffer, which the main function writes to the console in one operation,
+// so the writer uses '\n' instead of std::endl, which would flush on every line.
+//
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+enum OutputFormat { OutputText, OutputXML, OutputJSON, OutputHex };
+
+// Write a string as the contents of a JSON string, escaping quotes, backslashes and control characters.
+static inline void write_json_string(std::wostream& stream, const wchar_t* value)
+{
+	for (; *value; ++value) {
+		if (*value == L'"' || *value == L'\\')
+			stream << L'\\' << *value;
+		else if (*value < 0x20)
+			stream << L"\\u" << std::hex << std::setw(4) << std::setfill(L'0') << static_cast<unsigned int>(*value) << std::dec << std::setfill(L' ');
+		else
+			stream << *value;
+	}
+}
+
+class FeatureListWriter
+{
+public:
+	// With report_usable, each feature has separate processor and operating system support (see OSSupport.h),
+	// which is reported in the same way as the Microsoft and AVX modes always have. Without it, the
+	// format of the default mode is used: Only supported, and only names when filtering on one of them.
+	FeatureListWriter(std::wostream& stream, OutputFormat format, bool print_supported, bool print_unsupported, bool report_usable)
+		: stream_(stream), format_(format), print_supported_(print_supported), print_unsupported_(print_unsupported), report_usable_(report_usable)
+	{}
+
+	void feature(const wchar_t* name, bool is_supported, bool is_usable)
+	{
+		if (format_ == OutputHex) {
+			if (bits_.size() * 32 <= count_)
+				bits_.push_back(0);
+			if (is_usable)
+				bits_[count_ / 32] |= 1u << (count_ % 32);
+			++count_;
+			return;
+		}
+		if ((is_supported && !print_supported_) || (!is_supported && !print_unsupported_))
+			return;
+		switch (format_) {
+		case OutputXML:
+			stream_ << L"<feature name=\"" << name << L"\" supported=\"" << (is_supported ? L"true" : L"false");
+			if (report_usable_)
+				stream_ << L"\" usable=\"" << (is_usable ? L"true" : L"false");
+			stream_ << L"\"/>" << L'\n';
+			break;
+		case OutputJSON:
+			stream_ << (count_ ? L",\n" : L"\n") << L"{\"name\":\"";
+			write_json_string(stream_, name);
+			stream_ << L"\",\"supported\":" << (is_supported ? L"true" : L"false");
+			if (report_usable_)
+				stream_ << L",\"usable\":" << (is_usable ? L"true" : L"false");
+			stream_ << L'}';
+			break;
+		default:
+			if (report_usable_)
+				stream_ << name << (is_supported ? (is_usable ? L" supported" : L" supported (not enabled by operating system)") : L" not supported") << L'\n';
+			else if (print_supported_ && print_unsupported_)
+				stream_ << name << (is_supported ? L" supported" : L" not supported") << L'\n';
+			else
+				stream_ << name << L'\n';
+		}
+		++count_;
+	}
+
+	// Packed bitmask of the features written, as hexadecimal number without prefix.
+	void write_bitmask()
+	{
+		stream_ << std::hex << std::setfill(L'0');
+		if (bits_.empty())
+			stream_ << L'0';
+		for (size_t i = bits_.size(); i-- > 0;)
+			stream_ << std::setw(i == bits_.size() - 1 ? 0 : 8) << bits_[i];
+		stream_ << std::dec << std::setfill(L' ');
+	}
+
+private:
+	std::wostream& stream_;
+	const OutputFormat format_;
+	const bool print_supported_;
+	const bool print_unsupported_;
+	const bool report_usable_;
+	unsigned int count_ = 0; // Number of features written (all features in hex format)
+	std::vector<unsigned int> bits_;
+};
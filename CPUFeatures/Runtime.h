@@ -0,0 +1,76 @@
+//
+// Runtime detection of the most relevant CPU features, for use when selecting between
+// implementations optimized for different instruction sets (see Common/Dispatch.h).
+//
+// This is the detection of the default mode (see CPUFeatures.cpp), which is based on libsodium
+// (src/libsodium/include/sodium/runtime.h), and just like there the AVX features are reported
+// only when they are supported by both the processor and the operating system, meaning that
+// they actually can be used.
+//
+// On AArch64 the features beyond NEON and ARMCRYPTO are from the ARM registry (Common/ARMFeatures.h),
+// reported by the operating system and therefore always usable when reported.
+//
+#pragma once
+
+typedef struct CPUFeatures_ {
+    int has_neon; // ARM specific (Advanced SIMD extension for ARM)
+    int has_armcrypto;
+    int has_sve;
+    int has_sve2;
+    int has_lse; // ARMv8.1 atomic instructions (Large System Extensions)
+    int has_dotprod;
+    int has_i8mm;
+    int has_bf16;
+    int sve_vector_length; // In bits, 0 if SVE is not supported or the length is unknown
+    int has_sse2;
+    int has_sse3;
+    int has_ssse3;
+    int has_sse41;
+    int has_avx;
+    int has_avx2;
+    int has_avx512f;
+    int has_pclmul;
+    int has_aesni;
+    int has_rdrand;
+} CPUFeatures;
+
+// Detect features of the current processor. Detection is performed only once, on first
+// call, and it is safe to call concurrently from multiple threads. The runtime_has_*
+// functions below call it implicitly, so calling it explicitly is only needed for
+// forcing the detection to happen at a specific time, e.g. at startup.
+// Returns 0 on success, -1 if the processor could not be identified.
+int runtime_get_cpu_features(void);
+
+// The detected features, as a struct.
+const CPUFeatures* runtime_cpu_features(void);
+
+int runtime_has_neon(void);
+int runtime_has_armcrypto(void);
+int runtime_has_sve(void);
+int runtime_has_sve2(void);
+int runtime_has_lse(void);
+int runtime_has_dotprod(void);
+int runtime_has_i8mm(void);
+int runtime_has_bf16(void);
+int runtime_sve_vector_length(void);
+int runtime_has_sse2(void);
+int runtime_has_sse3(void);
+int runtime_has_ssse3(void);
+int runtime_has_sse41(void);
+int runtime_has_avx(void);
+int runtime_has_avx2(void);
+int runtime_has_avx512f(void);
+int runtime_has_pclmul(void);
+int runtime_has_aesni(void);
+int runtime_has_rdrand(void);
+
+// Preferred vector width in bits (128, 256 or 512), measured on first call by running the
+// throughput and frequency drop measurement of the AVX throughput mode (see AVXThroughput.cpp),
+// which takes a few hundred milliseconds. Returns 0 if the measurement requires features that
+// are not supported (FMA and AVX).
+int runtime_preferred_vector_width(void);
+
+// Feature check for registering a 512-bit variant with the dispatcher (see Common/Dispatch.h) only
+// preferred when AVX-512 is both usable and not slowed down by frequency drop: Supported
+// by processor and operating system, and the preferred vector width is 512 bits.
+int runtime_prefer_avx512(void);
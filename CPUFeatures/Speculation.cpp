@@ -0,0 +1,113 @@
+//
+// Reporting the speculative execution controls of the executing processor, the mitigations of
+// speculative execution vulnerabilities the operating system has applied, and the instruction
+// classes that the configuration is known to slow down, e.g. AVX2 gathers with the GDS microcode,
+// or system calls with retpolines and VERW buffer clearing, for routing hot workloads away from
+// such hosts. The decoding and the rules are in the shared header Speculation.h.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include "../Common/Speculation.h"
+#include "Output.h"
+
+static const wchar_t* const speculation_os_names[] = { L"none", L"linux", L"windows" };
+
+static std::wstring _widen(const char* text)
+{
+	std::wstring result(text, text + strlen(text));
+	for (wchar_t& c : result) {
+		if (c < 0x20 || c > 0x7e || c == L'"' || c == L'\\' || c == L'<' || c == L'&')
+			c = L'.'; // Read from the operating system, replaced to be valid in both XML and JSON
+	}
+	return result;
+}
+
+void print_speculation(std::wostream& stream, bool print_supported, bool print_unsupported, OutputFormat format)
+{
+	const SpeculationInfo info = get_speculation_info();
+	SpeculationImpact impacts[32];
+	const unsigned int impact_count = std::min(speculation_impacts(info, impacts, 32), 32u);
+	FeatureListWriter writer(stream, format, print_supported, print_unsupported, false);
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<speculation os=\"" << speculation_os_names[info.os_source] << L"\">" << L'\n';
+		stream << L"<features>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"speculation\":{\"os\":\"" << speculation_os_names[info.os_source] << L"\",\"features\":[";
+	} else {
+		stream << L"Speculation control features:" << L'\n';
+	}
+	for (int i = 0; i < FeatureCount; ++i) {
+		const Feature feature = static_cast<Feature>(i);
+		if (feature_table[feature].groups & FeatureGroupSpeculation)
+			writer.feature(_widen(feature_table[feature].label).c_str(), feature_hardware(info.features, feature), feature_hardware(info.features, feature));
+	}
+	if (format == OutputXML)
+		stream << L"</features>" << L'\n';
+	else if (format == OutputJSON)
+		stream << L"\n],\"vulnerabilities\":[";
+	else if (info.os_source == SpeculationOSLinux)
+		stream << L"Mitigations reported by Linux:" << L'\n';
+	else if (info.os_source == SpeculationOSNone)
+		stream << L"Mitigations not reported by the operating system" << L'\n';
+	for (unsigned int i = 0; i < info.vulnerability_count; ++i) {
+		const SpeculationVulnerability& vulnerability = info.vulnerabilities[i];
+		const std::wstring state_name = _widen(speculation_state_names[speculation_state(vulnerability.state)]);
+		if (format == OutputXML)
+			stream << L"<vulnerability name=\"" << _widen(vulnerability.name) << L"\" state=\"" << state_name << L"\" value=\"" << _widen(vulnerability.state) << L"\"/>" << L'\n';
+		else if (format == OutputJSON)
+			stream << (i ? L",{" : L"{") << L"\"name\":\"" << _widen(vulnerability.name) << L"\",\"state\":\"" << state_name << L"\",\"value\":\"" << _widen(vulnerability.state) << L"\"}";
+		else
+			stream << _widen(vulnerability.name) << L": " << _widen(vulnerability.state) << L'\n';
+	}
+	if (format == OutputJSON)
+		stream << L']';
+	if (info.os_source == SpeculationOSWindows) {
+		if (format == OutputXML)
+			stream << L"<windows flags=\"0x" << std::hex << info.windows_flags << L"\" kva_shadow_flags=\"0x" << info.windows_kva_shadow_flags << std::dec << L"\">" << L'\n';
+		else if (format == OutputJSON)
+			stream << L",\"windows\":{\"flags\":" << info.windows_flags << L",\"kva_shadow_flags\":" << info.windows_kva_shadow_flags << L",\"names\":[";
+		else
+			stream << L"Speculation control reported by Windows:";
+		bool first = true;
+		for (const auto& flag : windows_speculation_flags) {
+			if (((info.windows_flags >> flag.bit) & 1) == 0)
+				continue;
+			if (format == OutputXML)
+				stream << L"<flag name=\"" << _widen(flag.name) << L"\"/>" << L'\n';
+			else if (format == OutputJSON)
+				stream << (first ? L"\"" : L",\"") << _widen(flag.name) << L'"';
+			else
+				stream << L' ' << _widen(flag.name);
+			first = false;
+		}
+		if (format == OutputXML)
+			stream << L"</windows>" << L'\n';
+		else if (format == OutputJSON)
+			stream << L"]}";
+		else
+			stream << L'\n' << L"Kernel VA shadow " << ((info.windows_kva_shadow_flags >> WINDOWS_KVA_SHADOW_ENABLED) & 1 ? L"enabled" : L"not enabled") << L'\n';
+	}
+	if (format == OutputJSON)
+		stream << L",\"impacts\":[";
+	else if (format == OutputText)
+		stream << (impact_count ? L"Performance impact:" : L"No known performance impact of the mitigations") << L'\n';
+	for (unsigned int i = 0; i < impact_count; ++i) {
+		const SpeculationImpact& impact = impacts[i];
+		const std::wstring class_name = _widen(speculation_impact_names[impact.impact]);
+		if (format == OutputXML)
+			stream << L"<impact class=\"" << class_name << L"\" cause=\"" << _widen(impact.cause) << L"\" hint=\"" << _widen(impact.hint) << L"\"/>" << L'\n';
+		else if (format == OutputJSON)
+			stream << (i ? L",{" : L"{") << L"\"class\":\"" << class_name << L"\",\"cause\":\"" << _widen(impact.cause) << L"\",\"hint\":\"" << _widen(impact.hint) << L"\"}";
+		else
+			stream << class_name << L" (" << _widen(impact.cause) << L"): " << _widen(impact.hint) << L'\n';
+	}
+	if (format == OutputXML) {
+		stream << L"</speculation>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"]}}" << L'\n';
+	}
+}
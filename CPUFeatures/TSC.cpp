@@ -0,0 +1,55 @@
+//
+// Reporting the time stamp counter (TSC) parameters of the executing processor, for timing with
+// rdtsc: Whether the TSC is invariant and rdtscp is available, the values of function ids 0x15
+// (TSC to core crystal clock ratio) and 0x16 (base, maximum and bus frequency), the frequency
+// reported by a hypervisor in function id 0x40000010, and the resulting TSC frequency with the
+// source it was taken from. The frequency is also always measured against the system clock,
+// which verifies the reported one. The decoding is done in the shared header TSC.h.
+//
+// Uses the Microsoft-specific intrinsics, which build with GCC and Clang through the portable shim Intrinsics.h.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <string.h>
+#include "../Common/TSC.h"
+#include "Output.h"
+
+void print_tsc(std::wostream& stream, OutputFormat format)
+{
+	const TSCInfo info = get_tsc_info();
+	const double measured_mhz = info.source == TSCFrequencyMeasured ? info.frequency_mhz : measure_tsc_frequency();
+	const char* source = tsc_frequency_source_names[info.source];
+	const std::wstring source_wide(source, source + strlen(source));
+	stream << std::fixed << std::setprecision(3);
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<tsc invariant=\"" << (info.invariant ? L"true" : L"false") << L"\" rdtscp=\"" << (info.rdtscp ? L"true" : L"false")
+			<< L"\" frequency_mhz=\"" << info.frequency_mhz << L"\" source=\"" << source_wide << L"\" measured_mhz=\"" << measured_mhz
+			<< L"\" ns_per_tick=\"" << info.ns_per_tick / 4294967296.0 << L"\">" << L'\n';
+		stream << L"<ratio numerator=\"" << info.ratio_numerator << L"\" denominator=\"" << info.ratio_denominator << L"\" crystal_hz=\"" << info.crystal_hz << L"\"/>" << L'\n';
+		stream << L"<nominal base_mhz=\"" << info.base_mhz << L"\" max_mhz=\"" << info.max_mhz << L"\" bus_mhz=\"" << info.bus_mhz << L"\"/>" << L'\n';
+		stream << L"<hypervisor khz=\"" << info.hypervisor_khz << L"\"/>" << L'\n';
+		stream << L"</tsc>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"tsc\":{\"invariant\":" << (info.invariant ? L"true" : L"false") << L",\"rdtscp\":" << (info.rdtscp ? L"true" : L"false")
+			<< L",\"frequency_mhz\":" << info.frequency_mhz << L",\"source\":\"" << source_wide << L"\",\"measured_mhz\":" << measured_mhz
+			<< L",\"ns_per_tick\":" << info.ns_per_tick / 4294967296.0
+			<< L",\"ratio_numerator\":" << info.ratio_numerator << L",\"ratio_denominator\":" << info.ratio_denominator << L",\"crystal_hz\":" << info.crystal_hz
+			<< L",\"base_mhz\":" << info.base_mhz << L",\"max_mhz\":" << info.max_mhz << L",\"bus_mhz\":" << info.bus_mhz
+			<< L",\"hypervisor_khz\":" << info.hypervisor_khz << L"}}" << L'\n';
+	} else {
+		stream << L"Invariant TSC " << (info.invariant ? L"supported" : L"not supported") << L'\n';
+		stream << L"RDTSCP " << (info.rdtscp ? L"supported" : L"not supported") << L'\n';
+		if (info.ratio_denominator && info.ratio_numerator)
+			stream << L"TSC/crystal ratio " << info.ratio_numerator << L'/' << info.ratio_denominator << L", crystal " << info.crystal_hz << L" Hz" << L'\n';
+		if (info.base_mhz)
+			stream << L"Base " << info.base_mhz << L" MHz, max " << info.max_mhz << L" MHz, bus " << info.bus_mhz << L" MHz" << L'\n';
+		if (info.hypervisor_khz)
+			stream << L"Hypervisor TSC frequency " << info.hypervisor_khz << L" kHz" << L'\n';
+		stream << L"TSC frequency " << info.frequency_mhz << L" MHz (" << source_wide << L"), measured " << measured_mhz << L" MHz" << L'\n';
+		stream << L"One tick is " << info.ns_per_tick / 4294967296.0 << L" ns" << L'\n';
+	}
+}
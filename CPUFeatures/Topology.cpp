@@ -0,0 +1,48 @@
+//
+// Reporting the topology of the logical processors the process is allowed to run on: For each
+// logical processor its APIC ID, and the package, die, module, core and SMT thread it belongs
+// to, together with the L2 and L3 cache sharing domains. The enumeration is done in the shared
+// header Topology.h, by pinning the thread to each logical processor in turn and decoding
+// function id 0x1F, 0xB or 0x80000026.
+//
+// Uses the Microsoft-specific intrinsics, which build with GCC and Clang through the portable shim Intrinsics.h.
+//
+#include "Targetver.h"
+#include "../Common/Topology.h"
+#include <iostream>
+
+static const wchar_t* topology_source_names[] = { L"legacy", L"0xB", L"0x1F", L"0x80000026" };
+
+void print_topology(std::wostream& stream, bool print_xml)
+{
+	const Topology topology = get_topology();
+	const std::vector<unsigned int> cores = one_thread_per_core(topology);
+	if (print_xml) {
+		stream << L"<cpu>" << std::endl;
+		stream << L"<topology source=\"" << topology_source_names[topology.source] << L"\" packages=\"" << topology.packages
+			<< L"\" dies=\"" << topology.dies << L"\" modules=\"" << topology.modules << L"\" cores=\"" << topology.cores
+			<< L"\" numa_nodes=\"" << topology.numa_nodes << L"\" logical_processors=\"" << topology.processors.size() << L"\" hybrid=\"" << (topology.hybrid ? L"true" : L"false") << L"\">" << std::endl;
+		for (unsigned int i = 0; i < topology.processors.size(); ++i) {
+			const LogicalProcessor& processor = topology.processors[i];
+			stream << L"<processor group=\"" << processor.group << L"\" number=\"" << processor.number << L"\" apic_id=\"" << processor.apic_id
+				<< L"\" package=\"" << processor.package << L"\" die=\"" << processor.die << L"\" module=\"" << processor.module
+				<< L"\" core=\"" << processor.core << L"\" smt=\"" << processor.smt << L"\" numa_node=\"" << processor.numa_node << L"\" l2=\"" << processor.l2 << L"\" l3=\"" << processor.l3
+				<< L"\" core_type=\"" << (processor.core_type == CoreTypePerformance ? L"performance" : processor.core_type == CoreTypeEfficiency ? L"efficiency" : L"unknown")
+				<< L"\" primary=\"" << (std::find(cores.begin(), cores.end(), i) != cores.end() ? L"true" : L"false") << L"\"/>" << std::endl;
+		}
+		stream << L"</topology>" << std::endl;
+		stream << L"</cpu>" << std::endl;
+	} else {
+		stream << L"Topology source " << topology_source_names[topology.source] << L": " << topology.packages << L" packages, " << topology.dies << L" dies, " << topology.modules << L" modules, "
+			<< topology.cores << L" cores, " << topology.numa_nodes << L" NUMA nodes, " << topology.processors.size() << L" logical processors" << std::endl;
+		stream << L"Group\tNumber\tAPIC ID\tPackage\tDie\tModule\tCore\tSMT\tNode\tL2\tL3" << (topology.hybrid ? L"\tType" : L"") << std::endl;
+		for (const LogicalProcessor& processor : topology.processors) {
+			stream << processor.group << L"\t" << processor.number << L"\t" << processor.apic_id << L"\t" << processor.package << L"\t"
+				<< processor.die << L"\t" << processor.module << L"\t" << processor.core << L"\t" << processor.smt << L"\t"
+				<< processor.numa_node << L"\t" << processor.l2 << L"\t" << processor.l3;
+			if (topology.hybrid)
+				stream << L"\t" << (processor.core_type == CoreTypePerformance ? L"P" : processor.core_type == CoreTypeEfficiency ? L"E" : L"?");
+			stream << std::endl;
+		}
+	}
+}
@@ -1,12 +1,14 @@
 // Version numbers, used in resource file and in source.
 
-#ifdef _WIN64
+#if defined(_M_ARM64) || defined(__aarch64__)
+#define VERSION_PLATFORM_STRING "ARM64"
+#elif defined(_WIN64) || defined(__x86_64__)
 #define VERSION_PLATFORM_STRING "x64"
 #else
 #define VERSION_PLATFORM_STRING "x86"
 #endif
 
-#if _DEBUG
+#if defined(_DEBUG) || (!defined(_WIN32) && !defined(NDEBUG)) // The CMake build defines NDEBUG in release builds on all compilers, but _DEBUG only with Microsoft
 #define VERSION_CONFIGURATION_STRING "Debug"
 #else
 #define VERSION_CONFIGURATION_STRING "Release"
@@ -0,0 +1,98 @@
+//
+// Reporting the extended processor state (XSAVE) area of the executing processor: The XSAVE
+// instructions supported, each state component with its size and offset, and the size of the
+// area for the enabled components in the standard and compacted formats, which is the cost of
+// saving a thread's state on context switches. The decoding is done in the shared header XSave.h.
+//
+// Uses the Microsoft-specific intrinsics, which build with GCC and Clang through the portable shim Intrinsics.h.
+//
+#include "Targetver.h"
+#include <iostream>
+#include <string>
+#include <string.h>
+#include "../Common/XSave.h"
+#include "Output.h"
+
+static const struct { unsigned int flag; const wchar_t* name; } xsave_feature_names[] = {
+	{ XSAVE_FEATURE_XSAVEOPT, L"XSAVEOPT" }, { XSAVE_FEATURE_XSAVEC, L"XSAVEC" }, { XSAVE_FEATURE_XGETBV1, L"XGETBV1" },
+	{ XSAVE_FEATURE_XSAVES, L"XSAVES" }, { XSAVE_FEATURE_XFD, L"XFD" } };
+
+static std::wstring _component_name(unsigned int index)
+{
+	const char* name = xsave_component_name(index);
+	return std::wstring(name, name + strlen(name));
+}
+
+static const wchar_t* _component_state(const XSaveComponent& component)
+{
+	return component.supervisor ? L"supervisor" : component.enabled ? L"enabled" : L"disabled";
+}
+
+void print_xsave(std::wostream& stream, OutputFormat format)
+{
+	const XSaveInfo info = get_xsave_info();
+	const unsigned int compacted_size = xsave_compacted_size(info, info.xcr0);
+	const unsigned int compacted_size_without_xfd = xsave_compacted_size(info, info.xcr0 & ~xsave_xfd_components(info));
+	if (format == OutputXML) {
+		stream << L"<cpu>" << L'\n';
+		stream << L"<xsave supported=\"" << (info.supported ? L"true" : L"false") << std::hex << L"\" xcr0=\"0x" << info.xcr0
+			<< L"\" xcr0_supported=\"0x" << info.xcr0_supported << L"\" xss_supported=\"0x" << info.xss_supported << std::dec
+			<< L"\" size=\"" << info.size << L"\" max_size=\"" << info.max_size << L"\" compacted_size=\"" << compacted_size
+			<< L"\" compacted_size_without_xfd=\"" << compacted_size_without_xfd << L"\" system_size=\"" << info.system_size << L"\">" << L'\n';
+		for (const auto& feature : xsave_feature_names) {
+			if (info.features & feature.flag)
+				stream << L"<feature name=\"" << feature.name << L"\"/>" << L'\n';
+		}
+		for (unsigned int i = 0; i < info.component_count; ++i) {
+			const XSaveComponent& component = info.components[i];
+			stream << L"<component index=\"" << component.index << L"\" name=\"" << _component_name(component.index) << L"\" size=\"" << component.size
+				<< L"\" offset=\"" << component.offset << L"\" aligned=\"" << (component.aligned ? L"true" : L"false") << L"\" xfd=\"" << (component.xfd ? L"true" : L"false")
+				<< L"\" state=\"" << _component_state(component) << L"\"/>" << L'\n';
+		}
+		stream << L"</xsave>" << L'\n';
+		stream << L"</cpu>" << L'\n';
+	} else if (format == OutputJSON) {
+		stream << L"{\"xsave\":{\"supported\":" << (info.supported ? L"true" : L"false")
+			<< L",\"xcr0\":" << info.xcr0 << L",\"xcr0_supported\":" << info.xcr0_supported << L",\"xss_supported\":" << info.xss_supported
+			<< L",\"size\":" << info.size << L",\"max_size\":" << info.max_size << L",\"compacted_size\":" << compacted_size
+			<< L",\"compacted_size_without_xfd\":" << compacted_size_without_xfd << L",\"system_size\":" << info.system_size << L",\"features\":[";
+		bool first = true;
+		for (const auto& feature : xsave_feature_names) {
+			if (info.features & feature.flag) {
+				stream << (first ? L"\"" : L",\"") << feature.name << L'"';
+				first = false;
+			}
+		}
+		stream << L"],\"components\":[";
+		for (unsigned int i = 0; i < info.component_count; ++i) {
+			const XSaveComponent& component = info.components[i];
+			stream << (i ? L",{" : L"{") << L"\"index\":" << component.index << L",\"name\":\"" << _component_name(component.index) << L"\",\"size\":" << component.size
+				<< L",\"offset\":" << component.offset << L",\"aligned\":" << (component.aligned ? L"true" : L"false") << L",\"xfd\":" << (component.xfd ? L"true" : L"false")
+				<< L",\"state\":\"" << _component_state(component) << L"\"}";
+		}
+		stream << L"]}}" << L'\n';
+	} else {
+		if (!info.supported) {
+			stream << L"XSAVE not supported" << L'\n';
+			return;
+		}
+		stream << L"XSAVE supported, with";
+		for (const auto& feature : xsave_feature_names) {
+			if (info.features & feature.flag)
+				stream << L' ' << feature.name;
+		}
+		stream << L'\n';
+		stream << std::hex << L"XCR0 0x" << info.xcr0 << L" (supported 0x" << info.xcr0_supported << L"), IA32_XSS supported 0x" << info.xss_supported << std::dec << L'\n';
+		stream << L"Index\tComponent\tSize\tOffset\tAligned\tXFD\tState" << L'\n';
+		for (unsigned int i = 0; i < info.component_count; ++i) {
+			const XSaveComponent& component = info.components[i];
+			stream << component.index << L'\t' << _component_name(component.index) << L'\t' << component.size << L'\t' << component.offset << L'\t'
+				<< (component.aligned ? L"yes" : L"no") << L'\t' << (component.xfd ? L"yes" : L"no") << L'\t' << _component_state(component) << L'\n';
+		}
+		stream << L"Standard format (XSAVE): " << info.size << L" bytes for the enabled components, " << info.max_size << L" bytes for all supported" << L'\n';
+		if (compacted_size)
+			stream << L"Compacted format (XSAVEC): " << compacted_size << L" bytes for the enabled components, " << compacted_size_without_xfd << L" bytes without the XFD components" << L'\n';
+		if (info.system_size)
+			stream << L"Compacted format (XSAVES): " << info.system_size << L" bytes including the supervisor components" << L'\n';
+	}
+}
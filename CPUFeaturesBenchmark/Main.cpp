@@ -0,0 +1,414 @@
+//
+// Microbenchmark of representative instructions of the features detected, measuring latency
+// and throughput in core clock cycles.
+//
+// That a feature is supported does not mean that it is fast: PEXT/PDEP (BMI2) are microcoded
+// on AMD processors before Zen 3, with latency depending on the mask, RDRAND may be emulated
+// or trapped by a hypervisor, and gathers are much slower than separate loads on some
+// processors. For each benchmark whose feature is usable (see Common/FeatureRegistry.h),
+// the latency is measured with a dependent chain of the instruction, and the throughput
+// (reciprocal, cycles per instruction) with eight independent chains. The instructions
+// without input from the previous result (RDRAND and RDSEED) only have throughput measured.
+//
+// The loops are timed with rdtsc, repeated and taking the median, and converted to core cycles
+// using the ratio of core cycles to time stamp counter ticks measured immediately after each
+// run (see Common/CycleCounter.h). The results can be presented as XML (-xml or -x) or JSON
+// (-json or -j), e.g. for blacklisting code paths that are supported, but slow.
+//
+// With argument -kernels (-k) it instead benchmarks each variant of the utility kernels of the
+// CPUFeaturesLibrary (see Common/Kernels.h) that the executing processor supports, reporting the
+// bandwidth in GB/s, and which variant the dispatcher selects. Each variant is first verified
+// against the portable variant, and for AES against the test vector of NIST SP 800-38A, and the
+// exit code is 1 if any of them fails.
+//
+#include "Targetver.h"
+#include "../Common/WMain.h"
+#include "../Common/FeatureSnapshot.h"
+#include "../Common/CycleCounter.h"
+#include "../Common/Kernels.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+typedef double (*Kernel)(uint64_t iterations);
+
+static const int chain_length = 8; // Instructions per iteration of each kernel
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+// Kernels measuring latency: A single chain, each instruction depending on the result of the previous.
+#define BENCHMARK_LATENCY(name, instruction_sets, type, init, op, result) \
+	CPUFEATURES_TARGET(instruction_sets) static double name(uint64_t iterations) \
+	{ \
+		type x = init(0); \
+		for (uint64_t n = 0; n < iterations; ++n) { \
+			x = op(x); x = op(x); x = op(x); x = op(x); \
+			x = op(x); x = op(x); x = op(x); x = op(x); \
+		} \
+		return static_cast<double>(result(x)); \
+	}
+
+// Kernels measuring throughput: Eight independent chains, with different initial values so that
+// the compiler can not merge them.
+#define BENCHMARK_THROUGHPUT(name, instruction_sets, type, init, op, result) \
+	CPUFEATURES_TARGET(instruction_sets) static double name(uint64_t iterations) \
+	{ \
+		type x0 = init(1), x1 = init(2), x2 = init(3), x3 = init(4), x4 = init(5), x5 = init(6), x6 = init(7), x7 = init(8); \
+		for (uint64_t n = 0; n < iterations; ++n) { \
+			x0 = op(x0); x1 = op(x1); x2 = op(x2); x3 = op(x3); \
+			x4 = op(x4); x5 = op(x5); x6 = op(x6); x7 = op(x7); \
+		} \
+		return static_cast<double>(result(x0)) + result(x1) + result(x2) + result(x3) + result(x4) + result(x5) + result(x6) + result(x7); \
+	}
+
+#define BENCHMARK_KERNELS(name, instruction_sets, type, init, op, result) \
+	BENCHMARK_LATENCY(name##_latency, instruction_sets, type, init, op, result) \
+	BENCHMARK_THROUGHPUT(name##_throughput, instruction_sets, type, init, op, result)
+
+static volatile uint32_t seed = 0x9E3779B9u; // Volatile to prevent the compiler from computing the chains at compile time
+static int gather_table[256];
+
+#define SCALAR_INIT(i) (seed + (i))
+#define SCALAR_RESULT(x) (x)
+#define INT128_INIT(i) _mm_set1_epi32(static_cast<int>(seed) + (i))
+#define INT128_RESULT(x) _mm_cvtsi128_si32(x)
+#define INT256_INIT(i) _mm256_set1_epi32((i))
+#define INT256_RESULT(x) _mm256_cvtsi256_si32(x)
+#define FLOAT256_INIT(i) _mm256_set1_ps(1.0f + (i))
+#define FLOAT256_RESULT(x) _mm256_cvtss_f32(x)
+#define INT512_INIT(i) _mm512_set1_epi32(static_cast<int>(seed) + (i))
+#define INT512_RESULT(x) _mm512_cvtsi512_si32(x)
+
+#define PEXT_OP(x) _pext_u32((x), 0xF0F0FF73u) // Mask with many bits set, the latency depends on it when microcoded
+#define POPCNT_OP(x) static_cast<uint32_t>(_mm_popcnt_u32(x))
+#define AESENC_OP(x) _mm_aesenc_si128((x), _mm_set1_epi32(0x5A5A5A5A))
+#define PCLMUL_OP(x) _mm_clmulepi64_si128((x), _mm_set1_epi32(0x12345679), 0x00)
+#define GATHER_OP(x) _mm256_i32gather_epi32(gather_table, (x), 4)
+#define FMA_OP(x) _mm256_fmadd_ps((x), _mm256_set1_ps(0.999999f), _mm256_set1_ps(0.000001f))
+#define VPERMB_OP(x) _mm512_maskz_permutexvar_epi8(~0ull, _mm512_set1_epi32(0x00010203), (x))
+#define VPCOMPRESSD_OP(x) _mm512_maskz_compress_epi32(0x5A5A, (x))
+
+BENCHMARK_KERNELS(_pext, "bmi2", uint32_t, SCALAR_INIT, PEXT_OP, SCALAR_RESULT)
+BENCHMARK_KERNELS(_popcnt, "popcnt", uint32_t, SCALAR_INIT, POPCNT_OP, SCALAR_RESULT)
+BENCHMARK_KERNELS(_aesenc, "aes,sse2", __m128i, INT128_INIT, AESENC_OP, INT128_RESULT)
+BENCHMARK_KERNELS(_pclmul, "pclmul,sse2", __m128i, INT128_INIT, PCLMUL_OP, INT128_RESULT)
+BENCHMARK_KERNELS(_gather, "avx2", __m256i, INT256_INIT, GATHER_OP, INT256_RESULT)
+BENCHMARK_KERNELS(_fma, "avx,fma", __m256, FLOAT256_INIT, FMA_OP, FLOAT256_RESULT)
+BENCHMARK_KERNELS(_vpermb, "avx512f,avx512bw,avx512vbmi", __m512i, INT512_INIT, VPERMB_OP, INT512_RESULT)
+BENCHMARK_KERNELS(_vpcompressd, "avx512f", __m512i, INT512_INIT, VPCOMPRESSD_OP, INT512_RESULT)
+
+#define RDRAND_OP(x) ((x) ^ ((_rdrand32_step(&value)), value))
+#define RDSEED_OP(x) ((x) ^ ((_rdseed32_step(&value)), value))
+
+CPUFEATURES_TARGET("rdrnd") static double _rdrand_throughput(uint64_t iterations)
+{
+	unsigned int value = 0, x = 0;
+	for (uint64_t n = 0; n < iterations; ++n) {
+		x = RDRAND_OP(x); x = RDRAND_OP(x); x = RDRAND_OP(x); x = RDRAND_OP(x);
+		x = RDRAND_OP(x); x = RDRAND_OP(x); x = RDRAND_OP(x); x = RDRAND_OP(x);
+	}
+	return x;
+}
+
+CPUFEATURES_TARGET("rdseed") static double _rdseed_throughput(uint64_t iterations)
+{
+	unsigned int value = 0, x = 0;
+	for (uint64_t n = 0; n < iterations; ++n) {
+		x = RDSEED_OP(x); x = RDSEED_OP(x); x = RDSEED_OP(x); x = RDSEED_OP(x);
+		x = RDSEED_OP(x); x = RDSEED_OP(x); x = RDSEED_OP(x); x = RDSEED_OP(x);
+	}
+	return x;
+}
+
+#define BENCHMARK(feature, instruction, name) { Feature_##feature, instruction, name##_latency, name##_throughput }
+
+#endif
+
+struct Benchmark {
+	Feature feature;
+	const wchar_t* instruction;
+	Kernel latency; // nullptr if the instruction does not depend on a previous result
+	Kernel throughput;
+};
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+static const Benchmark benchmarks[] = {
+	BENCHMARK(BMI2, L"PEXT", _pext),
+	BENCHMARK(POPCNT, L"POPCNT", _popcnt),
+	BENCHMARK(AES, L"AESENC", _aesenc),
+	BENCHMARK(PCLMULQDQ, L"PCLMULQDQ", _pclmul),
+	{ Feature_RDRAND, L"RDRAND", nullptr, _rdrand_throughput },
+	{ Feature_RDSEED, L"RDSEED", nullptr, _rdseed_throughput },
+	BENCHMARK(AVX2, L"VPGATHERDD", _gather),
+	BENCHMARK(FMA, L"VFMADD", _fma),
+	BENCHMARK(AVX512VBMI, L"VPERMB", _vpermb),
+	BENCHMARK(AVX512F, L"VPCOMPRESSD", _vpcompressd),
+};
+static const size_t benchmark_count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+#else
+static const Benchmark* const benchmarks = nullptr; // No benchmarks on other architectures
+static const size_t benchmark_count = 0;
+#endif
+
+// Run a kernel for at least about a millisecond, doubling the iteration count until reached, and then
+// repeat it taking the median, which is less sensitive than the minimum to noise in the measured ratio
+// of core cycles to ticks. Returns core cycles per instruction.
+static double _measure(Kernel kernel)
+{
+	static volatile double sink;
+	const uint64_t min_ticks = 2000000;
+	const int repeats = 5;
+	uint64_t iterations = 16;
+	double cycles[repeats];
+	for (int repeat = 0; repeat < repeats;) {
+		const uint64_t start = __rdtsc();
+		sink = kernel(iterations);
+		const uint64_t ticks = __rdtsc() - start;
+		(void)sink; // Read back outside the measurement, the result is only stored to keep the kernel from being optimized away
+		if (ticks < min_ticks) {
+			iterations *= 2;
+			continue;
+		}
+		cycles[repeat++] = ticks * core_cycles_per_tick() / (static_cast<double>(iterations) * chain_length);
+	}
+	std::sort(cycles, cycles + repeats);
+	return cycles[repeats / 2];
+}
+
+struct KernelResult {
+	const wchar_t* kernel;
+	std::wstring variant;
+	bool supported;
+	bool selected;
+	bool verified;
+	double bandwidth; // GB/s
+};
+
+static const size_t kernel_buffer_size = 1 << 20;
+static const size_t kernel_random_size = 1 << 16; // The random generators are much slower
+static const size_t kernel_verify_sizes[] = { 0, 1, 15, 16, 17, 63, 64, 65, 127, 128, 255, 256, 257, 1000, 4096 + 13, kernel_buffer_size };
+
+// Time calls of a kernel, each returning the number of bytes processed, taking the median of repeats
+// after a first call warming up the caches. Returns GB/s.
+template<typename Call>
+static double _measure_bandwidth(double tsc_frequency, Call call)
+{
+	const int repeats = 7;
+	double bandwidths[repeats];
+	call();
+	for (int repeat = 0; repeat < repeats; ++repeat) {
+		const uint64_t start = __rdtsc();
+		const size_t bytes = call();
+		const uint64_t ticks = std::max<uint64_t>(__rdtsc() - start, 1);
+		bandwidths[repeat] = bytes * tsc_frequency / (ticks * 1000.0); // Frequency in MHz, so bytes per microsecond / 1000
+	}
+	std::sort(bandwidths, bandwidths + repeats);
+	return bandwidths[repeats / 2];
+}
+
+// Verify and measure each variant supported of a kernel's dispatcher.
+template<typename KernelDispatcher, typename Verify, typename Run>
+static void _benchmark_kernel(std::vector<KernelResult>& results, const wchar_t* kernel, const KernelDispatcher& dispatcher, double tsc_frequency, Verify verify, Run run)
+{
+	for (size_t i = 0; i < dispatcher.size(); ++i) {
+		const char* name = dispatcher.variant(i).name;
+		KernelResult result = { kernel, std::wstring(name, name + strlen(name)), dispatcher.supported(i), i == dispatcher.selected(), false, 0 };
+		if (result.supported) {
+			const typename KernelDispatcher::Function function = dispatcher.variant(i).function;
+			result.verified = verify(function);
+			if (result.verified)
+				result.bandwidth = _measure_bandwidth(tsc_frequency, [&]() { return run(function); });
+		}
+		results.push_back(result);
+	}
+}
+
+static int _benchmark_kernels(bool print_xml, bool print_json)
+{
+	static volatile uint64_t sink;
+	const double tsc_frequency = measure_tsc_frequency();
+	std::vector<unsigned char> data(kernel_buffer_size + 64), output(kernel_buffer_size + 64);
+	uint32_t state = 0x9E3779B9u;
+	for (unsigned char& byte : data) {
+		state = state * 1664525u + 1013904223u;
+		byte = static_cast<unsigned char>(state >> 24);
+	}
+	const unsigned char* const input = data.data() + 1; // Unaligned, as buffers from the caller may be
+	unsigned char* const out = output.data() + 1;
+	std::vector<KernelResult> results;
+
+	_benchmark_kernel(results, L"crc32c", crc32c_dispatcher(), tsc_frequency,
+		[&](CRC32CDispatcher::Function function) {
+			if (function(0, "123456789", 9) != 0xE3069283u)
+				return false;
+			for (size_t size : kernel_verify_sizes) {
+				if (function(0, input, size) != crc32c_scalar(0, input, size) || function(0x12345678, input, size) != crc32c_scalar(0x12345678, input, size))
+					return false;
+			}
+			return true;
+		},
+		[&](CRC32CDispatcher::Function function) { sink = function(0, input, kernel_buffer_size); return kernel_buffer_size; });
+
+	_benchmark_kernel(results, L"popcount", popcount_dispatcher(), tsc_frequency,
+		[&](PopCountDispatcher::Function function) {
+			for (size_t size : kernel_verify_sizes) {
+				if (function(input, size) != popcount_scalar(input, size))
+					return false;
+			}
+			return true;
+		},
+		[&](PopCountDispatcher::Function function) { sink = function(input, kernel_buffer_size); return kernel_buffer_size; });
+
+	_benchmark_kernel(results, L"copy", copy_bytes_dispatcher(), tsc_frequency,
+		[&](CopyBytesDispatcher::Function function) {
+			for (size_t size : kernel_verify_sizes) {
+				std::fill(output.begin(), output.end(), static_cast<unsigned char>(0xCC));
+				if (function(out, input, size) != out || memcmp(out, input, size) != 0 || out[size] != 0xCC || out[-1] != 0xCC)
+					return false;
+			}
+			return true;
+		},
+		[&](CopyBytesDispatcher::Function function) { sink = reinterpret_cast<uintptr_t>(function(out, input, kernel_buffer_size)); return kernel_buffer_size; });
+
+	// NIST SP 800-38A, F.5.1 CTR-AES128.Encrypt
+	static const unsigned char aes_key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+	static const unsigned char aes_counter[16] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+	static const unsigned char aes_plaintext[64] = {
+		0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+		0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+		0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+		0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10 };
+	static const unsigned char aes_ciphertext[64] = {
+		0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+		0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+		0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+		0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee };
+	AES128Key key;
+	aes128_expand_key(aes_key, key);
+	_benchmark_kernel(results, L"aes128-ctr", aes128_ctr_dispatcher(), tsc_frequency,
+		[&](AES128CTRDispatcher::Function function) {
+			unsigned char ciphertext[64];
+			function(key, aes_counter, aes_plaintext, ciphertext, sizeof(ciphertext));
+			if (memcmp(ciphertext, aes_ciphertext, sizeof(ciphertext)) != 0)
+				return false;
+			std::vector<unsigned char> expected(kernel_buffer_size);
+			for (size_t size : kernel_verify_sizes) {
+				aes128_ctr_scalar(key, aes_counter, input, expected.data(), size);
+				function(key, aes_counter, input, out, size);
+				if (memcmp(out, expected.data(), size) != 0)
+					return false;
+			}
+			return true;
+		},
+		[&](AES128CTRDispatcher::Function function) { function(key, aes_counter, input, out, kernel_buffer_size); return kernel_buffer_size; });
+
+	_benchmark_kernel(results, L"random", random_fill_dispatcher(), tsc_frequency,
+		[&](RandomFillDispatcher::Function function) {
+			// The portable variant has no generator, any other must deliver, but RDSEED may run out of entropy
+			const size_t filled = function(out, 64);
+			return function == random_fill_none ? filled == 0 : function == random_fill_rdrand ? filled == 64 : filled > 0;
+		},
+		[&](RandomFillDispatcher::Function function) { return function(out, kernel_random_size); }); // The bytes actually filled, the generator may give up
+	(void)sink; // Read back, the results are only stored to keep the calls from being optimized away
+
+	bool verified = true;
+	if (print_xml)
+		std::wcout << L"<cpu>" << std::endl << L"<kernels>" << std::endl;
+	else if (print_json)
+		std::wcout << L"{\"kernels\":[";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const KernelResult& result = results[i];
+		verified = verified && (!result.supported || result.verified);
+		if (print_xml) {
+			std::wcout << L"<kernel name=\"" << result.kernel << L"\" variant=\"" << result.variant << L"\" supported=\"" << (result.supported ? L"true" : L"false")
+				<< L"\" selected=\"" << (result.selected ? L"true" : L"false") << L"\"";
+			if (result.supported)
+				std::wcout << L" verified=\"" << (result.verified ? L"true" : L"false") << L"\" bandwidth=\"" << result.bandwidth << L"\"";
+			std::wcout << L"/>" << std::endl;
+		} else if (print_json) {
+			std::wcout << (i ? L",\n" : L"\n") << L"{\"kernel\":\"" << result.kernel << L"\",\"variant\":\"" << result.variant << L"\",\"supported\":" << (result.supported ? L"true" : L"false")
+				<< L",\"selected\":" << (result.selected ? L"true" : L"false");
+			if (result.supported)
+				std::wcout << L",\"verified\":" << (result.verified ? L"true" : L"false") << L",\"bandwidth\":" << result.bandwidth;
+			std::wcout << L"}";
+		} else if (!result.supported) {
+			std::wcout << result.kernel << L' ' << result.variant << L" not supported" << std::endl;
+		} else if (!result.verified) {
+			std::wcout << result.kernel << L' ' << result.variant << L": verification failed" << std::endl;
+		} else {
+			std::wcout << result.kernel << L' ' << result.variant << L": " << result.bandwidth << L" GB/s" << (result.selected ? L" (selected)" : L"") << std::endl;
+		}
+	}
+	if (print_xml)
+		std::wcout << L"</kernels>" << std::endl << L"</cpu>" << std::endl;
+	else if (print_json)
+		std::wcout << L"\n]}" << std::endl;
+	return verified ? 0 : 1;
+}
+
+int wmain(int argc, wchar_t* argv[], wchar_t* envp[])
+{
+	bool print_xml = false, print_json = false, kernels = false;
+	for (int i = 1; i < argc; ++i) {
+		if (_wcsicmp(argv[i], L"-xml") == 0 || _wcsicmp(argv[i], L"-x") == 0)
+			print_xml = true;
+		else if (_wcsicmp(argv[i], L"-json") == 0 || _wcsicmp(argv[i], L"-j") == 0)
+			print_json = true;
+		else if (_wcsicmp(argv[i], L"-kernels") == 0 || _wcsicmp(argv[i], L"-k") == 0)
+			kernels = true;
+	}
+	std::wcout << std::fixed << std::setprecision(2);
+	if (kernels)
+		return _benchmark_kernels(print_xml, print_json);
+	const FeatureSnapshot snapshot = get_feature_snapshot();
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	for (int i = 0; i < 256; ++i)
+		gather_table[i] = (i * 97 + 13) & 0xff;
+#endif
+	if (print_xml)
+		std::wcout << L"<cpu>" << std::endl << L"<benchmarks>" << std::endl;
+	else if (print_json)
+		std::wcout << L"{\"benchmarks\":[";
+	for (size_t i = 0; i < benchmark_count; ++i) {
+		const Benchmark& benchmark = benchmarks[i];
+		const char* feature_name = feature_table[benchmark.feature].name;
+		const std::wstring feature(feature_name, feature_name + strlen(feature_name));
+		const bool supported = feature_usable(snapshot, benchmark.feature);
+		const double latency = supported && benchmark.latency ? _measure(benchmark.latency) : 0;
+		const double throughput = supported ? _measure(benchmark.throughput) : 0;
+		if (print_xml) {
+			std::wcout << L"<benchmark feature=\"" << feature << L"\" instruction=\"" << benchmark.instruction << L"\" supported=\"" << (supported ? L"true" : L"false") << L"\"";
+			if (supported && benchmark.latency)
+				std::wcout << L" latency=\"" << latency << L"\"";
+			if (supported)
+				std::wcout << L" throughput=\"" << throughput << L"\"";
+			std::wcout << L"/>" << std::endl;
+		} else if (print_json) {
+			std::wcout << (i ? L",\n" : L"\n") << L"{\"feature\":\"" << feature << L"\",\"instruction\":\"" << benchmark.instruction << L"\",\"supported\":" << (supported ? L"true" : L"false");
+			if (supported) {
+				std::wcout << L",\"latency\":";
+				if (benchmark.latency)
+					std::wcout << latency;
+				else
+					std::wcout << L"null";
+				std::wcout << L",\"throughput\":" << throughput;
+			}
+			std::wcout << L"}";
+		} else if (!supported) {
+			std::wcout << feature << L' ' << benchmark.instruction << L" not supported" << std::endl;
+		} else {
+			std::wcout << feature << L' ' << benchmark.instruction << L": ";
+			if (benchmark.latency)
+				std::wcout << L"latency " << latency << L" cycles, ";
+			std::wcout << L"throughput " << throughput << L" cycles per instruction" << std::endl;
+		}
+	}
+	if (print_xml)
+		std::wcout << L"</benchmarks>" << std::endl << L"</cpu>" << std::endl;
+	else if (print_json)
+		std::wcout << L"\n]}" << std::endl;
+	return 0;
+}
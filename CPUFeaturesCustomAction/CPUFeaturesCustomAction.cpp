@@ -16,6 +16,36 @@ Functions supported:
    SupportAVX512
    SupportAES
    SupportRDRND
+   SupportAMX
+   ISALevel
+   DetectCPUFeatures
+
+Features depending on extended processor state (AVX, AVX2, AVX512, AMX) are only reported as supported when
+they are usable, meaning that both the processor and the operating system supports them: Running code using
+for instance AVX-512 instructions on a system where the operating system (or hypervisor) has not enabled the
+ZMM state will crash with an invalid instruction exception. When the processor supports the feature, but the
+operating system does not, the property CPUFEATURE_<feature>_HARDWARE is set, e.g. CPUFEATURE_AVX512_HARDWARE,
+but the property CPUFEATURE_<feature> is not, and the custom action fails.
+
+The ISALevel custom action sets the property CPUFEATURE_ISALEVEL to the x86-64 microarchitecture level, from 1 for
+x86-64-v1 (the baseline) to 4 for x86-64-v4, or 0 if not even the baseline is usable, and the property
+CPUFEATURE_AVX10 to the AVX10 version when AVX10 is usable (see Common/ISALevel.h). It always succeeds, so an installer
+built for e.g. x86-64-v3 checks the level with a condition element: <Condition Message="...">CPUFEATURE_ISALEVEL >= 3</Condition>.
+
+The DetectCPUFeatures custom action sets all the properties of the other custom actions at once, from a single walk
+of cpuid over all valid function ids, and writes the raw registers of that walk and XCR0 to the MSI log. It always succeeds, so the properties
+are checked with condition elements, as described below. Scheduling it once, instead of one custom action for each feature,
+avoids loading the library and executing cpuid repeatedly, in both the UI and execute sequences:
+
+  <CustomAction Id="CustomActionDetectCPUFeatures" BinaryKey="CPUFeaturesCustomActionDll" DllEntry="DetectCPUFeatures"/>
+  <InstallExecuteSequence>
+    <Custom Action="CustomActionDetectCPUFeatures" After="AppSearch" />
+  </InstallExecuteSequence>
+  <InstallUISequence>
+    <Custom Action="CustomActionDetectCPUFeatures" After="AppSearch" />
+  </InstallUISequence>
+
+  <Condition Message="This CPU does not support AVX2">CPUFEATURE_AVX2</Condition>
 
 Example:
 
@@ -75,103 +105,131 @@ property value has not been executed yet.
 #include <Windows.h>
 #include <Msi.h>
 #include <Msiquery.h>
-#include <intrin.h>
-
-static bool CheckFeature(int functionId, unsigned char registerNumber, unsigned char bitNumber)
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "../Common/CPUIDDump.h"
+#include "../Common/FeatureSnapshot.h"
+#include "../Common/ISALevel.h"
+
+// Set property CPUFEATURE_<name> if the feature is usable in the snapshot, and return if it is.
+// For features depending on extended processor state (having an XCR0 requirement in the registry),
+// property CPUFEATURE_<name>_HARDWARE is set when the processor supports it, regardless of the
+// operating system support.
+static bool SetFeatureProperties(MSIHANDLE hInstall, const FeatureSnapshot& snapshot, Feature feature, const wchar_t* property)
 {
-	bool support = false;
-	int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
-	if (functionId > 0) { // Regular function id
-		__cpuid(cpu_info, 0x0); // Request value at id 0 to get the highest valid function ID
-		if (functionId <= cpu_info[0]) {
-			__cpuid(cpu_info, functionId);
-			support = (cpu_info[registerNumber] & 1 << bitNumber) != 0; // Check specified bit in specified register
-		}
+	if (feature_hardware(snapshot, feature) && feature_table[feature].xcr0 != 0)
+		MsiSetProperty(hInstall, (std::wstring(property) + L"_HARDWARE").c_str(), L"1");
+	if (feature_usable(snapshot, feature)) {
+		MsiSetProperty(hInstall, property, L"1");
+		return true;
 	}
-	else if (functionId < 0) { // Extended function id have unsigned value above INT32_MAX (2147483647), so are represented by a negative signed integers
-		__cpuid(cpu_info, 0x80000000); // Request value at id 0x80000000 to get the highest valid extended function ID
-		if (functionId <= cpu_info[0]) {
-			__cpuid(cpu_info, functionId);
-			support = (cpu_info[registerNumber] & 1 << bitNumber) != 0; // Check specified bit in specified register
-		}
-	}
-	return support;
+	return false;
 }
 
-UINT __stdcall SupportSSE(MSIHANDLE hInstall)
-{
-	if (CheckFeature(1, 3, 25)) { // Function id 1 contains bitset with flags for main features, and in fourth register (EDX) bit 25 indicates SSE.
-		MsiSetProperty(hInstall, L"CPUFEATURE_SSE", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
-}
-UINT __stdcall SupportSSE2(MSIHANDLE hInstall)
-{
-	if (CheckFeature(1, 3, 26)) { // Function id 1 contains bitset with flags for main features, and in fourth register (EDX) bit 26 indicates SSE2.
-		MsiSetProperty(hInstall, L"CPUFEATURE_SSE2", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
-}
-UINT __stdcall SupportSSE3(MSIHANDLE hInstall)
+// Set the feature properties, and return success if the feature is usable, else return failure.
+static UINT CheckFeature(MSIHANDLE hInstall, Feature feature, const wchar_t* property)
 {
-	if (CheckFeature(1, 2, 0)) { // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 0 indicates SSE3.
-		MsiSetProperty(hInstall, L"CPUFEATURE_SSE3", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
+	const FeatureSnapshot snapshot = get_feature_snapshot(); // Executes cpuid, since each custom action is normally only called once
+	return SetFeatureProperties(hInstall, snapshot, feature, property) ? ERROR_SUCCESS : ERROR_INSTALL_FAILURE;
 }
-UINT __stdcall SupportSSSE3(MSIHANDLE hInstall)
-{
-	if (CheckFeature(1, 2, 9)) { // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 9 indicates SSSE3.
-		MsiSetProperty(hInstall, L"CPUFEATURE_SSSE3", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
-}
-UINT __stdcall SupportSSE41(MSIHANDLE hInstall)
+
+// Set property CPUFEATURE_ISALEVEL to the x86-64 microarchitecture level, and CPUFEATURE_AVX10 to the AVX10 version
+// if AVX10 is usable.
+static void SetISALevelProperties(MSIHANDLE hInstall, const FeatureSnapshot& snapshot)
 {
-	if (CheckFeature(1, 2, 19)) { // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 19 indicates SSE4.1.
-		MsiSetProperty(hInstall, L"CPUFEATURE_SSE41", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
+	MsiSetProperty(hInstall, L"CPUFEATURE_ISALEVEL", std::to_wstring(static_cast<int>(isa_level(snapshot))).c_str());
+	const unsigned int avx10 = avx10_version(snapshot);
+	if (avx10)
+		MsiSetProperty(hInstall, L"CPUFEATURE_AVX10", std::to_wstring(avx10).c_str());
 }
-UINT __stdcall SupportSSE42(MSIHANDLE hInstall)
+
+// Write a line to the MSI log, as an informational message. The text is inserted into field 1 of the record,
+// so that it is not interpreted as a formatted string.
+static void LogMessage(MSIHANDLE hInstall, const std::wstring& message)
 {
-	if (CheckFeature(1, 2, 20)) { // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 20 indicates SSE4.2.
-		MsiSetProperty(hInstall, L"CPUFEATURE_SSE42", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
+	PMSIHANDLE record = MsiCreateRecord(1);
+	MsiRecordSetString(record, 0, L"CPUFeatures: [1]");
+	MsiRecordSetString(record, 1, message.c_str());
+	MsiProcessMessage(hInstall, INSTALLMESSAGE_INFO, record);
 }
-UINT __stdcall SupportAVX(MSIHANDLE hInstall)
+
+// The raw leaf dump (see Common/CPUIDDump.h), the four registers of each valid function id and sub-function id,
+// from a single walk of cpuid, with the snapshot decoded from it.
+struct CPUIDCapture {
+	std::vector<CPUIDRecord> records;
+	unsigned int max_function_id;
+	unsigned int max_extended_function_id;
+	FeatureSnapshot snapshot;
+};
+
+static CPUIDCapture CaptureCPUID()
 {
-	if (CheckFeature(1, 2, 28)) { // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 28 indicates AVX.
-		MsiSetProperty(hInstall, L"CPUFEATURE_AVX", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
+	CPUIDCapture capture;
+	cpuid_enumerate([&capture](const CPUIDRecord& record) { capture.records.push_back(record); }, capture.max_function_id, capture.max_extended_function_id);
+	const unsigned int count = static_cast<unsigned int>(capture.records.size());
+	const CPUIDRecord* function1 = cpuid_dump_find(capture.records.data(), count, 0x1);
+	const CPUIDDumpSource source = { capture.records.data(), count, function1 ? read_xcr0(function1->ecx) : 0 };
+	capture.snapshot = decode_feature_snapshot(source);
+	return capture;
 }
-UINT __stdcall SupportAVX2(MSIHANDLE hInstall)
+
+// Write the capture to the MSI log: The vendor and XCR0, and the registers of each record, in hexadecimal, for support
+// cases where the installer rejected a system.
+static void LogCapture(MSIHANDLE hInstall, const CPUIDCapture& capture)
 {
-	if (CheckFeature(7, 1, 5)) { // Function id 7 contains bitset with flags for extended features, and in second register (EBX) bit 5 indicates AVX2.
-		MsiSetProperty(hInstall, L"CPUFEATURE_AVX2", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
+	const FeatureSnapshot& snapshot = capture.snapshot;
+	wchar_t line[128];
+	swprintf_s(line, L"vendor %s, XCR0 0x%016llx", snapshot.vendor == FeatureVendorIntel ? L"Intel" : snapshot.vendor == FeatureVendorAMD ? L"AMD" : L"other", snapshot.xcr0);
+	LogMessage(hInstall, line);
+	swprintf_s(line, L"cpuid maximum function id 0x%08x, extended 0x%08x, %u records", capture.max_function_id, capture.max_extended_function_id, static_cast<unsigned int>(capture.records.size()));
+	LogMessage(hInstall, line);
+	for (const CPUIDRecord& record : capture.records) {
+		swprintf_s(line, L"cpuid 0x%08x.%u EAX 0x%08x EBX 0x%08x ECX 0x%08x EDX 0x%08x", record.function_id, record.subfunction_id, record.eax, record.ebx, record.ecx, record.edx);
+		LogMessage(hInstall, line);
+	}
 }
-UINT __stdcall SupportAVX512(MSIHANDLE hInstall)
+
+// The exported custom actions: Export name, without the Support prefix, and feature id in the registry.
+#define CUSTOM_ACTION_FEATURE_LIST(X) \
+	X(SSE, SSE) \
+	X(SSE2, SSE2) \
+	X(SSE3, SSE3) \
+	X(SSSE3, SSSE3) \
+	X(SSE41, SSE41) \
+	X(SSE42, SSE42) \
+	X(AVX, AVX) \
+	X(AVX2, AVX2) \
+	X(AVX512, AVX512F) /* AVX-512 Foundation, the core extension required by all implementations of AVX-512 */ \
+	X(AES, AES) \
+	X(RDRND, RDRAND) \
+	X(AMX, AMXTILE) /* AMX-TILE, the tile architecture required by all AMX extensions */
+
+#define _CUSTOM_ACTION_WIDEN(text) L ## text
+#define CUSTOM_ACTION_WIDEN(text) _CUSTOM_ACTION_WIDEN(text)
+#define CUSTOM_ACTION_FUNCTION(name, feature) \
+	UINT __stdcall Support##name(MSIHANDLE hInstall) { return CheckFeature(hInstall, Feature_##feature, CUSTOM_ACTION_WIDEN("CPUFEATURE_" #name)); }
+CUSTOM_ACTION_FEATURE_LIST(CUSTOM_ACTION_FUNCTION)
+#undef CUSTOM_ACTION_FUNCTION
+
+// Set property CPUFEATURE_ISALEVEL to the x86-64 microarchitecture level, and CPUFEATURE_AVX10 to the AVX10 version
+// if AVX10 is usable, and return success.
+UINT __stdcall ISALevel(MSIHANDLE hInstall)
 {
-	if (CheckFeature(7, 1, 16)) { // Function id 7 contains bitset with flags for extended features, and in second register (EBX) bit 16 indicates AVX-512 Foundation - the core extension required by all imiplementations of AVX-512.
-		MsiSetProperty(hInstall, L"CPUFEATURE_AVX512", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
+	SetISALevelProperties(hInstall, get_feature_snapshot());
+	return ERROR_SUCCESS;
 }
-UINT __stdcall SupportAES(MSIHANDLE hInstall)
+
+// Set all properties of the individual custom actions from a single snapshot, write the snapshot to the MSI log,
+// and return success. Replaces scheduling one custom action for each feature, each executing cpuid separately.
+UINT __stdcall DetectCPUFeatures(MSIHANDLE hInstall)
 {
-	if (CheckFeature(1, 2, 25)) { // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 25 indicates AES.
-		MsiSetProperty(hInstall, L"CPUFEATURE_AES", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
+	const CPUIDCapture capture = CaptureCPUID();
+	const FeatureSnapshot& snapshot = capture.snapshot;
+	LogCapture(hInstall, capture);
+#define CUSTOM_ACTION_SET_PROPERTIES(name, feature) SetFeatureProperties(hInstall, snapshot, Feature_##feature, CUSTOM_ACTION_WIDEN("CPUFEATURE_" #name));
+	CUSTOM_ACTION_FEATURE_LIST(CUSTOM_ACTION_SET_PROPERTIES)
+#undef CUSTOM_ACTION_SET_PROPERTIES
+	SetISALevelProperties(hInstall, snapshot);
+	return ERROR_SUCCESS;
 }
-UINT __stdcall SupportRDRND(MSIHANDLE hInstall)
-{
-	if (CheckFeature(1, 2, 30)) { // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 30 indicates RDRAND.
-		MsiSetProperty(hInstall, L"CPUFEATURE_RDRND", L"1");
-		return ERROR_SUCCESS;
-	} else return ERROR_INSTALL_FAILURE;
-}
\ No newline at end of file
@@ -12,79 +12,484 @@
 //    bool SupportAVX2()
 //    bool SupportAVX512()
 //    bool SupportAES()
+//    bool SupportAMX()
+//    bool SupportAMXINT8()
+//    bool SupportAMXBF16()
+//    bool SupportAMXFP16()
+//    bool SupportAVXVNNI()
+//    bool SupportAVX512BF16()
+//    bool SupportAVX512FP16()
+//    bool SupportAPX()
+//    bool SupportVMX()
+//    bool SupportRDTSCP()
+//    bool SupportInvariantTSC()
+//    bool SupportFeature(const char* name)
+//    bool HardwareSupportFeature(const char* name)
+//    unsigned int CacheSize(unsigned int level)
+//    unsigned int CacheLineSize(unsigned int level)
+//    unsigned int CacheAssociativity(unsigned int level)
+//    unsigned int CacheSharing(unsigned int level)
+//    unsigned int DataTLBEntries(unsigned int level)
+//    int ISALevel()
+//    int AVX10Version()
+//    int AVX10VectorLength()
+//    bool AMXPalette(unsigned int palette, CPUAMXPalette* result)
+//    double TSCFrequency()
+//    unsigned long long TicksToNanoseconds(unsigned long long ticks)
+//    unsigned long long XSaveComponents()
+//    unsigned int XSaveSize()
+//    unsigned int XSaveCompactedSize(unsigned long long components)
+//    void CurrentFeatureMask(CPUFeatureMask* mask)
+//    bool FeatureMaskFromNames(const char* names, CPUFeatureMask* mask)
+//    const char* FeatureMaskName(unsigned int index)
+//    unsigned int SerializeFeatureMask(const CPUFeatureMask* mask, char* buffer, unsigned int size)
+//    bool DeserializeFeatureMask(const char* text, CPUFeatureMask* mask)
+//    bool FeatureMaskSubset(const CPUFeatureMask* required, const CPUFeatureMask* host)
+//    void FeatureMaskMissing(const CPUFeatureMask* required, const CPUFeatureMask* host, CPUFeatureMask* missing)
+//    unsigned int FeatureMaskMatch(const CPUFeatureMask* required, const CPUFeatureMask* hosts, unsigned int count, unsigned char* compatible)
+//    void FeatureMaskIntersection(const CPUFeatureMask* masks, unsigned int count, CPUFeatureMask* result)
+//    bool LoadFeatureFile()
+//    bool FeatureFileLoaded()
+//    unsigned int ReadCallCounters(CPUCallCounter* counters, unsigned int capacity, bool reset)
+//    unsigned int CRC32C(unsigned int crc, const void* data, size_t size)
+//    unsigned long long PopCount(const void* data, size_t size)
+//    void* CopyBytes(void* destination, const void* source, size_t size)
+//    void AES128CTR(const unsigned char key[16], const unsigned char counter[16], const void* input, void* output, size_t size)
+//    size_t RandomFill(void* data, size_t size)
+//    const char* KernelVariant(const char* kernel)
+//
+// Features depending on extended processor state (AVX, AVX-512, AMX) are only reported as
+// supported when they are usable, meaning that both the processor and the operating system
+// supports them. Processor support alone is reported by the corresponding HardwareSupport
+// functions, such as HardwareSupportAVX512().
+//
+// The functions are generated from the shared feature registry (see ../Common/FeatureRegistry.h),
+// which also defines the operating system support each feature requires. Any feature in the
+// registry can be checked by its name, as listed by the Microsoft mode of the CPUFeatures
+// utility, with SupportFeature and HardwareSupportFeature, e.g. SupportFeature("AVX512VNNI").
+// Unknown names are reported as not supported.
+//
+// The cpuid instruction is only executed on the first call of any function, where the feature flag
+// registers of the relevant function ids are captured into a snapshot, cached process-wide without
+// heap allocation (see ../Common/FeatureCache.h), so the functions can be called from any thread.
+// Each function is then just a bit test at a constant offset in the snapshot. This matters since
+// cpuid is a serializing instruction, and in virtual machines it will normally also trap to the
+// hypervisor, making it very expensive to execute. The first call only executes cpuid, so like all
+// other calls it is safe from DllMain.
+//
+// LoadFeatureFile reads the snapshot and the cache parameters from a feature file (see
+// ../Common/FeatureFile.h) written by "CPUFeatures -dump" during the current boot instead, if it is
+// trusted, and only executes function ids 0, 1 and 7 to check that it is for this processor. As it
+// opens the file and reads its security descriptor and the registry, it must not be called from
+// DllMain, and it only has an effect as the first call of the library, e.g. at the start of main.
+// It returns, as FeatureFileLoaded does afterwards, whether the file was used.
+//
+// The cache functions report the parameters of the data (or unified) cache at the given
+// level, 1 for L1 data cache, 2 for L2 and so on, and 0 if there is no such cache. They are
+// decoded from cpuid on the first call as well (see ../Common/CacheInfo.h).
+//
+// ISALevel reports the x86-64 microarchitecture level, from 1 for x86-64-v1 (the baseline) to 4
+// for x86-64-v4, and 0 if not even the baseline is usable. AVX10Version reports the version of
+// AVX10, e.g. 1 for AVX10.1, and 0 if AVX10 is not usable (see ../Common/ISALevel.h), and
+// AVX10VectorLength its maximum vector length in bits, 128, 256 or 512.
+//
+// AMXPalette gets the tile geometry of an AMX palette, from 1, and is false if the palette is not
+// supported (see ../Common/AMX.h). It is decoded on the first call, even if AMX is not usable.
+//
+// TSCFrequency reports the time stamp counter frequency in MHz, and TicksToNanoseconds converts a
+// difference of two rdtsc values to nanoseconds (see ../Common/TSC.h). The parameters are decoded
+// with the snapshot, but when no function id reports the frequency it is measured on the first call
+// of these two instead, which takes about 50 ms. The conversion is only meaningful when the TSC is invariant (SupportInvariantTSC).
+//
+// The XSAVE functions report the extended state save area, the per-thread cost of the enabled state
+// (see ../Common/XSave.h). XSaveComponents is the mask of state components enabled in XCR0, in the
+// format of the mask operand of the XSAVE instructions, XSaveSize the size of the standard format
+// area written by XSAVE, and XSaveCompactedSize the size of the compacted format area written by
+// XSAVEC for the given components (limited to the enabled ones, ~0 for all), or 0 without XSAVEC.
+//
+// The feature mask functions compare sets of features, e.g. the features required by a binary with
+// the features of many hosts, without the names (see ../Common/FeatureMask.h). CurrentFeatureMask
+// gets the usable features of the executing processor, FeatureMaskFromNames builds a mask from
+// names separated by commas or spaces (false if any is unknown), and FeatureMaskName is the name
+// of bit index, or null past the last feature. SerializeFeatureMask writes the mask as text to
+// buffer, when size has room for it and the terminating null, and returns its length; it can only
+// be deserialized by a library with the same features. FeatureMaskMatch tests required against
+// an array of count host masks (vectorized), setting compatible[i] unless it is null, and returns
+// the number of compatible hosts. FeatureMaskIntersection gets the features common to all masks.
+//
+// In a build with CPUFEATURES_INSTRUMENTED, each exported function counts its calls, and the
+// cpuid instructions executed with the ticks spent in them, which are all executed on the first call
+// (counted as load_features, including those decoding the TSC parameters, or as load_feature_file
+// when called by LoadFeatureFile, including those validating the file), see ../Common/CallCounters.h. ReadCallCounters writes the counters
+// of the functions called so far, at most capacity, optionally resetting them, and returns their
+// number. It returns 0 in a build without instrumentation.
+//
+// The kernel functions are utility kernels selecting the best variant for the executing processor
+// on first call, through the feature snapshot of the library (see ../Common/Kernels.h). CRC32C is
+// the CRC-32C of data, starting with 0 and continuing with the previous result for more data,
+// PopCount the number of bits set, CopyBytes copies like memcpy, AES128CTR encrypts or decrypts
+// with AES-128 in counter mode, with the last 8 bytes of the counter block incremented as big-endian,
+// and RandomFill fills data from the processor's random generator, returning the bytes filled.
+// KernelVariant is the name of the variant selected for "crc32c", "popcount", "copy", "aes128-ctr"
+// or "random", e.g. "VPCLMULQDQ" for CRC32C, or null for an unknown kernel.
 //
 #include "Targetver.h"
 #include "CPUFeaturesLibrary.h"
-#include <intrin.h>
+#ifdef _WIN32
+#define STRICT // Enable STRICT Type Checking in Windows headers
+#define WIN32_LEAN_AND_MEAN // To speed the build process exclude rarely-used services from Windows headers
+#define NOMINMAX // Exclude min/max macros from Windows header
+#include <Windows.h>
+#endif
+#include "../Common/FeatureCache.h"
+#include "../Common/CacheInfo.h"
+#include "../Common/ISALevel.h"
+#include "../Common/TSC.h"
+#include "../Common/FeatureMask.h"
+#include "../Common/FeatureFile.h"
+#include "../Common/XSave.h"
+#include "../Common/AMX.h"
+#include "../Common/CallCounters.h"
+#include "../Common/Kernels.h"
 
-static bool CheckFeature(int functionId, unsigned char registerNumber, unsigned char bitNumber)
+// Decoded together with the feature snapshot, by load_features on the first call.
+struct LibraryState {
+	CacheInfo cache_info; // Cache and TLB parameters
+	XSaveInfo xsave_info; // Extended state components and sizes
+	AMXInfo amx_info; // AMX tile palettes
+	TSCInfo tsc_info; // Without a measured frequency, see tsc_info()
+	bool feature_file_loaded; // Features and caches read from the feature file
+};
+
+static LibraryState library_state_storage; // Zero initialized, written before the snapshot is published
+
+#ifdef CPUFEATURES_INSTRUMENTED
+static CallCounters call_counters; // Constant initialized, so it can be used from DllMain
+#endif
+
+// Loader of the feature cache, called on the first call of any function: Execute cpuid, which is all
+// it does, so that the first call is as safe from DllMain as the others.
+static bool load_features(CachedFeatureSnapshot& snapshot)
 {
-	bool support = false;
-	int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
-	if (functionId > 0) { // Regular function id have positive value
-		__cpuid(cpu_info, 0x0); // Request value at id 0 to get the highest valid function ID
-		if (functionId <= cpu_info[0]) {
-			__cpuid(cpu_info, functionId);
-			support = (cpu_info[registerNumber] & 1 << bitNumber) != 0; // Check specified bit in specified register
-		}
-	} else if (functionId < 0) { // Extended function id have unsigned value above INT32_MAX (2147483647), so are represented by a negative signed integers
-		__cpuid(cpu_info, 0x80000000); // Request value at id 0x80000000 to get the highest valid extended function ID
-		if (functionId <= cpu_info[0]) {
-			__cpuid(cpu_info, functionId);
-			support = (cpu_info[registerNumber] & 1 << bitNumber) != 0; // Check specified bit in specified register
+	CALL_COUNTED(call_counters); // Counting the cpuid executed when loading
+	LibraryState& state = library_state_storage;
+	const auto source = CALL_COUNTED_SOURCE(call_counters);
+	decode_cached_feature_snapshot(source, snapshot);
+	state.cache_info = decode_cache_info(source);
+	state.xsave_info = decode_xsave_info(source);
+	state.amx_info = decode_amx_info(source);
+	state.tsc_info = decode_tsc_info(source);
+	return true;
+}
+
+// Loader set by LoadFeatureFile: Use the feature file if it is trusted and valid for this processor and
+// boot, otherwise execute cpuid as load_features.
+static bool load_feature_file(CachedFeatureSnapshot& snapshot)
+{
+	CALL_COUNTED(call_counters); // Counting the cpuid validating the file
+	LibraryState& state = library_state_storage;
+	const std::string path = default_feature_file_path();
+	bool trusted = false;
+	if (const FeatureFile* file = map_feature_file(path.c_str(), &trusted)) {
+		if (trusted && validate_feature_file(*file, CALL_COUNTED_SOURCE(call_counters)) == FeatureFileValid) {
+			snapshot = file->snapshot;
+			state.cache_info = file->cache_info;
+			const CPUIDDumpSource source = { file->records, file->dump.record_count, file->dump.xcr0_low | static_cast<unsigned long long>(file->dump.xcr0_high) << 32 };
+			state.xsave_info = decode_xsave_info(source);
+			state.amx_info = decode_amx_info(source);
+			state.tsc_info = decode_tsc_info(source);
+			if (state.tsc_info.source == TSCFrequencyNone) // The hypervisor function ids are not in the dump
+				state.tsc_info = decode_tsc_info(CALL_COUNTED_SOURCE(call_counters));
+			state.feature_file_loaded = true;
 		}
+		unmap_feature_file(file);
 	}
-	return support;
+	return state.feature_file_loaded || load_features(snapshot);
+}
+
+// The state decoded with the snapshot, after loading it if this is the first call.
+static const LibraryState& library_state()
+{
+	cached_feature_snapshot(); // The acquire load of the published snapshot orders the reads of the state
+	return library_state_storage;
+}
+
+#ifdef _WIN32
+BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReserved)
+{
+	switch (ul_reason_for_call)
+	{
+	case DLL_PROCESS_ATTACH:
+		// Only set the loader of the snapshot, before any of the exported functions can be called.
+		// The cache does not depend on static initialization, so it is safe to do here.
+		set_feature_cache_loader(load_features);
+		break;
+	case DLL_THREAD_ATTACH:
+	case DLL_THREAD_DETACH:
+	case DLL_PROCESS_DETACH:
+		break;
+	}
+	return TRUE;
+}
+#else
+// Shared library on other operating systems: Constructor executed when the library is loaded, like DllMain on process attach
+__attribute__((constructor)) static void load_library()
+{
+	set_feature_cache_loader(load_features);
+}
+#endif
+
+// The exported functions checking a single feature: Export name and feature id in the registry.
+// Support<name> reports usable support, including the operating system support required by the feature.
+#define LIBRARY_SUPPORT_LIST(X) \
+	X(LongMode, LM) \
+	X(SSE, SSE) \
+	X(SSE2, SSE2) \
+	X(SSE3, SSE3) \
+	X(SSSE3, SSSE3) \
+	X(SSE41, SSE41) \
+	X(SSE42, SSE42) \
+	X(AVX, AVX) \
+	X(AVX2, AVX2) \
+	X(AVX512, AVX512F) /* AVX-512 Foundation, the core extension required by all implementations of AVX-512 */ \
+	X(AES, AES) \
+	X(RDRND, RDRAND) \
+	X(VMX, VMX) \
+	X(RDTSCP, RDTSCP) \
+	X(InvariantTSC, INVTSC) \
+	X(AMX, AMXTILE) /* AMX-TILE, the tile architecture required by all AMX extensions */ \
+	X(AMXINT8, AMXINT8) \
+	X(AMXBF16, AMXBF16) \
+	X(AMXFP16, AMXFP16) \
+	X(AVXVNNI, AVXVNNI) /* VEX-encoded VNNI, for processors without AVX-512 */ \
+	X(AVX512BF16, AVX512BF16) \
+	X(AVX512FP16, AVX512FP16) \
+	X(APX, APX)
+// HardwareSupport<name> reports processor support only, for the features depending on extended processor state.
+#define LIBRARY_HARDWARE_SUPPORT_LIST(X) \
+	X(AVX, AVX) \
+	X(AVX2, AVX2) \
+	X(AVX512, AVX512F) \
+	X(AMX, AMXTILE)
+
+#define LIBRARY_SUPPORT_FUNCTION(name, feature) bool Support##name() { CALL_COUNTED(call_counters); return feature_usable(cached_feature_snapshot().features, Feature_##feature); }
+LIBRARY_SUPPORT_LIST(LIBRARY_SUPPORT_FUNCTION)
+#undef LIBRARY_SUPPORT_FUNCTION
+#define LIBRARY_HARDWARE_SUPPORT_FUNCTION(name, feature) bool HardwareSupport##name() { CALL_COUNTED(call_counters); return feature_hardware(cached_feature_snapshot().features, Feature_##feature); }
+LIBRARY_HARDWARE_SUPPORT_LIST(LIBRARY_HARDWARE_SUPPORT_FUNCTION)
+#undef LIBRARY_HARDWARE_SUPPORT_FUNCTION
+
+bool SupportFeature(const char* name)
+{
+	CALL_COUNTED(call_counters);
+	const Feature feature = find_feature(name);
+	return feature != FeatureCount && feature_usable(cached_feature_snapshot().features, feature);
+}
+bool HardwareSupportFeature(const char* name)
+{
+	CALL_COUNTED(call_counters);
+	const Feature feature = find_feature(name);
+	return feature != FeatureCount && feature_hardware(cached_feature_snapshot().features, feature);
+}
+unsigned int CacheSize(unsigned int level)
+{
+	CALL_COUNTED(call_counters);
+	const CacheDescriptor* cache = find_cache(library_state().cache_info, level);
+	return cache ? cache->size : 0; // Total size in bytes
+}
+unsigned int CacheLineSize(unsigned int level)
+{
+	CALL_COUNTED(call_counters);
+	const CacheDescriptor* cache = find_cache(library_state().cache_info, level);
+	return cache ? cache->line_size : 0;
+}
+unsigned int CacheAssociativity(unsigned int level)
+{
+	CALL_COUNTED(call_counters);
+	const CacheDescriptor* cache = find_cache(library_state().cache_info, level);
+	return cache ? cache->ways : 0; // Number of ways, equal to number of lines if fully associative
+}
+unsigned int CacheSharing(unsigned int level)
+{
+	CALL_COUNTED(call_counters);
+	const CacheDescriptor* cache = find_cache(library_state().cache_info, level);
+	return cache ? cache->shared_by : 0; // Maximum number of logical processors sharing the cache
+}
+unsigned int DataTLBEntries(unsigned int level)
+{
+	CALL_COUNTED(call_counters);
+	const TLBDescriptor* tlb = find_tlb(library_state().cache_info, level, TLB_PAGE_4K);
+	return tlb ? tlb->entries : 0; // Number of entries for 4 KB pages
 }
-bool SupportLongMode()
+int ISALevel()
 {
-	return CheckFeature(0x80000001, 3, 29); // Function id 0x80000001 contains bitset with flags for extended processor info and features, and in fourth register (EDX) bit 29 indicates Long Mode (64-bit x86-64/AMD64 processor).
+	CALL_COUNTED(call_counters);
+	return isa_level(cached_feature_snapshot().features);
 }
-bool SupportSSE()
+int AVX10Version()
 {
-	return CheckFeature(1, 3, 25); // Function id 1 contains bitset with flags for main features, and in fourth register (EDX) bit 25 indicates SSE.
+	CALL_COUNTED(call_counters);
+	return static_cast<int>(avx10_version(cached_feature_snapshot().features));
 }
-bool SupportSSE2()
+int AVX10VectorLength()
 {
-	return CheckFeature(1, 3, 26); // Function id 1 contains bitset with flags for main features, and in fourth register (EDX) bit 26 indicates SSE2.
+	CALL_COUNTED(call_counters);
+	return static_cast<int>(avx10_vector_length(cached_feature_snapshot().features));
 }
-bool SupportSSE3()
+
+static_assert(sizeof(CPUAMXPalette) == sizeof(AMXTilePalette), "The exported AMX palette must have the layout of the shared one");
+
+bool AMXPalette(unsigned int palette, CPUAMXPalette* result)
+{
+	CALL_COUNTED(call_counters);
+	const AMXTilePalette* found = find_amx_palette(library_state().amx_info, palette);
+	if (found)
+		memcpy(result, found, sizeof(*result));
+	return found != nullptr;
+}
+
+// The TSC parameters decoded with the snapshot, with the frequency measured on first use if no function
+// id reports it. Initialization of the local static is thread safe.
+static const TSCInfo& tsc_info()
+{
+	static const TSCInfo info = [] {
+		TSCInfo measured = library_state().tsc_info;
+		measure_tsc_info(measured);
+		return measured;
+	}();
+	return info;
+}
+double TSCFrequency()
+{
+	CALL_COUNTED(call_counters);
+	return tsc_info().frequency_mhz;
+}
+unsigned long long TicksToNanoseconds(unsigned long long ticks)
 {
-	return CheckFeature(1, 2, 0); // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 0 indicates SSE3.
+	CALL_COUNTED(call_counters);
+	return tsc_ticks_to_ns(tsc_info(), ticks);
 }
-bool SupportSSSE3()
+
+unsigned long long XSaveComponents()
 {
-	return CheckFeature(1, 2, 9); // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 9 indicates SSSE3.
+	CALL_COUNTED(call_counters);
+	return library_state().xsave_info.xcr0;
 }
-bool SupportSSE41()
+unsigned int XSaveSize()
 {
-	return CheckFeature(1, 2, 19); // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 19 indicates SSE4.1.
+	CALL_COUNTED(call_counters);
+	return library_state().xsave_info.size;
 }
-bool SupportSSE42()
+unsigned int XSaveCompactedSize(unsigned long long components)
 {
-	return CheckFeature(1, 2, 20); // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 20 indicates SSE4.2.
+	CALL_COUNTED(call_counters);
+	return xsave_compacted_size(library_state().xsave_info, components);
 }
-bool SupportAVX()
+
+static_assert(sizeof(CPUFeatureMask) == sizeof(FeatureMask), "The exported feature mask must have the layout of the shared one");
+
+void CurrentFeatureMask(CPUFeatureMask* mask)
 {
-	return CheckFeature(1, 2, 28); // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 28 indicates AVX.
+	CALL_COUNTED(call_counters);
+	*reinterpret_cast<FeatureMask*>(mask) = feature_mask_from_snapshot(cached_feature_snapshot().features);
 }
-bool SupportAVX2()
+bool FeatureMaskFromNames(const char* names, CPUFeatureMask* mask)
 {
-	return CheckFeature(7, 1, 5); // Function id 7 contains bitset with flags for extended features, and in second register (EBX) bit 5 indicates AVX2.
+	CALL_COUNTED(call_counters);
+	return feature_mask_from_names(names, *reinterpret_cast<FeatureMask*>(mask));
 }
-bool SupportAVX512()
+const char* FeatureMaskName(unsigned int index)
 {
-	return CheckFeature(7, 1, 16); // Function id 7 contains bitset with flags for extended features, and in second register (EBX) bit 16 indicates AVX-512 Foundation - the core extension required by all imiplementations of AVX-512.
+	CALL_COUNTED(call_counters);
+	return index < FeatureCount ? feature_table[index].name : nullptr;
 }
-bool SupportAES()
+unsigned int SerializeFeatureMask(const CPUFeatureMask* mask, char* buffer, unsigned int size)
 {
-	return CheckFeature(1, 2, 25); // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 25 indicates AES.
+	CALL_COUNTED(call_counters);
+	if (buffer && size > FEATURE_MASK_TEXT_LENGTH)
+		feature_mask_serialize(*reinterpret_cast<const FeatureMask*>(mask), buffer);
+	return FEATURE_MASK_TEXT_LENGTH;
 }
-bool SupportRDRND()
+bool DeserializeFeatureMask(const char* text, CPUFeatureMask* mask)
 {
-	return CheckFeature(1, 2, 30); // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 30 indicates RDRAND.
+	CALL_COUNTED(call_counters);
+	return feature_mask_deserialize(text, *reinterpret_cast<FeatureMask*>(mask));
 }
-bool SupportVMX()
+bool FeatureMaskSubset(const CPUFeatureMask* required, const CPUFeatureMask* host)
 {
-	return CheckFeature(1, 2, 25); // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 5 indicates Virtual Machine eXtensions (Intel VT-x and AMD-V).
-}
\ No newline at end of file
+	CALL_COUNTED(call_counters);
+	return feature_mask_subset(*reinterpret_cast<const FeatureMask*>(required), *reinterpret_cast<const FeatureMask*>(host));
+}
+void FeatureMaskMissing(const CPUFeatureMask* required, const CPUFeatureMask* host, CPUFeatureMask* missing)
+{
+	CALL_COUNTED(call_counters);
+	*reinterpret_cast<FeatureMask*>(missing) = feature_mask_missing(*reinterpret_cast<const FeatureMask*>(required), *reinterpret_cast<const FeatureMask*>(host));
+}
+unsigned int FeatureMaskMatch(const CPUFeatureMask* required, const CPUFeatureMask* hosts, unsigned int count, unsigned char* compatible)
+{
+	CALL_COUNTED(call_counters);
+	return static_cast<unsigned int>(feature_masks_compatible(*reinterpret_cast<const FeatureMask*>(required), reinterpret_cast<const FeatureMask*>(hosts), count, compatible));
+}
+void FeatureMaskIntersection(const CPUFeatureMask* masks, unsigned int count, CPUFeatureMask* result)
+{
+	CALL_COUNTED(call_counters);
+	*reinterpret_cast<FeatureMask*>(result) = feature_masks_intersection(reinterpret_cast<const FeatureMask*>(masks), count);
+}
+bool LoadFeatureFile()
+{
+	CALL_COUNTED(call_counters);
+	set_feature_cache_loader(load_feature_file); // No effect if the snapshot was already loaded by another call
+	return library_state().feature_file_loaded;
+}
+bool FeatureFileLoaded()
+{
+	CALL_COUNTED(call_counters);
+	return library_state().feature_file_loaded;
+}
+
+static_assert(sizeof(CPUCallCounter) == sizeof(CallCounter), "The exported call counter must have the layout of the shared one");
+
+unsigned int ReadCallCounters(CPUCallCounter* counters, unsigned int capacity, bool reset)
+{
+#ifdef CPUFEATURES_INSTRUMENTED
+	return call_counters.read(reinterpret_cast<CallCounter*>(counters), counters ? capacity : 0, reset);
+#else
+	return 0;
+#endif
+}
+
+unsigned int CRC32C(unsigned int crc, const void* data, size_t size)
+{
+	CALL_COUNTED(call_counters);
+	return crc32c(crc, data, size);
+}
+
+unsigned long long PopCount(const void* data, size_t size)
+{
+	CALL_COUNTED(call_counters);
+	return popcount(data, size);
+}
+
+void* CopyBytes(void* destination, const void* source, size_t size)
+{
+	CALL_COUNTED(call_counters);
+	return copy_bytes(destination, source, size);
+}
+
+void AES128CTR(const unsigned char key[16], const unsigned char counter[16], const void* input, void* output, size_t size)
+{
+	CALL_COUNTED(call_counters);
+	aes128_ctr(key, counter, input, output, size);
+}
+
+size_t RandomFill(void* data, size_t size)
+{
+	CALL_COUNTED(call_counters);
+	return random_fill(data, size);
+}
+
+const char* KernelVariant(const char* kernel)
+{
+	CALL_COUNTED(call_counters);
+	return kernel_variant(kernel);
+}
@@ -1,6 +1,10 @@
 #pragma once
+#include <stddef.h>
 
-#ifdef CPUFEATURESLIBRARY_EXPORTS
+#ifndef _WIN32
+	// Shared library on other operating systems, built with CMake
+	#define LIBRARY_API __attribute__((visibility("default")))
+#elif defined(CPUFEATURESLIBRARY_EXPORTS)
 	//Exporting using module-definition file instead of dllexport, to avoid any name mangling.
 	//#define LIBRARY_API __declspec(dllexport)
 	#define LIBRARY_API
@@ -20,3 +24,77 @@ LIBRARY_API bool SupportAVX2();
 LIBRARY_API bool SupportAVX512();
 LIBRARY_API bool SupportAES();
 LIBRARY_API bool SupportRDRND();
+LIBRARY_API bool SupportAMX();
+LIBRARY_API bool SupportAMXINT8();
+LIBRARY_API bool SupportAMXBF16();
+LIBRARY_API bool SupportAMXFP16();
+LIBRARY_API bool SupportAVXVNNI();
+LIBRARY_API bool SupportAVX512BF16();
+LIBRARY_API bool SupportAVX512FP16();
+LIBRARY_API bool SupportAPX();
+LIBRARY_API bool SupportVMX();
+LIBRARY_API bool SupportRDTSCP();
+LIBRARY_API bool SupportInvariantTSC();
+LIBRARY_API bool SupportFeature(const char* name);
+LIBRARY_API bool HardwareSupportAVX();
+LIBRARY_API bool HardwareSupportAVX2();
+LIBRARY_API bool HardwareSupportAVX512();
+LIBRARY_API bool HardwareSupportAMX();
+LIBRARY_API bool HardwareSupportFeature(const char* name);
+LIBRARY_API unsigned int CacheSize(unsigned int level);
+LIBRARY_API unsigned int CacheLineSize(unsigned int level);
+LIBRARY_API unsigned int CacheAssociativity(unsigned int level);
+LIBRARY_API unsigned int CacheSharing(unsigned int level);
+LIBRARY_API unsigned int DataTLBEntries(unsigned int level);
+LIBRARY_API int ISALevel();
+LIBRARY_API int AVX10Version();
+LIBRARY_API int AVX10VectorLength();
+
+// Geometry of an AMX tile palette, see AMXTilePalette in Common/AMX.h
+struct CPUAMXPalette {
+	unsigned int total_tile_bytes;
+	unsigned int bytes_per_tile;
+	unsigned int bytes_per_row;
+	unsigned int max_names;
+	unsigned int max_rows;
+};
+
+LIBRARY_API bool AMXPalette(unsigned int palette, CPUAMXPalette* result);
+LIBRARY_API double TSCFrequency();
+LIBRARY_API unsigned long long TicksToNanoseconds(unsigned long long ticks);
+LIBRARY_API unsigned long long XSaveComponents();
+LIBRARY_API unsigned int XSaveSize();
+LIBRARY_API unsigned int XSaveCompactedSize(unsigned long long components);
+
+// Feature mask with one bit for each feature known by the library, see the feature mask functions
+struct CPUFeatureMask {
+	unsigned long long words[4];
+};
+
+LIBRARY_API void CurrentFeatureMask(CPUFeatureMask* mask);
+LIBRARY_API bool FeatureMaskFromNames(const char* names, CPUFeatureMask* mask);
+LIBRARY_API const char* FeatureMaskName(unsigned int index);
+LIBRARY_API unsigned int SerializeFeatureMask(const CPUFeatureMask* mask, char* buffer, unsigned int size);
+LIBRARY_API bool DeserializeFeatureMask(const char* text, CPUFeatureMask* mask);
+LIBRARY_API bool FeatureMaskSubset(const CPUFeatureMask* required, const CPUFeatureMask* host);
+LIBRARY_API void FeatureMaskMissing(const CPUFeatureMask* required, const CPUFeatureMask* host, CPUFeatureMask* missing);
+LIBRARY_API unsigned int FeatureMaskMatch(const CPUFeatureMask* required, const CPUFeatureMask* hosts, unsigned int count, unsigned char* compatible);
+LIBRARY_API void FeatureMaskIntersection(const CPUFeatureMask* masks, unsigned int count, CPUFeatureMask* result);
+LIBRARY_API bool LoadFeatureFile();
+LIBRARY_API bool FeatureFileLoaded();
+
+// Counters of an exported function, in an instrumented build, see ReadCallCounters
+struct CPUCallCounter {
+	const char* name;
+	unsigned long long calls;
+	unsigned long long cpuid_count;
+	unsigned long long cpuid_ticks;
+};
+
+LIBRARY_API unsigned int ReadCallCounters(CPUCallCounter* counters, unsigned int capacity, bool reset);
+LIBRARY_API unsigned int CRC32C(unsigned int crc, const void* data, size_t size);
+LIBRARY_API unsigned long long PopCount(const void* data, size_t size);
+LIBRARY_API void* CopyBytes(void* destination, const void* source, size_t size);
+LIBRARY_API void AES128CTR(const unsigned char key[16], const unsigned char counter[16], const void* input, void* output, size_t size);
+LIBRARY_API size_t RandomFill(void* data, size_t size);
+LIBRARY_API const char* KernelVariant(const char* kernel);
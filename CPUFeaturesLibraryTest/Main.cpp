@@ -1,9 +1,56 @@
 #include "Targetver.h"
 #include "../CPUFeaturesLibrary/CPUFeaturesLibrary.h"
+#include "../Common/WMain.h"
 #include <iostream>
+#include <vector>
+#include "../Common/Intrinsics.h"
+
+// Measure the cost of a feature check through the library, which tests a bit in the snapshot
+// captured at load time, compared to executing cpuid for every check. The latter is how the
+// library used to work, and is a trap to the hypervisor on every call when running in a VM.
+static void benchmark()
+{
+	const int library_iterations = 10000000;
+	const int cpuid_iterations = 10000;
+	volatile bool sink = false;
+	unsigned long long start = __rdtsc();
+	for (int i = 0; i < library_iterations; ++i)
+		sink = SupportAVX2();
+	const double library_ticks = (double)(__rdtsc() - start) / library_iterations;
+	start = __rdtsc();
+	for (int i = 0; i < cpuid_iterations; ++i) {
+		int cpu_info[4];
+		__cpuid(cpu_info, 0x0);
+		if (cpu_info[0] >= 7) {
+			__cpuid(cpu_info, 0x7);
+			sink = (cpu_info[1] & 1 << 5) != 0;
+		}
+	}
+	const double cpuid_ticks = (double)(__rdtsc() - start) / cpuid_iterations;
+	(void)sink; // Read back, the results are only stored to keep the calls from being optimized away
+	std::wcout << L"SupportAVX2 (snapshot) " << library_ticks << L" ticks per call" << std::endl;
+	std::wcout << L"SupportAVX2 (cpuid) " << cpuid_ticks << L" ticks per call" << std::endl;
+
+	// Matching a required feature mask against a fleet of host masks
+	const unsigned int hosts = 100000;
+	std::vector<CPUFeatureMask> host_masks(hosts);
+	std::vector<unsigned char> compatible(hosts);
+	CurrentFeatureMask(&host_masks[0]);
+	for (unsigned int i = 1; i < hosts; ++i) {
+		host_masks[i] = host_masks[0];
+		host_masks[i].words[i % 4] &= ~(1ull << (i % 64)); // Hosts missing one of the features
+	}
+	CPUFeatureMask required;
+	FeatureMaskFromNames("SSE2,SSE42,POPCNT", &required);
+	start = __rdtsc();
+	const unsigned int matches = FeatureMaskMatch(&required, host_masks.data(), hosts, compatible.data());
+	const double match_ticks = (double)(__rdtsc() - start) / hosts;
+	std::wcout << L"FeatureMaskMatch " << match_ticks << L" ticks per host, " << matches << L" of " << hosts << L" compatible" << std::endl;
+}
 
 int wmain(int argc, wchar_t *argv[], wchar_t *envp[])
 {
+	LoadFeatureFile(); // The first call, so that a trusted feature file is used if there is one
 	std::wcout << L"LongMode (64-bit) " << (SupportLongMode() ? L"supported" : L"not supported") << std::endl;
 	std::wcout << L"SSE " << (SupportSSE() ? L"supported" : L"not supported") << std::endl;
 	std::wcout << L"SSE2 " << (SupportSSE2() ? L"supported" : L"not supported") << std::endl;
@@ -16,4 +63,58 @@ int wmain(int argc, wchar_t *argv[], wchar_t *envp[])
 	std::wcout << L"AVX512 " << (SupportAVX512() ? L"supported" : L"not supported") << std::endl;
 	std::wcout << L"AES " << (SupportAES() ? L"supported" : L"not supported") << std::endl;
 	std::wcout << L"RDRND " << (SupportRDRND() ? L"supported" : L"not supported") << std::endl;
-}
\ No newline at end of file
+	std::wcout << L"AMX " << (SupportAMX() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AMX-INT8 " << (SupportAMXINT8() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AMX-BF16 " << (SupportAMXBF16() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AMX-FP16 " << (SupportAMXFP16() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AVX-VNNI " << (SupportAVXVNNI() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AVX512-BF16 " << (SupportAVX512BF16() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AVX512-FP16 " << (SupportAVX512FP16() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"APX " << (SupportAPX() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"VMX " << (SupportVMX() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"RDTSCP " << (SupportRDTSCP() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"Invariant TSC " << (SupportInvariantTSC() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AVX512VNNI (by name) " << (SupportFeature("AVX512VNNI") ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AVX (hardware) " << (HardwareSupportAVX() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AVX2 (hardware) " << (HardwareSupportAVX2() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AVX512 (hardware) " << (HardwareSupportAVX512() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AMX (hardware) " << (HardwareSupportAMX() ? L"supported" : L"not supported") << std::endl;
+	for (unsigned int level = 1; level <= 3; ++level)
+		std::wcout << L"L" << level << L" cache " << CacheSize(level) << L" bytes, " << CacheLineSize(level) << L" byte line, "
+			<< CacheAssociativity(level) << L"-way, shared by " << CacheSharing(level) << std::endl;
+	std::wcout << L"L1 data TLB " << DataTLBEntries(1) << L" entries" << std::endl;
+	std::wcout << L"ISA level x86-64-v" << ISALevel() << L", AVX10 version " << AVX10Version() << L", " << AVX10VectorLength() << L" bits" << std::endl;
+	CPUAMXPalette palette;
+	if (AMXPalette(1, &palette))
+		std::wcout << L"AMX palette 1 " << palette.max_names << L" tiles of " << palette.max_rows << L" rows of " << palette.bytes_per_row << L" bytes" << std::endl;
+	std::wcout << L"TSC " << TSCFrequency() << L" MHz, 1000000 ticks is " << TicksToNanoseconds(1000000) << L" ns" << std::endl;
+	std::wcout << L"XSAVE components 0x" << std::hex << XSaveComponents() << std::dec << L", " << XSaveSize() << L" bytes, compacted " << XSaveCompactedSize(~0ULL) << L" bytes" << std::endl;
+	CPUFeatureMask mask, required, missing;
+	char serialized[128];
+	CurrentFeatureMask(&mask);
+	SerializeFeatureMask(&mask, serialized, sizeof(serialized));
+	std::wcout << L"Feature file " << (FeatureFileLoaded() ? L"loaded" : L"not loaded") << std::endl;
+	std::wcout << L"Feature mask " << serialized << (DeserializeFeatureMask(serialized, &required) && FeatureMaskSubset(&required, &mask) && FeatureMaskSubset(&mask, &required) ? L"" : L" (round trip failed)") << std::endl;
+	FeatureMaskFromNames("AVX2,AVX512F,AMX-TILE", &required);
+	FeatureMaskMissing(&required, &mask, &missing);
+	std::wcout << L"Missing of AVX2,AVX512F,AMX-TILE:";
+	for (unsigned int i = 0; FeatureMaskName(i); ++i) {
+		if ((missing.words[i / 64] >> (i % 64)) & 1)
+			std::wcout << L' ' << FeatureMaskName(i);
+	}
+	std::wcout << std::endl;
+	const unsigned char key[16] = {}, counter[16] = {};
+	unsigned char buffer[64] = {}, copy[64];
+	AES128CTR(key, counter, buffer, buffer, sizeof(buffer));
+	CopyBytes(copy, buffer, sizeof(buffer));
+	std::wcout << L"CRC32C of \"123456789\" 0x" << std::hex << CRC32C(0, "123456789", 9) << std::dec << L" (" << KernelVariant("crc32c") << L"), popcount of AES-128-CTR keystream "
+		<< PopCount(copy, sizeof(copy)) << L" (" << KernelVariant("popcount") << L", " << KernelVariant("aes128-ctr") << L", " << KernelVariant("copy")
+		<< L"), random fill " << RandomFill(buffer, sizeof(buffer)) << L" bytes (" << KernelVariant("random") << L")" << std::endl;
+	if (argc > 1 && (argv[1][0] == L'-' || argv[1][0] == L'/') && _wcsicmp(&argv[1][1], L"benchmark") == 0)
+		benchmark();
+	CPUCallCounter counters[96];
+	const unsigned int counter_count = ReadCallCounters(counters, 96, false); // Zero without instrumentation
+	for (unsigned int i = 0; i < counter_count && i < 96; ++i)
+		std::wcout << counters[i].name << L": " << counters[i].calls << L" calls, " << counters[i].cpuid_count << L" cpuid, " << counters[i].cpuid_ticks << L" ticks" << std::endl;
+	return 0;
+}
@@ -9,6 +9,9 @@
 // not the Windows XP compatible variant) which means Windows Vista / Server 2008 is
 // minimum possible supported Windows version. Setting _WIN32_WINNT to 0x0600 ensuring
 // this (Vista/Server 2008) is our actual minimum.
+// Not used when building for other operating systems, with the CMake build.
+#ifdef _WIN32
 #include <winsdkver.h>
 #define _WIN32_WINNT 0x0600
 #include <SDKDDKVer.h>
+#endif
@@ -0,0 +1,84 @@
+//
+// Decoding of the Advanced Matrix Extensions (AMX) tile geometry of the executing processor, for
+// sizing the tile configuration of AMX kernels.
+//
+// Function id 0x1D describes the tile palettes: Sub-function 0 reports the highest palette in EAX,
+// and each sub-function from 1 describes palette i: The total size of the tile registers, the size
+// and number of the tile registers (names), and the maximum rows and bytes per row of a tile.
+// Palette 0 is the initialized state without tiles, and palette 1 the one of Sapphire Rapids,
+// eight tiles of 16 rows of 64 bytes. Function id 0x1E sub-function 0 describes the tile matrix
+// multiply unit (TMUL) in EBX: The maximum K (rows or columns) and N (bytes per column).
+//
+// The tiles can only be used when AMX-TILE is usable (see FeatureRegistry.h), with the tile state
+// enabled by the operating system, and on Linux a thread must also request permission to use it
+// first (arch_prctl ARCH_REQ_XCOMP_PERM), see XSave.h.
+//
+// The decoding is done from a source of cpuid data (see CPUIDSource.h), the executing processor
+// with get_amx_info, or a dump captured elsewhere with decode_amx_info.
+//
+// Header-only, shared by the CPUFeatures application (-avx mode) and the CPUFeaturesLibrary.
+//
+// See also: https://software.intel.com/content/www/us/en/develop/articles/intel-sdm.html (Volume 2A, CPUID, and Volume 1, Chapter 18)
+//
+#pragma once
+#include "Intrinsics.h"
+#include "CPUIDSource.h"
+
+#define AMX_MAX_PALETTES 8
+
+struct AMXTilePalette {
+	unsigned int total_tile_bytes; // Size of all tile registers
+	unsigned int bytes_per_tile;   // Size of one tile register
+	unsigned int bytes_per_row;    // Maximum bytes per row
+	unsigned int max_names;        // Number of tile registers
+	unsigned int max_rows;         // Maximum rows per tile
+};
+
+struct AMXInfo {
+	unsigned int palette_count;    // Palettes from 1, 0 without AMX
+	AMXTilePalette palettes[AMX_MAX_PALETTES]; // Palette i at index i - 1
+	unsigned int tmul_max_k;       // Maximum rows or columns (K) of a TMUL operation
+	unsigned int tmul_max_n;       // Maximum bytes per column (N) of a TMUL operation
+};
+
+// Palette by number, from 1, nullptr if not supported.
+static inline const AMXTilePalette* find_amx_palette(const AMXInfo& info, unsigned int palette)
+{
+	return palette >= 1 && palette <= info.palette_count ? &info.palettes[palette - 1] : nullptr;
+}
+
+template<typename Source>
+static inline AMXInfo decode_amx_info(const Source& source)
+{
+	AMXInfo info = {};
+	int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
+	source.cpuid(cpu_info, 0x0);
+	const unsigned int max_function_id = static_cast<unsigned int>(cpu_info[0]);
+	if (max_function_id < 0x1D)
+		return info;
+	source.cpuid(cpu_info, 0x7, 0);
+	if (!(cpu_info[3] & (1 << 24))) // AMX-TILE
+		return info;
+	source.cpuid(cpu_info, 0x1D, 0);
+	const unsigned int max_palette = static_cast<unsigned int>(cpu_info[0]);
+	for (unsigned int palette = 1; palette <= max_palette && palette <= AMX_MAX_PALETTES; ++palette) {
+		source.cpuid(cpu_info, 0x1D, palette);
+		AMXTilePalette& result = info.palettes[info.palette_count++];
+		result.total_tile_bytes = cpu_info[0] & 0xFFFF;
+		result.bytes_per_tile = (cpu_info[0] >> 16) & 0xFFFF;
+		result.bytes_per_row = cpu_info[1] & 0xFFFF;
+		result.max_names = (cpu_info[1] >> 16) & 0xFFFF;
+		result.max_rows = cpu_info[2] & 0xFFFF;
+	}
+	if (max_function_id >= 0x1E) {
+		source.cpuid(cpu_info, 0x1E, 0);
+		info.tmul_max_k = cpu_info[1] & 0xFF;
+		info.tmul_max_n = (cpu_info[1] >> 8) & 0xFFFF;
+	}
+	return info;
+}
+
+static inline AMXInfo get_amx_info()
+{
+	return decode_amx_info(CPUIDLiveSource());
+}
@@ -0,0 +1,172 @@
+//
+// Registry of AArch64 (ARM64) CPU features, the counterpart of FeatureRegistry.h for ARM processors,
+// and capturing an ArmFeatureSnapshot of the executing processor.
+//
+// The ARM feature registers (ID_AA64ISAR0_EL1 etc.) can only be read by the kernel, so unlike with
+// cpuid on x86 the features are reported by the operating system, which means that a feature
+// reported is also usable:
+// - Linux, Android and FreeBSD: The hardware capability bits HWCAP and HWCAP2 from the auxiliary
+//   vector, read with getauxval (elf_aux_info on FreeBSD). See arch/arm64/include/uapi/asm/hwcap.h.
+// - Apple (macOS and iOS): The sysctl values hw.optional.arm.FEAT_*, one for each feature.
+// - Windows: IsProcessorFeaturePresent with the PF_ARM_* constants, which only cover some features.
+//   The constants are given by value, since the newer ones are not in older Windows SDKs.
+//
+// The SVE vector length is implementation defined, from 128 to 2048 bits, and is read with
+// prctl(PR_SVE_GET_VL) on Linux. It is 0 when SVE is not supported, or the length is unknown.
+//
+// Each feature is added with a single line in ARM_FEATURE_LIST, which generates both the ArmFeature
+// enumeration and the table, just like CPU_FEATURE_LIST. The table is in alphabetical order.
+// On other architectures than AArch64, the snapshot is empty.
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include <string.h>
+
+#if defined(__aarch64__) && (defined(__linux__) || defined(__ANDROID__))
+#include <sys/auxv.h>
+#include <sys/prctl.h>
+#elif defined(__aarch64__) && defined(__FreeBSD__)
+#include <sys/auxv.h>
+#elif defined(__aarch64__) && defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#elif defined(_M_ARM64)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+
+// Auxiliary vector entry of the hardware capability bits
+#define ArmHwcapNone 0
+#define ArmHwcap     1 // AT_HWCAP
+#define ArmHwcap2    2 // AT_HWCAP2
+
+#define ARM_FEATURE_LIST(X) \
+	/*    id,         name,         label,                        hwcap, bit, Apple sysctl,                  Windows PF_ARM_* */ \
+	X(AES,        "AES",        "AES",                        ArmHwcap,  3,  "hw.optional.arm.FEAT_AES",     30) \
+	X(BF16,       "BF16",       "BFloat16",                   ArmHwcap2, 14, "hw.optional.arm.FEAT_BF16",    68) \
+	X(BTI,        "BTI",        "Branch Target Identification", ArmHwcap2, 17, "hw.optional.arm.FEAT_BTI",   -1) \
+	X(CRC32,      "CRC32",      "CRC32",                      ArmHwcap,  7,  "hw.optional.armv8_crc32",      31) \
+	X(DOTPROD,    "DOTPROD",    "Dot Product",                ArmHwcap,  20, "hw.optional.arm.FEAT_DotProd", 43) \
+	X(FCMA,       "FCMA",       "Complex Number",             ArmHwcap,  14, "hw.optional.arm.FEAT_FCMA",    -1) \
+	X(FHM,        "FHM",        "FP16 Multiplication",        ArmHwcap,  23, "hw.optional.arm.FEAT_FHM",     -1) \
+	X(FP16,       "FP16",       "Half Precision",             ArmHwcap,  10, "hw.optional.arm.FEAT_FP16",    67) \
+	X(I8MM,       "I8MM",       "Int8 Matrix Multiplication", ArmHwcap2, 13, "hw.optional.arm.FEAT_I8MM",    66) \
+	X(JSCVT,      "JSCVT",      "JavaScript Conversion",      ArmHwcap,  13, "hw.optional.arm.FEAT_JSCVT",   44) \
+	X(LRCPC,      "LRCPC",      "Load-Acquire RCpc",          ArmHwcap,  15, "hw.optional.arm.FEAT_LRCPC",   45) \
+	X(LSE,        "LSE",        "Large System Extensions (atomics)", ArmHwcap, 8, "hw.optional.arm.FEAT_LSE", 34) \
+	X(MTE,        "MTE",        "Memory Tagging",             ArmHwcap2, 18, nullptr,                        -1) \
+	X(NEON,       "NEON",       "Advanced SIMD",              ArmHwcap,  1,  "hw.optional.neon",             19) \
+	X(PACA,       "PACA",       "Pointer Authentication",     ArmHwcap,  30, "hw.optional.arm.FEAT_PAuth",   -1) \
+	X(PMULL,      "PMULL",      "Polynomial Multiply Long",   ArmHwcap,  4,  "hw.optional.arm.FEAT_PMULL",   30) \
+	X(RDM,        "RDM",        "Rounding Double Multiply",   ArmHwcap,  12, "hw.optional.arm.FEAT_RDM",     -1) \
+	X(RNG,        "RNG",        "Random Number",              ArmHwcap2, 16, nullptr,                        -1) \
+	X(SHA1,       "SHA1",       "SHA1",                       ArmHwcap,  5,  "hw.optional.arm.FEAT_SHA1",    30) \
+	X(SHA2,       "SHA2",       "SHA256",                     ArmHwcap,  6,  "hw.optional.arm.FEAT_SHA256",  30) \
+	X(SHA3,       "SHA3",       "SHA3",                       ArmHwcap,  17, "hw.optional.arm.FEAT_SHA3",    64) \
+	X(SHA512,     "SHA512",     "SHA512",                     ArmHwcap,  21, "hw.optional.arm.FEAT_SHA512",  65) \
+	X(SM3,        "SM3",        "SM3",                        ArmHwcap,  18, nullptr,                        -1) \
+	X(SM4,        "SM4",        "SM4",                        ArmHwcap,  19, nullptr,                        -1) \
+	X(SME,        "SME",        "Scalable Matrix Extension",  ArmHwcap2, 23, "hw.optional.arm.FEAT_SME",     70) \
+	X(SVE,        "SVE",        "Scalable Vector Extension",  ArmHwcap,  22, nullptr,                        46) \
+	X(SVE2,       "SVE2",       "SVE2",                       ArmHwcap2, 1,  nullptr,                        47) \
+	X(SVEAES,     "SVEAES",     "SVE AES",                    ArmHwcap2, 2,  nullptr,                        49) \
+	X(SVEBF16,    "SVEBF16",    "SVE BFloat16",               ArmHwcap2, 12, nullptr,                        52) \
+	X(SVEBITPERM, "SVEBITPERM", "SVE Bit Permute",            ArmHwcap2, 4,  nullptr,                        51) \
+	X(SVEI8MM,    "SVEI8MM",    "SVE Int8 Matrix Multiplication", ArmHwcap2, 9, nullptr,                     57) \
+	X(SVESHA3,    "SVESHA3",    "SVE SHA3",                   ArmHwcap2, 5,  nullptr,                        55) \
+	X(SVESM4,     "SVESM4",     "SVE SM4",                    ArmHwcap2, 6,  nullptr,                        56)
+
+enum ArmFeature {
+#define ARM_FEATURE_ENUM(id, name, label, hwcap, bit, apple_sysctl, windows_feature) ArmFeature_##id,
+	ARM_FEATURE_LIST(ARM_FEATURE_ENUM)
+#undef ARM_FEATURE_ENUM
+	ArmFeatureCount
+};
+static_assert(ArmFeatureCount <= 64, "The features of an ArmFeatureSnapshot are a 64-bit mask");
+
+struct ArmFeatureInfo {
+	const char* name;
+	const char* label;
+	unsigned int hwcap;       // One of ArmHwcap*, the auxiliary vector entry on Linux, Android and FreeBSD
+	unsigned int bit;         // Bit in the auxiliary vector entry
+	const char* apple_sysctl; // Name of the sysctl value on Apple, nullptr if not reported
+	int windows_feature;      // PF_ARM_* value for IsProcessorFeaturePresent on Windows, -1 if not reported
+};
+
+static constexpr ArmFeatureInfo arm_feature_table[ArmFeatureCount] = {
+#define ARM_FEATURE_INFO(id, name, label, hwcap, bit, apple_sysctl, windows_feature) { name, label, hwcap, bit, apple_sysctl, windows_feature },
+	ARM_FEATURE_LIST(ARM_FEATURE_INFO)
+#undef ARM_FEATURE_INFO
+};
+
+// Snapshot of the features reported by the operating system
+struct ArmFeatureSnapshot {
+	unsigned long long features;    // Bit for each ArmFeature
+	unsigned int sve_vector_length; // SVE vector length in bits, 0 if not supported or unknown
+};
+
+static inline bool arm_feature_supported(const ArmFeatureSnapshot& snapshot, ArmFeature feature)
+{
+	return ((snapshot.features >> feature) & 1) != 0;
+}
+
+// Find a feature by name (case sensitive), ArmFeatureCount if not found.
+static inline ArmFeature find_arm_feature(const char* name)
+{
+	for (int i = 0; i < ArmFeatureCount; ++i) {
+		if (strcmp(arm_feature_table[i].name, name) == 0)
+			return static_cast<ArmFeature>(i);
+	}
+	return ArmFeatureCount;
+}
+
+// Decode the hardware capability bits from the auxiliary vector, for values obtained elsewhere, e.g. from
+// /proc/self/auxv of another process.
+static inline unsigned long long arm_features_from_hwcap(unsigned long long hwcap, unsigned long long hwcap2)
+{
+	unsigned long long features = 0;
+	for (int i = 0; i < ArmFeatureCount; ++i) {
+		const ArmFeatureInfo& info = arm_feature_table[i];
+		const unsigned long long value = info.hwcap == ArmHwcap ? hwcap : info.hwcap == ArmHwcap2 ? hwcap2 : 0;
+		if ((value >> info.bit) & 1)
+			features |= 1ull << i;
+	}
+	return features;
+}
+
+static inline ArmFeatureSnapshot get_arm_feature_snapshot()
+{
+	ArmFeatureSnapshot snapshot = {};
+#if defined(__aarch64__) && (defined(__linux__) || defined(__ANDROID__))
+	snapshot.features = arm_features_from_hwcap(getauxval(AT_HWCAP), getauxval(AT_HWCAP2));
+	if (arm_feature_supported(snapshot, ArmFeature_SVE)) {
+#ifndef PR_SVE_GET_VL
+#define PR_SVE_GET_VL 51 // Linux 4.15
+#endif
+		const int result = prctl(PR_SVE_GET_VL);
+		if (result >= 0)
+			snapshot.sve_vector_length = (static_cast<unsigned int>(result) & 0xffff) * 8; // PR_SVE_VL_LEN_MASK, in bytes
+	}
+#elif defined(__aarch64__) && defined(__FreeBSD__)
+	unsigned long hwcap = 0, hwcap2 = 0;
+	elf_aux_info(AT_HWCAP, &hwcap, sizeof(hwcap));
+	elf_aux_info(AT_HWCAP2, &hwcap2, sizeof(hwcap2));
+	snapshot.features = arm_features_from_hwcap(hwcap, hwcap2);
+#elif defined(__aarch64__) && defined(__APPLE__)
+	for (int i = 0; i < ArmFeatureCount; ++i) {
+		int value = 0;
+		size_t size = sizeof(value);
+		if (arm_feature_table[i].apple_sysctl && sysctlbyname(arm_feature_table[i].apple_sysctl, &value, &size, nullptr, 0) == 0 && value)
+			snapshot.features |= 1ull << i;
+	}
+#elif defined(_M_ARM64)
+	for (int i = 0; i < ArmFeatureCount; ++i) {
+		if (arm_feature_table[i].windows_feature >= 0 && IsProcessorFeaturePresent(static_cast<DWORD>(arm_feature_table[i].windows_feature)))
+			snapshot.features |= 1ull << i;
+	}
+#endif
+	return snapshot;
+}
@@ -0,0 +1,365 @@
+//
+// The instruction set extensions the including translation unit is compiled for, recorded at compile
+// time from the predefined macros of the compiler, e.g. __AVX2__ with GCC and Clang -mavx2 or
+// -march=x86-64-v3, and with Microsoft Visual C++ /arch:AVX2, so that a binary built for more than
+// the baseline can fail at startup with a clear message instead of with an illegal instruction
+// somewhere later, and report how much of the executing processor it leaves unused.
+//
+// With GCC and Clang each extension has its own macro. Microsoft Visual C++ only defines _M_IX86_FP
+// (SSE and SSE2 on 32-bit), __AVX__, __AVX2__ and the AVX-512 macros of /arch:AVX512, and an /arch
+// option lets the compiler use everything below it: /arch:AVX the SSE3 to SSE4.2 and POPCNT
+// instructions, and /arch:AVX2 also FMA, F16C, BMI1, BMI2, LZCNT and MOVBE, so those are recorded as
+// implied. It has no macros for CMPXCHG16B and LAHF-SAHF either, which every 64-bit processor with AVX
+// has, so a 64-bit /arch:AVX build or above records them, and is named x86-64-v2 or above, not v1. The 64-bit baseline (long mode, CMOV, CX8, FPU, FXSR, MMX, SSE and SSE2) is implied by the
+// architecture. The other features of the registry, e.g. ERMS or the speculation controls, are not
+// instruction sets a compiler targets, and are only used by code checking for them at runtime.
+//
+// The macros are evaluated where the header is included, so the record is that of the including
+// translation unit, which is the point: A program can mix one translation unit built for the baseline
+// with others for AVX2, and the ones to record are those built for the target. The record is constant
+// data, but code compiled for the target may use for example VEX encoded instructions anywhere, also
+// in the snapshot and the check, and would fault on the very processor the check should reject. So
+// CPUFEATURES_REQUIRE_BUILD_TARGET only passes the record to require_build_target_baseline, which the
+// program defines in a translation unit built for the baseline (CPUFeatures/BuildTargetCheck.cpp).
+//
+// Header-only, used by the CPUFeatures application (startup check and -compare-build mode).
+//
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include "FeatureSnapshot.h"
+#include "FeatureMask.h"
+#include "ISALevel.h"
+
+// The features build_target_features() can record, in registry order: The ones a compiler can be
+// told to target, and with that is free to use anywhere, not only in intrinsics.
+static const Feature build_target_recordable_features[] = {
+	Feature_ADX, Feature_AES, Feature_AMXBF16, Feature_AMXCOMPLEX, Feature_AMXFP16, Feature_AMXINT8, Feature_AMXTILE, Feature_APX,
+	Feature_AVX, Feature_AVX2, Feature_AVX512F, Feature_AVX512CD, Feature_AVX512ER, Feature_AVX512PF, Feature_AVX512VL, Feature_AVX512BW,
+	Feature_AVX512DQ, Feature_AVX512IFMA, Feature_AVX512VBMI, Feature_AVX512VNNI, Feature_AVX512VBMI2, Feature_AVX512POPCNTDQ,
+	Feature_AVX512BITALG, Feature_AVX5124VNNIW, Feature_AVX5124FMAPS, Feature_AVX512VP2INTERSECT, Feature_AVX512BF16, Feature_AVXVNNI,
+	Feature_AVX512FP16, Feature_AVXIFMA, Feature_AVXVNNIINT8, Feature_AVXNECONVERT, Feature_AVXVNNIINT16, Feature_BMI1, Feature_BMI2,
+	Feature_CMOV, Feature_CMPXCHG16B, Feature_CX8, Feature_F16C, Feature_FMA, Feature_FPU, Feature_FSGSBASE, Feature_FXSR, Feature_GFNI,
+	Feature_HLE, Feature_LAHF, Feature_LM, Feature_LZCNT, Feature_MMX, Feature_MOVBE, Feature_MOVDIRI, Feature_PCLMULQDQ, Feature_POPCNT,
+	Feature_PREFETCHWT1, Feature_RDRAND, Feature_RDSEED, Feature_RTM, Feature_SERIALIZE, Feature_SHA, Feature_SSE, Feature_SSE2,
+	Feature_SSE3, Feature_SSE41, Feature_SSE42, Feature_SSE4a, Feature_SSSE3, Feature_TBM, Feature_VAES, Feature_VPCLMULQDQ, Feature_XOP,
+	Feature_XSAVE, Feature_XSAVEC, Feature_XSAVEOPT, Feature_XSAVES,
+};
+static const size_t build_target_recordable_feature_count = sizeof(build_target_recordable_features) / sizeof(build_target_recordable_features[0]);
+
+// The features the including translation unit is compiled for, as constant data, so that recording them
+// executes no code: Terminated by FeatureCount, which also keeps the array from being empty.
+static const Feature build_target_feature_list[] = {
+#if defined(_M_X64) || defined(__x86_64__)
+	Feature_LM,
+	Feature_CMOV,
+	Feature_CX8,
+	Feature_FPU,
+	Feature_FXSR,
+	Feature_MMX,
+	Feature_SSE,
+	Feature_SSE2,
+#endif
+#if defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	Feature_SSE,
+#endif
+#if defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	Feature_SSE2,
+#endif
+#if defined(__SSE3__) || (defined(_MSC_VER) && defined(__AVX__))
+	Feature_SSE3,
+#endif
+#if defined(__SSSE3__) || (defined(_MSC_VER) && defined(__AVX__))
+	Feature_SSSE3,
+#endif
+#if defined(__SSE4_1__) || (defined(_MSC_VER) && defined(__AVX__))
+	Feature_SSE41,
+#endif
+#if defined(__SSE4_2__) || (defined(_MSC_VER) && defined(__AVX__))
+	Feature_SSE42,
+#endif
+#if defined(__POPCNT__) || (defined(_MSC_VER) && defined(__AVX__))
+	Feature_POPCNT,
+#endif
+#if defined(__SSE4A__)
+	Feature_SSE4a,
+#endif
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16) || (defined(_MSC_VER) && defined(_M_X64) && defined(__AVX__)) // -mcx16
+	Feature_CMPXCHG16B,
+#endif
+#if defined(__LAHF_SAHF__) || (defined(_MSC_VER) && defined(_M_X64) && defined(__AVX__))
+	Feature_LAHF,
+#endif
+#if defined(__AVX__)
+	Feature_AVX,
+#endif
+#if defined(__AVX2__)
+	Feature_AVX2,
+#endif
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+	Feature_FMA,
+#endif
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+	Feature_F16C,
+#endif
+#if defined(__BMI__) || (defined(_MSC_VER) && defined(__AVX2__))
+	Feature_BMI1,
+#endif
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+	Feature_BMI2,
+#endif
+#if defined(__LZCNT__) || (defined(_MSC_VER) && defined(__AVX2__))
+	Feature_LZCNT,
+#endif
+#if defined(__MOVBE__) || (defined(_MSC_VER) && defined(__AVX2__))
+	Feature_MOVBE,
+#endif
+#if defined(__AVX512F__)
+	Feature_AVX512F,
+#endif
+#if defined(__AVX512CD__)
+	Feature_AVX512CD,
+#endif
+#if defined(__AVX512ER__)
+	Feature_AVX512ER,
+#endif
+#if defined(__AVX512PF__)
+	Feature_AVX512PF,
+#endif
+#if defined(__AVX512VL__)
+	Feature_AVX512VL,
+#endif
+#if defined(__AVX512BW__)
+	Feature_AVX512BW,
+#endif
+#if defined(__AVX512DQ__)
+	Feature_AVX512DQ,
+#endif
+#if defined(__AVX512IFMA__)
+	Feature_AVX512IFMA,
+#endif
+#if defined(__AVX512VBMI__)
+	Feature_AVX512VBMI,
+#endif
+#if defined(__AVX512VNNI__)
+	Feature_AVX512VNNI,
+#endif
+#if defined(__AVX512VBMI2__)
+	Feature_AVX512VBMI2,
+#endif
+#if defined(__AVX512VPOPCNTDQ__)
+	Feature_AVX512POPCNTDQ,
+#endif
+#if defined(__AVX512BITALG__)
+	Feature_AVX512BITALG,
+#endif
+#if defined(__AVX5124VNNIW__)
+	Feature_AVX5124VNNIW,
+#endif
+#if defined(__AVX5124FMAPS__)
+	Feature_AVX5124FMAPS,
+#endif
+#if defined(__AVX512VP2INTERSECT__)
+	Feature_AVX512VP2INTERSECT,
+#endif
+#if defined(__AVX512BF16__)
+	Feature_AVX512BF16,
+#endif
+#if defined(__AVX512FP16__)
+	Feature_AVX512FP16,
+#endif
+#if defined(__AVXVNNI__)
+	Feature_AVXVNNI,
+#endif
+#if defined(__AVXIFMA__)
+	Feature_AVXIFMA,
+#endif
+#if defined(__AVXVNNIINT8__)
+	Feature_AVXVNNIINT8,
+#endif
+#if defined(__AVXNECONVERT__)
+	Feature_AVXNECONVERT,
+#endif
+#if defined(__AVXVNNIINT16__)
+	Feature_AVXVNNIINT16,
+#endif
+#if defined(__AMX_TILE__)
+	Feature_AMXTILE,
+#endif
+#if defined(__AMX_INT8__)
+	Feature_AMXINT8,
+#endif
+#if defined(__AMX_BF16__)
+	Feature_AMXBF16,
+#endif
+#if defined(__AMX_FP16__)
+	Feature_AMXFP16,
+#endif
+#if defined(__AMX_COMPLEX__)
+	Feature_AMXCOMPLEX,
+#endif
+#if defined(__APX_F__)
+	Feature_APX,
+#endif
+#if defined(__AES__)
+	Feature_AES,
+#endif
+#if defined(__PCLMUL__)
+	Feature_PCLMULQDQ,
+#endif
+#if defined(__VAES__)
+	Feature_VAES,
+#endif
+#if defined(__VPCLMULQDQ__)
+	Feature_VPCLMULQDQ,
+#endif
+#if defined(__GFNI__)
+	Feature_GFNI,
+#endif
+#if defined(__SHA__)
+	Feature_SHA,
+#endif
+#if defined(__ADX__)
+	Feature_ADX,
+#endif
+#if defined(__RDRND__)
+	Feature_RDRAND,
+#endif
+#if defined(__RDSEED__)
+	Feature_RDSEED,
+#endif
+#if defined(__FSGSBASE__)
+	Feature_FSGSBASE,
+#endif
+#if defined(__MOVDIRI__)
+	Feature_MOVDIRI,
+#endif
+#if defined(__SERIALIZE__)
+	Feature_SERIALIZE,
+#endif
+#if defined(__PREFETCHWT1__)
+	Feature_PREFETCHWT1,
+#endif
+#if defined(__RTM__)
+	Feature_RTM,
+#endif
+#if defined(__HLE__)
+	Feature_HLE,
+#endif
+#if defined(__TBM__)
+	Feature_TBM,
+#endif
+#if defined(__XOP__)
+	Feature_XOP,
+#endif
+#if defined(__XSAVE__)
+	Feature_XSAVE,
+#endif
+#if defined(__XSAVEC__)
+	Feature_XSAVEC,
+#endif
+#if defined(__XSAVEOPT__)
+	Feature_XSAVEOPT,
+#endif
+#if defined(__XSAVES__)
+	Feature_XSAVES,
+#endif
+	FeatureCount
+};
+static const size_t build_target_feature_list_count = sizeof(build_target_feature_list) / sizeof(build_target_feature_list[0]) - 1;
+
+// The mask of a list of features.
+static inline FeatureMask build_target_mask(const Feature* features, size_t count)
+{
+	FeatureMask mask = {};
+	for (size_t i = 0; i < count; ++i)
+		feature_mask_set(mask, features[i]);
+	return mask;
+}
+
+// The features the including translation unit is compiled for.
+static inline FeatureMask build_target_features()
+{
+	return build_target_mask(build_target_feature_list, build_target_feature_list_count);
+}
+
+// The features of an x86-64 level (see ISALevel.h), for comparing with a build for that level. OSXSAVE
+// is not an instruction set, so it is not part of the build target.
+static inline FeatureMask build_target_features_of_level(X86Level level)
+{
+	FeatureMask mask = {};
+	for (size_t i = 0; i < x86_level_feature_count; ++i) {
+		if (x86_level_features[i].level <= level && x86_level_features[i].feature != Feature_OSXSAVE)
+			feature_mask_set(mask, x86_level_features[i].feature);
+	}
+	return mask;
+}
+
+// The highest x86-64 level with all its instruction sets in a build target.
+static inline X86Level build_target_level(const FeatureMask& build)
+{
+	X86Level level = X86LevelV4;
+	for (size_t i = 0; i < x86_level_feature_count; ++i) {
+		if (x86_level_features[i].level <= level && x86_level_features[i].feature != Feature_OSXSAVE && !feature_mask_test(build, x86_level_features[i].feature))
+			level = static_cast<X86Level>(x86_level_features[i].level - 1);
+	}
+	return level;
+}
+
+// The recordable features usable on the processor of a snapshot. LZCNT is the same bit as ABM, which is
+// how it is reported in the registry for AMD processors (see ISALevel.h).
+static inline FeatureMask build_target_host_features(const FeatureSnapshot& snapshot)
+{
+	FeatureMask mask = {};
+	for (size_t i = 0; i < build_target_recordable_feature_count; ++i) {
+		const Feature feature = build_target_recordable_features[i];
+		if (feature == Feature_LZCNT ? x86_level_feature_usable(snapshot, feature) : feature_usable(snapshot, feature))
+			feature_mask_set(mask, feature);
+	}
+	return mask;
+}
+
+// Widest vector registers used by a build target, or usable on a host, in bits.
+static inline unsigned int build_target_vector_width(const FeatureMask& features)
+{
+	return feature_mask_test(features, Feature_AVX512F) ? 512 : feature_mask_test(features, Feature_AVX) ? 256 : feature_mask_test(features, Feature_SSE) ? 128 : 0;
+}
+
+// Check a build target against the processor of a snapshot: The features of the build that are not usable
+// (which the program must not start with), and the recordable features usable that the build leaves unused.
+static inline bool check_build_target(const FeatureMask& build, const FeatureSnapshot& snapshot, FeatureMask* missing = nullptr, FeatureMask* unused = nullptr)
+{
+	const FeatureMask host = build_target_host_features(snapshot);
+	const FeatureMask not_usable = feature_mask_missing(build, host);
+	if (missing)
+		*missing = not_usable;
+	if (unused)
+		*unused = feature_mask_missing(host, build);
+	return feature_mask_count(not_usable) == 0;
+}
+
+// Fail fast, with a message on standard error and exit code 1, if a build target is not usable on the
+// executing processor. Uses a snapshot of its own, not the cached one (see FeatureCache.h), so it can be
+// called before a snapshot is published.
+static inline void require_build_target(const FeatureMask& build)
+{
+	const FeatureSnapshot snapshot = get_feature_snapshot();
+	FeatureMask missing;
+	if (check_build_target(build, snapshot, &missing))
+		return;
+	fprintf(stderr, "This program is built for %s and instruction set extensions not usable on this processor (%s):",
+		x86_level_names[build_target_level(build)], x86_level_names[isa_level(snapshot)]);
+	for (int i = 0; i < FeatureCount; ++i) {
+		if (feature_mask_test(missing, static_cast<Feature>(i)))
+			fprintf(stderr, " %s", feature_table[i].name);
+	}
+	fprintf(stderr, "\n");
+	exit(EXIT_FAILURE);
+}
+
+// require_build_target of a list of features, defined in a translation unit built for the baseline.
+void require_build_target_baseline(const Feature* features, size_t count);
+
+// Check the build target of the translation unit where it is used at startup, before main.
+#define CPUFEATURES_REQUIRE_BUILD_TARGET() \
+	static const bool cpufeatures_build_target_required = (require_build_target_baseline(build_target_feature_list, build_target_feature_list_count), true)
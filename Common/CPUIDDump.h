@@ -0,0 +1,156 @@
+//
+// Dump of the raw cpuid registers of all valid function ids of the executing processor.
+//
+// Each record holds the four registers EAX, EBX, ECX and EDX returned for one function id and
+// sub-function id (sub-leaf). All standard function ids up to the maximum reported by function
+// id 0, and all extended function ids up to the maximum reported by 0x80000000 are included,
+// with sub-function id 0, except for the function ids that are enumerated by sub-function id,
+// where all valid sub-function ids are included:
+//   0x4        Deterministic cache parameters, until cache type null
+//   0x7        Extended features, up to the maximum reported in EAX of sub-function 0
+//   0xB, 0x1F  Extended topology enumeration, until level type null
+//   0xD        Processor extended state enumeration, sub-functions 0 and 1, and each state component with nonzero size
+//   0x14       Processor trace, up to the maximum reported in EAX of sub-function 0
+//   0x18       Deterministic address translation parameters, up to the maximum reported in EAX of sub-function 0
+//   0x1D       AMX tile information, each palette up to the maximum reported in EAX of sub-function 0
+//   0x1E       AMX TMUL information, up to the maximum reported in EAX of sub-function 0
+//   0x24       AVX10 converged vector ISA enumeration, up to the maximum reported in EAX of sub-function 0
+//   0x8000001D AMD cache topology, until cache type null
+//
+// The dump is described by a versioned descriptor, so that it can be decoded elsewhere,
+// e.g. by a managed caller or offline, without having to execute cpuid again. The descriptor
+// and the records consist of 32-bit unsigned integers only, so they can be marshalled as plain
+// arrays. New fields will only be added at the end of the descriptor, increasing its size and
+// version, and the number of records can always be computed from record_count and record_size.
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include "Intrinsics.h"
+#include "OSSupport.h"
+
+#define CPUID_DUMP_VERSION 1
+
+struct CPUIDRecord {
+	unsigned int function_id;
+	unsigned int subfunction_id;
+	unsigned int eax;
+	unsigned int ebx;
+	unsigned int ecx;
+	unsigned int edx;
+};
+
+struct CPUIDDumpDescriptor {
+	unsigned int size;         // Size of this descriptor in bytes
+	unsigned int version;      // CPUID_DUMP_VERSION
+	unsigned int record_size;  // Size of each record in bytes
+	unsigned int record_count; // Number of valid records, may be larger than the number written if the buffer was too small
+	unsigned int max_function_id;          // Highest valid standard function id, from function id 0
+	unsigned int max_extended_function_id; // Highest valid extended function id, from function id 0x80000000
+	unsigned int xcr0_low;     // Low 32 bits of XCR0, 0 if the operating system has not enabled XSAVE
+	unsigned int xcr0_high;    // High 32 bits of XCR0
+};
+
+// Highest number of function ids dumped in each range, as a guard against bogus maximum function ids
+#define CPUID_DUMP_MAX_FUNCTIONS 0x100
+// Highest number of sub-function ids dumped for each function id
+#define CPUID_DUMP_MAX_SUBFUNCTIONS 64
+
+// Execute cpuid for all valid function ids and sub-function ids, and call function(record) for each.
+template<typename Function>
+static inline void cpuid_enumerate(Function function, unsigned int& max_function_id, unsigned int& max_extended_function_id)
+{
+	int cpu_info[4];
+	CPUIDRecord record;
+	const auto query = [&cpu_info, &record](unsigned int function_id, unsigned int subfunction_id) {
+		__cpuidex(cpu_info, static_cast<int>(function_id), static_cast<int>(subfunction_id));
+		record.function_id = function_id;
+		record.subfunction_id = subfunction_id;
+		record.eax = cpu_info[0];
+		record.ebx = cpu_info[1];
+		record.ecx = cpu_info[2];
+		record.edx = cpu_info[3];
+	};
+	query(0x0, 0);
+	max_function_id = record.eax;
+	query(0x80000000, 0);
+	max_extended_function_id = record.eax;
+	const unsigned int ranges[2][2] = {
+		{ 0x0, max_function_id < CPUID_DUMP_MAX_FUNCTIONS ? max_function_id : CPUID_DUMP_MAX_FUNCTIONS - 1 },
+		{ 0x80000000, max_extended_function_id >= 0x80000000 && max_extended_function_id < 0x80000000 + CPUID_DUMP_MAX_FUNCTIONS ? max_extended_function_id : 0x80000000 } };
+	for (const auto& range : ranges) {
+		for (unsigned int function_id = range[0]; function_id <= range[1]; ++function_id) {
+			query(function_id, 0);
+			function(record);
+			switch (function_id) {
+			case 0x4:
+			case 0x8000001D:
+				for (unsigned int i = 1; i < CPUID_DUMP_MAX_SUBFUNCTIONS && (record.eax & 0x1F) != 0; ++i) { // Until cache type null
+					query(function_id, i);
+					if ((record.eax & 0x1F) != 0)
+						function(record);
+				}
+				break;
+			case 0x7:
+			case 0x14:
+			case 0x18:
+			case 0x1D:
+			case 0x1E:
+			case 0x24:
+				for (unsigned int i = 1, n = record.eax; i <= n && i < CPUID_DUMP_MAX_SUBFUNCTIONS; ++i) {
+					query(function_id, i);
+					function(record);
+				}
+				break;
+			case 0xB:
+			case 0x1F:
+				for (unsigned int i = 1; i < CPUID_DUMP_MAX_SUBFUNCTIONS && (record.ecx & 0xFF00) != 0; ++i) { // Until level type null
+					query(function_id, i);
+					if ((record.ecx & 0xFF00) != 0)
+						function(record);
+				}
+				break;
+			case 0xD:
+				for (unsigned int i = 1; i < CPUID_DUMP_MAX_SUBFUNCTIONS; ++i) {
+					query(function_id, i);
+					if (i == 1 || record.eax != 0)
+						function(record);
+				}
+				break;
+			}
+		}
+	}
+}
+
+// Dump all valid function ids and sub-function ids into records, writing at most capacity records.
+// Returns the number of valid records, which is larger than capacity if the buffer is too small.
+static inline unsigned int cpuid_capture(CPUIDDumpDescriptor& descriptor, CPUIDRecord* records, unsigned int capacity)
+{
+	unsigned int count = 0;
+	unsigned int max_function_id = 0, max_extended_function_id = 0;
+	cpuid_enumerate([records, capacity, &count](const CPUIDRecord& record) {
+		if (records && count < capacity)
+			records[count] = record;
+		++count;
+	}, max_function_id, max_extended_function_id);
+	const unsigned long long xcr0 = max_function_id >= 1 ? read_xcr0() : 0;
+	descriptor.size = sizeof(CPUIDDumpDescriptor);
+	descriptor.version = CPUID_DUMP_VERSION;
+	descriptor.record_size = sizeof(CPUIDRecord);
+	descriptor.record_count = count;
+	descriptor.max_function_id = max_function_id;
+	descriptor.max_extended_function_id = max_extended_function_id;
+	descriptor.xcr0_low = static_cast<unsigned int>(xcr0);
+	descriptor.xcr0_high = static_cast<unsigned int>(xcr0 >> 32);
+	return count;
+}
+
+// Find the record of a function id and sub-function id in a dump, nullptr if not present.
+static inline const CPUIDRecord* cpuid_dump_find(const CPUIDRecord* records, unsigned int count, unsigned int function_id, unsigned int subfunction_id = 0)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		if (records[i].function_id == function_id && records[i].subfunction_id == subfunction_id)
+			return &records[i];
+	}
+	return nullptr;
+}
@@ -0,0 +1,50 @@
+//
+// Sources of cpuid data for the decoders (FeatureSnapshot.h, CacheInfo.h, TSC.h), so that decoding is a
+// pure function of the register values, done the same way for the executing processor and for
+// dumps captured elsewhere (see CPUIDDump.h), e.g. collected from many machines to decode centrally.
+//
+// A source has two functions:
+//   void cpuid(int cpu_info[4], unsigned int function_id, unsigned int subfunction_id) const
+//   unsigned long long xcr0(unsigned int function1_ecx) const
+// with the registers EAX, EBX, ECX and EDX returned by cpuid, and the value of XCR0, 0 if the
+// operating system has not enabled XSAVE.
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include "Intrinsics.h"
+#include "OSSupport.h"
+#include "CPUIDDump.h"
+
+// The executing processor.
+struct CPUIDLiveSource {
+	void cpuid(int cpu_info[4], unsigned int function_id, unsigned int subfunction_id = 0) const
+	{
+		__cpuidex(cpu_info, static_cast<int>(function_id), static_cast<int>(subfunction_id));
+	}
+	unsigned long long xcr0(unsigned int function1_ecx) const
+	{
+		return read_xcr0(function1_ecx);
+	}
+};
+
+// A dump of records, as captured by cpuid_capture. Function ids and sub-function ids not in the dump
+// return all zero, which is also what processors return for invalid sub-function ids.
+struct CPUIDDumpSource {
+	const CPUIDRecord* records;
+	unsigned int count;
+	unsigned long long xcr0_value;
+
+	void cpuid(int cpu_info[4], unsigned int function_id, unsigned int subfunction_id = 0) const
+	{
+		const CPUIDRecord* record = cpuid_dump_find(records, count, function_id, subfunction_id);
+		cpu_info[0] = record ? static_cast<int>(record->eax) : 0;
+		cpu_info[1] = record ? static_cast<int>(record->ebx) : 0;
+		cpu_info[2] = record ? static_cast<int>(record->ecx) : 0;
+		cpu_info[3] = record ? static_cast<int>(record->edx) : 0;
+	}
+	unsigned long long xcr0(unsigned int) const
+	{
+		return xcr0_value;
+	}
+};
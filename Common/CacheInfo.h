@@ -0,0 +1,383 @@
+//
+// Decoding of the cache and translation lookaside buffer (TLB) parameters of the executing processor.
+//
+// Intel processors describe each cache level with the deterministic cache parameters of
+// function id 4, and each TLB with the deterministic address translation parameters of function
+// id 0x18. Older Intel processors, without function id 0x18, describe the TLBs with the one-byte
+// descriptors of function id 2 instead. AMD processors with topology extensions describe the
+// caches with function id 0x8000001D, using the same format as Intel function id 4, and older
+// AMD processors with the fixed-format functions 0x80000005 (L1) and 0x80000006 (L2 and L3).
+// The AMD TLBs are described by functions 0x80000005, 0x80000006 and 0x80000019 (1 GB pages).
+//
+// The number of logical processors sharing a cache (shared_by) is the maximum number of
+// addressable IDs reported by cpuid, which can be larger than the number of logical processors
+// actually present, e.g. when hyper-threading is disabled. The actual topology has to be
+// enumerated by running on each logical processor.
+//
+// The decoding is done from a source of cpuid data (see CPUIDSource.h), the executing processor
+// with get_cache_info, or a dump captured elsewhere with decode_cache_info.
+//
+// Header-only, shared by the CPUFeatures application (-cache mode) and the CPUFeaturesLibrary.
+//
+// Example, sizing a data structure to half of the L2 cache:
+//
+//   const CacheInfo cache_info = get_cache_info();
+//   const CacheDescriptor* l2 = find_cache(cache_info, 2);
+//   const size_t block_size = l2 ? l2->size / 2 : 128 * 1024;
+//
+// See also: https://software.intel.com/content/www/us/en/develop/articles/intel-sdm.html (Volume 2A, CPUID)
+// See also: https://www.amd.com/system/files/TechDocs/24594.pdf (Appendix E)
+//
+#pragma once
+#include "Intrinsics.h"
+#include "CPUIDSource.h"
+#include <string.h>
+
+enum CacheType { CacheTypeNull = 0, CacheTypeData = 1, CacheTypeInstruction = 2, CacheTypeUnified = 3 };
+enum TLBType { TLBTypeNull = 0, TLBTypeData = 1, TLBTypeInstruction = 2, TLBTypeUnified = 3, TLBTypeLoad = 4, TLBTypeStore = 5 };
+
+// Page sizes covered by a TLB, as a bit mask in the same format as function id 0x18 EBX
+#define TLB_PAGE_4K 0x1
+#define TLB_PAGE_2M 0x2
+#define TLB_PAGE_4M 0x4
+#define TLB_PAGE_1G 0x8
+
+#define CACHE_INFO_MAX_CACHES 16
+#define CACHE_INFO_MAX_TLBS 32
+
+struct CacheDescriptor {
+	unsigned int level;
+	CacheType type;
+	unsigned int size;      // Total size in bytes
+	unsigned int ways;      // Ways of associativity, equal to number of lines if fully associative
+	unsigned int line_size; // Line size in bytes
+	unsigned int partitions; // Physical line partitions (lines per tag)
+	unsigned int sets;
+	unsigned int shared_by; // Maximum number of logical processors sharing the cache, 0 if unknown
+	bool fully_associative;
+	bool inclusive;         // Inclusive of lower cache levels
+};
+
+struct TLBDescriptor {
+	unsigned int level;
+	TLBType type;
+	unsigned int page_sizes; // Bit mask of TLB_PAGE_*
+	unsigned int entries;
+	unsigned int ways;       // Ways of associativity, 0 if unknown, equal to entries if fully associative
+	unsigned int shared_by;  // Maximum number of logical processors sharing the TLB, 0 if unknown
+	bool fully_associative;
+};
+
+struct CacheInfo {
+	unsigned int cache_count;
+	unsigned int tlb_count;
+	unsigned int prefetch_size; // Prefetch stride in bytes from function id 2, 0 if not reported
+	CacheDescriptor caches[CACHE_INFO_MAX_CACHES];
+	TLBDescriptor tlbs[CACHE_INFO_MAX_TLBS];
+};
+
+static inline void _cache_info_add_cache(CacheInfo& info, unsigned int level, CacheType type, unsigned int size, unsigned int ways, unsigned int line_size, unsigned int partitions, unsigned int sets, unsigned int shared_by, bool fully_associative, bool inclusive)
+{
+	if (info.cache_count >= CACHE_INFO_MAX_CACHES || size == 0)
+		return;
+	CacheDescriptor& cache = info.caches[info.cache_count++];
+	cache.level = level;
+	cache.type = type;
+	cache.size = size;
+	cache.ways = ways;
+	cache.line_size = line_size;
+	cache.partitions = partitions;
+	cache.sets = sets;
+	cache.shared_by = shared_by;
+	cache.fully_associative = fully_associative;
+	cache.inclusive = inclusive;
+}
+
+static inline void _cache_info_add_tlb(CacheInfo& info, unsigned int level, TLBType type, unsigned int page_sizes, unsigned int entries, unsigned int ways, unsigned int shared_by, bool fully_associative)
+{
+	if (info.tlb_count >= CACHE_INFO_MAX_TLBS || entries == 0)
+		return;
+	TLBDescriptor& tlb = info.tlbs[info.tlb_count++];
+	tlb.level = level;
+	tlb.type = type;
+	tlb.page_sizes = page_sizes;
+	tlb.entries = entries;
+	tlb.ways = fully_associative ? entries : ways;
+	tlb.shared_by = shared_by;
+	tlb.fully_associative = fully_associative;
+}
+
+// Deterministic cache parameters, in the format of Intel function id 4 and AMD function id 0x8000001D,
+// enumerated by sub-leaf until one with cache type null.
+template<typename Source>
+static inline void _cache_info_deterministic_caches(const Source& source, CacheInfo& info, int function_id)
+{
+	int cpu_info[4];
+	for (int i = 0; i < CACHE_INFO_MAX_CACHES; ++i) {
+		source.cpuid(cpu_info, function_id, i);
+		const unsigned int eax = cpu_info[0], ebx = cpu_info[1], ecx = cpu_info[2], edx = cpu_info[3];
+		const CacheType type = static_cast<CacheType>(eax & 0x1F);
+		if (type == CacheTypeNull)
+			break;
+		const unsigned int ways = (ebx >> 22) + 1;
+		const unsigned int partitions = ((ebx >> 12) & 0x3FF) + 1;
+		const unsigned int line_size = (ebx & 0xFFF) + 1;
+		const unsigned int sets = ecx + 1;
+		_cache_info_add_cache(info, (eax >> 5) & 0x7, type, ways * partitions * line_size * sets, ways, line_size, partitions, sets,
+			((eax >> 14) & 0xFFF) + 1, (eax & (1 << 9)) != 0, (edx & (1 << 1)) != 0);
+	}
+}
+
+// Deterministic address translation parameters, Intel function id 0x18.
+template<typename Source>
+static inline void _cache_info_deterministic_tlbs(const Source& source, CacheInfo& info)
+{
+	int cpu_info[4];
+	source.cpuid(cpu_info, 0x18, 0);
+	const unsigned int max_subleaf = cpu_info[0];
+	for (unsigned int i = 0; i <= max_subleaf && i < 64; ++i) {
+		if (i > 0)
+			source.cpuid(cpu_info, 0x18, i);
+		const unsigned int ebx = cpu_info[1], ecx = cpu_info[2], edx = cpu_info[3];
+		const TLBType type = static_cast<TLBType>(edx & 0x1F);
+		if (type == TLBTypeNull)
+			continue;
+		const unsigned int ways = ebx >> 16;
+		_cache_info_add_tlb(info, (edx >> 5) & 0x7, type, ebx & 0xF, ways * ecx, ways, ((edx >> 14) & 0xFFF) + 1, (edx & (1 << 8)) != 0);
+	}
+}
+
+// TLB descriptors of Intel function id 2 (only the TLB descriptors: Processors reporting caches
+// with one-byte descriptors only, and not function id 4, are older than the ones supported here).
+struct _TLBDescriptorByte { unsigned char descriptor; unsigned char level; TLBType type; unsigned char page_sizes; unsigned short entries; unsigned char ways; bool fully_associative; };
+static const _TLBDescriptorByte _tlb_descriptor_bytes[] = {
+	{ 0x01, 1, TLBTypeInstruction, TLB_PAGE_4K, 32, 4, false },
+	{ 0x02, 1, TLBTypeInstruction, TLB_PAGE_4M, 2, 0, true },
+	{ 0x03, 1, TLBTypeData, TLB_PAGE_4K, 64, 4, false },
+	{ 0x04, 1, TLBTypeData, TLB_PAGE_4M, 8, 4, false },
+	{ 0x05, 1, TLBTypeData, TLB_PAGE_4M, 32, 4, false },
+	{ 0x0B, 1, TLBTypeInstruction, TLB_PAGE_4M, 4, 4, false },
+	{ 0x4F, 1, TLBTypeInstruction, TLB_PAGE_4K, 32, 0, false },
+	{ 0x50, 1, TLBTypeInstruction, TLB_PAGE_4K | TLB_PAGE_2M | TLB_PAGE_4M, 64, 0, false },
+	{ 0x51, 1, TLBTypeInstruction, TLB_PAGE_4K | TLB_PAGE_2M | TLB_PAGE_4M, 128, 0, false },
+	{ 0x52, 1, TLBTypeInstruction, TLB_PAGE_4K | TLB_PAGE_2M | TLB_PAGE_4M, 256, 0, false },
+	{ 0x55, 1, TLBTypeInstruction, TLB_PAGE_2M | TLB_PAGE_4M, 7, 0, true },
+	{ 0x56, 1, TLBTypeData, TLB_PAGE_4M, 16, 4, false },
+	{ 0x57, 1, TLBTypeData, TLB_PAGE_4K, 16, 4, false },
+	{ 0x59, 1, TLBTypeData, TLB_PAGE_4K, 16, 0, true },
+	{ 0x5A, 1, TLBTypeData, TLB_PAGE_2M | TLB_PAGE_4M, 32, 4, false },
+	{ 0x5B, 1, TLBTypeData, TLB_PAGE_4K | TLB_PAGE_4M, 64, 0, false },
+	{ 0x5C, 1, TLBTypeData, TLB_PAGE_4K | TLB_PAGE_4M, 128, 0, false },
+	{ 0x5D, 1, TLBTypeData, TLB_PAGE_4K | TLB_PAGE_4M, 256, 0, false },
+	{ 0x61, 1, TLBTypeInstruction, TLB_PAGE_4K, 48, 0, true },
+	{ 0x63, 1, TLBTypeData, TLB_PAGE_2M | TLB_PAGE_4M, 32, 4, false },
+	{ 0x63, 1, TLBTypeData, TLB_PAGE_1G, 4, 4, false },
+	{ 0x64, 1, TLBTypeData, TLB_PAGE_4K, 512, 4, false },
+	{ 0x6A, 1, TLBTypeData, TLB_PAGE_4K, 64, 8, false },
+	{ 0x6B, 1, TLBTypeData, TLB_PAGE_4K, 256, 8, false },
+	{ 0x6C, 1, TLBTypeData, TLB_PAGE_2M | TLB_PAGE_4M, 128, 8, false },
+	{ 0x6D, 1, TLBTypeData, TLB_PAGE_1G, 16, 0, true },
+	{ 0x76, 1, TLBTypeInstruction, TLB_PAGE_2M | TLB_PAGE_4M, 8, 0, true },
+	{ 0xA0, 1, TLBTypeData, TLB_PAGE_4K, 32, 0, true },
+	{ 0xB0, 1, TLBTypeInstruction, TLB_PAGE_4K, 128, 4, false },
+	{ 0xB1, 1, TLBTypeInstruction, TLB_PAGE_2M, 8, 4, false },
+	{ 0xB2, 1, TLBTypeInstruction, TLB_PAGE_4K, 64, 4, false },
+	{ 0xB3, 1, TLBTypeData, TLB_PAGE_4K, 128, 4, false },
+	{ 0xB4, 1, TLBTypeData, TLB_PAGE_4K, 256, 4, false },
+	{ 0xB5, 1, TLBTypeInstruction, TLB_PAGE_4K, 64, 8, false },
+	{ 0xB6, 1, TLBTypeInstruction, TLB_PAGE_4K, 128, 8, false },
+	{ 0xBA, 1, TLBTypeData, TLB_PAGE_4K, 64, 4, false },
+	{ 0xC0, 1, TLBTypeData, TLB_PAGE_4K | TLB_PAGE_4M, 8, 4, false },
+	{ 0xC1, 2, TLBTypeUnified, TLB_PAGE_4K | TLB_PAGE_2M, 1024, 8, false },
+	{ 0xC2, 1, TLBTypeData, TLB_PAGE_4K | TLB_PAGE_2M, 16, 4, false },
+	{ 0xC3, 2, TLBTypeUnified, TLB_PAGE_4K | TLB_PAGE_2M, 1536, 6, false },
+	{ 0xC3, 2, TLBTypeUnified, TLB_PAGE_1G, 16, 4, false },
+	{ 0xC4, 1, TLBTypeData, TLB_PAGE_2M | TLB_PAGE_4M, 32, 4, false },
+	{ 0xCA, 2, TLBTypeUnified, TLB_PAGE_4K, 512, 4, false },
+};
+
+static inline void _cache_info_descriptor_byte(CacheInfo& info, unsigned char descriptor)
+{
+	if (descriptor == 0xF0)
+		info.prefetch_size = 64;
+	else if (descriptor == 0xF1)
+		info.prefetch_size = 128;
+	for (const _TLBDescriptorByte& tlb : _tlb_descriptor_bytes) {
+		if (tlb.descriptor == descriptor)
+			_cache_info_add_tlb(info, tlb.level, tlb.type, tlb.page_sizes, tlb.entries, tlb.ways, 0, tlb.fully_associative);
+	}
+}
+
+// Cache and TLB descriptors of Intel function id 2. The low byte of EAX is the number of times
+// the function must be executed, always 1 on current processors, and a register with bit 31 set
+// does not contain valid descriptors.
+template<typename Source>
+static inline void _cache_info_descriptors(const Source& source, CacheInfo& info, bool include_tlbs)
+{
+	int cpu_info[4];
+	source.cpuid(cpu_info, 0x2);
+	for (int r = 0; r < 4; ++r) {
+		const unsigned int value = cpu_info[r];
+		if (value & 0x80000000)
+			continue;
+		for (int b = (r == 0 ? 1 : 0); b < 4; ++b) {
+			const unsigned char descriptor = (value >> (b * 8)) & 0xFF;
+			if (descriptor == 0xF0 || descriptor == 0xF1 || include_tlbs)
+				_cache_info_descriptor_byte(info, descriptor);
+		}
+	}
+}
+
+// Associativity encoding of AMD functions 0x80000006 and 0x80000019
+static inline unsigned int _cache_info_amd_ways(unsigned int encoded)
+{
+	static const unsigned int ways[16] = { 0, 1, 2, 3, 4, 6, 8, 0, 16, 0, 32, 48, 64, 96, 128, 0 };
+	return ways[encoded & 0xF];
+}
+
+// Legacy AMD cache parameters, functions 0x80000005 (L1) and 0x80000006 (L2 and L3).
+template<typename Source>
+static inline void _cache_info_amd_caches(const Source& source, CacheInfo& info, unsigned int max_extended_function_id)
+{
+	int cpu_info[4];
+	if (max_extended_function_id >= 0x80000005) {
+		source.cpuid(cpu_info, 0x80000005);
+		for (int r = 2; r <= 3; ++r) { // ECX is L1 data cache, EDX is L1 instruction cache
+			const unsigned int value = cpu_info[r];
+			const unsigned int size = (value >> 24) * 1024, ways = (value >> 16) & 0xFF, partitions = (value >> 8) & 0xFF, line_size = value & 0xFF;
+			const bool fully_associative = ways == 0xFF;
+			const unsigned int lines = line_size ? size / line_size : 0;
+			_cache_info_add_cache(info, 1, r == 2 ? CacheTypeData : CacheTypeInstruction, size, fully_associative ? lines : ways, line_size,
+				partitions, fully_associative || !ways ? 1 : lines / ways, 0, fully_associative, false);
+		}
+	}
+	if (max_extended_function_id >= 0x80000006) {
+		source.cpuid(cpu_info, 0x80000006);
+		const unsigned int ecx = cpu_info[2], edx = cpu_info[3];
+		const unsigned int l2_size = (ecx >> 16) * 1024, l2_line_size = ecx & 0xFF;
+		const bool l2_fully_associative = ((ecx >> 12) & 0xF) == 0xF;
+		const unsigned int l2_lines = l2_line_size ? l2_size / l2_line_size : 0;
+		const unsigned int l2_ways = l2_fully_associative ? l2_lines : _cache_info_amd_ways(ecx >> 12);
+		_cache_info_add_cache(info, 2, CacheTypeUnified, l2_size, l2_ways, l2_line_size, (ecx >> 8) & 0xF,
+			l2_ways ? l2_lines / l2_ways : 0, 0, l2_fully_associative, false);
+		const unsigned int l3_size = (edx >> 18) * 512 * 1024, l3_line_size = edx & 0xFF;
+		const bool l3_fully_associative = ((edx >> 12) & 0xF) == 0xF;
+		const unsigned int l3_lines = l3_line_size ? l3_size / l3_line_size : 0;
+		const unsigned int l3_ways = l3_fully_associative ? l3_lines : _cache_info_amd_ways(edx >> 12);
+		_cache_info_add_cache(info, 3, CacheTypeUnified, l3_size, l3_ways, l3_line_size, (edx >> 8) & 0xF,
+			l3_ways ? l3_lines / l3_ways : 0, 0, l3_fully_associative, false);
+	}
+}
+
+// AMD TLB parameters, functions 0x80000005 (L1), 0x80000006 (L2) and 0x80000019 (1 GB pages).
+template<typename Source>
+static inline void _cache_info_amd_tlbs(const Source& source, CacheInfo& info, unsigned int max_extended_function_id)
+{
+	int cpu_info[4];
+	if (max_extended_function_id >= 0x80000005) {
+		source.cpuid(cpu_info, 0x80000005);
+		for (int r = 0; r <= 1; ++r) { // EAX is 2 MB and 4 MB pages, EBX is 4 KB pages
+			const unsigned int value = cpu_info[r];
+			const unsigned int page_sizes = r == 0 ? TLB_PAGE_2M | TLB_PAGE_4M : TLB_PAGE_4K;
+			_cache_info_add_tlb(info, 1, TLBTypeData, page_sizes, (value >> 16) & 0xFF, value >> 24, 0, (value >> 24) == 0xFF);
+			_cache_info_add_tlb(info, 1, TLBTypeInstruction, page_sizes, value & 0xFF, (value >> 8) & 0xFF, 0, ((value >> 8) & 0xFF) == 0xFF);
+		}
+	}
+	if (max_extended_function_id >= 0x80000006) {
+		source.cpuid(cpu_info, 0x80000006);
+		for (int r = 0; r <= 1; ++r) { // EAX is 2 MB and 4 MB pages, EBX is 4 KB pages
+			const unsigned int value = cpu_info[r];
+			const unsigned int page_sizes = r == 0 ? TLB_PAGE_2M | TLB_PAGE_4M : TLB_PAGE_4K;
+			_cache_info_add_tlb(info, 2, TLBTypeData, page_sizes, (value >> 16) & 0xFFF, _cache_info_amd_ways(value >> 28), 0, (value >> 28) == 0xF);
+			_cache_info_add_tlb(info, 2, TLBTypeInstruction, page_sizes, value & 0xFFF, _cache_info_amd_ways(value >> 12), 0, ((value >> 12) & 0xF) == 0xF);
+		}
+	}
+	if (max_extended_function_id >= 0x80000019) {
+		source.cpuid(cpu_info, 0x80000019);
+		for (int r = 0; r <= 1; ++r) { // EAX is L1, EBX is L2, same format as 0x80000006
+			const unsigned int value = cpu_info[r];
+			_cache_info_add_tlb(info, r + 1, TLBTypeData, TLB_PAGE_1G, (value >> 16) & 0xFFF, _cache_info_amd_ways(value >> 28), 0, (value >> 28) == 0xF);
+			_cache_info_add_tlb(info, r + 1, TLBTypeInstruction, TLB_PAGE_1G, value & 0xFFF, _cache_info_amd_ways(value >> 12), 0, ((value >> 12) & 0xF) == 0xF);
+		}
+	}
+}
+
+// Decode the cache and TLB parameters from a source of cpuid data (see CPUIDSource.h).
+template<typename Source>
+static inline CacheInfo decode_cache_info(const Source& source)
+{
+	CacheInfo info;
+	memset(&info, 0, sizeof(info));
+	int cpu_info[4];
+	source.cpuid(cpu_info, 0x0);
+	const int max_function_id = cpu_info[0];
+	char vendor[13];
+	memcpy(vendor, &cpu_info[1], 4);
+	memcpy(vendor + 4, &cpu_info[3], 4);
+	memcpy(vendor + 8, &cpu_info[2], 4);
+	vendor[12] = '\0';
+	const bool amd = strcmp(vendor, "AuthenticAMD") == 0 || strcmp(vendor, "HygonGenuine") == 0;
+	source.cpuid(cpu_info, 0x80000000);
+	const unsigned int max_extended_function_id = cpu_info[0];
+	unsigned int extended_function1_ecx = 0;
+	if (max_extended_function_id >= 0x80000001) {
+		source.cpuid(cpu_info, 0x80000001);
+		extended_function1_ecx = cpu_info[2];
+	}
+	if (amd) {
+		if (max_extended_function_id >= 0x8000001D && (extended_function1_ecx & (1 << 22))) // Bit 22 of ECX indicates topology extensions
+			_cache_info_deterministic_caches(source, info, 0x8000001D);
+		else
+			_cache_info_amd_caches(source, info, max_extended_function_id);
+		_cache_info_amd_tlbs(source, info, max_extended_function_id);
+	} else {
+		if (max_function_id >= 4)
+			_cache_info_deterministic_caches(source, info, 0x4);
+		if (max_function_id >= 0x18)
+			_cache_info_deterministic_tlbs(source, info);
+		if (max_function_id >= 2)
+			_cache_info_descriptors(source, info, max_function_id < 0x18);
+	}
+	return info;
+}
+
+// Decode the cache and TLB parameters of the executing processor.
+static inline CacheInfo get_cache_info()
+{
+	return decode_cache_info(CPUIDLiveSource());
+}
+
+// Find the cache at a given level. Data caches also match unified caches, so that e.g.
+// find_cache(info, 2) returns the L2 cache no matter if it is reported as data or unified.
+static inline const CacheDescriptor* find_cache(const CacheInfo& info, unsigned int level, CacheType type = CacheTypeData)
+{
+	for (unsigned int i = 0; i < info.cache_count; ++i) {
+		const CacheDescriptor& cache = info.caches[i];
+		if (cache.level == level && (cache.type == type || (type == CacheTypeData && cache.type == CacheTypeUnified)))
+			return &cache;
+	}
+	return nullptr;
+}
+
+// Find the TLB at a given level covering a given page size (one of TLB_PAGE_*). Data TLBs also
+// match unified and load TLBs.
+static inline const TLBDescriptor* find_tlb(const CacheInfo& info, unsigned int level, unsigned int page_size = TLB_PAGE_4K, TLBType type = TLBTypeData)
+{
+	for (unsigned int i = 0; i < info.tlb_count; ++i) {
+		const TLBDescriptor& tlb = info.tlbs[i];
+		if (tlb.level == level && (tlb.page_sizes & page_size) && (tlb.type == type || (type == TLBTypeData && (tlb.type == TLBTypeUnified || tlb.type == TLBTypeLoad))))
+			return &tlb;
+	}
+	return nullptr;
+}
+
+// The largest cache level present, e.g. 3 for processors with an L3 cache.
+static inline unsigned int last_cache_level(const CacheInfo& info)
+{
+	unsigned int level = 0;
+	for (unsigned int i = 0; i < info.cache_count; ++i) {
+		if (info.caches[i].level > level)
+			level = info.caches[i].level;
+	}
+	return level;
+}
@@ -0,0 +1,148 @@
+//
+// Call counters for the exported functions of the libraries, in instrumented builds, to find
+// callers checking features on hot paths instead of once at initialization, e.g. a plugin calling
+// SupportAVX2() in an inner loop, or worse, executing cpuid each time, which in a virtual machine is
+// a VM exit.
+//
+// Counting is only compiled in when CPUFEATURES_INSTRUMENTED is defined (the CMake option of the
+// same name), otherwise the macros expand to the plain code, and the libraries' functions reading
+// the counters report none. For each exported function the counters are the number of calls, the
+// number of cpuid instructions it executed, and the time stamp counter ticks spent executing them.
+//
+// Each function is registered with its name on its first call, through a local static, so only the
+// functions that have been called are reported. The counters are sharded per thread, each thread
+// counting with relaxed atomic increments in one of CALL_COUNTER_SHARDS cache line aligned shards,
+// so that threads calling the same function concurrently do not contend on the same cache line.
+// Reading sums the shards, and can reset them at the same time.
+//
+// Usage in an exported function:
+//
+//   bool SupportSomething()
+//   {
+//       CALL_COUNTED(call_counters);
+//       int cpu_info[4];
+//       CALL_COUNTED_CPUID(call_counters, cpu_info, 0x7, 0);
+//       ...
+//   }
+//
+// Header-only, shared by the CPUFeaturesLibrary and the cpuid library.
+//
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include "Intrinsics.h"
+#include "OSSupport.h"
+#include "CPUIDSource.h"
+
+#define CALL_COUNTER_SHARDS 16
+#define CALL_COUNTER_MAX_FUNCTIONS 96
+
+// Counters of one function, as read by CallCounters::read.
+struct CallCounter {
+	const char* name;         // Name of the function
+	uint64_t calls;           // Number of calls
+	uint64_t cpuid_count;     // Number of cpuid instructions executed by the calls
+	uint64_t cpuid_ticks;     // Time stamp counter ticks spent executing them
+};
+
+class CallCounters
+{
+public:
+	// Register a function by name, returning its index. Called once for each function, from its local static.
+	unsigned int index(const char* name)
+	{
+		const unsigned int index = count_.fetch_add(1, std::memory_order_relaxed);
+		if (index < CALL_COUNTER_MAX_FUNCTIONS)
+			names_[index].store(name, std::memory_order_release);
+		return index;
+	}
+
+	void count(unsigned int index)
+	{
+		if (index < CALL_COUNTER_MAX_FUNCTIONS)
+			shard().entries[index].calls.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Execute cpuid, counting it and the ticks spent on the function.
+	void cpuid(unsigned int index, int cpu_info[4], unsigned int function_id, unsigned int subfunction_id)
+	{
+		const uint64_t start = __rdtsc();
+		__cpuidex(cpu_info, static_cast<int>(function_id), static_cast<int>(subfunction_id));
+		const uint64_t ticks = __rdtsc() - start;
+		if (index < CALL_COUNTER_MAX_FUNCTIONS) {
+			Entry& entry = shard().entries[index];
+			entry.cpuid_count.fetch_add(1, std::memory_order_relaxed);
+			entry.cpuid_ticks.fetch_add(ticks, std::memory_order_relaxed);
+		}
+	}
+
+	// Sum the shards into counters, at most capacity of them, and zero them when reset is set.
+	// Returns the number of registered functions, which is larger than capacity if it is too small.
+	unsigned int read(CallCounter* counters, unsigned int capacity, bool reset)
+	{
+		unsigned int count = count_.load(std::memory_order_relaxed);
+		if (count > CALL_COUNTER_MAX_FUNCTIONS)
+			count = CALL_COUNTER_MAX_FUNCTIONS;
+		for (unsigned int i = 0; i < count && i < capacity; ++i) {
+			CallCounter& counter = counters[i];
+			counter.name = names_[i].load(std::memory_order_acquire);
+			counter.calls = counter.cpuid_count = counter.cpuid_ticks = 0;
+			for (Shard& shard : shards_) {
+				Entry& entry = shard.entries[i];
+				counter.calls += reset ? entry.calls.exchange(0, std::memory_order_relaxed) : entry.calls.load(std::memory_order_relaxed);
+				counter.cpuid_count += reset ? entry.cpuid_count.exchange(0, std::memory_order_relaxed) : entry.cpuid_count.load(std::memory_order_relaxed);
+				counter.cpuid_ticks += reset ? entry.cpuid_ticks.exchange(0, std::memory_order_relaxed) : entry.cpuid_ticks.load(std::memory_order_relaxed);
+			}
+			if (!counter.name) // Registration racing with the read
+				counter.name = "";
+		}
+		return count;
+	}
+
+private:
+	struct Entry {
+		std::atomic<uint64_t> calls;
+		std::atomic<uint64_t> cpuid_count;
+		std::atomic<uint64_t> cpuid_ticks;
+	};
+	struct alignas(64) Shard {
+		Entry entries[CALL_COUNTER_MAX_FUNCTIONS];
+	};
+
+	// The shard of the calling thread, assigned round robin on the first call in each thread.
+	Shard& shard()
+	{
+		static thread_local unsigned int shard_index = next_shard_.fetch_add(1, std::memory_order_relaxed) % CALL_COUNTER_SHARDS;
+		return shards_[shard_index];
+	}
+
+	Shard shards_[CALL_COUNTER_SHARDS] = {};
+	std::atomic<const char*> names_[CALL_COUNTER_MAX_FUNCTIONS] = {};
+	std::atomic<unsigned int> count_{ 0 };
+	std::atomic<unsigned int> next_shard_{ 0 };
+};
+
+// Source of cpuid data (see CPUIDSource.h) counting the instructions on a function's counters.
+struct CPUIDCountedSource {
+	CallCounters& counters;
+	unsigned int index;
+
+	void cpuid(int cpu_info[4], unsigned int function_id, unsigned int subfunction_id = 0) const
+	{
+		counters.cpuid(index, cpu_info, function_id, subfunction_id);
+	}
+	unsigned long long xcr0(unsigned int function1_ecx) const
+	{
+		return read_xcr0(function1_ecx);
+	}
+};
+
+#ifdef CPUFEATURES_INSTRUMENTED
+#define CALL_COUNTED(counters) static const unsigned int call_counter_index = (counters).index(__func__); (counters).count(call_counter_index)
+#define CALL_COUNTED_CPUID(counters, cpu_info, function_id, subfunction_id) (counters).cpuid(call_counter_index, cpu_info, function_id, subfunction_id)
+#define CALL_COUNTED_SOURCE(counters) CPUIDCountedSource{ counters, call_counter_index }
+#else
+#define CALL_COUNTED(counters) ((void)0)
+#define CALL_COUNTED_CPUID(counters, cpu_info, function_id, subfunction_id) __cpuidex(cpu_info, static_cast<int>(function_id), static_cast<int>(subfunction_id))
+#define CALL_COUNTED_SOURCE(counters) CPUIDLiveSource()
+#endif
@@ -0,0 +1,127 @@
+//
+// Verification that all logical processors report the same features, which everything else assumes:
+// The feature checks execute cpuid on whichever logical processor the thread happens to run on, once,
+// e.g. the cpuid library when it is loaded, and the result is used by threads on any processor. On
+// multi-socket servers with processors of different steppings or microcode, and on hybrid processors,
+// that assumption can fail, and a thread migrating to another processor can fault on an instruction
+// it lacks.
+//
+// The feature snapshot (see FeatureSnapshot.h) is captured on every logical processor the process is
+// allowed to run on, in parallel, with a thread pinned to each of them, across all processor groups on
+// Windows (see Topology.h). The logical processors are grouped into classes of identical snapshot,
+// processor signature (family, model and stepping, function id 1 EAX) and core type. The features
+// usable on all logical processors, the intersection, are the only ones safe to use from threads that
+// are not pinned, and the features usable on only some of them are asymmetric. Logical processors a
+// thread could not be pinned to are not checked, and the features are then not reported as
+// consistent, since they were not verified on every logical processor.
+//
+// Header-only, used by the CPUFeatures application (-consistency mode).
+//
+#pragma once
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include "Intrinsics.h"
+#include "Topology.h"
+#include "FeatureMask.h"
+
+struct ProcessorFeatures {
+	unsigned int group;       // Processor group (Windows), 0 on other operating systems
+	unsigned int number;      // Processor number within the group (Windows), or the CPU number (other operating systems)
+	unsigned int package;     // Package (socket) ID, from the topology
+	CoreType core_type;       // Core type on hybrid processors, CoreTypeUnknown otherwise
+	unsigned int signature;   // Function id 1 EAX: Stepping, model and family
+	FeatureSnapshot features;
+};
+
+// Logical processors with the same features, signature and core type.
+struct ProcessorClass {
+	unsigned int signature;
+	CoreType core_type;
+	FeatureSnapshot features;
+	std::vector<unsigned int> processors; // Indexes into FeatureConsistency::processors
+	std::vector<unsigned int> packages;   // Distinct packages of the processors
+	FeatureMask missing;                  // Asymmetric features this class lacks
+};
+
+struct FeatureConsistency {
+	std::vector<ProcessorFeatures> processors; // In order of processor group and number
+	std::vector<ProcessorClass> classes;
+	FeatureMask intersection; // Usable on all logical processors: Safe for threads that are not pinned
+	FeatureMask asymmetric;   // Usable on some, but not all, logical processors
+	bool mixed_signatures;    // Processors of different family, model or stepping
+	unsigned int unpinned;    // Logical processors a thread could not be pinned to, not checked
+};
+
+static inline bool feature_snapshots_equal(const FeatureSnapshot& a, const FeatureSnapshot& b)
+{
+	for (int i = 0; i < FeatureWordCount; ++i) {
+		if (a.words[i] != b.words[i])
+			return false;
+	}
+	return a.vendor == b.vendor && a.xcr0 == b.xcr0;
+}
+
+// All logical processors report the same usable features, checked on each of them.
+static inline bool features_consistent(const FeatureConsistency& consistency)
+{
+	return feature_mask_count(consistency.asymmetric) == 0 && !consistency.unpinned && !consistency.processors.empty();
+}
+
+static inline FeatureConsistency get_feature_consistency()
+{
+	FeatureConsistency consistency;
+	const Topology topology = get_topology(); // Package and core type of each logical processor
+	std::mutex mutex;
+	consistency.unpinned = for_each_logical_processor_parallel([&consistency, &mutex](unsigned int group, unsigned int number) {
+		ProcessorFeatures processor = {};
+		processor.group = group;
+		processor.number = number;
+		processor.features = get_feature_snapshot();
+		int cpu_info[4];
+		__cpuid(cpu_info, 0x1);
+		processor.signature = static_cast<unsigned int>(cpu_info[0]);
+		std::lock_guard<std::mutex> lock(mutex);
+		consistency.processors.push_back(processor);
+	});
+	std::sort(consistency.processors.begin(), consistency.processors.end(),
+		[](const ProcessorFeatures& a, const ProcessorFeatures& b) { return a.group != b.group ? a.group < b.group : a.number < b.number; });
+
+	std::vector<FeatureMask> masks;
+	for (unsigned int i = 0; i < consistency.processors.size(); ++i) {
+		ProcessorFeatures& processor = consistency.processors[i];
+		for (const LogicalProcessor& logical : topology.processors) {
+			if (logical.group == processor.group && logical.number == processor.number) {
+				processor.package = logical.package;
+				processor.core_type = logical.core_type;
+			}
+		}
+		masks.push_back(feature_mask_from_snapshot(processor.features));
+		auto it = std::find_if(consistency.classes.begin(), consistency.classes.end(), [&processor](const ProcessorClass& c) {
+			return c.signature == processor.signature && c.core_type == processor.core_type && feature_snapshots_equal(c.features, processor.features); });
+		if (it == consistency.classes.end()) {
+			ProcessorClass processor_class = {};
+			processor_class.signature = processor.signature;
+			processor_class.core_type = processor.core_type;
+			processor_class.features = processor.features;
+			consistency.classes.push_back(processor_class);
+			it = consistency.classes.end() - 1;
+		}
+		it->processors.push_back(i);
+		if (std::find(it->packages.begin(), it->packages.end(), processor.package) == it->packages.end())
+			it->packages.push_back(processor.package);
+	}
+	consistency.intersection = feature_masks_intersection(masks.data(), masks.size());
+	FeatureMask any = {}; // Usable on at least one logical processor
+	for (const FeatureMask& mask : masks) {
+		for (int i = 0; i < FEATURE_MASK_WORDS; ++i)
+			any.words[i] |= mask.words[i];
+	}
+	consistency.asymmetric = feature_mask_missing(any, consistency.intersection);
+	consistency.mixed_signatures = false;
+	for (ProcessorClass& processor_class : consistency.classes) {
+		processor_class.missing = feature_mask_missing(any, feature_mask_from_snapshot(processor_class.features));
+		consistency.mixed_signatures = consistency.mixed_signatures || processor_class.signature != consistency.classes[0].signature;
+	}
+	return consistency;
+}
@@ -0,0 +1,61 @@
+//
+// Converting time stamp counter ticks to core clock cycles, for measurements timed with rdtsc.
+//
+// The time stamp counter runs at a constant rate on all relevant processors, independent of the
+// core frequency, so ticks must be scaled by the ratio of core frequency to TSC frequency to get
+// core cycles. The ratio is measured by timing a dependent chain with a known number of core
+// cycles: 64-bit integer multiplications, which have a latency of 3 cycles on all relevant Intel
+// and AMD processors, each combined with a shift and exclusive or (1 cycle) to prevent the compiler
+// from reassociating the chain. The ratio changes with the frequency, so it should be measured
+// immediately before or after the measurement it is used for.
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include <stdint.h>
+#include <chrono>
+#include "Intrinsics.h"
+
+// Number of core cycles per iteration of the probe: 8 dependent steps, each a multiplication
+// with latency 3 cycles followed by an exclusive or with latency 1 cycle (the shift executes
+// in parallel with the multiplication).
+static const int cycle_probe_cycles_per_iteration = 8 * 4;
+
+static inline uint64_t cycle_probe(uint64_t iterations, uint64_t seed)
+{
+	uint64_t x = seed;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		x = (x * seed) ^ (x >> 29); x = (x * seed) ^ (x >> 29);
+		x = (x * seed) ^ (x >> 29); x = (x * seed) ^ (x >> 29);
+		x = (x * seed) ^ (x >> 29); x = (x * seed) ^ (x >> 29);
+		x = (x * seed) ^ (x >> 29); x = (x * seed) ^ (x >> 29);
+	}
+	return x;
+}
+
+// Core cycles per time stamp counter tick, at the current core frequency.
+static inline double core_cycles_per_tick()
+{
+	static volatile uint64_t seed = 0x9E3779B97F4A7C15ull; // Volatile to prevent the compiler from computing the chain at compile time
+	static volatile uint64_t sink;
+	const uint64_t iterations = 20000; // About 0.2 ms at 2.5 GHz, short enough to stay within the current license level
+	const uint64_t start = __rdtsc();
+	sink = cycle_probe(iterations, seed);
+	const uint64_t ticks = __rdtsc() - start;
+	(void)sink; // Read back, the result is only stored to keep the chain from being optimized away
+	return static_cast<double>(iterations) * cycle_probe_cycles_per_iteration / (ticks ? ticks : 1);
+}
+
+// Calibrate the time stamp counter frequency in MHz against the system clock, over about 50 ms.
+static inline double measure_tsc_frequency()
+{
+	const auto clock_start = std::chrono::steady_clock::now();
+	const uint64_t tsc_start = __rdtsc();
+	auto clock_end = clock_start;
+	do {
+		clock_end = std::chrono::steady_clock::now();
+	} while (clock_end - clock_start < std::chrono::milliseconds(50));
+	const uint64_t tsc_end = __rdtsc();
+	const double microseconds = std::chrono::duration<double, std::micro>(clock_end - clock_start).count();
+	return (tsc_end - tsc_start) / microseconds;
+}
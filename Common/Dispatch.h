@@ -0,0 +1,106 @@
+//
+// Runtime dispatch between implementations of a function optimized for different instruction
+// sets, selecting the best variant that the executing processor actually can run.
+//
+// The selection is done once, when the dispatcher is constructed, and subsequent calls
+// are just an indirect call through the selected function pointer, without any feature
+// checks. Declaring the dispatcher at namespace scope resolves it at startup, during
+// dynamic initialization; declaring it as a function-local static resolves it on first
+// call instead (similar to an IFUNC).
+//
+// Each variant is registered with a feature check function, such as the runtime_has_*
+// functions from Runtime.h, in order of preference with the best variant first. A variant
+// without a feature check function is always supported, and the last variant must be such a
+// portable fallback, so that there always is a variant to select. At most max_variants can be
+// registered. Both are checked with assertions; in a build without assertions a dispatcher
+// breaking them selects no function, so calling it faults on a null pointer instead of
+// executing instructions the processor lacks.
+//
+// Example:
+//
+//   #include "Runtime.h"
+//   #include "../Common/Dispatch.h"
+//
+//   static void sum_avx512(const float* data, size_t size, float* result);
+//   static void sum_avx2(const float* data, size_t size, float* result);
+//   static void sum_sse2(const float* data, size_t size, float* result);
+//   static void sum_scalar(const float* data, size_t size, float* result);
+//
+//   static const Dispatcher<void(const float*, size_t, float*)> sum {
+//       { sum_avx512, runtime_has_avx512f, "AVX-512" },
+//       { sum_avx2,   runtime_has_avx2,    "AVX2" },
+//       { sum_sse2,   runtime_has_sse2,    "SSE2" },
+//       { sum_scalar, nullptr,             "Scalar" },
+//   };
+//
+//   sum(data, size, &result); // Calls the best variant supported
+//
+// Similar to the pattern used in libsodium (see e.g. crypto_generichash/blake2b/ref/generichash_blake2b.c,
+// function _crypto_generichash_blake2b_pick_best_implementation), just generalized.
+//
+// Header-only, shared by the CPUFeatures application and the kernels of the CPUFeaturesLibrary (see Kernels.h).
+//
+#pragma once
+#include <stddef.h>
+#include <assert.h>
+#include <initializer_list>
+#include <utility>
+
+template <typename Signature> class Dispatcher;
+
+template <typename R, typename... Args>
+class Dispatcher<R(Args...)>
+{
+public:
+	typedef R (*Function)(Args...);
+	struct Variant {
+		Function function;
+		int (*supported)(void); // Feature check function, nullptr if always supported
+		const char* name; // Optional name, for diagnostics and benchmarking
+	};
+	static const size_t max_variants = 8;
+
+	Dispatcher(std::initializer_list<Variant> variants)
+		: variants_{},
+		count_{ 0 },
+		selected_{ 0 },
+		function_{ nullptr }
+	{
+		assert(variants.size() <= max_variants && "Too many variants registered with the dispatcher");
+		assert(variants.size() > 0 && (variants.end() - 1)->supported == nullptr && "The last variant of the dispatcher must be an unconditional fallback");
+		if (variants.size() > max_variants || variants.size() == 0 || (variants.end() - 1)->supported != nullptr)
+			return; // Invalid, no function selected
+		for (const Variant& variant : variants)
+			variants_[count_++] = variant;
+		resolve();
+	}
+
+	// Select the best supported variant. Called by the constructor, but can be called
+	// again to re-evaluate. Not thread-safe with concurrent calls to the function.
+	void resolve()
+	{
+		size_t i = 0;
+		while (i < count_ && variants_[i].supported && !variants_[i].supported())
+			++i;
+		assert((count_ == 0 || i < count_) && "No variant of the dispatcher is supported");
+		selected_ = i < count_ ? i : 0;
+		function_ = i < count_ ? variants_[i].function : nullptr;
+	}
+
+	R operator()(Args... args) const { return function_(std::forward<Args>(args)...); }
+
+	Function function() const { return function_; } // The selected function
+	size_t selected() const { return selected_; } // Index of the selected variant
+	const char* name() const { return function_ ? variants_[selected_].name : nullptr; } // Name of the selected variant
+
+	// Access to all registered variants, e.g. for benchmarking each of them.
+	size_t size() const { return count_; }
+	const Variant& variant(size_t index) const { return variants_[index]; }
+	bool supported(size_t index) const { return !variants_[index].supported || variants_[index].supported(); }
+
+private:
+	Variant variants_[max_variants];
+	size_t count_;
+	size_t selected_;
+	Function function_;
+};
@@ -0,0 +1,133 @@
+//
+// Process-wide cache of the feature snapshot of the executing processor, for code calling feature
+// queries from many threads, e.g. at startup of thread pools, without executing cpuid on every call.
+//
+// The cached snapshot is plain data of fixed size: The FeatureSnapshot (see FeatureRegistry.h)
+// and the vendor and brand strings as character arrays, so capturing it allocates nothing and it
+// can be copied with memcpy, e.g. into a per-thread copy. It is aligned to, and padded to a multiple
+// of, the cache line size, so that readers never share a cache line with data written by other code.
+//
+// The cache is initialized on first use, without a constructor executing during dynamic initialization
+// of statics, so it is safe to use from any thread, from other static initializers and from DllMain:
+// The storage is zero initialized, and one of the threads calling first claims it with an atomic
+// exchange, captures the snapshot and publishes it with a release store of an atomic pointer. After
+// that a call is a single acquire load. Threads racing with the first call wait for the publication,
+// which only takes the time of executing cpuid, and never blocks on a lock or the loader.
+//
+// Instead of capturing it, a snapshot obtained elsewhere, e.g. read from a feature file (see FeatureFile.h),
+// can be published before first use with publish_cached_feature_snapshot, or obtained on first use by a
+// loader set with set_feature_cache_loader, which is then called in place of the capture by the thread
+// claiming the cache. Setting the loader is a single atomic store, so it can be done from DllMain, while
+// the loader itself may do anything the first caller can, e.g. read a file, and the first call should
+// then not be made from DllMain.
+//
+// The functions are inline, not static inline as the other shared headers, so that there is one cache
+// in each module (executable or library), and not one in each translation unit.
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <string.h>
+#include "Intrinsics.h"
+#include "FeatureSnapshot.h"
+
+#define FEATURE_CACHE_LINE_SIZE 64
+
+struct alignas(FEATURE_CACHE_LINE_SIZE) CachedFeatureSnapshot {
+	FeatureSnapshot features;
+	char vendor[13]; // Vendor string of function id 0, e.g. "GenuineIntel"
+	char brand[49];  // Brand string of function ids 0x80000002-0x80000004, empty if not reported
+};
+static_assert(sizeof(CachedFeatureSnapshot) % FEATURE_CACHE_LINE_SIZE == 0, "The cached snapshot must fill whole cache lines");
+static_assert(std::is_trivially_copyable<CachedFeatureSnapshot>::value && std::is_standard_layout<CachedFeatureSnapshot>::value, "The cached snapshot must be plain data");
+
+// Decode the snapshot and the strings from a source of cpuid data (see CPUIDSource.h).
+template<typename Source>
+static inline void decode_cached_feature_snapshot(const Source& source, CachedFeatureSnapshot& snapshot)
+{
+	int cpu_info[4];
+	snapshot.features = decode_feature_snapshot(source);
+	source.cpuid(cpu_info, 0x0);
+	memcpy(snapshot.vendor, &cpu_info[1], 4);
+	memcpy(snapshot.vendor + 4, &cpu_info[3], 4);
+	memcpy(snapshot.vendor + 8, &cpu_info[2], 4);
+	snapshot.vendor[12] = '\0';
+	snapshot.brand[0] = '\0';
+	source.cpuid(cpu_info, 0x80000000);
+	if (static_cast<unsigned int>(cpu_info[0]) >= 0x80000004) {
+		for (int i = 0; i < 3; ++i) {
+			source.cpuid(cpu_info, 0x80000002 + i);
+			memcpy(snapshot.brand + i * 16, cpu_info, 16);
+		}
+		snapshot.brand[48] = '\0';
+	}
+}
+
+static inline void capture_cached_feature_snapshot(CachedFeatureSnapshot& snapshot)
+{
+	decode_cached_feature_snapshot(CPUIDLiveSource(), snapshot);
+}
+
+// Fills the snapshot on first use instead of capturing it, returns false to have it captured instead.
+typedef bool (*FeatureCacheLoader)(CachedFeatureSnapshot& snapshot);
+
+// State of the cache, in its own cache line: Constant initialized, so it is valid before any constructor executes.
+struct alignas(FEATURE_CACHE_LINE_SIZE) FeatureCacheState {
+	std::atomic<const CachedFeatureSnapshot*> published;
+	std::atomic<bool> claimed;
+	std::atomic<FeatureCacheLoader> loader; // Null to capture
+};
+
+inline FeatureCacheState& _feature_cache_state()
+{
+	static FeatureCacheState state; // Zero initialized (static storage, trivial constructors of the atomics)
+	return state;
+}
+
+inline CachedFeatureSnapshot& _feature_cache_storage()
+{
+	static CachedFeatureSnapshot storage; // Zero initialized
+	return storage;
+}
+
+// The cached snapshot, captured or loaded on the first call in the module.
+inline const CachedFeatureSnapshot& cached_feature_snapshot()
+{
+	FeatureCacheState& state = _feature_cache_state();
+	const CachedFeatureSnapshot* snapshot = state.published.load(std::memory_order_acquire);
+	if (snapshot)
+		return *snapshot;
+	if (!state.claimed.exchange(true, std::memory_order_acq_rel)) {
+		CachedFeatureSnapshot& storage = _feature_cache_storage();
+		const FeatureCacheLoader loader = state.loader.load(std::memory_order_acquire);
+		if (!loader || !loader(storage))
+			capture_cached_feature_snapshot(storage);
+		state.published.store(&storage, std::memory_order_release);
+		return storage;
+	}
+	while (!(snapshot = state.published.load(std::memory_order_acquire)))
+		std::this_thread::yield();
+	return *snapshot;
+}
+
+// Set the loader called on first use, see above. Has no effect once the cache was claimed.
+inline void set_feature_cache_loader(FeatureCacheLoader loader)
+{
+	_feature_cache_state().loader.store(loader, std::memory_order_release);
+}
+
+// Publish a snapshot obtained elsewhere instead of capturing it on first use. Returns false, keeping the
+// existing snapshot, if the cache was already claimed by another call.
+inline bool publish_cached_feature_snapshot(const CachedFeatureSnapshot& snapshot)
+{
+	FeatureCacheState& state = _feature_cache_state();
+	if (state.claimed.exchange(true, std::memory_order_acq_rel))
+		return false;
+	CachedFeatureSnapshot& storage = _feature_cache_storage();
+	memcpy(&storage, &snapshot, sizeof(storage));
+	state.published.store(&storage, std::memory_order_release);
+	return true;
+}
@@ -0,0 +1,401 @@
+//
+// Feature file: A snapshot of the features of the processor, persisted to a small binary file that
+// can be memory mapped, for short-lived processes that would otherwise spend their startup executing
+// cpuid, each one a VM exit when running in a virtual machine.
+//
+// The file has a fixed layout, the FeatureFile struct: A header identifying the processor and the
+// boot it was written in, followed by the cached snapshot (FeatureCache.h), the mask of usable
+// features (FeatureMask.h), the decoded cache parameters (CacheInfo.h) and the raw registers of all
+// function ids (CPUIDDump.h). All of it is plain data, written once per boot, e.g. by a startup
+// task running "CPUFeatures -dump", and read by mapping the file and validating the header:
+// - Magic, version, size and checksum: Written by this layout, and not truncated or corrupted.
+// - Registry hash: Written by a build with the same feature registry (see feature_mask_registry_hash).
+// - Boot id: Written during the current boot, since a new boot may have a new processor, microcode
+//   or operating system configuration (XCR0). On Linux it is /proc/sys/kernel/random/boot_id, on
+//   Windows the boot counter BootId in the registry.
+// - Processor signature: Family, model and stepping (function id 1, EAX) of the executing processor.
+// - Microcode revision: Microcode updates loaded at runtime may disable features, e.g. TSX. On Linux
+//   it is read from sysfs, on Windows from the "Update Revision" of the processor in the registry.
+// - Feature flags: The feature flag registers of function ids 1 and 7 and XCR0 in the snapshot are
+//   those of the executing processor, so that a file can not make features usable that are not.
+//   These and function id 0 are the only cpuid executed when loading.
+//
+// The checksum only detects accidental corruption, it does not prove who wrote the file, so a file
+// whose contents are used in place of cpuid must also be trusted (see map_feature_file): Owned by root
+// and not writable by group or others on Linux, and owned by SYSTEM or the Administrators and only
+// writable by them on Windows, where standard users can create files in %ProgramData%.
+//
+// The default location is /run/cpufeatures.bin on Linux, which is cleared on boot, and
+// %ProgramData%\CPUFeatures.bin on Windows, and can be overridden with environment variable
+// CPUFEATURES_FILE, except in processes with privileges a file could be used against (see
+// feature_file_privileged).
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <type_traits>
+#include "Intrinsics.h"
+#include "FeatureCache.h"
+#include "FeatureMask.h"
+#include "CacheInfo.h"
+#include "CPUIDDump.h"
+#ifdef _WIN32
+#ifndef STRICT
+#define STRICT // Enable STRICT Type Checking in Windows headers
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN // To speed the build process exclude rarely-used services from Windows headers
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX // Exclude min/max macros from Windows header
+#endif
+#include <Windows.h>
+#include <AclAPI.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#endif
+#endif
+
+#define FEATURE_FILE_VERSION 1
+#define FEATURE_FILE_MAX_RECORDS 512
+#define FEATURE_FILE_BOOT_ID_SIZE 40
+
+static const char feature_file_magic[8] = { 'C', 'P', 'U', 'F', 'E', 'A', 'T', '\0' };
+
+struct FeatureFileHeader {
+	char magic[8];                // feature_file_magic
+	uint32_t version;             // FEATURE_FILE_VERSION
+	uint32_t size;                // Size of the file, sizeof(FeatureFile)
+	uint32_t checksum;            // FNV-1a hash of the file, with this field zero
+	uint32_t registry_hash;       // feature_mask_registry_hash of the writer
+	uint32_t signature;           // Function id 1 EAX: Stepping, model and family
+	uint32_t microcode;           // Microcode revision, 0 if not known
+	char boot_id[FEATURE_FILE_BOOT_ID_SIZE]; // Identifier of the boot the file was written in, empty if not known
+	uint64_t created;             // Time written, seconds since 1970
+};
+
+struct FeatureFile {
+	FeatureFileHeader header;
+	CachedFeatureSnapshot snapshot;
+	FeatureMask usable;           // Usable features of the snapshot
+	CacheInfo cache_info;
+	CPUIDDumpDescriptor dump;     // Number of records in dump.record_count, at most FEATURE_FILE_MAX_RECORDS
+	CPUIDRecord records[FEATURE_FILE_MAX_RECORDS];
+};
+static_assert(std::is_trivially_copyable<FeatureFile>::value, "The feature file must be plain data");
+
+enum FeatureFileStatus {
+	FeatureFileValid, FeatureFileMissing, FeatureFileCorrupt, FeatureFileOtherRegistry, FeatureFileOtherBoot, FeatureFileOtherProcessor,
+	FeatureFileStatusCount
+};
+
+static const char* const feature_file_status_names[FeatureFileStatusCount] = {
+	"valid", "missing", "corrupt", "other registry", "other boot", "other processor"
+};
+
+// Whether the process has privileges a crafted feature file could be used against, so that the file is
+// only read from the default location: Elevated, or a service (session 0), on Windows, and root, or
+// setuid, setgid or with file capabilities (AT_SECURE, issetugid) elsewhere.
+static inline bool feature_file_privileged()
+{
+#ifdef _WIN32
+	bool privileged = true;
+	HANDLE token = nullptr;
+	if (OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) {
+		TOKEN_ELEVATION elevation = {};
+		DWORD size = 0;
+		privileged = !GetTokenInformation(token, TokenElevation, &elevation, sizeof(elevation), &size) || elevation.TokenIsElevated;
+		CloseHandle(token);
+	}
+	DWORD session = 0;
+	return privileged || !ProcessIdToSessionId(GetCurrentProcessId(), &session) || session == 0;
+#elif defined(__linux__)
+	return geteuid() == 0 || getauxval(AT_SECURE) != 0;
+#else
+	return geteuid() == 0 || issetugid() != 0;
+#endif
+}
+
+static inline std::string default_feature_file_path()
+{
+	const bool privileged = feature_file_privileged();
+#ifdef _WIN32
+	const auto environment = [](const char* name) {
+		char* variable = nullptr;
+		size_t length = 0;
+		std::string value;
+		if (_dupenv_s(&variable, &length, name) == 0 && variable)
+			value = variable;
+		free(variable);
+		return value;
+	};
+	const std::string path = privileged ? std::string() : environment("CPUFEATURES_FILE");
+	if (!path.empty())
+		return path;
+	const std::string program_data = environment("ProgramData");
+	return (program_data.empty() ? std::string("C:\\ProgramData") : program_data) + "\\CPUFeatures.bin";
+#else
+	const char* variable = privileged ? nullptr : getenv("CPUFEATURES_FILE");
+	return variable && *variable ? variable : "/run/cpufeatures.bin";
+#endif
+}
+
+// Identifier of the current boot, written into boot_id (empty if not known).
+static inline void feature_file_boot_id(char (&boot_id)[FEATURE_FILE_BOOT_ID_SIZE])
+{
+	memset(boot_id, 0, sizeof(boot_id));
+#ifdef _WIN32
+	DWORD value = 0, size = sizeof(value);
+	if (RegGetValueA(HKEY_LOCAL_MACHINE, "SYSTEM\\CurrentControlSet\\Control\\Session Manager\\Memory Management\\PrefetchParameters", "BootId",
+		RRF_RT_REG_DWORD, nullptr, &value, &size) == ERROR_SUCCESS)
+		snprintf(boot_id, sizeof(boot_id), "%lu", static_cast<unsigned long>(value));
+#elif defined(__linux__)
+	if (FILE* file = fopen("/proc/sys/kernel/random/boot_id", "r")) {
+		if (fgets(boot_id, sizeof(boot_id), file))
+			boot_id[strcspn(boot_id, "\r\n")] = '\0';
+		fclose(file);
+	}
+#endif
+}
+
+// Microcode revision of the executing processor, 0 if not known.
+static inline uint32_t feature_file_microcode()
+{
+	uint32_t microcode = 0;
+#ifdef _WIN32
+	unsigned char value[8] = {};
+	DWORD size = sizeof(value);
+	if (RegGetValueA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", "Update Revision",
+		RRF_RT_REG_BINARY, nullptr, value, &size) == ERROR_SUCCESS)
+		memcpy(&microcode, value + 4, 4); // The revision is in the high 32 bits
+#elif defined(__linux__)
+	if (FILE* file = fopen("/sys/devices/system/cpu/cpu0/microcode/version", "r")) {
+		unsigned int value = 0;
+		if (fscanf(file, "%x", &value) == 1)
+			microcode = value;
+		fclose(file);
+	}
+#endif
+	return microcode;
+}
+
+static inline uint32_t feature_file_checksum(const FeatureFile& file)
+{
+	FeatureFileHeader header = file.header;
+	header.checksum = 0;
+	uint32_t hash = 2166136261u;
+	const auto update = [&hash](const void* data, size_t size) {
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ static_cast<const unsigned char*>(data)[i]) * 16777619u;
+	};
+	update(&header, sizeof(header));
+	update(reinterpret_cast<const char*>(&file) + sizeof(header), sizeof(file) - sizeof(header));
+	return hash;
+}
+
+// Capture the features of the executing processor into file. Executes cpuid for all function ids.
+static inline void capture_feature_file(FeatureFile& file)
+{
+	memset(&file, 0, sizeof(file)); // Including padding, so the checksum is well defined
+	memcpy(file.header.magic, feature_file_magic, sizeof(feature_file_magic));
+	file.header.version = FEATURE_FILE_VERSION;
+	file.header.size = sizeof(FeatureFile);
+	file.header.registry_hash = feature_mask_registry_hash();
+	int cpu_info[4];
+	__cpuid(cpu_info, 0x1);
+	file.header.signature = static_cast<uint32_t>(cpu_info[0]);
+	file.header.microcode = feature_file_microcode();
+	feature_file_boot_id(file.header.boot_id);
+	file.header.created = static_cast<uint64_t>(time(nullptr));
+	capture_cached_feature_snapshot(file.snapshot);
+	file.usable = feature_mask_from_snapshot(file.snapshot.features);
+	file.cache_info = get_cache_info();
+	cpuid_capture(file.dump, file.records, FEATURE_FILE_MAX_RECORDS);
+	if (file.dump.record_count > FEATURE_FILE_MAX_RECORDS)
+		file.dump.record_count = FEATURE_FILE_MAX_RECORDS;
+	file.header.checksum = feature_file_checksum(file);
+}
+
+// Check that file is complete and not corrupted, without checking that it is for the executing processor, e.g. for decoding offline.
+static inline bool feature_file_intact(const FeatureFile& file)
+{
+	return memcmp(file.header.magic, feature_file_magic, sizeof(feature_file_magic)) == 0 && file.header.version == FEATURE_FILE_VERSION
+		&& file.header.size == sizeof(FeatureFile) && file.dump.record_count <= FEATURE_FILE_MAX_RECORDS && file.header.checksum == feature_file_checksum(file);
+}
+
+// The feature flag registers of function ids 1 and 7 and XCR0 of the snapshot are those of the executing
+// processor, given the registers of function id 1. Function ids above the maximum must be all zero.
+template<typename Source>
+static inline bool _feature_file_flags_match(const FeatureFile& file, const int function1[4], const Source& source)
+{
+	int cpu_info[4];
+	source.cpuid(cpu_info, 0x0);
+	const unsigned int max_function_id = static_cast<unsigned int>(cpu_info[0]);
+	unsigned int function_id = ~0u, subfunction_id = ~0u;
+	for (int i = 0; i < FeatureWordCount; ++i) {
+		const FeatureWordInfo& word = feature_words[i];
+		if (word.function_id != 0x1 && word.function_id != 0x7)
+			continue;
+		if (word.function_id > max_function_id) {
+			memset(cpu_info, 0, sizeof(cpu_info));
+		} else if (word.function_id == 0x1) {
+			memcpy(cpu_info, function1, sizeof(cpu_info));
+		} else if (word.function_id != function_id || word.subfunction_id != subfunction_id) {
+			source.cpuid(cpu_info, word.function_id, word.subfunction_id);
+		}
+		function_id = word.function_id;
+		subfunction_id = word.subfunction_id;
+		if (static_cast<uint32_t>(cpu_info[word.register_name]) != file.snapshot.features.words[i])
+			return false;
+	}
+	return file.snapshot.features.xcr0 == source.xcr0(static_cast<unsigned int>(function1[2]));
+}
+
+// Check that file was written for the executing processor during the current boot. Executes cpuid for
+// function ids 0, 1 and 7, through source, e.g. to count them (see CallCounters.h). Whether the file can
+// be trusted is up to the caller, see map_feature_file.
+template<typename Source = CPUIDLiveSource>
+static inline FeatureFileStatus validate_feature_file(const FeatureFile& file, const Source& source = Source())
+{
+	if (!feature_file_intact(file))
+		return FeatureFileCorrupt;
+	if (file.header.registry_hash != feature_mask_registry_hash())
+		return FeatureFileOtherRegistry;
+	char boot_id[FEATURE_FILE_BOOT_ID_SIZE];
+	feature_file_boot_id(boot_id);
+	if (!boot_id[0] || memcmp(boot_id, file.header.boot_id, sizeof(boot_id)) != 0)
+		return FeatureFileOtherBoot; // Never trusted without a boot id, since it could be from an earlier boot
+	int cpu_info[4];
+	source.cpuid(cpu_info, 0x1);
+	if (static_cast<uint32_t>(cpu_info[0]) != file.header.signature || feature_file_microcode() != file.header.microcode)
+		return FeatureFileOtherProcessor;
+	if (!_feature_file_flags_match(file, cpu_info, source))
+		return FeatureFileOtherProcessor;
+	return FeatureFileValid;
+}
+
+// Write file to path, replacing any existing file. Returns false on failure.
+static inline bool write_feature_file(const char* path, const FeatureFile& file)
+{
+	const std::string temporary = std::string(path) + ".tmp";
+	FILE* stream = fopen(temporary.c_str(), "wb");
+	if (!stream)
+		return false;
+	const bool written = fwrite(&file, sizeof(file), 1, stream) == 1;
+	if (fclose(stream) != 0 || !written) {
+		remove(temporary.c_str());
+		return false;
+	}
+#ifndef _WIN32
+	chmod(temporary.c_str(), 0644); // Not writable by group or others whatever the umask, as required to be trusted
+#endif
+	// Replace atomically, so that a process mapping the file concurrently never sees it partially written
+#ifdef _WIN32
+	if (!MoveFileExA(temporary.c_str(), path, MOVEFILE_REPLACE_EXISTING)) {
+#else
+	if (rename(temporary.c_str(), path) != 0) {
+#endif
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+#ifdef _WIN32
+static inline bool _feature_file_trusted_sid(PSID sid)
+{
+	return IsWellKnownSid(sid, WinLocalSystemSid) || IsWellKnownSid(sid, WinBuiltinAdministratorsSid);
+}
+
+// The file is owned by SYSTEM or the Administrators, and its DACL grants no one else write access.
+static inline bool _feature_file_trusted(HANDLE handle)
+{
+	PSID owner = nullptr;
+	PACL dacl = nullptr;
+	PSECURITY_DESCRIPTOR descriptor = nullptr;
+	if (GetSecurityInfo(handle, SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION, &owner, nullptr, &dacl, nullptr, &descriptor) != ERROR_SUCCESS)
+		return false;
+	const DWORD write_access = FILE_WRITE_DATA | FILE_APPEND_DATA | WRITE_DAC | WRITE_OWNER | GENERIC_WRITE | GENERIC_ALL;
+	bool trusted = owner && dacl && _feature_file_trusted_sid(owner); // A null DACL grants everyone full access
+	for (DWORD i = 0; trusted && i < dacl->AceCount; ++i) {
+		void* ace = nullptr;
+		if (!GetAce(dacl, i, &ace)) {
+			trusted = false;
+			break;
+		}
+		const ACE_HEADER* header = static_cast<const ACE_HEADER*>(ace);
+		if (header->AceType == ACCESS_DENIED_ACE_TYPE || (header->AceFlags & INHERIT_ONLY_ACE))
+			continue;
+		if (header->AceType != ACCESS_ALLOWED_ACE_TYPE) { // Conditional and object ACEs are not expected on the file
+			trusted = false;
+			break;
+		}
+		const ACCESS_ALLOWED_ACE* allowed = static_cast<const ACCESS_ALLOWED_ACE*>(ace);
+		if ((allowed->Mask & write_access) && !_feature_file_trusted_sid(const_cast<DWORD*>(&allowed->SidStart)))
+			trusted = false;
+	}
+	LocalFree(descriptor);
+	return trusted;
+}
+#endif
+
+// Map the file at path read-only, nullptr if it does not exist or has the wrong size. Not validated. If
+// trusted is not null, it is set to whether the file can only have been written by the system (see above),
+// checked on the file opened, so it can not be replaced in between.
+static inline const FeatureFile* map_feature_file(const char* path, bool* trusted = nullptr)
+{
+	const FeatureFile* file = nullptr;
+	if (trusted)
+		*trusted = false;
+#ifdef _WIN32
+	const HANDLE handle = CreateFileA(path, GENERIC_READ | READ_CONTROL, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return nullptr;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(handle, &size) && size.QuadPart == static_cast<LONGLONG>(sizeof(FeatureFile))) {
+		if (trusted)
+			*trusted = _feature_file_trusted(handle);
+		if (const HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+			file = static_cast<const FeatureFile*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(FeatureFile)));
+			CloseHandle(mapping); // The view keeps the mapping open
+		}
+	}
+	CloseHandle(handle);
+#else
+	const int descriptor = open(path, O_RDONLY);
+	if (descriptor < 0)
+		return nullptr;
+	struct stat status;
+	if (fstat(descriptor, &status) == 0 && status.st_size == static_cast<off_t>(sizeof(FeatureFile))) {
+		if (trusted)
+			*trusted = S_ISREG(status.st_mode) && status.st_uid == 0 && !(status.st_mode & (S_IWGRP | S_IWOTH));
+		void* view = mmap(nullptr, sizeof(FeatureFile), PROT_READ, MAP_SHARED, descriptor, 0);
+		if (view != MAP_FAILED)
+			file = static_cast<const FeatureFile*>(view);
+	}
+	close(descriptor);
+#endif
+	return file;
+}
+
+static inline void unmap_feature_file(const FeatureFile* file)
+{
+	if (!file)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(file);
+#else
+	munmap(const_cast<FeatureFile*>(file), sizeof(FeatureFile));
+#endif
+}
@@ -0,0 +1,305 @@
+//
+// Fixed-width feature mask, with one bit for each feature in the registry (see FeatureRegistry.h),
+// for comparing the features required by a binary with the features of many hosts, e.g. when
+// placing jobs in a cluster: Is the required mask a subset of the host mask, which features are
+// missing, and which features do all hosts have in common (the lowest common denominator).
+//
+// Bit i of the mask is feature i in the Feature enumeration, in words of 64 bits. Since the
+// enumeration follows the order of the registry, which changes when features are added, the
+// serialized form starts with a hash of the registry's feature names, and masks can only be
+// deserialized by a build with the same registry. The serialized form is text, the hash and the
+// words as hexadecimal numbers, most significant first: "hhhhhhhh:wwww...wwww".
+//
+// The bulk operations on arrays of masks are vectorized, using AVX2 when usable on the executing
+// processor, which tests a whole mask with a single instruction, else SSE2, and plain 64-bit
+// operations on other architectures. The variant is selected on first use by a Dispatcher (see
+// Dispatch.h), as for the kernels (see Kernels.h).
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Intrinsics.h"
+#include "FeatureRegistry.h"
+#include "FeatureCache.h"
+#include "Dispatch.h"
+
+#define FEATURE_MASK_WORDS 4
+#define FEATURE_MASK_TEXT_LENGTH (8 + 1 + FEATURE_MASK_WORDS * 16) // Length of the serialized form, without terminating null
+
+static_assert(FeatureCount <= FEATURE_MASK_WORDS * 64, "The feature mask must have a bit for each feature in the registry");
+
+struct FeatureMask {
+	uint64_t words[FEATURE_MASK_WORDS];
+};
+
+static inline void feature_mask_set(FeatureMask& mask, Feature feature)
+{
+	mask.words[feature / 64] |= 1ull << (feature % 64);
+}
+
+static inline bool feature_mask_test(const FeatureMask& mask, Feature feature)
+{
+	return ((mask.words[feature / 64] >> (feature % 64)) & 1) != 0;
+}
+
+static inline unsigned int feature_mask_count(const FeatureMask& mask)
+{
+	unsigned int count = 0;
+	for (uint64_t word : mask.words) {
+		for (; word; word &= word - 1)
+			++count;
+	}
+	return count;
+}
+
+// Mask of the usable features of a snapshot, or with usable false the features supported by the processor.
+static inline FeatureMask feature_mask_from_snapshot(const FeatureSnapshot& snapshot, bool usable = true)
+{
+	FeatureMask mask = {};
+	for (int i = 0; i < FeatureCount; ++i) {
+		const Feature feature = static_cast<Feature>(i);
+		if (usable ? feature_usable(snapshot, feature) : feature_hardware(snapshot, feature))
+			feature_mask_set(mask, feature);
+	}
+	return mask;
+}
+
+// Mask of feature names separated by commas or spaces, e.g. "AVX2,FMA,BMI2". Returns false
+// if any of the names is not in the registry, with the known names set in the mask.
+static inline bool feature_mask_from_names(const char* names, FeatureMask& mask)
+{
+	mask = {};
+	bool known = true;
+	char name[32];
+	while (*names) {
+		const size_t length = strcspn(names, ", ");
+		if (length > 0) {
+			Feature feature = FeatureCount;
+			if (length < sizeof(name)) {
+				memcpy(name, names, length);
+				name[length] = '\0';
+				feature = find_feature(name);
+			}
+			if (feature == FeatureCount)
+				known = false;
+			else
+				feature_mask_set(mask, feature);
+		}
+		names += length;
+		if (*names)
+			++names;
+	}
+	return known;
+}
+
+// FNV-1a hash of the feature names in registry order, identifying the bit layout of the mask.
+static inline uint32_t feature_mask_registry_hash()
+{
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < FeatureCount; ++i) {
+		for (const char* c = feature_table[i].name; ; ++c) {
+			hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+			if (!*c)
+				break;
+		}
+	}
+	return hash;
+}
+
+// Write the serialized form into text, which must have room for FEATURE_MASK_TEXT_LENGTH characters and a terminating null.
+static inline void feature_mask_serialize(const FeatureMask& mask, char* text)
+{
+	static const char digits[] = "0123456789abcdef";
+	const uint32_t hash = feature_mask_registry_hash();
+	for (int i = 0; i < 8; ++i)
+		*text++ = digits[(hash >> (28 - 4 * i)) & 0xF];
+	*text++ = ':';
+	for (int word = FEATURE_MASK_WORDS - 1; word >= 0; --word) {
+		for (int i = 0; i < 16; ++i)
+			*text++ = digits[(mask.words[word] >> (60 - 4 * i)) & 0xF];
+	}
+	*text = '\0';
+}
+
+// Parse the serialized form. Returns false if it is malformed, or from a build with a different registry.
+static inline bool feature_mask_deserialize(const char* text, FeatureMask& mask)
+{
+	if (strlen(text) != FEATURE_MASK_TEXT_LENGTH || text[8] != ':')
+		return false;
+	uint64_t values[1 + FEATURE_MASK_WORDS] = {};
+	for (int i = 0, position = 0; i < FEATURE_MASK_TEXT_LENGTH; ++i) {
+		if (i == 8)
+			continue;
+		const char c = text[i];
+		const unsigned int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+		if (digit > 15)
+			return false;
+		const int value = position < 8 ? 0 : 1 + (position - 8) / 16;
+		values[value] = values[value] << 4 | digit;
+		++position;
+	}
+	if (values[0] != feature_mask_registry_hash())
+		return false;
+	for (int word = 0; word < FEATURE_MASK_WORDS; ++word)
+		mask.words[word] = values[FEATURE_MASK_WORDS - word];
+	return true;
+}
+
+// All features of required are in host.
+static inline bool feature_mask_subset(const FeatureMask& required, const FeatureMask& host)
+{
+	uint64_t missing = 0;
+	for (int word = 0; word < FEATURE_MASK_WORDS; ++word)
+		missing |= required.words[word] & ~host.words[word];
+	return missing == 0;
+}
+
+// The features of required that are not in host.
+static inline FeatureMask feature_mask_missing(const FeatureMask& required, const FeatureMask& host)
+{
+	FeatureMask missing;
+	for (int word = 0; word < FEATURE_MASK_WORDS; ++word)
+		missing.words[word] = required.words[word] & ~host.words[word];
+	return missing;
+}
+
+// The vectorized loops of the bulk operations, for each instruction set.
+
+static inline size_t _feature_masks_compatible_scalar(const FeatureMask& required, const FeatureMask* hosts, size_t count, unsigned char* compatible)
+{
+	size_t matches = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const bool match = feature_mask_subset(required, hosts[i]);
+		if (compatible)
+			compatible[i] = match;
+		matches += match;
+	}
+	return matches;
+}
+static inline FeatureMask _feature_masks_intersection_scalar(const FeatureMask* masks, size_t count)
+{
+	FeatureMask result = masks[0];
+	for (size_t i = 1; i < count; ++i) {
+		for (int word = 0; word < FEATURE_MASK_WORDS; ++word)
+			result.words[word] &= masks[i].words[word];
+	}
+	return result;
+}
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+static_assert(sizeof(FeatureMask) == 32, "The vectorized operations process a mask as one 256-bit or two 128-bit vectors");
+
+CPUFEATURES_TARGET("sse2") static inline size_t _feature_masks_compatible_sse2(const FeatureMask& required, const FeatureMask* hosts, size_t count, unsigned char* compatible)
+{
+	const __m128i required_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(required.words));
+	const __m128i required_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(required.words + 2));
+	size_t matches = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const __m128i low = _mm_andnot_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hosts[i].words)), required_low);
+		const __m128i high = _mm_andnot_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hosts[i].words + 2)), required_high);
+		const bool match = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(low, high), _mm_setzero_si128())) == 0xFFFF;
+		if (compatible)
+			compatible[i] = match;
+		matches += match;
+	}
+	return matches;
+}
+CPUFEATURES_TARGET("sse2") static inline FeatureMask _feature_masks_intersection_sse2(const FeatureMask* masks, size_t count)
+{
+	__m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[0].words));
+	__m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[0].words + 2));
+	for (size_t i = 1; i < count; ++i) {
+		low = _mm_and_si128(low, _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[i].words)));
+		high = _mm_and_si128(high, _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[i].words + 2)));
+	}
+	FeatureMask result;
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(result.words), low);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(result.words + 2), high);
+	return result;
+}
+
+// vptest sets the carry flag when all bits of required are set in the host mask, a subset test of the whole mask in one instruction.
+CPUFEATURES_TARGET("avx2") static inline size_t _feature_masks_compatible_avx2(const FeatureMask& required, const FeatureMask* hosts, size_t count, unsigned char* compatible)
+{
+	const __m256i required_mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(required.words));
+	size_t matches = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const bool match = _mm256_testc_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hosts[i].words)), required_mask) != 0;
+		if (compatible)
+			compatible[i] = match;
+		matches += match;
+	}
+	_mm256_zeroupper();
+	return matches;
+}
+CPUFEATURES_TARGET("avx2") static inline FeatureMask _feature_masks_intersection_avx2(const FeatureMask* masks, size_t count)
+{
+	__m256i result_mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks[0].words));
+	for (size_t i = 1; i < count; ++i)
+		result_mask = _mm256_and_si256(result_mask, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks[i].words)));
+	FeatureMask result;
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(result.words), result_mask);
+	_mm256_zeroupper();
+	return result;
+}
+#define FEATURE_MASK_VECTORIZED
+#endif
+
+// Feature checks of the variants, from the cached snapshot, and the dispatchers selecting the best
+// variant on first use (see Dispatch.h).
+
+static inline int _feature_mask_usable(Feature feature) { return feature_usable(cached_feature_snapshot().features, feature) ? 1 : 0; }
+static inline int _feature_mask_has_sse2(void) { return _feature_mask_usable(Feature_SSE2); }
+static inline int _feature_mask_has_avx2(void) { return _feature_mask_usable(Feature_AVX2); }
+
+typedef Dispatcher<size_t(const FeatureMask&, const FeatureMask*, size_t, unsigned char*)> FeatureMasksCompatibleDispatcher;
+typedef Dispatcher<FeatureMask(const FeatureMask*, size_t)> FeatureMasksIntersectionDispatcher;
+
+static inline const FeatureMasksCompatibleDispatcher& feature_masks_compatible_dispatcher()
+{
+	static const FeatureMasksCompatibleDispatcher dispatcher {
+#ifdef FEATURE_MASK_VECTORIZED
+		{ _feature_masks_compatible_avx2,   _feature_mask_has_avx2, "AVX2" },
+		{ _feature_masks_compatible_sse2,   _feature_mask_has_sse2, "SSE2" },
+#endif
+		{ _feature_masks_compatible_scalar, nullptr,                "Scalar" },
+	};
+	return dispatcher;
+}
+
+static inline const FeatureMasksIntersectionDispatcher& feature_masks_intersection_dispatcher()
+{
+	static const FeatureMasksIntersectionDispatcher dispatcher {
+#ifdef FEATURE_MASK_VECTORIZED
+		{ _feature_masks_intersection_avx2,   _feature_mask_has_avx2, "AVX2" },
+		{ _feature_masks_intersection_sse2,   _feature_mask_has_sse2, "SSE2" },
+#endif
+		{ _feature_masks_intersection_scalar, nullptr,                "Scalar" },
+	};
+	return dispatcher;
+}
+
+// Compare required with each of count host masks, setting compatible[i] (unless compatible is null)
+// to whether host i has all the required features. Returns the number of compatible hosts.
+static inline size_t feature_masks_compatible(const FeatureMask& required, const FeatureMask* hosts, size_t count, unsigned char* compatible)
+{
+	return feature_masks_compatible_dispatcher()(required, hosts, count, compatible);
+}
+
+// The features of required missing on each of count host masks, written to missing[i].
+static inline void feature_masks_missing(const FeatureMask& required, const FeatureMask* hosts, size_t count, FeatureMask* missing)
+{
+	for (size_t i = 0; i < count; ++i)
+		missing[i] = feature_mask_missing(required, hosts[i]); // Compiled to vector operations by the optimizer
+}
+
+// The features common to all count masks, e.g. the target for a build that runs on all hosts. Empty if count is 0.
+static inline FeatureMask feature_masks_intersection(const FeatureMask* masks, size_t count)
+{
+	if (count == 0)
+		return FeatureMask{};
+	return feature_masks_intersection_dispatcher()(masks, count);
+}
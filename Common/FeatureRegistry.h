@@ -0,0 +1,326 @@
+//
+// Registry of CPU features (extended instruction sets) detected by cpuid, as a single table
+// where each feature is described by its name, the function id (leaf), sub-function id
+// (sub-leaf), register and bit reporting it, the processor vendors it is valid for, and the
+// state components that the operating system must have enabled in XCR0 for it to be usable.
+//
+// All sub-projects look up features from this table instead of repeating the bit positions.
+// Each feature is added with a single line in CPU_FEATURE_LIST, which generates both the Feature
+// enumeration and the constexpr table, so that looking up a feature by its enumeration value is
+// resolved at compile time to a bit test at a constant offset in a FeatureSnapshot.
+//
+// The label is the name shown in the AVX mode, and features in group FeatureGroupAVX are the
+// ones listed there, in table order, which is why the AVX family is kept in order of introduction.
+// The rest of the table is in alphabetical order. The AVX mode then lists the related extensions
+// in group FeatureGroupAVXRelated (vector AES, carry-less multiplication and Galois field
+// instructions, AMX and APX), in their alphabetical table order. The speculation mode lists the
+// speculation controls in group FeatureGroupSpeculation. The Microsoft mode lists all features,
+// sorted by name.
+//
+// The lookups only decode register values, and can be used for registers obtained elsewhere,
+// e.g. from a dump. Capturing a snapshot of the executing processor is done by FeatureSnapshot.h.
+//
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "OSSupport.h"
+
+enum FeatureRegisterName { RegisterEAX = 0, RegisterEBX = 1, RegisterECX = 2, RegisterEDX = 3 };
+
+// Processor vendors a feature bit is valid for, bits may have different meaning on different vendors
+#define FeatureVendorIntel 0x1
+#define FeatureVendorAMD   0x2
+#define FeatureVendorOther 0x4
+#define FeatureVendorAny   (FeatureVendorIntel | FeatureVendorAMD | FeatureVendorOther)
+
+// Groups of features, for selecting the features listed in the different modes
+#define FeatureGroupNone       0x0
+#define FeatureGroupAVX        0x1
+#define FeatureGroupAVXRelated 0x2
+#define FeatureGroupSpeculation 0x4
+
+// The registers captured in a FeatureSnapshot: One word for each function id, sub-function id and register
+// containing feature flags. Features can only be added for registers listed here.
+#define CPU_FEATURE_WORD_LIST(X) \
+	/*     name,      function id, sub-function id, register */ \
+	X(Function1_ECX,  0x1,        0, RegisterECX) \
+	X(Function1_EDX,  0x1,        0, RegisterEDX) \
+	X(Function7_EBX,  0x7,        0, RegisterEBX) \
+	X(Function7_ECX,  0x7,        0, RegisterECX) \
+	X(Function7_EDX,  0x7,        0, RegisterEDX) \
+	X(Function7_1_EAX, 0x7,       1, RegisterEAX) \
+	X(Function7_1_EDX, 0x7,       1, RegisterEDX) \
+	X(Function7_2_EDX, 0x7,       2, RegisterEDX) \
+	X(Function13_1_EAX, 0xD,      1, RegisterEAX) /* XSAVE instructions, see XSave.h */ \
+	X(Function24_EBX, 0x24,       0, RegisterEBX) /* AVX10 version in bits 0-7, see ISALevel.h */ \
+	X(Extended1_ECX,  0x80000001, 0, RegisterECX) \
+	X(Extended1_EDX,  0x80000001, 0, RegisterEDX) \
+	X(Extended7_EDX,  0x80000007, 0, RegisterEDX) \
+	X(Extended8_EBX,  0x80000008, 0, RegisterEBX) \
+	X(Extended21_EAX, 0x80000021, 0, RegisterEAX)
+
+#define CPU_FEATURE_LIST(X) \
+	/*  id,               name,              label,              function id, sub, register, bit, vendors, XCR0 state required, groups */ \
+	X(_3DNOW,          "3DNOW",           "3DNOW",            0x80000001, 0, RegisterEDX, 31, FeatureVendorAMD,   0, FeatureGroupNone) \
+	X(_3DNOWEXT,       "3DNOWEXT",        "3DNOWEXT",         0x80000001, 0, RegisterEDX, 30, FeatureVendorAMD,   0, FeatureGroupNone) \
+	X(ABM,             "ABM",             "ABM",              0x80000001, 0, RegisterECX, 5,  FeatureVendorAMD,   0, FeatureGroupNone) \
+	X(ADX,             "ADX",             "ADX",              0x7,        0, RegisterEBX, 19, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(AES,             "AES",             "AES",              0x1,        0, RegisterECX, 25, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(AMDIBPB,         "AMD-IBPB",        "AMD IBPB",         0x80000008, 0, RegisterEBX, 12, FeatureVendorAMD,   0, FeatureGroupSpeculation) \
+	X(AMDIBRS,         "AMD-IBRS",        "AMD IBRS",         0x80000008, 0, RegisterEBX, 14, FeatureVendorAMD,   0, FeatureGroupSpeculation) \
+	X(AMDSSBD,         "AMD-SSBD",        "AMD SSBD",         0x80000008, 0, RegisterEBX, 24, FeatureVendorAMD,   0, FeatureGroupSpeculation) \
+	X(AMDSTIBP,        "AMD-STIBP",       "AMD STIBP",        0x80000008, 0, RegisterEBX, 15, FeatureVendorAMD,   0, FeatureGroupSpeculation) \
+	X(AMXBF16,         "AMX-BF16",        "AMX-BF16",         0x7,        0, RegisterEDX, 22, FeatureVendorAny,   XCR0_AMX_STATE, FeatureGroupAVXRelated) \
+	X(AMXCOMPLEX,      "AMX-COMPLEX",     "AMX-COMPLEX",      0x7,        1, RegisterEDX, 8,  FeatureVendorAny,   XCR0_AMX_STATE, FeatureGroupAVXRelated) \
+	X(AMXFP16,         "AMX-FP16",        "AMX-FP16",         0x7,        1, RegisterEAX, 21, FeatureVendorAny,   XCR0_AMX_STATE, FeatureGroupAVXRelated) \
+	X(AMXINT8,         "AMX-INT8",        "AMX-INT8",         0x7,        0, RegisterEDX, 25, FeatureVendorAny,   XCR0_AMX_STATE, FeatureGroupAVXRelated) \
+	X(AMXTILE,         "AMX-TILE",        "AMX-TILE",         0x7,        0, RegisterEDX, 24, FeatureVendorAny,   XCR0_AMX_STATE, FeatureGroupAVXRelated) \
+	X(APX,             "APX",             "APX",              0x7,        1, RegisterEDX, 21, FeatureVendorAny,   XCR0_APX_STATE, FeatureGroupAVXRelated) \
+	X(ARCHCAPABILITIES, "ARCH-CAPABILITIES", "ARCH_CAPABILITIES", 0x7,    0, RegisterEDX, 29, FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(AUTOIBRS,        "AUTO-IBRS",       "Automatic IBRS",   0x80000021, 0, RegisterEAX, 8,  FeatureVendorAMD,   0, FeatureGroupSpeculation) \
+	X(AVX,             "AVX",             "AVX",              0x1,        0, RegisterECX, 28, FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupAVX) \
+	X(AVX2,            "AVX2",            "AVX2",             0x7,        0, RegisterEBX, 5,  FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupAVX) \
+	X(AVX512F,         "AVX512F",         "AVX-512 (F)",      0x7,        0, RegisterEBX, 16, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512CD,        "AVX512CD",        "AVX-512 CD",       0x7,        0, RegisterEBX, 28, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512ER,        "AVX512ER",        "AVX-512 ER",       0x7,        0, RegisterEBX, 27, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512PF,        "AVX512PF",        "AVX-512 PF",       0x7,        0, RegisterEBX, 26, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512VL,        "AVX512VL",        "AVX-512 VL",       0x7,        0, RegisterEBX, 31, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512BW,        "AVX512BW",        "AVX-512 BW",       0x7,        0, RegisterEBX, 30, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512DQ,        "AVX512DQ",        "AVX-512 DQ",       0x7,        0, RegisterEBX, 17, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512IFMA,      "AVX512IFMA",      "AVX-512 IFMA",     0x7,        0, RegisterEBX, 21, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512VBMI,      "AVX512VBMI",      "AVX-512 VBMI",     0x7,        0, RegisterECX, 1,  FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512VNNI,      "AVX512VNNI",      "AVX-512 VNNI",     0x7,        0, RegisterECX, 11, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512VBMI2,     "AVX512VBMI2",     "AVX-512 VBMI2",    0x7,        0, RegisterECX, 6,  FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512POPCNTDQ,  "AVX512POPCNTDQ",  "AVX-512 POPCNTDQ", 0x7,        0, RegisterECX, 14, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512BITALG,    "AVX512BITALG",    "AVX-512 BITALG",   0x7,        0, RegisterECX, 12, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX5124VNNIW,    "AVX5124VNNIW",    "AVX-512 4VNNIW",   0x7,        0, RegisterEDX, 2,  FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX5124FMAPS,    "AVX5124FMAPS",    "AVX-512 4FMAPS",   0x7,        0, RegisterEDX, 3,  FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512VP2INTERSECT, "AVX512VP2INTERSECT", "AVX-512 VP2INTERSECT", 0x7,       0, RegisterEDX, 8,  FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVX512BF16,      "AVX512BF16",      "AVX-512 BF16",     0x7,        1, RegisterEAX, 5,  FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVXVNNI,         "AVX-VNNI",        "AVX-VNNI",         0x7,        1, RegisterEAX, 4,  FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupAVX) \
+	X(AVX512FP16,      "AVX512FP16",      "AVX-512 FP16",     0x7,        0, RegisterEDX, 23, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(AVXIFMA,         "AVX-IFMA",        "AVX-IFMA",         0x7,        1, RegisterEAX, 23, FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupAVX) \
+	X(AVXVNNIINT8,     "AVX-VNNI-INT8",   "AVX-VNNI-INT8",    0x7,        1, RegisterEDX, 4,  FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupAVX) \
+	X(AVXNECONVERT,    "AVX-NE-CONVERT",  "AVX-NE-CONVERT",   0x7,        1, RegisterEDX, 5,  FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupAVX) \
+	X(AVXVNNIINT16,    "AVX-VNNI-INT16",  "AVX-VNNI-INT16",   0x7,        1, RegisterEDX, 10, FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupAVX) \
+	X(AVX10,           "AVX10",           "AVX10",            0x7,        1, RegisterEDX, 19, FeatureVendorAny,   XCR0_AVX512_STATE, FeatureGroupAVX) \
+	X(BHICTRL,         "BHI-CTRL",        "BHI_CTRL",         0x7,        2, RegisterEDX, 4,  FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(BMI1,            "BMI1",            "BMI1",             0x7,        0, RegisterEBX, 3,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(BMI2,            "BMI2",            "BMI2",             0x7,        0, RegisterEBX, 8,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(CLFSH,           "CLFSH",           "CLFSH",            0x1,        0, RegisterEDX, 19, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(CMOV,            "CMOV",            "CMOV",             0x1,        0, RegisterEDX, 15, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(CMPXCHG16B,      "CMPXCHG16B",      "CMPXCHG16B",       0x1,        0, RegisterECX, 13, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(CX8,             "CX8",             "CX8",              0x1,        0, RegisterEDX, 8,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(ERMS,            "ERMS",            "ERMS",             0x7,        0, RegisterEBX, 9,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(F16C,            "F16C",            "F16C",             0x1,        0, RegisterECX, 29, FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupNone) \
+	X(FMA,             "FMA",             "FMA",              0x1,        0, RegisterECX, 12, FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupNone) \
+	X(FPU,             "FPU",             "FPU",              0x1,        0, RegisterEDX, 0,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(FSGSBASE,        "FSGSBASE",        "FSGSBASE",         0x7,        0, RegisterEBX, 0,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(FSRM,            "FSRM",            "FSRM",             0x7,        0, RegisterEDX, 4,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(FXSR,            "FXSR",            "FXSR",             0x1,        0, RegisterEDX, 24, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(GFNI,            "GFNI",            "GFNI",             0x7,        0, RegisterECX, 8,  FeatureVendorAny,   0, FeatureGroupAVXRelated) \
+	X(HLE,             "HLE",             "HLE",              0x7,        0, RegisterEBX, 4,  FeatureVendorIntel, 0, FeatureGroupNone) \
+	X(HYBRID,          "HYBRID",          "HYBRID",           0x7,        0, RegisterEDX, 15, FeatureVendorIntel, 0, FeatureGroupNone) \
+	X(HYPERVISOR,      "HYPERVISOR",      "HYPERVISOR",       0x1,        0, RegisterECX, 31, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(IBRS,            "IBRS",            "IBRS/IBPB",        0x7,        0, RegisterEDX, 26, FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(INVPCID,         "INVPCID",         "INVPCID",          0x7,        0, RegisterEBX, 10, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(INVTSC,          "INVTSC",          "Invariant TSC",    0x80000007, 0, RegisterEDX, 8,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(IPREDCTRL,       "IPRED-CTRL",      "IPRED_CTRL",       0x7,        2, RegisterEDX, 1,  FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(L1DFLUSH,        "L1D-FLUSH",       "L1D_FLUSH",        0x7,        0, RegisterEDX, 28, FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(LAHF,            "LAHF",            "LAHF",             0x80000001, 0, RegisterECX, 0,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(LM,              "LM",              "LM",               0x80000001, 0, RegisterEDX, 29, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(LZCNT,           "LZCNT",           "LZCNT",            0x80000001, 0, RegisterECX, 5,  FeatureVendorIntel, 0, FeatureGroupNone) \
+	X(MDCLEAR,         "MD-CLEAR",        "MD_CLEAR",         0x7,        0, RegisterEDX, 10, FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(MMX,             "MMX",             "MMX",              0x1,        0, RegisterEDX, 23, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(MMXEXT,          "MMXEXT",          "MMXEXT",           0x80000001, 0, RegisterEDX, 22, FeatureVendorAMD,   0, FeatureGroupNone) \
+	X(MONITOR,         "MONITOR",         "MONITOR",          0x1,        0, RegisterECX, 3,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(MOVBE,           "MOVBE",           "MOVBE",            0x1,        0, RegisterECX, 22, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(MOVDIRI,         "MOVDIRI",         "MOVDIRI",          0x7,        0, RegisterECX, 27, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(MSR,             "MSR",             "MSR",              0x1,        0, RegisterEDX, 5,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(OSXSAVE,         "OSXSAVE",         "OSXSAVE",          0x1,        0, RegisterECX, 27, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(PCLMULQDQ,       "PCLMULQDQ",       "PCLMULQDQ",        0x1,        0, RegisterECX, 1,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(POPCNT,          "POPCNT",          "POPCNT",           0x1,        0, RegisterECX, 23, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(PREFETCHWT1,     "PREFETCHWT1",     "PREFETCHWT1",      0x7,        0, RegisterECX, 0,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(PSFD,            "PSFD",            "PSFD",             0x7,        2, RegisterEDX, 0,  FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(RDRAND,          "RDRAND",          "RDRAND",           0x1,        0, RegisterECX, 30, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(RDSEED,          "RDSEED",          "RDSEED",           0x7,        0, RegisterEBX, 18, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(RDTSCP,          "RDTSCP",          "RDTSCP",           0x80000001, 0, RegisterEDX, 27, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(RRSBACTRL,       "RRSBA-CTRL",      "RRSBA_CTRL",       0x7,        2, RegisterEDX, 2,  FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(RTM,             "RTM",             "RTM",              0x7,        0, RegisterEBX, 11, FeatureVendorIntel, 0, FeatureGroupNone) \
+	X(RTMALWAYSABORT,  "RTM-ALWAYS-ABORT", "RTM_ALWAYS_ABORT", 0x7,       0, RegisterEDX, 11, FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(SEP,             "SEP",             "SEP",              0x1,        0, RegisterEDX, 11, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(SERIALIZE,       "SERIALIZE",       "SERIALIZE",        0x7,        0, RegisterEDX, 14, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(SHA,             "SHA",             "SHA",              0x7,        0, RegisterEBX, 29, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(SSBNO,           "SSB-NO",          "SSB_NO",           0x80000008, 0, RegisterEBX, 26, FeatureVendorAMD,   0, FeatureGroupSpeculation) \
+	X(SSBD,            "SSBD",            "SSBD",             0x7,        0, RegisterEDX, 31, FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(SSE,             "SSE",             "SSE",              0x1,        0, RegisterEDX, 25, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(SSE2,            "SSE2",            "SSE2",             0x1,        0, RegisterEDX, 26, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(SSE3,            "SSE3",            "SSE3",             0x1,        0, RegisterECX, 0,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(SSE41,           "SSE4.1",          "SSE4.1",           0x1,        0, RegisterECX, 19, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(SSE42,           "SSE4.2",          "SSE4.2",           0x1,        0, RegisterECX, 20, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(SSE4a,           "SSE4a",           "SSE4a",            0x80000001, 0, RegisterECX, 6,  FeatureVendorAMD,   0, FeatureGroupNone) \
+	X(SSSE3,           "SSSE3",           "SSSE3",            0x1,        0, RegisterECX, 9,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(STIBP,           "STIBP",           "STIBP",            0x7,        0, RegisterEDX, 27, FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(SYSCALL,         "SYSCALL",         "SYSCALL",          0x80000001, 0, RegisterEDX, 11, FeatureVendorIntel, 0, FeatureGroupNone) \
+	X(TBM,             "TBM",             "TBM",              0x80000001, 0, RegisterECX, 21, FeatureVendorAMD,   0, FeatureGroupNone) \
+	X(TSXFORCEABORT,   "TSX-FORCE-ABORT", "TSX_FORCE_ABORT",  0x7,        0, RegisterEDX, 13, FeatureVendorIntel, 0, FeatureGroupSpeculation) \
+	X(VAES,            "VAES",            "VAES",             0x7,        0, RegisterECX, 9,  FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupAVXRelated) \
+	X(VIRTSSBD,        "VIRT-SSBD",       "VIRT_SSBD",        0x80000008, 0, RegisterEBX, 25, FeatureVendorAMD,   0, FeatureGroupSpeculation) \
+	X(VMX,             "VMX",             "VMX",              0x1,        0, RegisterECX, 5,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(VPCLMULQDQ,      "VPCLMULQDQ",      "VPCLMULQDQ",       0x7,        0, RegisterECX, 10, FeatureVendorAny,   XCR0_AVX_STATE, FeatureGroupAVXRelated) \
+	X(XFD,             "XFD",             "XFD",              0xD,        1, RegisterEAX, 4,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(XGETBV1,         "XGETBV1",         "XGETBV1",          0xD,        1, RegisterEAX, 2,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(XOP,             "XOP",             "XOP",              0x80000001, 0, RegisterECX, 11, FeatureVendorAMD,   0, FeatureGroupNone) \
+	X(XSAVE,           "XSAVE",           "XSAVE",            0x1,        0, RegisterECX, 26, FeatureVendorAny,   0, FeatureGroupNone) \
+	X(XSAVEC,          "XSAVEC",          "XSAVEC",           0xD,        1, RegisterEAX, 1,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(XSAVEOPT,        "XSAVEOPT",        "XSAVEOPT",         0xD,        1, RegisterEAX, 0,  FeatureVendorAny,   0, FeatureGroupNone) \
+	X(XSAVES,          "XSAVES",          "XSAVES",           0xD,        1, RegisterEAX, 3,  FeatureVendorAny,   0, FeatureGroupNone)
+
+enum FeatureWord {
+#define CPU_FEATURE_WORD_ENUM(name, function_id, subfunction_id, register_name) FeatureWord_##name,
+	CPU_FEATURE_WORD_LIST(CPU_FEATURE_WORD_ENUM)
+#undef CPU_FEATURE_WORD_ENUM
+	FeatureWordCount
+};
+
+enum Feature {
+#define CPU_FEATURE_ENUM(id, name, label, function_id, subfunction_id, register_name, bit, vendors, xcr0, groups) Feature_##id,
+	CPU_FEATURE_LIST(CPU_FEATURE_ENUM)
+#undef CPU_FEATURE_ENUM
+	FeatureCount
+};
+
+struct FeatureWordInfo {
+	unsigned int function_id;
+	unsigned int subfunction_id;
+	FeatureRegisterName register_name;
+};
+
+struct FeatureInfo {
+	const char* name;
+	const char* label;
+	unsigned int function_id;
+	unsigned int subfunction_id;
+	FeatureRegisterName register_name;
+	unsigned int bit;
+	unsigned int vendors;         // Mask of FeatureVendor*
+	unsigned long long xcr0;      // State components that must be enabled in XCR0, see OSSupport.h
+	unsigned int groups;          // Mask of FeatureGroup*
+	int word;                     // Index of the register in FeatureSnapshot::words, resolved at compile time
+};
+
+static constexpr FeatureWordInfo feature_words[FeatureWordCount] = {
+#define CPU_FEATURE_WORD_INFO(name, function_id, subfunction_id, register_name) { function_id, subfunction_id, register_name },
+	CPU_FEATURE_WORD_LIST(CPU_FEATURE_WORD_INFO)
+#undef CPU_FEATURE_WORD_INFO
+};
+
+// Version of the layout of the words written for decoding elsewhere, e.g. in the hex format of the Microsoft mode,
+// incremented when the order or the meaning of the words changes in other ways than CPU_FEATURE_WORD_LIST shows.
+#define FEATURE_WORD_LAYOUT_VERSION 1
+
+// FNV-1a hash of the layout version and of CPU_FEATURE_WORD_LIST, the name, function id, sub-function id and
+// register of each word in order, so that words written by a build with a different list are rejected.
+static inline uint32_t feature_word_layout_hash()
+{
+	static const char* const names[FeatureWordCount] = {
+#define CPU_FEATURE_WORD_NAME(name, function_id, subfunction_id, register_name) #name,
+		CPU_FEATURE_WORD_LIST(CPU_FEATURE_WORD_NAME)
+#undef CPU_FEATURE_WORD_NAME
+	};
+	uint32_t hash = 2166136261u;
+	const auto mix = [&hash](uint32_t value) {
+		for (int i = 0; i < 4; ++i)
+			hash = (hash ^ ((value >> (8 * i)) & 0xFF)) * 16777619u;
+	};
+	mix(FEATURE_WORD_LAYOUT_VERSION);
+	for (int i = 0; i < FeatureWordCount; ++i) {
+		for (const char* c = names[i]; *c; ++c)
+			hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+		mix(feature_words[i].function_id);
+		mix(feature_words[i].subfunction_id);
+		mix(static_cast<uint32_t>(feature_words[i].register_name));
+	}
+	return hash;
+}
+
+// Index in feature_words of a function id, sub-function id and register, -1 if not captured.
+static constexpr int feature_word_index(unsigned int function_id, unsigned int subfunction_id, FeatureRegisterName register_name, int index = 0)
+{
+	return index >= FeatureWordCount ? -1
+		: (feature_words[index].function_id == function_id && feature_words[index].subfunction_id == subfunction_id && feature_words[index].register_name == register_name) ? index
+		: feature_word_index(function_id, subfunction_id, register_name, index + 1);
+}
+
+static constexpr FeatureInfo feature_table[FeatureCount] = {
+#define CPU_FEATURE_INFO(id, name, label, function_id, subfunction_id, register_name, bit, vendors, xcr0, groups) \
+	{ name, label, function_id, subfunction_id, register_name, bit, vendors, xcr0, groups, feature_word_index(function_id, subfunction_id, register_name) },
+	CPU_FEATURE_LIST(CPU_FEATURE_INFO)
+#undef CPU_FEATURE_INFO
+};
+
+static constexpr bool _feature_table_valid(int index = 0)
+{
+	return index >= FeatureCount || (feature_table[index].word >= 0 && feature_table[index].bit < 32 && _feature_table_valid(index + 1));
+}
+static_assert(_feature_table_valid(), "Every feature must be in a register listed in CPU_FEATURE_WORD_LIST");
+
+// Snapshot of the feature flag registers of a processor, all zero for function ids not supported
+struct FeatureSnapshot {
+	unsigned int words[FeatureWordCount];
+	unsigned int vendor;     // One of FeatureVendor*
+	unsigned long long xcr0; // Value of XCR0, 0 if the operating system has not enabled XSAVE
+};
+
+// Processor vendor from the vendor string registers EBX, EDX and ECX of function id 0.
+static inline unsigned int feature_vendor(unsigned int ebx, unsigned int edx, unsigned int ecx)
+{
+	char vendor[13];
+	memcpy(vendor, &ebx, 4);
+	memcpy(vendor + 4, &edx, 4);
+	memcpy(vendor + 8, &ecx, 4);
+	vendor[12] = '\0';
+	if (strcmp(vendor, "GenuineIntel") == 0)
+		return FeatureVendorIntel;
+	if (strcmp(vendor, "AuthenticAMD") == 0 || strcmp(vendor, "HygonGenuine") == 0)
+		return FeatureVendorAMD;
+	return FeatureVendorOther;
+}
+
+// Processor support: The feature bit is set, and valid for the processor vendor.
+static inline bool feature_hardware(const FeatureSnapshot& snapshot, Feature feature)
+{
+	const FeatureInfo& info = feature_table[feature];
+	return (snapshot.vendor & info.vendors) != 0 && ((snapshot.words[info.word] >> info.bit) & 1) != 0;
+}
+
+// Operating system support: The state components required by the feature are enabled in XCR0.
+static inline bool feature_os_support(const FeatureSnapshot& snapshot, Feature feature)
+{
+	const FeatureInfo& info = feature_table[feature];
+	return (snapshot.xcr0 & info.xcr0) == info.xcr0;
+}
+
+// Usable: Supported by both processor and operating system.
+static inline bool feature_usable(const FeatureSnapshot& snapshot, Feature feature)
+{
+	return feature_hardware(snapshot, feature) && feature_os_support(snapshot, feature);
+}
+
+// Test the feature bit in the four registers EAX, EBX, ECX and EDX returned by the feature's function id,
+// for code that executes cpuid itself.
+static inline bool feature_in_registers(const unsigned int registers[4], Feature feature)
+{
+	const FeatureInfo& info = feature_table[feature];
+	return ((registers[info.register_name] >> info.bit) & 1) != 0;
+}
+
+// Find a feature by name (case sensitive), FeatureCount if not found.
+static inline Feature find_feature(const char* name)
+{
+	for (int i = 0; i < FeatureCount; ++i) {
+		if (strcmp(feature_table[i].name, name) == 0)
+			return static_cast<Feature>(i);
+	}
+	return FeatureCount;
+}
@@ -0,0 +1,40 @@
+//
+// Capturing a FeatureSnapshot (see FeatureRegistry.h) of the executing processor: Executes
+// cpuid for each function id and sub-function id in the registry's word list, and reads XCR0.
+// The same decoding is done from any source of cpuid data (see CPUIDSource.h) with
+// decode_feature_snapshot, e.g. a dump captured on another machine.
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include "Intrinsics.h"
+#include "FeatureRegistry.h"
+#include "OSSupport.h"
+#include "CPUIDSource.h"
+
+template<typename Source>
+static inline FeatureSnapshot decode_feature_snapshot(const Source& source)
+{
+	FeatureSnapshot snapshot = {};
+	int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
+	source.cpuid(cpu_info, 0x0); // Request function id 0 to get the number of the highest valid function ID, and the vendor string
+	const unsigned int max_function_id = static_cast<unsigned int>(cpu_info[0]);
+	snapshot.vendor = feature_vendor(cpu_info[1], cpu_info[3], cpu_info[2]);
+	source.cpuid(cpu_info, 0x80000000); // Request function id 0x80000000 to get the number of the highest valid extended ID
+	const unsigned int max_extended_function_id = static_cast<unsigned int>(cpu_info[0]);
+	for (int i = 0; i < FeatureWordCount; ++i) {
+		const FeatureWordInfo& word = feature_words[i];
+		const unsigned int max = word.function_id >= 0x80000000 ? max_extended_function_id : max_function_id;
+		if (word.function_id > max)
+			continue;
+		source.cpuid(cpu_info, word.function_id, word.subfunction_id);
+		snapshot.words[i] = static_cast<unsigned int>(cpu_info[word.register_name]);
+	}
+	snapshot.xcr0 = source.xcr0(snapshot.words[FeatureWord_Function1_ECX]);
+	return snapshot;
+}
+
+static inline FeatureSnapshot get_feature_snapshot()
+{
+	return decode_feature_snapshot(CPUIDLiveSource());
+}
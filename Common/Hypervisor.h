@@ -0,0 +1,244 @@
+//
+// Detection of the hypervisor the executing processor runs under, if any, from the hypervisor
+// function ids 0x40000000 and up, which are reserved for the hypervisor and never executed by the
+// processor itself.
+//
+// A hypervisor sets the hypervisor present flag (function id 1, ECX bit 31), and reports the highest
+// hypervisor function id and a vendor signature in function id 0x40000000, e.g. "Microsoft Hv" for
+// Hyper-V. Hypervisors emulating the Hyper-V interface for Windows guests, such as KVM and Xen, move
+// their own signature to base 0x40000100, so both bases are checked. The Hyper-V interface is
+// identified by the interface signature "Hv#1" in function id base+1, regardless of the vendor, and
+// its enlightenments are decoded from function ids base+3 (features, partition privileges) and
+// base+4 (recommendations). KVM reports its paravirtual features in function id base+1. VMware and
+// KVM may report the TSC and bus frequencies in kHz in function id base+0x10.
+//
+// AWS Nitro is based on KVM and reports the KVM signature, so it is identified by the system
+// vendor in DMI, which can only be read on Linux (/sys/class/dmi/id/sys_vendor).
+//
+// Hypervisors commonly mask features of the host processor, e.g. TSX (HLE and RTM), AVX-512 or
+// RDSEED, and cpuid always traps to the hypervisor (a VM exit), which makes it cost microseconds
+// instead of about a hundred cycles. The cost is measured by measure_cpuid_cost, and tells whether
+// results must be cached instead of executing cpuid repeatedly.
+//
+// See also: https://learn.microsoft.com/en-us/virtualization/hyper-v-on-windows/tlfs/feature-discovery
+// See also: https://www.kernel.org/doc/html/latest/virt/kvm/x86/cpuid.html
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include "Intrinsics.h"
+#if defined(__linux__)
+#include <stdio.h>
+#endif
+
+enum HypervisorVendor {
+	HypervisorNone, HypervisorHyperV, HypervisorKVM, HypervisorVMware, HypervisorXen, HypervisorNitro,
+	HypervisorQEMU, HypervisorVirtualBox, HypervisorParallels, HypervisorBhyve, HypervisorACRN, HypervisorOther,
+	HypervisorVendorCount
+};
+
+static const char* const hypervisor_vendor_names[HypervisorVendorCount] = {
+	"none", "Hyper-V", "KVM", "VMware", "Xen", "Nitro", "QEMU", "VirtualBox", "Parallels", "bhyve", "ACRN", "other"
+};
+
+// Known vendor signatures in EBX, ECX and EDX of function id 0x40000000, padded with zeros to 12 characters
+static const struct { const char* signature; HypervisorVendor vendor; } hypervisor_signatures[] = {
+	{ "Microsoft Hv", HypervisorHyperV },
+	{ "KVMKVMKVM",    HypervisorKVM },
+	{ "Linux KVM Hv", HypervisorKVM }, // KVM emulating Hyper-V, with its own signature then at base 0x40000100
+	{ "VMwareVMware", HypervisorVMware },
+	{ "XenVMMXenVMM", HypervisorXen },
+	{ "TCGTCGTCGTCG", HypervisorQEMU }, // QEMU without acceleration
+	{ "VBoxVBoxVBox", HypervisorVirtualBox },
+	{ " lrpepyh  vr", HypervisorParallels },
+	{ "bhyve bhyve ", HypervisorBhyve },
+	{ "ACRNACRNACRN", HypervisorACRN },
+};
+
+// Named bits of the hypervisor function ids, for listing the enlightenments
+struct HypervisorFlag {
+	unsigned int bit;
+	const char* name;
+};
+
+// Hyper-V function id base+3 EAX: Partition privileges for synthetic MSRs
+static const HypervisorFlag hyperv_feature_flags[] = {
+	{ 0, "VP_RUNTIME" }, { 1, "TIME_REF_COUNT" }, { 2, "SYNIC" }, { 3, "SYNTHETIC_TIMERS" },
+	{ 4, "APIC_ACCESS" }, { 5, "HYPERCALL" }, { 6, "VP_INDEX" }, { 7, "RESET" },
+	{ 8, "STATS" }, { 9, "REFERENCE_TSC" }, { 10, "GUEST_IDLE" }, { 11, "FREQUENCY_MSRS" },
+	{ 12, "DEBUG_MSRS" }, { 13, "REENLIGHTENMENT" },
+};
+
+// Hyper-V function id base+4 EAX: Recommendations for the guest
+static const HypervisorFlag hyperv_recommendation_flags[] = {
+	{ 0, "HYPERCALL_ADDRESS_SPACE_SWITCH" }, { 1, "HYPERCALL_LOCAL_FLUSH" }, { 2, "HYPERCALL_REMOTE_FLUSH" },
+	{ 3, "APIC_MSRS" }, { 4, "RESET_MSR" }, { 5, "RELAXED_TIMING" }, { 6, "DMA_REMAPPING" },
+	{ 7, "INTERRUPT_REMAPPING" }, { 9, "DEPRECATE_AUTO_EOI" }, { 10, "SYNTHETIC_CLUSTER_IPI" },
+	{ 11, "EX_PROCESSOR_MASKS" }, { 12, "NESTED" }, { 14, "ENLIGHTENED_VMCS" },
+};
+
+// KVM function id base+1 EAX: Paravirtual features
+static const HypervisorFlag kvm_feature_flags[] = {
+	{ 0, "CLOCKSOURCE" }, { 1, "NOP_IO_DELAY" }, { 2, "MMU_OP" }, { 3, "CLOCKSOURCE2" },
+	{ 4, "ASYNC_PF" }, { 5, "STEAL_TIME" }, { 6, "PV_EOI" }, { 7, "PV_UNHALT" },
+	{ 9, "PV_TLB_FLUSH" }, { 10, "ASYNC_PF_VMEXIT" }, { 11, "PV_SEND_IPI" }, { 12, "POLL_CONTROL" },
+	{ 13, "PV_SCHED_YIELD" }, { 14, "ASYNC_PF_INT" }, { 15, "MSI_EXT_DEST_ID" }, { 24, "CLOCKSOURCE_STABLE" },
+};
+
+#define HYPERV_FEATURE_REFERENCE_TSC 9
+#define HYPERV_FEATURE_FREQUENCY_MSRS 11
+#define KVM_FEATURE_CLOCKSOURCE_STABLE 24
+
+struct HypervisorInfo {
+	bool present;                    // Hypervisor present flag, function id 1 ECX bit 31
+	HypervisorVendor vendor;
+	char signature[13];              // Vendor signature of function id 0x40000000
+	unsigned int max_function_id;    // Highest hypervisor function id, 0 if not reported
+	bool hyperv_interface;           // Implements the Hyper-V interface ("Hv#1")
+	unsigned int hyperv_build;       // Hyper-V version, function id base+2
+	unsigned int hyperv_version;     // Major version in bits 16-31 and minor in bits 0-15
+	unsigned int hyperv_features[4]; // Function id base+3 EAX, EBX, ECX and EDX
+	unsigned int hyperv_recommendations; // Function id base+4 EAX
+	unsigned int hyperv_spinlock_retries; // Function id base+4 EBX, 0xFFFFFFFF if never notified
+	unsigned int hyperv_max_virtual_processors; // Function id base+5 EAX
+	unsigned int hyperv_max_logical_processors; // Function id base+5 EBX
+	unsigned int kvm_features;       // KVM function id base+1 EAX
+	unsigned int kvm_hints;          // KVM function id base+1 EDX
+	unsigned int tsc_khz;            // TSC frequency in kHz from function id base+0x10, 0 if not reported
+	unsigned int bus_khz;            // Bus (APIC timer) frequency in kHz from function id base+0x10
+	bool invariant_tsc;              // Invariant TSC flag, function id 0x80000007 EDX bit 8
+};
+
+static inline HypervisorVendor _hypervisor_vendor(const char* signature)
+{
+	for (const auto& known : hypervisor_signatures) {
+		if (strncmp(signature, known.signature, 12) == 0)
+			return known.vendor;
+	}
+	return HypervisorOther;
+}
+
+// The system vendor from DMI, empty if not available.
+static inline void _hypervisor_dmi_vendor(char* vendor, size_t size)
+{
+	vendor[0] = '\0';
+#if defined(__linux__)
+	if (FILE* file = fopen("/sys/class/dmi/id/sys_vendor", "r")) {
+		if (fgets(vendor, static_cast<int>(size), file))
+			vendor[strcspn(vendor, "\r\n")] = '\0';
+		fclose(file);
+	}
+#else
+	(void)size;
+#endif
+}
+
+static inline HypervisorInfo get_hypervisor_info()
+{
+	HypervisorInfo info = {};
+	int cpu_info[4];
+	__cpuid(cpu_info, 0x80000000);
+	if (static_cast<unsigned int>(cpu_info[0]) >= 0x80000007) {
+		__cpuid(cpu_info, 0x80000007);
+		info.invariant_tsc = (cpu_info[3] >> 8) & 1;
+	}
+	__cpuid(cpu_info, 0x1);
+	info.present = (static_cast<unsigned int>(cpu_info[2]) >> 31) & 1;
+	if (!info.present)
+		return info;
+	info.vendor = HypervisorOther;
+	for (unsigned int base = 0x40000000; base <= 0x40000100; base += 0x100) {
+		__cpuid(cpu_info, static_cast<int>(base));
+		const unsigned int max_function_id = static_cast<unsigned int>(cpu_info[0]);
+		if (max_function_id < base)
+			continue;
+		char signature[13];
+		memcpy(signature, &cpu_info[1], 4);
+		memcpy(signature + 4, &cpu_info[2], 4);
+		memcpy(signature + 8, &cpu_info[3], 4);
+		signature[12] = '\0';
+		if (base == 0x40000000) {
+			// The primary signature, normally the actual hypervisor
+			memcpy(info.signature, signature, sizeof(signature));
+			info.vendor = _hypervisor_vendor(signature);
+			info.max_function_id = max_function_id;
+		} else if (info.vendor == HypervisorHyperV || info.vendor == HypervisorKVM) {
+			// Emulating Hyper-V, the actual hypervisor reports its signature at the second base
+			const HypervisorVendor vendor = _hypervisor_vendor(signature);
+			if (vendor == HypervisorKVM || vendor == HypervisorXen)
+				info.vendor = vendor;
+		}
+		__cpuid(cpu_info, static_cast<int>(base + 1));
+		if (cpu_info[0] == 0x31237648 && !info.hyperv_interface && max_function_id >= base + 5) { // "Hv#1"
+			info.hyperv_interface = true;
+			__cpuid(cpu_info, static_cast<int>(base + 2));
+			info.hyperv_build = static_cast<unsigned int>(cpu_info[0]);
+			info.hyperv_version = static_cast<unsigned int>(cpu_info[1]);
+			__cpuid(cpu_info, static_cast<int>(base + 3));
+			for (int i = 0; i < 4; ++i)
+				info.hyperv_features[i] = static_cast<unsigned int>(cpu_info[i]);
+			__cpuid(cpu_info, static_cast<int>(base + 4));
+			info.hyperv_recommendations = static_cast<unsigned int>(cpu_info[0]);
+			info.hyperv_spinlock_retries = static_cast<unsigned int>(cpu_info[1]);
+			__cpuid(cpu_info, static_cast<int>(base + 5));
+			info.hyperv_max_virtual_processors = static_cast<unsigned int>(cpu_info[0]);
+			info.hyperv_max_logical_processors = static_cast<unsigned int>(cpu_info[1]);
+		} else if (strcmp(signature, "KVMKVMKVM") == 0) {
+			info.kvm_features = static_cast<unsigned int>(cpu_info[0]);
+			info.kvm_hints = static_cast<unsigned int>(cpu_info[3]);
+		}
+		if (max_function_id >= base + 0x10 && !info.tsc_khz) {
+			__cpuid(cpu_info, static_cast<int>(base + 0x10));
+			info.tsc_khz = static_cast<unsigned int>(cpu_info[0]);
+			info.bus_khz = static_cast<unsigned int>(cpu_info[1]);
+		}
+	}
+	if (info.vendor == HypervisorKVM) {
+		char dmi_vendor[64];
+		_hypervisor_dmi_vendor(dmi_vendor, sizeof(dmi_vendor));
+		if (strcmp(dmi_vendor, "Amazon EC2") == 0)
+			info.vendor = HypervisorNitro;
+	}
+	return info;
+}
+
+// Whether the time stamp counter can be used for timing: Invariant, and when running under a hypervisor,
+// also reported as stable by it, so that it is not affected by migration between hosts or by the hypervisor
+// scheduling virtual processors on different physical processors.
+static inline bool hypervisor_tsc_reliable(const HypervisorInfo& info)
+{
+	if (!info.invariant_tsc)
+		return false;
+	if (!info.present)
+		return true;
+	if (info.hyperv_interface && ((info.hyperv_features[0] >> HYPERV_FEATURE_REFERENCE_TSC) & 1))
+		return true;
+	if ((info.kvm_features >> KVM_FEATURE_CLOCKSOURCE_STABLE) & 1)
+		return true;
+	return info.vendor == HypervisorVMware && info.tsc_khz != 0;
+}
+
+// Cost of executing cpuid once, in time stamp counter ticks: The median of a number of runs, each timing
+// a number of calls. Executed natively cpuid takes about 100-200 cycles, while a trap to the hypervisor
+// (VM exit) makes it take thousands.
+static inline uint64_t measure_cpuid_cost()
+{
+	const int runs = 11;
+	const int calls = 16;
+	uint64_t ticks[runs];
+	int cpu_info[4];
+	for (int run = 0; run < runs; ++run) {
+		const uint64_t start = __rdtsc();
+		for (int call = 0; call < calls; ++call)
+			__cpuid(cpu_info, 0x1);
+		ticks[run] = (__rdtsc() - start) / calls;
+	}
+	std::sort(ticks, ticks + runs);
+	return ticks[runs / 2];
+}
+
+// Threshold in ticks for considering cpuid trapped, with results that should always be cached
+#define CPUID_TRAPPED_TICKS 1000
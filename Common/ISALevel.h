@@ -0,0 +1,102 @@
+//
+// Classification of the executing processor into the x86-64 microarchitecture levels defined by
+// the x86-64 psABI (System V Application Binary Interface), used by compilers as targets for
+// builds, e.g. -march=x86-64-v3 with GCC and Clang:
+//   x86-64-v1: The baseline of all x86-64 processors: CMOV, CX8, FPU, FXSR, MMX, SSE and SSE2.
+//   x86-64-v2: CMPXCHG16B, LAHF/SAHF, POPCNT, SSE3, SSE4.1, SSE4.2 and SSSE3.
+//   x86-64-v3: AVX, AVX2, BMI1, BMI2, F16C, FMA, LZCNT, MOVBE and OSXSAVE.
+//   x86-64-v4: AVX512F, AVX512BW, AVX512CD, AVX512DQ and AVX512VL.
+// A level requires all features of the level and the levels below it, and the features depending on
+// extended processor state must be usable (see OSSupport.h), so the level is the highest level of a
+// build that can run on the system. The baseline also requires long mode (64-bit), which means
+// a 32-bit processor is level 0. The SCE (SYSCALL) flag of the baseline is not checked, since Intel
+// processors only report it when executing in 64-bit mode.
+//
+// In addition, the AVX10 version is reported by function id 0x24, when the AVX10 flag is set
+// (function id 7, sub-function id 1, EDX bit 19). AVX10 is the converged vector instruction set of
+// newer Intel processors, AVX10.1 being the AVX-512 instruction set of Sapphire Rapids. Function id
+// 0x24 EBX also reports the vector lengths supported, bits 16, 17 and 18 for 128, 256 and 512 bits.
+// From AVX10.2 all implementations support 512 bits.
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include "FeatureRegistry.h"
+
+// The level, named X86Level since ISALevel is the name of the function exported by the library and custom action.
+enum X86Level { X86LevelNone, X86LevelV1, X86LevelV2, X86LevelV3, X86LevelV4, X86LevelCount };
+
+static const char* const x86_level_names[X86LevelCount] = { "none", "x86-64-v1", "x86-64-v2", "x86-64-v3", "x86-64-v4" };
+
+struct X86LevelFeature {
+	X86Level level;
+	Feature feature;
+};
+
+static const X86LevelFeature x86_level_features[] = {
+	{ X86LevelV1, Feature_LM },
+	{ X86LevelV1, Feature_CMOV },
+	{ X86LevelV1, Feature_CX8 },
+	{ X86LevelV1, Feature_FPU },
+	{ X86LevelV1, Feature_FXSR },
+	{ X86LevelV1, Feature_MMX },
+	{ X86LevelV1, Feature_SSE },
+	{ X86LevelV1, Feature_SSE2 },
+	{ X86LevelV2, Feature_CMPXCHG16B },
+	{ X86LevelV2, Feature_LAHF },
+	{ X86LevelV2, Feature_POPCNT },
+	{ X86LevelV2, Feature_SSE3 },
+	{ X86LevelV2, Feature_SSE41 },
+	{ X86LevelV2, Feature_SSE42 },
+	{ X86LevelV2, Feature_SSSE3 },
+	{ X86LevelV3, Feature_AVX },
+	{ X86LevelV3, Feature_AVX2 },
+	{ X86LevelV3, Feature_BMI1 },
+	{ X86LevelV3, Feature_BMI2 },
+	{ X86LevelV3, Feature_F16C },
+	{ X86LevelV3, Feature_FMA },
+	{ X86LevelV3, Feature_LZCNT },
+	{ X86LevelV3, Feature_MOVBE },
+	{ X86LevelV3, Feature_OSXSAVE },
+	{ X86LevelV4, Feature_AVX512F },
+	{ X86LevelV4, Feature_AVX512BW },
+	{ X86LevelV4, Feature_AVX512CD },
+	{ X86LevelV4, Feature_AVX512DQ },
+	{ X86LevelV4, Feature_AVX512VL },
+};
+static const size_t x86_level_feature_count = sizeof(x86_level_features) / sizeof(x86_level_features[0]);
+
+// Usable support of a feature required by a level. LZCNT is the same bit as ABM, which is how it is
+// reported in the registry for AMD processors.
+static inline bool x86_level_feature_usable(const FeatureSnapshot& snapshot, Feature feature)
+{
+	if (feature == Feature_LZCNT)
+		return feature_usable(snapshot, Feature_LZCNT) || feature_usable(snapshot, Feature_ABM);
+	return feature_usable(snapshot, feature);
+}
+
+// Highest level with all features of it and the levels below usable.
+static inline X86Level isa_level(const FeatureSnapshot& snapshot)
+{
+	X86Level level = X86LevelV4;
+	for (size_t i = 0; i < x86_level_feature_count; ++i) {
+		if (x86_level_features[i].level <= level && !x86_level_feature_usable(snapshot, x86_level_features[i].feature))
+			level = static_cast<X86Level>(x86_level_features[i].level - 1);
+	}
+	return level;
+}
+
+// AVX10 version, 0 if AVX10 is not usable.
+static inline unsigned int avx10_version(const FeatureSnapshot& snapshot)
+{
+	return feature_usable(snapshot, Feature_AVX10) ? snapshot.words[FeatureWord_Function24_EBX] & 0xff : 0;
+}
+
+// Maximum AVX10 vector length in bits, 0 if AVX10 is not usable.
+static inline unsigned int avx10_vector_length(const FeatureSnapshot& snapshot)
+{
+	if (!avx10_version(snapshot))
+		return 0;
+	const unsigned int ebx = snapshot.words[FeatureWord_Function24_EBX];
+	return ebx & (1u << 18) ? 512 : ebx & (1u << 17) ? 256 : ebx & (1u << 16) ? 128 : 0;
+}
@@ -0,0 +1,84 @@
+//
+// Portable access to the cpuid, xgetbv and rdtsc instructions, with the same names and signatures
+// as the Microsoft-specific intrinsics __cpuid, __cpuidex, _xgetbv and __rdtsc, so that the code
+// written for the Microsoft (Visual C++) compiler also builds with GCC and Clang.
+//
+// On Microsoft this just includes <intrin.h>. On other compilers for x86 and x64 it uses the
+// __cpuid_count macro from <cpuid.h>, which generates the cpuid instruction with inline assembly
+// the same way as _cpuid() in CPUFeatures.cpp, and inline assembly for xgetbv, so that it does not
+// require compiling with -mxsave. The GCC/Clang <cpuid.h> defines __cpuid as a macro with a different
+// signature, and newer versions of it also define __cpuidex, so the names are redirected to
+// functions defined here. On other architectures all the functions just return zero, which
+// means that none of the x86 features are reported as supported.
+//
+// CPUFEATURES_TARGET("avx2,fma") marks a function containing code for a specific instruction set,
+// when using intrinsics for an instruction set beyond the baseline of the build: The Microsoft
+// compiler allows intrinsics of any instruction set in any function, while GCC and Clang require
+// a target attribute, which only affects that function, so the rest of the code can still run on
+// processors not supporting the instruction set. The function must only be called after checking
+// that the processor and operating system support it.
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+#define CPUFEATURES_TARGET(instruction_sets)
+
+#elif defined(__x86_64__) || defined(__i386__)
+
+#include <cpuid.h>
+#include <x86intrin.h>
+
+#undef __cpuid
+#undef __cpuidex
+#undef _xgetbv
+#define __cpuid _cpufeatures_cpuid
+#define __cpuidex _cpufeatures_cpuidex
+#define _xgetbv _cpufeatures_xgetbv
+
+static inline void _cpufeatures_cpuidex(int cpu_info[4], int function_id, int subfunction_id)
+{
+	unsigned int eax, ebx, ecx, edx;
+	__cpuid_count(static_cast<unsigned int>(function_id), static_cast<unsigned int>(subfunction_id), eax, ebx, ecx, edx);
+	cpu_info[0] = static_cast<int>(eax);
+	cpu_info[1] = static_cast<int>(ebx);
+	cpu_info[2] = static_cast<int>(ecx);
+	cpu_info[3] = static_cast<int>(edx);
+}
+
+static inline void _cpufeatures_cpuid(int cpu_info[4], int function_id)
+{
+	_cpufeatures_cpuidex(cpu_info, function_id, 0);
+}
+
+static inline unsigned long long _cpufeatures_xgetbv(unsigned int xcr)
+{
+	unsigned int eax, edx;
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" /* XGETBV */ : "=a"(eax), "=d"(edx) : "c"(xcr));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+}
+
+#ifndef _XCR_XFEATURE_ENABLED_MASK
+#define _XCR_XFEATURE_ENABLED_MASK 0
+#endif
+
+#define CPUFEATURES_TARGET(instruction_sets) __attribute__((target(instruction_sets)))
+
+#else
+
+#include <string.h>
+#include <stdint.h>
+
+static inline void __cpuidex(int cpu_info[4], int, int) { memset(cpu_info, 0, 4 * sizeof(int)); }
+static inline void __cpuid(int cpu_info[4], int) { memset(cpu_info, 0, 4 * sizeof(int)); }
+static inline unsigned long long _xgetbv(unsigned int) { return 0; }
+static inline unsigned long long __rdtsc() { return 0; }
+
+#define _XCR_XFEATURE_ENABLED_MASK 0
+#define CPUFEATURES_TARGET(instruction_sets)
+
+#endif
@@ -0,0 +1,909 @@
+//
+// Utility kernels optimized for different instruction sets, each selecting the best variant the
+// executing processor and operating system support through the runtime dispatcher (see Dispatch.h),
+// as a showcase of the feature detection and for benchmarking the variants against each other:
+//
+//   crc32c       CRC-32C (Castagnoli) of a buffer: Table driven, the SSE4.2 crc32 instruction,
+//                folding 64 bytes per iteration with PCLMULQDQ, and 256 bytes with VPCLMULQDQ on
+//                512-bit vectors. The same convention as zlib's crc32: Start with 0, and continue
+//                with the result of the previous buffer. The check value of "123456789" is 0xE3069283.
+//   popcount     Number of bits set in a buffer: Portable bit twiddling (SWAR), the POPCNT
+//                instruction, AVX2 nibble lookups with vpshufb, and AVX-512 VPOPCNTDQ.
+//   copy_bytes   Copy of a buffer, like memcpy: Fast short rep movsb (FSRM), AVX-512, AVX,
+//                enhanced rep movsb (ERMS), SSE2, and memcpy of the C runtime.
+//   aes128_ctr   AES-128 encryption or decryption in counter (CTR) mode, with the last 8 bytes of the
+//                counter block as a big-endian 64-bit counter (as in NIST SP 800-38A, appendix F.5):
+//                Portable constant-time implementation with a bitsliced S-box, 4 blocks at a time,
+//                AES-NI with 8 blocks in flight, and VAES with 256-bit (AVX2) and 512-bit (AVX-512)
+//                vectors.
+//   random_fill  Fill of a buffer with random bytes from the processor's generator, RDRAND or
+//                RDSEED. Returns the number of bytes filled, which is less than requested if the
+//                generator repeatedly failed to deliver, and 0 if the processor has none.
+//
+// The vector variants are only built for x64, on other architectures only the portable
+// variants are registered. The feature checks use the cached feature snapshot of the module
+// (see FeatureCache.h), and the dispatchers are function-local statics, resolved on first call
+// of each kernel. The dispatcher of each kernel is accessible, e.g. crc32c_dispatcher(), for
+// enumerating and calling each of its variants directly, as done by the CPUFeaturesBenchmark.
+//
+// Header-only, shared by the CPUFeaturesLibrary and the CPUFeaturesBenchmark.
+//
+// See also: https://www.intel.com/content/dam/www/public/us/en/documents/white-papers/fast-crc-computation-generic-polynomials-pclmulqdq-paper.pdf
+//
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Intrinsics.h"
+#include "FeatureCache.h"
+#include "Dispatch.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define KERNELS_X64
+#endif
+
+// GCC 12 warns about the undefined lanes that its own AVX-512 intrinsics start from (GCC bug 105593),
+// which are not uses of uninitialized values in the kernels.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Feature checks of the variants, from the cached snapshot.
+
+static inline int _kernel_usable(Feature feature) { return feature_usable(cached_feature_snapshot().features, feature) ? 1 : 0; }
+
+static inline int kernel_has_sse2(void) { return _kernel_usable(Feature_SSE2); }
+static inline int kernel_has_sse42(void) { return _kernel_usable(Feature_SSE42); }
+static inline int kernel_has_pclmul(void) { return kernel_has_sse42() && _kernel_usable(Feature_PCLMULQDQ); }
+static inline int kernel_has_vpclmul(void) { return kernel_has_pclmul() && _kernel_usable(Feature_VPCLMULQDQ) && _kernel_usable(Feature_AVX512F); }
+static inline int kernel_has_popcnt(void) { return _kernel_usable(Feature_POPCNT); }
+static inline int kernel_has_avx(void) { return _kernel_usable(Feature_AVX); }
+static inline int kernel_has_avx2(void) { return _kernel_usable(Feature_AVX2); }
+static inline int kernel_has_avx512f(void) { return _kernel_usable(Feature_AVX512F); }
+static inline int kernel_has_avx512popcntdq(void) { return kernel_has_avx512f() && _kernel_usable(Feature_AVX512POPCNTDQ); }
+static inline int kernel_has_erms(void) { return _kernel_usable(Feature_ERMS); }
+static inline int kernel_has_fsrm(void) { return _kernel_usable(Feature_FSRM); }
+static inline int kernel_has_aesni(void) { return _kernel_usable(Feature_SSE41) && _kernel_usable(Feature_AES); } // The variants are built for SSE4.1 as well
+static inline int kernel_has_vaes_avx2(void) { return kernel_has_aesni() && kernel_has_avx2() && _kernel_usable(Feature_VAES); }
+static inline int kernel_has_vaes_avx512(void) { return kernel_has_vaes_avx2() && kernel_has_avx512f(); }
+static inline int kernel_has_rdrand(void) { return _kernel_usable(Feature_RDRAND); }
+static inline int kernel_has_rdseed(void) { return _kernel_usable(Feature_RDSEED); }
+
+static inline uint64_t _kernel_load64(const unsigned char* p) { uint64_t value; memcpy(&value, p, 8); return value; }
+
+static inline uint64_t _kernel_load_be64(const unsigned char* p)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i)
+		value = (value << 8) | p[i];
+	return value;
+}
+
+static inline void _kernel_store_be64(unsigned char* p, uint64_t value)
+{
+	for (int i = 7; i >= 0; --i, value >>= 8)
+		p[i] = static_cast<unsigned char>(value);
+}
+
+static inline uint64_t _kernel_bswap64(uint64_t value)
+{
+	value = ((value & 0x00FF00FF00FF00FFull) << 8) | ((value >> 8) & 0x00FF00FF00FF00FFull);
+	value = ((value & 0x0000FFFF0000FFFFull) << 16) | ((value >> 16) & 0x0000FFFF0000FFFFull);
+	return (value << 32) | (value >> 32);
+}
+
+//
+// CRC-32C
+//
+
+#define CRC32C_POLYNOMIAL 0x82F63B78u // Bit-reflected
+
+static inline const uint32_t* _crc32c_table()
+{
+	static const struct Table {
+		uint32_t entries[256];
+		Table()
+		{
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t crc = i;
+				for (int bit = 0; bit < 8; ++bit)
+					crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+				entries[i] = crc;
+			}
+		}
+	} table;
+	return table.entries;
+}
+
+static inline uint32_t crc32c_scalar(uint32_t crc, const void* data, size_t size)
+{
+	const uint32_t* table = _crc32c_table();
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	crc = ~crc;
+	for (; size; --size)
+		crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+#ifdef KERNELS_X64
+
+// Folding constant for a distance of n bits: x^n mod P, in the bit-reflected convention of the
+// polynomial, shifted left by one since the carry-less product of reflected values is one bit short.
+static constexpr uint64_t _crc32c_fold_constant(unsigned int n)
+{
+	uint32_t remainder = 0x80000000u; // x^0
+	for (unsigned int i = 0; i < n; ++i)
+		remainder = (remainder & 1) ? (remainder >> 1) ^ CRC32C_POLYNOMIAL : remainder >> 1;
+	return static_cast<uint64_t>(remainder) << 1;
+}
+
+CPUFEATURES_TARGET("sse4.2")
+static inline uint32_t _crc32c_sse42_update(uint32_t state, const unsigned char* p, size_t size)
+{
+	uint64_t state64 = state;
+	for (; size >= 8; p += 8, size -= 8)
+		state64 = _mm_crc32_u64(state64, _kernel_load64(p));
+	state = static_cast<uint32_t>(state64);
+	for (; size; --size)
+		state = _mm_crc32_u8(state, *p++);
+	return state;
+}
+
+CPUFEATURES_TARGET("sse4.2")
+static inline uint32_t crc32c_sse42(uint32_t crc, const void* data, size_t size)
+{
+	return ~_crc32c_sse42_update(~crc, static_cast<const unsigned char*>(data), size);
+}
+
+// Constants for folding 128 bits across a distance, low qword for the low half, high qword for the high half.
+CPUFEATURES_TARGET("sse4.2,pclmul")
+static inline __m128i _crc32c_fold_constants(uint64_t low, uint64_t high)
+{
+	return _mm_set_epi64x(static_cast<long long>(high), static_cast<long long>(low));
+}
+
+CPUFEATURES_TARGET("sse4.2,pclmul")
+static inline __m128i _crc32c_fold(__m128i value, __m128i constants, __m128i data)
+{
+	return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(value, constants, 0x00), _mm_clmulepi64_si128(value, constants, 0x11)), data);
+}
+
+// The remainder of the folded 128 bits, which equals the crc32 instruction on them from a zero state.
+CPUFEATURES_TARGET("sse4.2,pclmul")
+static inline uint32_t _crc32c_reduce(__m128i value)
+{
+	unsigned char bytes[16];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), value);
+	return _crc32c_sse42_update(0, bytes, 16);
+}
+
+CPUFEATURES_TARGET("sse4.2,pclmul")
+static inline uint32_t _crc32c_pclmul_update(uint32_t state, const unsigned char* p, size_t size)
+{
+	if (size < 64)
+		return _crc32c_sse42_update(state, p, size);
+	static constexpr uint64_t k512_low = _crc32c_fold_constant(512 + 32), k512_high = _crc32c_fold_constant(512 - 32);
+	static constexpr uint64_t k128_low = _crc32c_fold_constant(128 + 32), k128_high = _crc32c_fold_constant(128 - 32);
+	const __m128i k512 = _crc32c_fold_constants(k512_low, k512_high);
+	const __m128i k128 = _crc32c_fold_constants(k128_low, k128_high);
+	__m128i x0 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_cvtsi32_si128(static_cast<int>(state)));
+	__m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+	__m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+	__m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48));
+	for (p += 64, size -= 64; size >= 64; p += 64, size -= 64) {
+		x0 = _crc32c_fold(x0, k512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+		x1 = _crc32c_fold(x1, k512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)));
+		x2 = _crc32c_fold(x2, k512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32)));
+		x3 = _crc32c_fold(x3, k512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48)));
+	}
+	x1 = _crc32c_fold(x0, k128, x1);
+	x2 = _crc32c_fold(x1, k128, x2);
+	x3 = _crc32c_fold(x2, k128, x3);
+	return _crc32c_sse42_update(_crc32c_reduce(x3), p, size);
+}
+
+CPUFEATURES_TARGET("sse4.2,pclmul")
+static inline uint32_t crc32c_pclmul(uint32_t crc, const void* data, size_t size)
+{
+	return ~_crc32c_pclmul_update(~crc, static_cast<const unsigned char*>(data), size);
+}
+
+CPUFEATURES_TARGET("sse4.2,pclmul,avx512f,vpclmulqdq")
+static inline __m512i _crc32c_fold512(__m512i value, __m512i constants, __m512i data)
+{
+	return _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(value, constants, 0x00), _mm512_clmulepi64_epi128(value, constants, 0x11), data, 0x96); // Three-way xor
+}
+
+CPUFEATURES_TARGET("sse4.2,pclmul,avx512f,vpclmulqdq")
+static inline uint32_t crc32c_vpclmul(uint32_t crc, const void* data, size_t size)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	if (size < 256)
+		return ~_crc32c_pclmul_update(~crc, p, size);
+	static constexpr uint64_t k2048_low = _crc32c_fold_constant(2048 + 32), k2048_high = _crc32c_fold_constant(2048 - 32);
+	static constexpr uint64_t k512_low = _crc32c_fold_constant(512 + 32), k512_high = _crc32c_fold_constant(512 - 32);
+	static constexpr uint64_t k384_low = _crc32c_fold_constant(384 + 32), k384_high = _crc32c_fold_constant(384 - 32);
+	static constexpr uint64_t k256_low = _crc32c_fold_constant(256 + 32), k256_high = _crc32c_fold_constant(256 - 32);
+	static constexpr uint64_t k128_low = _crc32c_fold_constant(128 + 32), k128_high = _crc32c_fold_constant(128 - 32);
+	const __m512i k2048 = _mm512_broadcast_i32x4(_crc32c_fold_constants(k2048_low, k2048_high));
+	const __m512i k512 = _mm512_broadcast_i32x4(_crc32c_fold_constants(k512_low, k512_high));
+	__m512i x0 = _mm512_xor_si512(_mm512_loadu_si512(p), _mm512_castsi128_si512(_mm_cvtsi32_si128(static_cast<int>(~crc))));
+	__m512i x1 = _mm512_loadu_si512(p + 64);
+	__m512i x2 = _mm512_loadu_si512(p + 128);
+	__m512i x3 = _mm512_loadu_si512(p + 192);
+	for (p += 256, size -= 256; size >= 256; p += 256, size -= 256) {
+		x0 = _crc32c_fold512(x0, k2048, _mm512_loadu_si512(p));
+		x1 = _crc32c_fold512(x1, k2048, _mm512_loadu_si512(p + 64));
+		x2 = _crc32c_fold512(x2, k2048, _mm512_loadu_si512(p + 128));
+		x3 = _crc32c_fold512(x3, k2048, _mm512_loadu_si512(p + 192));
+	}
+	x1 = _crc32c_fold512(x0, k512, x1);
+	x2 = _crc32c_fold512(x1, k512, x2);
+	x3 = _crc32c_fold512(x2, k512, x3);
+	// Fold the four 128-bit lanes into the last one, lane i is (3 - i) * 128 bits from the end
+	__m128i x = _crc32c_fold(_mm512_extracti32x4_epi32(x3, 2), _crc32c_fold_constants(k128_low, k128_high), _mm512_extracti32x4_epi32(x3, 3));
+	x = _crc32c_fold(_mm512_extracti32x4_epi32(x3, 1), _crc32c_fold_constants(k256_low, k256_high), x);
+	x = _crc32c_fold(_mm512_extracti32x4_epi32(x3, 0), _crc32c_fold_constants(k384_low, k384_high), x);
+	return ~_crc32c_sse42_update(_crc32c_reduce(x), p, size);
+}
+
+#endif
+
+typedef Dispatcher<uint32_t(uint32_t, const void*, size_t)> CRC32CDispatcher;
+
+static inline const CRC32CDispatcher& crc32c_dispatcher()
+{
+	static const CRC32CDispatcher dispatcher {
+#ifdef KERNELS_X64
+		{ crc32c_vpclmul, kernel_has_vpclmul, "VPCLMULQDQ" },
+		{ crc32c_pclmul,  kernel_has_pclmul,  "PCLMULQDQ" },
+		{ crc32c_sse42,   kernel_has_sse42,   "SSE4.2" },
+#endif
+		{ crc32c_scalar,  nullptr,            "Scalar" },
+	};
+	return dispatcher;
+}
+
+static inline uint32_t crc32c(uint32_t crc, const void* data, size_t size)
+{
+	return crc32c_dispatcher()(crc, data, size);
+}
+
+//
+// Population count
+//
+
+static inline uint64_t _popcount_scalar_word(uint64_t value)
+{
+	value = value - ((value >> 1) & 0x5555555555555555ull);
+	value = (value & 0x3333333333333333ull) + ((value >> 2) & 0x3333333333333333ull);
+	value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return (value * 0x0101010101010101ull) >> 56;
+}
+
+static inline uint64_t popcount_scalar(const void* data, size_t size)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	uint64_t count = 0;
+	for (; size >= 8; p += 8, size -= 8)
+		count += _popcount_scalar_word(_kernel_load64(p));
+	for (; size; --size)
+		count += _popcount_scalar_word(*p++);
+	return count;
+}
+
+#ifdef KERNELS_X64
+
+CPUFEATURES_TARGET("popcnt")
+static inline uint64_t popcount_popcnt(const void* data, size_t size)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	uint64_t counts[4] = {}; // Independent accumulators, for more instructions in flight
+	for (; size >= 32; p += 32, size -= 32) {
+		counts[0] += _mm_popcnt_u64(_kernel_load64(p));
+		counts[1] += _mm_popcnt_u64(_kernel_load64(p + 8));
+		counts[2] += _mm_popcnt_u64(_kernel_load64(p + 16));
+		counts[3] += _mm_popcnt_u64(_kernel_load64(p + 24));
+	}
+	for (; size >= 8; p += 8, size -= 8)
+		counts[0] += _mm_popcnt_u64(_kernel_load64(p));
+	for (; size; --size)
+		counts[1] += _mm_popcnt_u32(*p++);
+	return counts[0] + counts[1] + counts[2] + counts[3];
+}
+
+// Bit counts of each byte, by looking up the count of each nibble.
+CPUFEATURES_TARGET("avx2")
+static inline __m256i _popcount_avx2_bytes(__m256i value)
+{
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0F);
+	return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(value, low_mask)), _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(value, 4), low_mask)));
+}
+
+CPUFEATURES_TARGET("avx2")
+static inline uint64_t popcount_avx2(const void* data, size_t size)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	__m256i total = _mm256_setzero_si256();
+	for (; size >= 128; p += 128, size -= 128) {
+		// The byte counts of four vectors are at most 32, and summed into 64-bit lanes with vpsadbw
+		__m256i counts = _popcount_avx2_bytes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+		counts = _mm256_add_epi8(counts, _popcount_avx2_bytes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32))));
+		counts = _mm256_add_epi8(counts, _popcount_avx2_bytes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 64))));
+		counts = _mm256_add_epi8(counts, _popcount_avx2_bytes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 96))));
+		total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+	}
+	const uint64_t count = static_cast<uint64_t>(_mm256_extract_epi64(total, 0)) + static_cast<uint64_t>(_mm256_extract_epi64(total, 1))
+		+ static_cast<uint64_t>(_mm256_extract_epi64(total, 2)) + static_cast<uint64_t>(_mm256_extract_epi64(total, 3));
+	return count + popcount_scalar(p, size);
+}
+
+CPUFEATURES_TARGET("avx512f,avx512vpopcntdq")
+static inline uint64_t popcount_avx512(const void* data, size_t size)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	__m512i total0 = _mm512_setzero_si512(), total1 = _mm512_setzero_si512();
+	for (; size >= 128; p += 128, size -= 128) {
+		total0 = _mm512_add_epi64(total0, _mm512_popcnt_epi64(_mm512_loadu_si512(p)));
+		total1 = _mm512_add_epi64(total1, _mm512_popcnt_epi64(_mm512_loadu_si512(p + 64)));
+	}
+	return static_cast<uint64_t>(_mm512_reduce_add_epi64(_mm512_add_epi64(total0, total1))) + popcount_scalar(p, size);
+}
+
+#endif
+
+typedef Dispatcher<uint64_t(const void*, size_t)> PopCountDispatcher;
+
+static inline const PopCountDispatcher& popcount_dispatcher()
+{
+	static const PopCountDispatcher dispatcher {
+#ifdef KERNELS_X64
+		{ popcount_avx512, kernel_has_avx512popcntdq, "AVX-512 VPOPCNTDQ" },
+		{ popcount_avx2,   kernel_has_avx2,           "AVX2" },
+		{ popcount_popcnt, kernel_has_popcnt,         "POPCNT" },
+#endif
+		{ popcount_scalar, nullptr,                   "Scalar" },
+	};
+	return dispatcher;
+}
+
+static inline uint64_t popcount(const void* data, size_t size)
+{
+	return popcount_dispatcher()(data, size);
+}
+
+//
+// Copy
+//
+
+static inline void* copy_bytes_memcpy(void* destination, const void* source, size_t size)
+{
+	return memcpy(destination, source, size);
+}
+
+#ifdef KERNELS_X64
+
+// With ERMS rep movsb is the fastest way to copy large buffers, and with FSRM also short ones.
+static inline void* copy_bytes_rep_movsb(void* destination, const void* source, size_t size)
+{
+#if defined(_MSC_VER)
+	__movsb(static_cast<unsigned char*>(destination), static_cast<const unsigned char*>(source), size);
+#else
+	void* d = destination;
+	__asm__ __volatile__("rep movsb" : "+D"(d), "+S"(source), "+c"(size) : : "memory");
+#endif
+	return destination;
+}
+
+CPUFEATURES_TARGET("sse2")
+static inline void* copy_bytes_sse2(void* destination, const void* source, size_t size)
+{
+	unsigned char* d = static_cast<unsigned char*>(destination);
+	const unsigned char* s = static_cast<const unsigned char*>(source);
+	for (; size >= 64; d += 64, s += 64, size -= 64) {
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+		const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+		const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(d), a);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 16), b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 32), c);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 48), e);
+	}
+	memcpy(d, s, size);
+	return destination;
+}
+
+CPUFEATURES_TARGET("avx")
+static inline void* copy_bytes_avx(void* destination, const void* source, size_t size)
+{
+	unsigned char* d = static_cast<unsigned char*>(destination);
+	const unsigned char* s = static_cast<const unsigned char*>(source);
+	for (; size >= 128; d += 128, s += 128, size -= 128) {
+		const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+		const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32));
+		const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 64));
+		const __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 96));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(d), a);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(d + 32), b);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(d + 64), c);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(d + 96), e);
+	}
+	_mm256_zeroupper(); // Before memcpy, which may use legacy SSE encoded instructions
+	memcpy(d, s, size);
+	return destination;
+}
+
+CPUFEATURES_TARGET("avx512f")
+static inline void* copy_bytes_avx512(void* destination, const void* source, size_t size)
+{
+	unsigned char* d = static_cast<unsigned char*>(destination);
+	const unsigned char* s = static_cast<const unsigned char*>(source);
+	for (; size >= 256; d += 256, s += 256, size -= 256) {
+		const __m512i a = _mm512_loadu_si512(s);
+		const __m512i b = _mm512_loadu_si512(s + 64);
+		const __m512i c = _mm512_loadu_si512(s + 128);
+		const __m512i e = _mm512_loadu_si512(s + 192);
+		_mm512_storeu_si512(d, a);
+		_mm512_storeu_si512(d + 64, b);
+		_mm512_storeu_si512(d + 128, c);
+		_mm512_storeu_si512(d + 192, e);
+	}
+	_mm256_zeroupper();
+	memcpy(d, s, size);
+	return destination;
+}
+
+#endif
+
+typedef Dispatcher<void*(void*, const void*, size_t)> CopyBytesDispatcher;
+
+static inline const CopyBytesDispatcher& copy_bytes_dispatcher()
+{
+	static const CopyBytesDispatcher dispatcher {
+#ifdef KERNELS_X64
+		{ copy_bytes_rep_movsb, kernel_has_fsrm,    "FSRM rep movsb" },
+		{ copy_bytes_avx512,    kernel_has_avx512f, "AVX-512" },
+		{ copy_bytes_avx,       kernel_has_avx,     "AVX" },
+		{ copy_bytes_rep_movsb, kernel_has_erms,    "ERMS rep movsb" },
+		{ copy_bytes_sse2,      kernel_has_sse2,    "SSE2" },
+#endif
+		{ copy_bytes_memcpy,    nullptr,            "memcpy" },
+	};
+	return dispatcher;
+}
+
+static inline void* copy_bytes(void* destination, const void* source, size_t size)
+{
+	return copy_bytes_dispatcher()(destination, source, size);
+}
+
+//
+// AES-128 in counter mode
+//
+
+struct AES128Key {
+	alignas(16) unsigned char round_keys[11 * 16]; // The expanded key, in the byte order of the state, as used by AES-NI
+};
+
+// SubBytes bitsliced, 64 bytes at a time, the state of 4 blocks: Plane j holds bit j of each of the
+// bytes, and the S-box is computed on the planes with logic operations instead of looked up in the
+// usual 256-byte table, as the multiplicative inverse in GF(2^8) followed by the affine transformation.
+// No memory access or branch depends on the data, so it leaks no key or data through cache timing.
+
+// Transpose between 64 bytes and their 8 bit planes, which is its own inverse in the reverse order:
+// The 8x8 bit matrix of each word, then the 8x8 byte matrix of the words.
+static inline uint64_t _aes_transpose_bits(uint64_t x)
+{
+	uint64_t t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+	return x ^ t ^ (t << 28);
+}
+
+static inline void _aes_transpose_bytes(uint64_t words[8])
+{
+	static const uint64_t masks[3] = { 0x00000000FFFFFFFFull, 0x0000FFFF0000FFFFull, 0x00FF00FF00FF00FFull };
+	for (int stage = 0, step = 4; step; ++stage, step /= 2) {
+		for (int i = 0; i < 8; ++i) {
+			if (i & step)
+				continue;
+			const uint64_t t = ((words[i] >> (8 * step)) ^ words[i + step]) & masks[stage];
+			words[i + step] ^= t;
+			words[i] ^= t << (8 * step);
+		}
+	}
+}
+
+// Product in GF(2^8) modulo x^8 + x^4 + x^3 + x + 1, of the bit planes.
+static inline void _aes_multiply_planes(const uint64_t a[8], const uint64_t b[8], uint64_t product[8])
+{
+	uint64_t c[15] = {};
+	for (int i = 0; i < 8; ++i) {
+		for (int j = 0; j < 8; ++j)
+			c[i + j] ^= a[i] & b[j];
+	}
+	for (int k = 14; k >= 8; --k) { // x^8 = x^4 + x^3 + x + 1
+		c[k - 4] ^= c[k];
+		c[k - 5] ^= c[k];
+		c[k - 7] ^= c[k];
+		c[k - 8] ^= c[k];
+	}
+	memcpy(product, c, 8 * sizeof(uint64_t));
+}
+
+static inline void _aes_square_planes(const uint64_t a[8], uint64_t square[8], int count)
+{
+	memcpy(square, a, 8 * sizeof(uint64_t));
+	for (int n = 0; n < count; ++n) {
+		uint64_t c[15] = {};
+		for (int i = 0; i < 8; ++i)
+			c[2 * i] = square[i];
+		for (int k = 14; k >= 8; --k) {
+			c[k - 4] ^= c[k];
+			c[k - 5] ^= c[k];
+			c[k - 7] ^= c[k];
+			c[k - 8] ^= c[k];
+		}
+		memcpy(square, c, 8 * sizeof(uint64_t));
+	}
+}
+
+static inline void _aes_sub_bytes64(unsigned char bytes[64])
+{
+	uint64_t x[8];
+	memcpy(x, bytes, sizeof(x));
+	for (int i = 0; i < 8; ++i)
+		x[i] = _aes_transpose_bits(x[i]);
+	_aes_transpose_bytes(x);
+	// The inverse as x^254, which is 0 for 0, by the addition chain 1, 2, 3, 12, 15, 240, 252, 254
+	uint64_t x2[8], x3[8], x12[8], x15[8], x240[8], x252[8], inverse[8];
+	_aes_square_planes(x, x2, 1);
+	_aes_multiply_planes(x2, x, x3);
+	_aes_square_planes(x3, x12, 2);
+	_aes_multiply_planes(x12, x3, x15);
+	_aes_square_planes(x15, x240, 4);
+	_aes_multiply_planes(x240, x12, x252);
+	_aes_multiply_planes(x252, x2, inverse);
+	for (int i = 0; i < 8; ++i) // Affine transformation: Each bit with the 4 bits below it, rotating, and 0x63
+		x[i] = inverse[i] ^ inverse[(i + 4) % 8] ^ inverse[(i + 5) % 8] ^ inverse[(i + 6) % 8] ^ inverse[(i + 7) % 8] ^ ((0x63 >> i) & 1 ? ~0ull : 0);
+	_aes_transpose_bytes(x);
+	for (int i = 0; i < 8; ++i)
+		x[i] = _aes_transpose_bits(x[i]);
+	memcpy(bytes, x, sizeof(x));
+}
+
+static inline void aes128_expand_key(const unsigned char key[16], AES128Key& expanded)
+{
+	static const unsigned char rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+	unsigned char* w = expanded.round_keys;
+	memcpy(w, key, 16);
+	for (int i = 16; i < 11 * 16; i += 4) {
+		unsigned char t[4] = { w[i - 4], w[i - 3], w[i - 2], w[i - 1] };
+		if (i % 16 == 0) { // RotWord, SubWord and the round constant
+			unsigned char word[64] = { t[1], t[2], t[3], t[0] };
+			_aes_sub_bytes64(word);
+			t[0] = static_cast<unsigned char>(word[0] ^ rcon[i / 16 - 1]);
+			t[1] = word[1];
+			t[2] = word[2];
+			t[3] = word[3];
+		}
+		for (int j = 0; j < 4; ++j)
+			w[i + j] = static_cast<unsigned char>(w[i - 16 + j] ^ t[j]);
+	}
+}
+
+static inline unsigned char _aes_xtime(unsigned char value)
+{
+	return static_cast<unsigned char>((value << 1) ^ (0x1b & -(value >> 7))); // Masked instead of a branch on the data
+}
+
+// Encryption of 4 blocks in place, as one bitsliced state.
+static inline void _aes128_encrypt_blocks(const AES128Key& key, unsigned char blocks[64])
+{
+	unsigned char state[64];
+	for (int i = 0; i < 64; ++i)
+		state[i] = static_cast<unsigned char>(blocks[i] ^ key.round_keys[i % 16]);
+	for (int round = 1; round <= 10; ++round) {
+		unsigned char shifted[64]; // SubBytes and ShiftRows, each state is column-major: Byte i is row i % 4 of column i / 4
+		_aes_sub_bytes64(state);
+		for (int i = 0; i < 64; ++i)
+			shifted[i] = state[(i & ~15) + ((i % 16) + 4 * (i % 4)) % 16];
+		for (int column = 0; column < 16 && round < 10; ++column) { // MixColumns, except in the last round
+			unsigned char* c = shifted + 4 * column;
+			const unsigned char a0 = c[0], a1 = c[1], a2 = c[2], a3 = c[3], all = static_cast<unsigned char>(a0 ^ a1 ^ a2 ^ a3);
+			c[0] = static_cast<unsigned char>(a0 ^ all ^ _aes_xtime(static_cast<unsigned char>(a0 ^ a1)));
+			c[1] = static_cast<unsigned char>(a1 ^ all ^ _aes_xtime(static_cast<unsigned char>(a1 ^ a2)));
+			c[2] = static_cast<unsigned char>(a2 ^ all ^ _aes_xtime(static_cast<unsigned char>(a2 ^ a3)));
+			c[3] = static_cast<unsigned char>(a3 ^ all ^ _aes_xtime(static_cast<unsigned char>(a3 ^ a0)));
+		}
+		for (int i = 0; i < 64; ++i)
+			state[i] = static_cast<unsigned char>(shifted[i] ^ key.round_keys[16 * round + i % 16]);
+	}
+	memcpy(blocks, state, 64);
+}
+
+// Counter block number index after the initial one, incrementing the last 8 bytes as a big-endian counter.
+static inline void _aes_counter_block(const unsigned char counter[16], uint64_t index, unsigned char block[16])
+{
+	memcpy(block, counter, 8);
+	_kernel_store_be64(block + 8, _kernel_load_be64(counter + 8) + index);
+}
+
+static inline void _aes_xor_keystream(const unsigned char* keystream, const unsigned char* input, unsigned char* output, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+		output[i] = static_cast<unsigned char>(input[i] ^ keystream[i]);
+}
+
+static inline void aes128_ctr_scalar(const AES128Key& key, const unsigned char* counter, const void* input, void* output, size_t size)
+{
+	const unsigned char* in = static_cast<const unsigned char*>(input);
+	unsigned char* out = static_cast<unsigned char*>(output);
+	for (uint64_t index = 0; size; index += 4) {
+		unsigned char blocks[64];
+		for (int i = 0; i < 4; ++i)
+			_aes_counter_block(counter, index + i, blocks + 16 * i);
+		_aes128_encrypt_blocks(key, blocks);
+		const size_t length = size < 64 ? size : 64;
+		_aes_xor_keystream(blocks, in, out, length);
+		in += length;
+		out += length;
+		size -= length;
+	}
+}
+
+#ifdef KERNELS_X64
+
+// Counter block number index after the initial one: The first 8 bytes as is, and the counter byte swapped.
+CPUFEATURES_TARGET("aes,sse4.1")
+static inline __m128i _aes_counter_block_aesni(uint64_t prefix, uint64_t base, uint64_t index)
+{
+	return _mm_set_epi64x(static_cast<long long>(_kernel_bswap64(base + index)), static_cast<long long>(prefix));
+}
+
+CPUFEATURES_TARGET("aes,sse4.1")
+static inline void _aes128_load_round_keys(const AES128Key& key, __m128i round_keys[11])
+{
+	for (int i = 0; i < 11; ++i)
+		round_keys[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(key.round_keys + 16 * i));
+}
+
+// The blocks from index, one at a time, including a final partial block.
+CPUFEATURES_TARGET("aes,sse4.1")
+static inline void _aes128_ctr_aesni_tail(const __m128i round_keys[11], uint64_t prefix, uint64_t base, uint64_t index, const unsigned char* in, unsigned char* out, size_t size)
+{
+	for (; size; ++index) {
+		__m128i block = _mm_xor_si128(_aes_counter_block_aesni(prefix, base, index), round_keys[0]);
+		for (int round = 1; round < 10; ++round)
+			block = _mm_aesenc_si128(block, round_keys[round]);
+		block = _mm_aesenclast_si128(block, round_keys[10]);
+		if (size >= 16) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_xor_si128(block, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in))));
+			in += 16;
+			out += 16;
+			size -= 16;
+		} else {
+			unsigned char keystream[16];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(keystream), block);
+			_aes_xor_keystream(keystream, in, out, size);
+			size = 0;
+		}
+	}
+}
+
+CPUFEATURES_TARGET("aes,sse4.1")
+static inline void aes128_ctr_aesni(const AES128Key& key, const unsigned char* counter, const void* input, void* output, size_t size)
+{
+	const unsigned char* in = static_cast<const unsigned char*>(input);
+	unsigned char* out = static_cast<unsigned char*>(output);
+	const uint64_t prefix = _kernel_load64(counter), base = _kernel_load_be64(counter + 8);
+	__m128i round_keys[11];
+	_aes128_load_round_keys(key, round_keys);
+	uint64_t index = 0;
+	for (; size >= 8 * 16; index += 8, in += 8 * 16, out += 8 * 16, size -= 8 * 16) {
+		__m128i blocks[8]; // Independent blocks, to keep the pipelined AES unit busy
+		for (int i = 0; i < 8; ++i)
+			blocks[i] = _mm_xor_si128(_aes_counter_block_aesni(prefix, base, index + i), round_keys[0]);
+		for (int round = 1; round < 10; ++round) {
+			for (int i = 0; i < 8; ++i)
+				blocks[i] = _mm_aesenc_si128(blocks[i], round_keys[round]);
+		}
+		for (int i = 0; i < 8; ++i) {
+			blocks[i] = _mm_aesenclast_si128(blocks[i], round_keys[10]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * i), _mm_xor_si128(blocks[i], _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16 * i))));
+		}
+	}
+	_aes128_ctr_aesni_tail(round_keys, prefix, base, index, in, out, size);
+}
+
+CPUFEATURES_TARGET("aes,sse4.1,avx2,vaes")
+static inline void aes128_ctr_vaes_avx2(const AES128Key& key, const unsigned char* counter, const void* input, void* output, size_t size)
+{
+	const unsigned char* in = static_cast<const unsigned char*>(input);
+	unsigned char* out = static_cast<unsigned char*>(output);
+	const uint64_t prefix = _kernel_load64(counter), base = _kernel_load_be64(counter + 8);
+	__m128i round_keys[11];
+	__m256i round_keys256[11];
+	_aes128_load_round_keys(key, round_keys);
+	for (int i = 0; i < 11; ++i)
+		round_keys256[i] = _mm256_broadcastsi128_si256(round_keys[i]);
+	uint64_t index = 0;
+	for (; size >= 8 * 16; index += 8, in += 8 * 16, out += 8 * 16, size -= 8 * 16) {
+		__m256i blocks[4]; // Two blocks in each vector
+		for (int i = 0; i < 4; ++i) {
+			const uint64_t block_index = index + 2 * i;
+			blocks[i] = _mm256_xor_si256(_mm256_set_epi64x(static_cast<long long>(_kernel_bswap64(base + block_index + 1)), static_cast<long long>(prefix),
+				static_cast<long long>(_kernel_bswap64(base + block_index)), static_cast<long long>(prefix)), round_keys256[0]);
+		}
+		for (int round = 1; round < 10; ++round) {
+			for (int i = 0; i < 4; ++i)
+				blocks[i] = _mm256_aesenc_epi128(blocks[i], round_keys256[round]);
+		}
+		for (int i = 0; i < 4; ++i) {
+			blocks[i] = _mm256_aesenclast_epi128(blocks[i], round_keys256[10]);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32 * i), _mm256_xor_si256(blocks[i], _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32 * i))));
+		}
+	}
+	_mm256_zeroupper();
+	_aes128_ctr_aesni_tail(round_keys, prefix, base, index, in, out, size);
+}
+
+CPUFEATURES_TARGET("aes,sse4.1,avx2,avx512f,vaes")
+static inline void aes128_ctr_vaes_avx512(const AES128Key& key, const unsigned char* counter, const void* input, void* output, size_t size)
+{
+	const unsigned char* in = static_cast<const unsigned char*>(input);
+	unsigned char* out = static_cast<unsigned char*>(output);
+	const uint64_t prefix = _kernel_load64(counter), base = _kernel_load_be64(counter + 8);
+	__m128i round_keys[11];
+	__m512i round_keys512[11];
+	_aes128_load_round_keys(key, round_keys);
+	for (int i = 0; i < 11; ++i)
+		round_keys512[i] = _mm512_broadcast_i32x4(round_keys[i]);
+	const long long p = static_cast<long long>(prefix);
+	uint64_t index = 0;
+	for (; size >= 16 * 16; index += 16, in += 16 * 16, out += 16 * 16, size -= 16 * 16) {
+		__m512i blocks[4]; // Four blocks in each vector
+		for (int i = 0; i < 4; ++i) {
+			const uint64_t c = base + index + 4 * i;
+			blocks[i] = _mm512_xor_si512(_mm512_set_epi64(static_cast<long long>(_kernel_bswap64(c + 3)), p, static_cast<long long>(_kernel_bswap64(c + 2)), p,
+				static_cast<long long>(_kernel_bswap64(c + 1)), p, static_cast<long long>(_kernel_bswap64(c)), p), round_keys512[0]);
+		}
+		for (int round = 1; round < 10; ++round) {
+			for (int i = 0; i < 4; ++i)
+				blocks[i] = _mm512_aesenc_epi128(blocks[i], round_keys512[round]);
+		}
+		for (int i = 0; i < 4; ++i) {
+			blocks[i] = _mm512_aesenclast_epi128(blocks[i], round_keys512[10]);
+			_mm512_storeu_si512(out + 64 * i, _mm512_xor_si512(blocks[i], _mm512_loadu_si512(in + 64 * i)));
+		}
+	}
+	_mm256_zeroupper();
+	_aes128_ctr_aesni_tail(round_keys, prefix, base, index, in, out, size);
+}
+
+#endif
+
+typedef Dispatcher<void(const AES128Key&, const unsigned char*, const void*, void*, size_t)> AES128CTRDispatcher;
+
+static inline const AES128CTRDispatcher& aes128_ctr_dispatcher()
+{
+	static const AES128CTRDispatcher dispatcher {
+#ifdef KERNELS_X64
+		{ aes128_ctr_vaes_avx512, kernel_has_vaes_avx512, "VAES (AVX-512)" },
+		{ aes128_ctr_vaes_avx2,   kernel_has_vaes_avx2,   "VAES (AVX2)" },
+		{ aes128_ctr_aesni,       kernel_has_aesni,       "AES-NI" },
+#endif
+		{ aes128_ctr_scalar,      nullptr,                "Scalar" },
+	};
+	return dispatcher;
+}
+
+// Encrypt, or decrypt, size bytes from input to output, which may be the same buffer. The key is expanded
+// on each call, use the dispatcher with an expanded key directly when encrypting many short buffers.
+static inline void aes128_ctr(const unsigned char key[16], const unsigned char counter[16], const void* input, void* output, size_t size)
+{
+	AES128Key expanded;
+	aes128_expand_key(key, expanded);
+	aes128_ctr_dispatcher()(expanded, counter, input, output, size);
+}
+
+//
+// Random fill
+//
+
+#define RANDOM_FILL_RETRIES 10 // Attempts for each 8 bytes, as recommended by Intel for RDRAND
+
+static inline size_t random_fill_none(void*, size_t)
+{
+	return 0;
+}
+
+#ifdef KERNELS_X64
+
+CPUFEATURES_TARGET("rdrnd")
+static inline size_t random_fill_rdrand(void* data, size_t size)
+{
+	unsigned char* p = static_cast<unsigned char*>(data);
+	size_t filled = 0;
+	while (filled < size) {
+		unsigned long long value;
+		int retries = RANDOM_FILL_RETRIES;
+		while (!_rdrand64_step(&value)) {
+			if (--retries == 0)
+				return filled;
+		}
+		const size_t length = size - filled < 8 ? size - filled : 8;
+		memcpy(p + filled, &value, length);
+		filled += length;
+	}
+	return filled;
+}
+
+CPUFEATURES_TARGET("rdseed")
+static inline size_t random_fill_rdseed(void* data, size_t size)
+{
+	unsigned char* p = static_cast<unsigned char*>(data);
+	size_t filled = 0;
+	while (filled < size) {
+		unsigned long long value;
+		int retries = RANDOM_FILL_RETRIES;
+		while (!_rdseed64_step(&value)) {
+			if (--retries == 0)
+				return filled;
+			_mm_pause(); // The entropy source is slower than the generator, give it time to reseed
+		}
+		const size_t length = size - filled < 8 ? size - filled : 8;
+		memcpy(p + filled, &value, length);
+		filled += length;
+	}
+	return filled;
+}
+
+#endif
+
+typedef Dispatcher<size_t(void*, size_t)> RandomFillDispatcher;
+
+static inline const RandomFillDispatcher& random_fill_dispatcher()
+{
+	static const RandomFillDispatcher dispatcher {
+#ifdef KERNELS_X64
+		{ random_fill_rdrand, kernel_has_rdrand, "RDRAND" },
+		{ random_fill_rdseed, kernel_has_rdseed, "RDSEED" },
+#endif
+		{ random_fill_none,   nullptr,           "None" },
+	};
+	return dispatcher;
+}
+
+static inline size_t random_fill(void* data, size_t size)
+{
+	return random_fill_dispatcher()(data, size);
+}
+
+// Name of the variant selected for a kernel by name: "crc32c", "popcount", "copy", "aes128-ctr" or "random", nullptr if unknown.
+static inline const char* kernel_variant(const char* kernel)
+{
+	if (!kernel)
+		return nullptr;
+	if (strcmp(kernel, "crc32c") == 0)
+		return crc32c_dispatcher().name();
+	if (strcmp(kernel, "popcount") == 0)
+		return popcount_dispatcher().name();
+	if (strcmp(kernel, "copy") == 0)
+		return copy_bytes_dispatcher().name();
+	if (strcmp(kernel, "aes128-ctr") == 0)
+		return aes128_ctr_dispatcher().name();
+	if (strcmp(kernel, "random") == 0)
+		return random_fill_dispatcher().name();
+	return nullptr;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,215 @@
+//
+// Sampling the dynamic state of a processor core, for continuous monitoring: Its effective frequency
+// and whether it is throttled, together with the thermal and power management capabilities reported
+// by function id 6.
+//
+// The effective frequency is taken from the first of the following sources available:
+// - APERF and MPERF (MSRs 0xE8 and 0xE7, function id 6 ECX bit 0): APERF counts at the actual core
+//   frequency and MPERF at a constant rate, the TSC frequency, both only while the core is not
+//   halted, so the ratio of their increments times the TSC frequency is the average frequency while
+//   running since the previous sample, including the drops of AVX-512 and AMX license transitions and
+//   of throttling, at no cost to the core. Reading MSRs requires the msr driver on Linux
+//   (/dev/cpu/N/msr, the msr module and root or CAP_SYS_RAWIO); other operating systems have no
+//   user mode access, and hypervisors normally do not expose them.
+// - Probe: Timing a short dependent chain with a known number of cycles (see CycleCounter.h), about
+//   0.2 ms, which is the frequency the core runs at when woken up to execute scalar code, not the
+//   average of what it executed, but notices throttling and a lower turbo ratio of the whole package.
+//
+// Throttling is reported as the current state, from IA32_THERM_STATUS (MSR 0x19C, Intel, with the
+// digital thermal sensor of function id 6 EAX bit 0): Bit 0 thermal monitor active (PROCHOT), and
+// bit 10 power limitation, below the requested performance state because of a power or current limit.
+// And as cumulative counts of events, which also catch throttling between samples, from Linux
+// /sys/devices/system/cpu/cpuN/thermal_throttle, maintained by the kernel's thermal interrupt handler
+// without requiring root, for the core and its package.
+//
+// Header-only, used by the CPUFeatures application (-monitor mode).
+//
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include "Intrinsics.h"
+#include "CycleCounter.h"
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define MSR_IA32_MPERF 0xE7
+#define MSR_IA32_APERF 0xE8
+#define MSR_IA32_THERM_STATUS 0x19C
+
+// Thermal and power management capabilities, function id 6.
+struct PowerManagementInfo {
+	bool digital_thermal_sensor;   // EAX bit 0
+	bool turbo;                    // EAX bit 1: Turbo Boost (Intel)
+	bool power_limit_notification; // EAX bit 4
+	bool package_thermal;          // EAX bit 6: Package thermal status
+	bool hwp;                      // EAX bit 7: Hardware-controlled performance states (Intel Speed Shift)
+	bool hardware_feedback;        // EAX bit 19: Hardware feedback interface (Intel Thread Director)
+	bool effective_frequency;      // ECX bit 0: APERF and MPERF
+};
+
+static inline PowerManagementInfo get_power_management_info()
+{
+	PowerManagementInfo info = {};
+	int cpu_info[4];
+	__cpuid(cpu_info, 0x0);
+	if (cpu_info[0] < 0x6)
+		return info;
+	__cpuid(cpu_info, 0x6);
+	const unsigned int eax = static_cast<unsigned int>(cpu_info[0]);
+	info.digital_thermal_sensor = eax & 1;
+	info.turbo = (eax >> 1) & 1;
+	info.power_limit_notification = (eax >> 4) & 1;
+	info.package_thermal = (eax >> 6) & 1;
+	info.hwp = (eax >> 7) & 1;
+	info.hardware_feedback = (eax >> 19) & 1;
+	info.effective_frequency = cpu_info[2] & 1;
+	return info;
+}
+
+// Reading model-specific registers of a logical processor, by its operating system CPU number. Returns
+// -1 if not possible, which is always the case on other operating systems than Linux.
+static inline int msr_open(unsigned int cpu)
+{
+#if defined(__linux__)
+	char path[64];
+	snprintf(path, sizeof(path), "/dev/cpu/%u/msr", cpu);
+	return open(path, O_RDONLY | O_CLOEXEC);
+#else
+	(void)cpu;
+	return -1;
+#endif
+}
+
+static inline bool msr_read(int msr, uint32_t index, uint64_t& value)
+{
+#if defined(__linux__)
+	return msr >= 0 && pread(msr, &value, sizeof(value), index) == static_cast<ssize_t>(sizeof(value));
+#else
+	(void)msr, (void)index, (void)value;
+	return false;
+#endif
+}
+
+static inline void msr_close(int msr)
+{
+#if defined(__linux__)
+	if (msr >= 0)
+		close(msr);
+#else
+	(void)msr;
+#endif
+}
+
+// Cumulative throttling events since boot, as counted by the operating system.
+struct ThrottleCounts {
+	bool available;
+	uint64_t core_thermal;
+	uint64_t core_power_limit;
+	uint64_t package_thermal;
+	uint64_t package_power_limit;
+};
+
+static inline bool _read_throttle_count(unsigned int cpu, const char* name, uint64_t& value)
+{
+#if defined(__linux__)
+	char path[128];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/thermal_throttle/%s", cpu, name);
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return false;
+	unsigned long long count = 0;
+	const bool read = fscanf(file, "%llu", &count) == 1;
+	fclose(file);
+	value = count;
+	return read;
+#else
+	(void)cpu, (void)name, (void)value;
+	return false;
+#endif
+}
+
+static inline ThrottleCounts read_throttle_counts(unsigned int cpu)
+{
+	ThrottleCounts counts = {};
+	counts.available = _read_throttle_count(cpu, "core_throttle_count", counts.core_thermal);
+	if (counts.available) {
+		_read_throttle_count(cpu, "core_power_limit_count", counts.core_power_limit);
+		_read_throttle_count(cpu, "package_throttle_count", counts.package_thermal);
+		_read_throttle_count(cpu, "package_power_limit_count", counts.package_power_limit);
+	}
+	return counts;
+}
+
+enum CoreFrequencySource { CoreFrequencyNone, CoreFrequencyAPERF, CoreFrequencyProbe };
+
+static const char* const core_frequency_source_names[] = { "none", "aperf", "probe" };
+
+// State of the sampling of one core, by a thread pinned to one of its logical processors.
+struct CoreSampler {
+	unsigned int cpu;      // Operating system CPU number of the logical processor
+	double tsc_mhz;        // TSC frequency, the rate of MPERF and the unit of the probe
+	int msr;               // MSR access (see msr_open), -1 if not available
+	bool aperf;            // APERF and MPERF readable
+	bool thermal_status;   // IA32_THERM_STATUS readable
+	uint64_t last_aperf;   // At the previous sample
+	uint64_t last_mperf;
+};
+
+struct CoreSample {
+	CoreFrequencySource frequency_source;
+	double frequency_mhz;        // Effective frequency, see above, 0 if not known
+	bool thermal_status;         // IA32_THERM_STATUS read, and the two following valid
+	bool thermal_throttling;     // Bit 0: Thermal monitor active
+	bool power_limit_throttling; // Bit 10: Power limitation
+	ThrottleCounts throttle_counts;
+	double seconds;              // Time taken by the sample, the overhead of the monitoring
+};
+
+static inline void core_sampler_start(CoreSampler& sampler, unsigned int cpu, double tsc_mhz, const PowerManagementInfo& power)
+{
+	sampler = {};
+	sampler.cpu = cpu;
+	sampler.tsc_mhz = tsc_mhz;
+	sampler.msr = msr_open(cpu);
+	uint64_t value = 0;
+	sampler.aperf = power.effective_frequency && msr_read(sampler.msr, MSR_IA32_APERF, sampler.last_aperf) && msr_read(sampler.msr, MSR_IA32_MPERF, sampler.last_mperf);
+	sampler.thermal_status = power.digital_thermal_sensor && msr_read(sampler.msr, MSR_IA32_THERM_STATUS, value);
+}
+
+static inline void core_sampler_stop(CoreSampler& sampler)
+{
+	msr_close(sampler.msr);
+	sampler.msr = -1;
+}
+
+// Sample the core, from the thread pinned to it.
+static inline CoreSample core_sampler_sample(CoreSampler& sampler)
+{
+	const auto start = std::chrono::steady_clock::now();
+	CoreSample sample = {};
+	uint64_t aperf = 0, mperf = 0, status = 0;
+	if (sampler.aperf && msr_read(sampler.msr, MSR_IA32_APERF, aperf) && msr_read(sampler.msr, MSR_IA32_MPERF, mperf)) {
+		const uint64_t aperf_delta = aperf - sampler.last_aperf, mperf_delta = mperf - sampler.last_mperf;
+		sampler.last_aperf = aperf;
+		sampler.last_mperf = mperf;
+		if (mperf_delta) {
+			sample.frequency_source = CoreFrequencyAPERF;
+			sample.frequency_mhz = sampler.tsc_mhz * aperf_delta / mperf_delta;
+		}
+	}
+	if (sample.frequency_source == CoreFrequencyNone && sampler.tsc_mhz > 0) { // Also when the core was halted since the previous sample
+		sample.frequency_source = CoreFrequencyProbe;
+		sample.frequency_mhz = core_cycles_per_tick() * sampler.tsc_mhz;
+	}
+	if (sampler.thermal_status && msr_read(sampler.msr, MSR_IA32_THERM_STATUS, status)) {
+		sample.thermal_status = true;
+		sample.thermal_throttling = status & 1;
+		sample.power_limit_throttling = (status >> 10) & 1;
+	}
+	sample.throttle_counts = read_throttle_counts(sampler.cpu);
+	sample.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return sample;
+}
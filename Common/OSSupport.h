@@ -0,0 +1,91 @@
+//
+// Checking operating system support for the extended processor state used by the SSE, AVX,
+// AVX-512 and AMX instruction sets.
+//
+// That the processor reports support for an instruction set through cpuid does not mean it
+// can actually be used: The operating system must also save and restore the corresponding
+// register state on context switches, and signal that it does by enabling the state components
+// in the extended control register XCR0. If not, for example when an operating system or
+// hypervisor has masked the ZMM state, using the instructions will raise an invalid opcode
+// exception (#UD). XCR0 is read with the xgetbv instruction, which is only available when the
+// processor supports XSAVE and the operating system has enabled it, as indicated by the
+// OSXSAVE flag (function id 1, ECX bit 27).
+//
+// Header-only, shared by the different sub-projects, each reporting both "hardware" support
+// (cpuid bit) and "usable" support (cpuid bit and operating system support from this header).
+//
+// See also: https://software.intel.com/content/www/us/en/develop/articles/intel-sdm.html (Volume 1, Chapter 13)
+// See also: https://stackoverflow.com/questions/44144763/avx-feature-detection-using-sigill-versus-cpu-probing/44157138#44157138
+//
+#pragma once
+#include "Intrinsics.h"
+
+// State components in XCR0
+#define XCR0_X87       0x00000001 // x87 FPU state
+#define XCR0_SSE       0x00000002 // XMM registers
+#define XCR0_AVX       0x00000004 // Upper halves of YMM registers
+#define XCR0_BNDREGS   0x00000008 // MPX bound registers
+#define XCR0_BNDCSR    0x00000010 // MPX bound configuration and status
+#define XCR0_OPMASK    0x00000020 // AVX-512 opmask registers k0-k7
+#define XCR0_ZMM_HI256 0x00000040 // Upper halves of ZMM0-ZMM15
+#define XCR0_HI16_ZMM  0x00000080 // ZMM16-ZMM31
+#define XCR0_PKRU      0x00000200 // Protection key rights register
+#define XCR0_XTILECFG  0x00020000 // AMX tile configuration register TILECFG
+#define XCR0_XTILEDATA 0x00040000 // AMX tile data registers TMM0-TMM7
+#define XCR0_APX       0x00080000 // APX extended general purpose registers R16-R31
+
+// Combinations of state components required by each instruction set family
+#define XCR0_SSE_STATE    (XCR0_SSE)
+#define XCR0_AVX_STATE    (XCR0_SSE | XCR0_AVX)
+#define XCR0_AVX512_STATE (XCR0_SSE | XCR0_AVX | XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM)
+#define XCR0_AMX_STATE    (XCR0_XTILECFG | XCR0_XTILEDATA)
+#define XCR0_APX_STATE    (XCR0_APX)
+
+#define CPUID_1_ECX_XSAVE   (1 << 26)
+#define CPUID_1_ECX_OSXSAVE (1 << 27)
+
+// Read XCR0, given the value of the ECX register from function id 1.
+// Returns 0 if the operating system has not enabled XSAVE, in which case none
+// of the state components beyond legacy x87/SSE are usable.
+static inline unsigned long long read_xcr0(unsigned int function1_ecx)
+{
+	if ((function1_ecx & (CPUID_1_ECX_XSAVE | CPUID_1_ECX_OSXSAVE)) != (CPUID_1_ECX_XSAVE | CPUID_1_ECX_OSXSAVE))
+		return 0;
+	return _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
+}
+
+// Read XCR0, executing cpuid function id 1 to check OSXSAVE first.
+static inline unsigned long long read_xcr0()
+{
+	int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
+	__cpuid(cpu_info, 0x0); // Request function id 0 to get the number of the highest valid function ID
+	if (cpu_info[0] < 1)
+		return 0;
+	__cpuid(cpu_info, 0x1);
+	return read_xcr0(static_cast<unsigned int>(cpu_info[2]));
+}
+
+// Operating system support for each instruction set family, from the value of XCR0.
+// Legacy SSE state is not included, since it is saved with FXSAVE and does not depend on
+// XSAVE being enabled: Any operating system supported by this project supports SSE.
+struct OSSupport {
+	bool avx = false;    // XMM and YMM state (AVX, AVX2, FMA, F16C, AVX-VNNI etc.)
+	bool avx512 = false; // XMM, YMM, opmask and full ZMM state (all AVX-512 extensions)
+	bool amx = false;    // Tile configuration and tile data state (AMX)
+	unsigned long long xcr0 = 0;
+};
+
+static inline OSSupport get_os_support(unsigned long long xcr0)
+{
+	OSSupport support;
+	support.xcr0 = xcr0;
+	support.avx = (xcr0 & XCR0_AVX_STATE) == XCR0_AVX_STATE;
+	support.avx512 = (xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE;
+	support.amx = (xcr0 & XCR0_AMX_STATE) == XCR0_AMX_STATE;
+	return support;
+}
+
+static inline OSSupport get_os_support()
+{
+	return get_os_support(read_xcr0());
+}
@@ -0,0 +1,232 @@
+//
+// Speculative execution controls of the executing processor, the mitigations the operating system
+// has applied, and the instruction classes the mitigations are known to slow down, for routing
+// latency sensitive workloads away from hosts where they are costly.
+//
+// The processor reports its speculation controls in function id 7 EDX (IBRS/IBPB, STIBP, SSBD,
+// L1D_FLUSH, MD_CLEAR and the IA32_ARCH_CAPABILITIES MSR) and sub-function 2 EDX (PSFD, IPRED_CTRL,
+// RRSBA_CTRL, BHI_CTRL) on Intel, and in function id 0x80000008 EBX and 0x80000021 EAX on AMD. They
+// are in the registry in group FeatureGroupSpeculation (see FeatureRegistry.h). Whether a processor
+// is affected by a vulnerability, e.g. has enhanced IBRS, is in IA32_ARCH_CAPABILITIES, which can
+// only be read in kernel mode, so it is taken from the operating system instead:
+// - Linux: The files in /sys/devices/system/cpu/vulnerabilities, one for each vulnerability, with
+//   a state of "Not affected", "Vulnerable" or "Mitigation: " followed by the mitigations.
+// - Windows: NtQuerySystemInformation with the speculation control and kernel VA shadow classes,
+//   the flags also reported by the Get-SpeculationControlSettings PowerShell module.
+//
+// The impacts are decided by rules on the Linux states and on the Windows flags, plus the TSX
+// microcode bit, which is also known from a dump. Each names the instruction class it slows down:
+// E.g. the GDS (Downfall) microcode slows AVX2 and AVX-512 gathers several times, retpolines and
+// VERW buffer clearing add to every system call, and with TSX disabled RTM transactions always abort.
+//
+// Header-only, shared by the CPUFeatures application (-speculation mode).
+//
+// See also: https://docs.kernel.org/admin-guide/hw-vuln/index.html
+// See also: https://www.intel.com/content/www/us/en/developer/topic-technology/software-security-guidance/cpuid-enumeration-and-architectural-msrs.html
+//
+#pragma once
+#include <string.h>
+#include <stdlib.h>
+#include "FeatureSnapshot.h"
+#if defined(_WIN32)
+#ifndef STRICT
+#define STRICT // Enable STRICT Type Checking in Windows headers
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN // To speed the build process exclude rarely-used services from Windows headers
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX // Exclude min/max macros from Windows header
+#endif
+#include <Windows.h>
+#elif defined(__linux__)
+#include <stdio.h>
+#include <dirent.h>
+#endif
+
+#define SPECULATION_MAX_VULNERABILITIES 32
+
+enum SpeculationOSSource { SpeculationOSNone, SpeculationOSLinux, SpeculationOSWindows };
+
+enum SpeculationState { SpeculationUnknown, SpeculationNotAffected, SpeculationMitigated, SpeculationVulnerable };
+
+static const char* const speculation_state_names[] = { "unknown", "not affected", "mitigated", "vulnerable" };
+
+// Instruction classes slowed down by a mitigation
+enum SpeculationImpactClass {
+	ImpactGather,          // AVX2 and AVX-512 gather instructions
+	ImpactVector,          // AVX and wider vector instructions as a whole
+	ImpactTransactional,   // TSX (RTM) transactions, lock elision
+	ImpactKernelEntry,     // System calls, interrupts, page faults and context switches
+	ImpactIndirectBranch,  // Indirect calls and jumps
+	ImpactStoreForwarding, // Loads forwarded from earlier stores
+	ImpactSMT,             // Sharing a core with an untrusted SMT sibling
+	ImpactClassCount
+};
+
+static const char* const speculation_impact_names[ImpactClassCount] = {
+	"gather", "vector", "transactional", "kernel-entry", "indirect-branch", "store-forwarding", "smt"
+};
+
+struct SpeculationVulnerability {
+	char name[32];   // Name of the file, e.g. "spectre_v2"
+	char state[192]; // Contents, e.g. "Mitigation: Retpolines; IBPB: conditional"
+};
+
+// Windows SYSTEM_SPECULATION_CONTROL_INFORMATION flags
+static const struct { unsigned int bit; const char* name; } windows_speculation_flags[] = {
+	{ 0, "BpbEnabled" }, { 3, "SpecCtrlEnumerated" }, { 5, "IbrsPresent" }, { 6, "StibpPresent" },
+	{ 8, "SsbdAvailable" }, { 10, "SsbdSystemWide" }, { 11, "SsbdKernel" }, { 12, "SsbdRequired" },
+	{ 14, "RetpolineEnabled" }, { 16, "EnhancedIbrs" }, { 24, "MdsHardwareProtected" }, { 25, "MbClearEnabled" },
+};
+
+#define WINDOWS_SPECULATION_SSBD_SYSTEM_WIDE 10
+#define WINDOWS_SPECULATION_RETPOLINE 14
+#define WINDOWS_SPECULATION_MB_CLEAR 25
+#define WINDOWS_KVA_SHADOW_ENABLED 0
+
+struct SpeculationInfo {
+	FeatureSnapshot features;        // The flags of group FeatureGroupSpeculation
+	SpeculationOSSource os_source;   // Where the mitigations were read from, SpeculationOSNone if not reported
+	unsigned int vulnerability_count; // Linux vulnerabilities
+	SpeculationVulnerability vulnerabilities[SPECULATION_MAX_VULNERABILITIES];
+	unsigned int windows_flags;      // SYSTEM_SPECULATION_CONTROL_INFORMATION flags
+	unsigned int windows_kva_shadow_flags; // SYSTEM_KERNEL_VA_SHADOW_INFORMATION flags
+};
+
+struct SpeculationImpact {
+	SpeculationImpactClass impact;
+	const char* cause; // The vulnerability or flag causing it
+	const char* hint;
+};
+
+static inline SpeculationState speculation_state(const char* state)
+{
+	if (strncmp(state, "Not affected", 12) == 0)
+		return SpeculationNotAffected;
+	if (strncmp(state, "Mitigation", 10) == 0)
+		return SpeculationMitigated;
+	if (strncmp(state, "Vulnerable", 10) == 0)
+		return SpeculationVulnerable;
+	return SpeculationUnknown;
+}
+
+// Rules on the Linux states: A vulnerability (any when null) with a state containing the match, or equal to it when whole.
+static const struct { const char* vulnerability; const char* match; bool whole; SpeculationImpactClass impact; const char* hint; } speculation_linux_rules[] = {
+	{ "gather_data_sampling", "Mitigation: Microcode", false, ImpactGather, "The GDS microcode makes AVX2 and AVX-512 gathers several times slower" },
+	{ "gather_data_sampling", "AVX disabled", false, ImpactVector, "AVX is disabled by the kernel, since there is no GDS microcode" },
+	{ "tsx_async_abort", "TSX disabled", false, ImpactTransactional, "TSX is disabled, RTM transactions always abort and fall back to locking" },
+	{ "mds", "Clear CPU buffers", false, ImpactKernelEntry, "VERW clears the CPU buffers on every return to user mode" },
+	{ "mmio_stale_data", "Clear CPU buffers", false, ImpactKernelEntry, "VERW clears the CPU buffers on every return to user mode" },
+	{ "reg_file_data_sampling", "Clear Register File", false, ImpactKernelEntry, "VERW clears the register file on every return to user mode" },
+	{ "meltdown", "PTI", false, ImpactKernelEntry, "Page table isolation switches page tables on every kernel entry and exit" },
+	{ "retbleed", "Mitigation: IBRS", false, ImpactKernelEntry, "IBRS is set on every kernel entry, slowing all kernel code" },
+	{ "retbleed", "untrained return thunk", false, ImpactKernelEntry, "Returns in the kernel go through a return thunk" },
+	{ "spec_rstack_overflow", "Safe RET", false, ImpactKernelEntry, "Returns in the kernel go through a safe return thunk" },
+	{ "spectre_v2", "BHI: SW loop", false, ImpactKernelEntry, "A software loop clears the branch history on every system call" },
+	{ "spectre_v2", "Retpolines", false, ImpactIndirectBranch, "The kernel uses retpolines instead of enhanced IBRS for indirect branches" },
+	{ "spectre_v2", "Mitigation: IBRS", false, ImpactIndirectBranch, "The kernel uses legacy IBRS, restricting indirect branch prediction in kernel mode" },
+	{ "spectre_v2", "STIBP: forced", false, ImpactSMT, "STIBP is always on, restricting indirect branch prediction of SMT siblings" },
+	{ "spec_store_bypass", "Mitigation: Speculative Store Bypass disabled", true, ImpactStoreForwarding, "SSBD is set for all processes, loads wait for earlier store addresses" },
+	{ nullptr, "SMT vulnerable", false, ImpactSMT, "SMT siblings can leak data to each other, do not share cores with untrusted workloads" },
+};
+
+// Read the mitigations reported by the operating system into info.
+static inline void read_speculation_mitigations(SpeculationInfo& info)
+{
+#if defined(_WIN32)
+	typedef LONG(WINAPI* NtQuerySystemInformationFunction)(ULONG, PVOID, ULONG, PULONG);
+	const auto query = reinterpret_cast<NtQuerySystemInformationFunction>(
+		reinterpret_cast<void*>(GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation")));
+	if (!query)
+		return;
+	ULONG flags = 0, length = 0;
+	if (query(201, &flags, sizeof(flags), &length) >= 0) { // SystemSpeculationControlInformation
+		info.os_source = SpeculationOSWindows;
+		info.windows_flags = flags;
+	}
+	flags = 0;
+	if (query(196, &flags, sizeof(flags), &length) >= 0) // SystemKernelVaShadowInformation
+		info.windows_kva_shadow_flags = flags;
+#elif defined(__linux__)
+	DIR* directory = opendir("/sys/devices/system/cpu/vulnerabilities");
+	if (!directory)
+		return;
+	info.os_source = SpeculationOSLinux;
+	while (const dirent* entry = readdir(directory)) {
+		if (entry->d_name[0] == '.' || info.vulnerability_count >= SPECULATION_MAX_VULNERABILITIES || strlen(entry->d_name) >= sizeof(SpeculationVulnerability::name))
+			continue;
+		SpeculationVulnerability& vulnerability = info.vulnerabilities[info.vulnerability_count];
+		char path[128];
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/vulnerabilities/%s", entry->d_name);
+		FILE* file = fopen(path, "r");
+		if (!file)
+			continue;
+		if (fgets(vulnerability.state, sizeof(vulnerability.state), file)) {
+			vulnerability.state[strcspn(vulnerability.state, "\r\n")] = '\0';
+			strcpy(vulnerability.name, entry->d_name);
+			++info.vulnerability_count;
+		}
+		fclose(file);
+	}
+	closedir(directory);
+	qsort(info.vulnerabilities, info.vulnerability_count, sizeof(SpeculationVulnerability), [](const void* a, const void* b) {
+		return strcmp(static_cast<const SpeculationVulnerability*>(a)->name, static_cast<const SpeculationVulnerability*>(b)->name);
+	});
+#else
+	(void)info;
+#endif
+}
+
+// The known performance impacts of the configuration, at most capacity of them. Returns their number.
+static inline unsigned int speculation_impacts(const SpeculationInfo& info, SpeculationImpact* impacts, unsigned int capacity)
+{
+	unsigned int count = 0;
+	const auto add = [&](SpeculationImpactClass impact, const char* cause, const char* hint) {
+		for (unsigned int i = 0; i < count && i < capacity; ++i) {
+			if (impacts[i].impact == impact && strcmp(impacts[i].hint, hint) == 0)
+				return; // The same mitigation reported for several vulnerabilities
+		}
+		if (count < capacity)
+			impacts[count] = { impact, cause, hint };
+		++count;
+	};
+	bool transactional = false;
+	for (unsigned int i = 0; i < info.vulnerability_count; ++i) {
+		const SpeculationVulnerability& vulnerability = info.vulnerabilities[i];
+		for (const auto& rule : speculation_linux_rules) {
+			if ((!rule.vulnerability || strcmp(rule.vulnerability, vulnerability.name) == 0) && (rule.whole ? strcmp(vulnerability.state, rule.match) == 0 : strstr(vulnerability.state, rule.match) != nullptr)) {
+				add(rule.impact, vulnerability.name, rule.hint);
+				transactional |= rule.impact == ImpactTransactional;
+			}
+		}
+	}
+	if (info.os_source == SpeculationOSWindows) {
+		if ((info.windows_flags >> WINDOWS_SPECULATION_RETPOLINE) & 1)
+			add(ImpactIndirectBranch, "RetpolineEnabled", "The kernel uses retpolines instead of enhanced IBRS for indirect branches");
+		if ((info.windows_flags >> WINDOWS_SPECULATION_MB_CLEAR) & 1)
+			add(ImpactKernelEntry, "MbClearEnabled", "VERW clears the CPU buffers on every return to user mode");
+		if ((info.windows_flags >> WINDOWS_SPECULATION_SSBD_SYSTEM_WIDE) & 1)
+			add(ImpactStoreForwarding, "SsbdSystemWide", "SSBD is set for all processes, loads wait for earlier store addresses");
+		if ((info.windows_kva_shadow_flags >> WINDOWS_KVA_SHADOW_ENABLED) & 1)
+			add(ImpactKernelEntry, "KvaShadowEnabled", "Kernel VA shadowing switches page tables on every kernel entry and exit");
+	}
+	if (!transactional && feature_hardware(info.features, Feature_RTMALWAYSABORT))
+		add(ImpactTransactional, "RTM-ALWAYS-ABORT", "TSX is disabled, RTM transactions always abort and fall back to locking");
+	return count;
+}
+
+template<typename Source>
+static inline SpeculationInfo decode_speculation_info(const Source& source)
+{
+	SpeculationInfo info = {};
+	info.features = decode_feature_snapshot(source);
+	return info;
+}
+
+static inline SpeculationInfo get_speculation_info()
+{
+	SpeculationInfo info = decode_speculation_info(CPUIDLiveSource());
+	read_speculation_mitigations(info);
+	return info;
+}
@@ -0,0 +1,125 @@
+//
+// Time stamp counter (TSC) parameters of the executing processor, for timing with rdtsc: Whether it is
+// invariant, whether rdtscp is available, its frequency and a converter from ticks to nanoseconds.
+//
+// The TSC is invariant when it runs at a constant rate in all ACPI P-, C- and T-states (function id
+// 0x80000007, EDX bit 8), which is required for using it as a clock. The frequency is taken from the
+// first of the following sources that reports it:
+// - Function id 0x15 (Intel): The TSC runs at EBX/EAX times the core crystal clock frequency in ECX.
+//   Some processors report the ratio but not the crystal frequency, and then the next source is used.
+// - Function id 0x16 (Intel): The base frequency in MHz, which is the TSC frequency on processors
+//   with an invariant TSC.
+// - Function id 0x40000010, reported by VMware and some KVM configurations: The TSC frequency in kHz.
+// - Measured: Calibrated against the system clock, over about 50 ms (see CycleCounter.h). AMD
+//   processors do not report the TSC frequency, and hypervisors normally hide function ids 0x15 and 0x16.
+//
+// The converter uses fixed point arithmetic, ticks multiplied by nanoseconds per tick in 32.32 format,
+// which is cheap enough for hot-path instrumentation, unlike clock_gettime or QueryPerformanceCounter.
+//
+// Header-only, shared by the different sub-projects.
+//
+#pragma once
+#include <stdint.h>
+#include "Intrinsics.h"
+#include "CycleCounter.h"
+#include "CPUIDSource.h"
+
+enum TSCFrequencySource { TSCFrequencyNone, TSCFrequencyCrystal, TSCFrequencyBase, TSCFrequencyHypervisor, TSCFrequencyMeasured };
+
+static const char* const tsc_frequency_source_names[] = { "none", "0x15", "0x16", "0x40000010", "measured" };
+
+struct TSCInfo {
+	bool invariant;              // Invariant TSC, function id 0x80000007 EDX bit 8
+	bool rdtscp;                 // rdtscp instruction, function id 0x80000001 EDX bit 27
+	unsigned int ratio_denominator; // Function id 0x15 EAX, 0 if not reported
+	unsigned int ratio_numerator;   // Function id 0x15 EBX, 0 if not reported
+	unsigned int crystal_hz;     // Core crystal clock frequency, function id 0x15 ECX, 0 if not reported
+	unsigned int base_mhz;       // Function id 0x16 EAX, 0 if not reported
+	unsigned int max_mhz;        // Function id 0x16 EBX
+	unsigned int bus_mhz;        // Function id 0x16 ECX
+	unsigned int hypervisor_khz; // Function id 0x40000010 EAX, 0 if not reported
+	TSCFrequencySource source;
+	double frequency_mhz;        // TSC frequency
+	uint64_t ns_per_tick;        // Nanoseconds per tick in 32.32 fixed point, for tsc_ticks_to_ns
+};
+
+// Convert a number of TSC ticks to nanoseconds.
+static inline uint64_t tsc_ticks_to_ns(const TSCInfo& info, uint64_t ticks)
+{
+	return (ticks >> 32) * info.ns_per_tick + (((ticks & 0xffffffffull) * info.ns_per_tick) >> 32);
+}
+
+// Decode the parameters from a source of cpuid data (see CPUIDSource.h). The frequency source is
+// TSCFrequencyNone when no function id reports it, see measure_tsc_info.
+template<typename Source>
+static inline TSCInfo decode_tsc_info(const Source& source)
+{
+	TSCInfo info = {};
+	int cpu_info[4];
+	source.cpuid(cpu_info, 0x0);
+	const unsigned int max_function_id = static_cast<unsigned int>(cpu_info[0]);
+	source.cpuid(cpu_info, 0x1);
+	const bool hypervisor = (static_cast<unsigned int>(cpu_info[2]) >> 31) & 1;
+	source.cpuid(cpu_info, 0x80000000);
+	const unsigned int max_extended_function_id = static_cast<unsigned int>(cpu_info[0]);
+	if (max_extended_function_id >= 0x80000001) {
+		source.cpuid(cpu_info, 0x80000001);
+		info.rdtscp = (cpu_info[3] >> 27) & 1;
+	}
+	if (max_extended_function_id >= 0x80000007) {
+		source.cpuid(cpu_info, 0x80000007);
+		info.invariant = (cpu_info[3] >> 8) & 1;
+	}
+	if (max_function_id >= 0x15) {
+		source.cpuid(cpu_info, 0x15);
+		info.ratio_denominator = static_cast<unsigned int>(cpu_info[0]);
+		info.ratio_numerator = static_cast<unsigned int>(cpu_info[1]);
+		info.crystal_hz = static_cast<unsigned int>(cpu_info[2]);
+	}
+	if (max_function_id >= 0x16) {
+		source.cpuid(cpu_info, 0x16);
+		info.base_mhz = static_cast<unsigned int>(cpu_info[0]) & 0xffff;
+		info.max_mhz = static_cast<unsigned int>(cpu_info[1]) & 0xffff;
+		info.bus_mhz = static_cast<unsigned int>(cpu_info[2]) & 0xffff;
+	}
+	if (hypervisor) {
+		source.cpuid(cpu_info, 0x40000000);
+		if (static_cast<unsigned int>(cpu_info[0]) >= 0x40000010) {
+			source.cpuid(cpu_info, 0x40000010);
+			info.hypervisor_khz = static_cast<unsigned int>(cpu_info[0]);
+		}
+	}
+	if (info.ratio_denominator && info.ratio_numerator && info.crystal_hz) {
+		info.source = TSCFrequencyCrystal;
+		info.frequency_mhz = static_cast<double>(info.crystal_hz) * info.ratio_numerator / info.ratio_denominator / 1e6;
+	} else if (info.base_mhz && info.invariant) {
+		info.source = TSCFrequencyBase;
+		info.frequency_mhz = info.base_mhz;
+	} else if (info.hypervisor_khz) {
+		info.source = TSCFrequencyHypervisor;
+		info.frequency_mhz = info.hypervisor_khz / 1000.0;
+	}
+	if (info.frequency_mhz > 0)
+		info.ns_per_tick = static_cast<uint64_t>(1000.0 / info.frequency_mhz * 4294967296.0 + 0.5);
+	return info;
+}
+
+// Measure the frequency if no function id reports it, which takes about 50 ms and executes no cpuid.
+static inline void measure_tsc_info(TSCInfo& info)
+{
+	if (info.source != TSCFrequencyNone)
+		return;
+	info.source = TSCFrequencyMeasured;
+	info.frequency_mhz = measure_tsc_frequency();
+	if (info.frequency_mhz > 0)
+		info.ns_per_tick = static_cast<uint64_t>(1000.0 / info.frequency_mhz * 4294967296.0 + 0.5);
+}
+
+// Without measure, the frequency source is TSCFrequencyNone when no function id reports it.
+static inline TSCInfo get_tsc_info(bool measure = true)
+{
+	TSCInfo info = decode_tsc_info(CPUIDLiveSource());
+	if (measure)
+		measure_tsc_info(info);
+	return info;
+}
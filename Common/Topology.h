@@ -0,0 +1,546 @@
+//
+// Enumeration of the processor topology: Which package, die, module, core and SMT thread
+// each logical processor belongs to, and which logical processors share each L2 and L3 cache.
+//
+// The topology is described by the x2APIC ID of each logical processor, which is split into
+// fields for each level by the bit shifts reported in the extended topology enumeration:
+// Intel function id 0x1F (V2, with module, tile and die levels), or 0xB on older processors,
+// and AMD function id 0x80000026 (with core complex and die levels) on Zen 4 and newer. Processors
+// without any of these are decoded from the legacy fields of function ids 1 and 4 (Intel) or
+// 0x80000008 and 0x8000001E (AMD). The cache sharing domains are decoded the same way, from the
+// number of logical processors sharing each cache level (see CacheInfo.h).
+//
+// Since the APIC ID returned by cpuid is that of the logical processor executing it, the
+// enumeration pins the calling thread to each logical processor in turn, using processor groups
+// and SetThreadGroupAffinity on Windows, and sched_setaffinity on Linux, and
+// restores the original affinity afterwards. Only the logical processors the process is allowed
+// to run on are included, on Windows those in the active processor mask of each group reported by
+// GetLogicalProcessorInformationEx, which need not be its lowest bits. The processors the thread
+// could not be pinned to are skipped, and counted. The NUMA node of each logical processor is not reported by cpuid, and is
+// queried from the operating system while pinned: GetNumaProcessorNodeEx on Windows, getcpu on Linux.
+//
+// On hybrid processors (function id 7 EDX bit 15), such as Intel Alder Lake and newer, the core
+// type of each logical processor is reported by function id 0x1A: Performance cores (P-cores)
+// or efficient cores (E-cores). The core types can have different caches and, in principle,
+// different features, which are captured for one logical processor of each type by
+// get_core_classes.
+//
+// Header-only, shared by the different sub-projects.
+//
+// Example, starting one worker per physical core, and finding the cores sharing the L3 cache
+// with the first one:
+//
+//   const Topology topology = get_topology();
+//   for (unsigned int index : one_thread_per_core(topology))
+//       start_worker(topology.processors[index].group, topology.processors[index].number);
+//   const std::vector<unsigned int> neighbours = cores_sharing_cache(topology, 0, 3);
+//
+// See also: https://software.intel.com/content/www/us/en/develop/articles/intel-64-architecture-processor-topology-enumeration.html
+// See also: https://www.amd.com/system/files/TechDocs/24594.pdf (Appendix E.4.23)
+//
+#pragma once
+#include "Intrinsics.h"
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "CacheInfo.h"
+#include "FeatureSnapshot.h"
+#ifdef _WIN32
+#ifndef STRICT
+#define STRICT // Enable STRICT Type Checking in Windows headers
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN // To speed the build process exclude rarely-used services from Windows headers
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX // Exclude min/max macros from Windows header
+#endif
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum TopologySource { TopologyLegacy, TopologyLeafB, TopologyLeaf1F, TopologyLeaf80000026 };
+enum CoreType { CoreTypeUnknown = 0, CoreTypeEfficiency = 0x20, CoreTypePerformance = 0x40 }; // Function id 0x1A EAX[31:24], Intel Atom and Intel Core
+
+struct LogicalProcessor {
+	unsigned int group;   // Processor group (Windows), 0 on other operating systems
+	unsigned int number;  // Processor number within the group (Windows), or the CPU number (other operating systems)
+	unsigned int apic_id; // x2APIC ID, or initial APIC ID for legacy topology
+	unsigned int package; // Package (socket) ID
+	unsigned int die;     // Die ID within the package
+	unsigned int module;  // Module, tile or core complex (CCX) ID within the die
+	unsigned int core;    // Core ID within the module
+	unsigned int smt;     // SMT thread ID within the core
+	unsigned int l2;      // ID of the L2 cache sharing domain, unique across packages
+	unsigned int l3;      // ID of the L3 cache sharing domain, unique across packages
+	CoreType core_type;   // Core type on hybrid processors, CoreTypeUnknown otherwise
+	unsigned int native_model_id; // Native model ID of the core type on hybrid processors
+	unsigned int numa_node; // NUMA node, as reported by the operating system, 0 if not available
+};
+
+struct Topology {
+	TopologySource source = TopologyLegacy;
+	// Bit shifts for extracting each level from the APIC ID: The ID of the core a logical processor
+	// belongs to, unique across packages, is apic_id >> smt_shift, and so on.
+	unsigned int smt_shift = 0, core_shift = 0, module_shift = 0, die_shift = 0, package_shift = 0;
+	unsigned int l2_shift = 0, l3_shift = 0;
+	unsigned int packages = 0, dies = 0, modules = 0, cores = 0; // Number of distinct units found
+	unsigned int numa_nodes = 0; // Number of distinct NUMA nodes found
+	bool hybrid = false; // Hybrid processor, with core types reported for each logical processor
+	std::vector<LogicalProcessor> processors;
+};
+
+// Number of bits needed to represent count distinct IDs.
+static inline unsigned int _topology_bits(unsigned int count)
+{
+	unsigned int bits = 0;
+	while ((1u << bits) < count && bits < 31)
+		++bits;
+	return bits;
+}
+
+static inline bool _topology_vendor_amd()
+{
+	int cpu_info[4];
+	__cpuid(cpu_info, 0x0);
+	return (cpu_info[1] == 0x68747541 && cpu_info[3] == 0x69746E65 && cpu_info[2] == 0x444D4163) // "AuthenticAMD"
+		|| (cpu_info[1] == 0x6F677948 && cpu_info[3] == 0x6E65476E && cpu_info[2] == 0x656E6975); // "HygonGenuine"
+}
+
+// Decode the level shifts from the extended topology enumeration of the given function id.
+// For Intel function ids 0xB and 0x1F the level types are 1 SMT, 2 core, 3 module, 4 tile,
+// 5 die and 6 die group, and the shift of each level gives the ID of the next level. For AMD
+// function id 0x80000026 the level types are 1 core, 2 core complex, 3 die and 4 socket, and
+// the shift of each level gives the ID of that level, so the shift of the core level is the
+// SMT width, the same as for the Intel SMT level. Levels not reported get the shift of the
+// level below, and the shift of the last level is the package shift.
+static inline void _topology_extended_shifts(Topology& topology, unsigned int function_id)
+{
+	unsigned int shifts[6] = { 0 }; // Indexed by normalized level: 1 SMT, 2 core, 3 module, 4 die, 5 package
+	int cpu_info[4];
+	for (int subleaf = 0; subleaf < 8; ++subleaf) {
+		__cpuidex(cpu_info, function_id, subleaf);
+		const unsigned int type = (cpu_info[2] >> 8) & 0xFF;
+		if (type == 0)
+			break;
+		const unsigned int shift = cpu_info[0] & 0x1F;
+		if (function_id == 0x80000026) {
+			if (type <= 4)
+				shifts[type] = shift;
+		} else {
+			const unsigned int level = type <= 2 ? type : type <= 4 ? 3 : type == 5 ? 4 : 0; // Tiles are reported as modules, die groups are ignored
+			shifts[level] = std::max(shifts[level], shift);
+		}
+		shifts[5] = std::max(shifts[5], shift);
+	}
+	for (int level = 2; level <= 5; ++level)
+		shifts[level] = std::max(shifts[level], shifts[level - 1]);
+	topology.smt_shift = shifts[1];
+	topology.core_shift = shifts[2];
+	topology.module_shift = shifts[3];
+	topology.die_shift = shifts[4];
+	topology.package_shift = shifts[5];
+}
+
+// Decode the level shifts from the legacy fields: The maximum number of addressable logical
+// processors per package from function id 1, and the number of cores per package from
+// function id 4 (Intel) or the APIC ID size from function id 0x80000008 (AMD).
+static inline void _topology_legacy_shifts(Topology& topology, bool amd, int max_function_id, unsigned int max_extended_function_id)
+{
+	int cpu_info[4];
+	__cpuid(cpu_info, 0x1);
+	const bool htt = (cpu_info[3] & (1 << 28)) != 0; // Bit 28 of EDX indicates that field EBX[23:16] is valid
+	const unsigned int logical_per_package = htt ? (cpu_info[1] >> 16) & 0xFF : 1;
+	unsigned int package_shift = _topology_bits(logical_per_package);
+	if (amd) {
+		if (max_extended_function_id >= 0x80000008) {
+			__cpuid(cpu_info, 0x80000008);
+			const unsigned int apic_id_size = (cpu_info[2] >> 12) & 0xF;
+			if (apic_id_size)
+				package_shift = apic_id_size;
+		}
+		topology.smt_shift = 0;
+		if (max_extended_function_id >= 0x8000001E) {
+			__cpuid(cpu_info, 0x8000001E);
+			topology.smt_shift = _topology_bits(((cpu_info[1] >> 8) & 0xFF) + 1);
+		}
+	} else {
+		unsigned int cores_per_package = 1;
+		if (max_function_id >= 4) {
+			__cpuidex(cpu_info, 0x4, 0);
+			cores_per_package = ((cpu_info[0] >> 26) & 0x3F) + 1;
+		}
+		topology.smt_shift = _topology_bits(logical_per_package / cores_per_package);
+	}
+	topology.core_shift = topology.module_shift = topology.die_shift = topology.package_shift = std::max(package_shift, topology.smt_shift);
+}
+
+// The APIC ID of the logical processor executing this.
+static inline unsigned int _topology_apic_id(TopologySource source)
+{
+	int cpu_info[4];
+	switch (source) {
+	case TopologyLeaf1F:
+		__cpuidex(cpu_info, 0x1F, 0);
+		return cpu_info[3];
+	case TopologyLeafB:
+		__cpuidex(cpu_info, 0xB, 0);
+		return cpu_info[3];
+	case TopologyLeaf80000026:
+		__cpuidex(cpu_info, 0x80000026, 0);
+		return cpu_info[3];
+	default:
+		__cpuid(cpu_info, 0x1);
+		return (cpu_info[1] >> 24) & 0xFF;
+	}
+}
+
+#ifdef _WIN32
+// The active processor mask of each processor group, from GetLogicalProcessorInformationEx. The active
+// processors of a group are not necessarily its lowest bits, e.g. with processors excluded at boot or
+// hot-added, so this is the lowest bits of GetActiveProcessorCount only if the query fails.
+static inline std::vector<KAFFINITY> active_processor_masks()
+{
+	std::vector<KAFFINITY> masks;
+	DWORD size = 0;
+	GetLogicalProcessorInformationEx(RelationGroup, nullptr, &size);
+	std::vector<unsigned char> buffer(size);
+	if (size && GetLogicalProcessorInformationEx(RelationGroup, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &size)) {
+		for (DWORD offset = 0; offset < size;) {
+			const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+			if (info->Relationship == RelationGroup) {
+				for (WORD group = 0; group < info->Group.ActiveGroupCount; ++group)
+					masks.push_back(info->Group.GroupInfo[group].ActiveProcessorMask);
+			}
+			if (!info->Size)
+				break;
+			offset += info->Size;
+		}
+	}
+	if (masks.empty()) {
+		const WORD group_count = GetActiveProcessorGroupCount();
+		for (WORD group = 0; group < group_count; ++group) {
+			const DWORD count = GetActiveProcessorCount(group);
+			masks.push_back(count >= sizeof(KAFFINITY) * 8 ? ~static_cast<KAFFINITY>(0) : (static_cast<KAFFINITY>(1) << count) - 1);
+		}
+	}
+	return masks;
+}
+#endif
+
+// Call function(group, number) on each logical processor the process is allowed to run on,
+// with the calling thread pinned to that processor, restoring the original affinity afterwards.
+// Returns the number of logical processors the thread could not be pinned to, which were skipped.
+template<typename Function>
+static inline unsigned int for_each_logical_processor(Function function)
+{
+	unsigned int unpinned = 0;
+#ifdef _WIN32
+	GROUP_AFFINITY previous_affinity;
+	if (!GetThreadGroupAffinity(GetCurrentThread(), &previous_affinity))
+		return 0;
+	const std::vector<KAFFINITY> groups = active_processor_masks();
+	for (WORD group = 0; group < groups.size(); ++group) {
+		for (DWORD number = 0; number < sizeof(KAFFINITY) * 8; ++number) {
+			if (!((groups[group] >> number) & 1))
+				continue;
+			GROUP_AFFINITY affinity = {};
+			affinity.Group = group;
+			affinity.Mask = static_cast<KAFFINITY>(1) << number;
+			if (SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr))
+				function(static_cast<unsigned int>(group), static_cast<unsigned int>(number));
+			else
+				++unpinned;
+		}
+	}
+	SetThreadGroupAffinity(GetCurrentThread(), &previous_affinity, nullptr);
+#elif defined(__linux__)
+	cpu_set_t previous_affinity;
+	CPU_ZERO(&previous_affinity);
+	if (sched_getaffinity(0, sizeof(previous_affinity), &previous_affinity) != 0)
+		return 0;
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (!CPU_ISSET(cpu, &previous_affinity))
+			continue;
+		cpu_set_t affinity;
+		CPU_ZERO(&affinity);
+		CPU_SET(cpu, &affinity);
+		if (sched_setaffinity(0, sizeof(affinity), &affinity) == 0)
+			function(0u, static_cast<unsigned int>(cpu));
+		else
+			++unpinned;
+	}
+	sched_setaffinity(0, sizeof(previous_affinity), &previous_affinity);
+#else
+	function(0u, 0u); // No thread affinity API (macOS), so only the processor the thread runs on
+#endif
+	return unpinned;
+}
+
+// Call function(group, number) on each logical processor the process is allowed to run on, in
+// parallel: One thread pinned to each of them, all started before waiting for any, so the function
+// is called concurrently. Across all processor groups on Windows, where a thread is otherwise
+// restricted to the group it started in. The calling thread's affinity is not changed. Returns the
+// number of logical processors a thread could not be pinned to, where the function was not called.
+template<typename Function>
+static inline unsigned int for_each_logical_processor_parallel(Function function)
+{
+	std::vector<std::thread> threads;
+	std::atomic<unsigned int> unpinned(0);
+#ifdef _WIN32
+	const std::vector<KAFFINITY> groups = active_processor_masks();
+	for (WORD group = 0; group < groups.size(); ++group) {
+		for (DWORD number = 0; number < sizeof(KAFFINITY) * 8; ++number) {
+			if (!((groups[group] >> number) & 1))
+				continue;
+			threads.emplace_back([group, number, &function, &unpinned]() {
+				GROUP_AFFINITY affinity = {};
+				affinity.Group = group;
+				affinity.Mask = static_cast<KAFFINITY>(1) << number;
+				if (SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr))
+					function(static_cast<unsigned int>(group), static_cast<unsigned int>(number));
+				else
+					++unpinned;
+			});
+		}
+	}
+#elif defined(__linux__)
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return 0;
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+		threads.emplace_back([cpu, &function, &unpinned]() {
+			cpu_set_t affinity;
+			CPU_ZERO(&affinity);
+			CPU_SET(cpu, &affinity);
+			if (sched_setaffinity(0, sizeof(affinity), &affinity) == 0) // Thread 0 is the calling thread
+				function(0u, static_cast<unsigned int>(cpu));
+			else
+				++unpinned;
+		});
+	}
+#else
+	function(0u, 0u);
+#endif
+	for (std::thread& thread : threads)
+		thread.join();
+	return unpinned.load();
+}
+
+// NUMA node of the logical processor, called with the thread pinned to it.
+static inline unsigned int _topology_numa_node(unsigned int group, unsigned int number)
+{
+#ifdef _WIN32
+	PROCESSOR_NUMBER processor = {};
+	processor.Group = static_cast<WORD>(group);
+	processor.Number = static_cast<BYTE>(number);
+	USHORT node = 0;
+	return GetNumaProcessorNodeEx(&processor, &node) ? node : 0;
+#elif defined(__linux__) && defined(SYS_getcpu)
+	(void)group;
+	(void)number;
+	unsigned int cpu = 0, node = 0;
+	return syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 ? node : 0;
+#else
+	(void)group;
+	(void)number;
+	return 0;
+#endif
+}
+
+static inline unsigned int _topology_count_distinct(const Topology& topology, unsigned int shift)
+{
+	std::vector<unsigned int> ids;
+	for (const LogicalProcessor& processor : topology.processors)
+		ids.push_back(shift < 32 ? processor.apic_id >> shift : 0);
+	std::sort(ids.begin(), ids.end());
+	return static_cast<unsigned int>(std::unique(ids.begin(), ids.end()) - ids.begin());
+}
+
+// Enumerate the topology of all logical processors the process is allowed to run on.
+static inline Topology get_topology()
+{
+	Topology topology;
+	int cpu_info[4];
+	__cpuid(cpu_info, 0x0);
+	const int max_function_id = cpu_info[0];
+	__cpuid(cpu_info, 0x80000000);
+	const unsigned int max_extended_function_id = cpu_info[0];
+	const bool amd = _topology_vendor_amd();
+	if (max_function_id < 1)
+		return topology;
+	// Prefer the most detailed enumeration available. A function id is only valid if sub-leaf 0 reports a level.
+	if (!amd && max_function_id >= 0x1F && (__cpuidex(cpu_info, 0x1F, 0), cpu_info[1] != 0))
+		topology.source = TopologyLeaf1F;
+	else if (amd && max_extended_function_id >= 0x80000026 && (__cpuidex(cpu_info, 0x80000026, 0), cpu_info[1] != 0))
+		topology.source = TopologyLeaf80000026;
+	else if (max_function_id >= 0xB && (__cpuidex(cpu_info, 0xB, 0), cpu_info[1] != 0))
+		topology.source = TopologyLeafB;
+	switch (topology.source) {
+	case TopologyLeaf1F:
+		_topology_extended_shifts(topology, 0x1F);
+		break;
+	case TopologyLeaf80000026:
+		_topology_extended_shifts(topology, 0x80000026);
+		break;
+	case TopologyLeafB:
+		_topology_extended_shifts(topology, 0xB);
+		break;
+	default:
+		_topology_legacy_shifts(topology, amd, max_function_id, max_extended_function_id);
+	}
+	const CacheInfo cache_info = get_cache_info();
+	const CacheDescriptor* l2 = find_cache(cache_info, 2);
+	const CacheDescriptor* l3 = find_cache(cache_info, 3);
+	topology.l2_shift = l2 && l2->shared_by ? _topology_bits(l2->shared_by) : topology.smt_shift;
+	topology.l3_shift = l3 && l3->shared_by ? _topology_bits(l3->shared_by) : topology.package_shift;
+
+	if (max_function_id >= 7) {
+		__cpuidex(cpu_info, 0x7, 0);
+		topology.hybrid = max_function_id >= 0x1A && feature_in_registers(reinterpret_cast<unsigned int*>(cpu_info), Feature_HYBRID);
+	}
+
+	const TopologySource source = topology.source;
+	const bool hybrid = topology.hybrid;
+	for_each_logical_processor([&topology, source, hybrid](unsigned int group, unsigned int number) {
+		LogicalProcessor processor;
+		processor.group = group;
+		processor.number = number;
+		processor.apic_id = _topology_apic_id(source);
+		const unsigned int apic_id = processor.apic_id;
+		const auto field = [apic_id](unsigned int low, unsigned int high) { return high > low ? (apic_id >> low) & ((1u << (high - low)) - 1) : 0u; };
+		processor.smt = field(0, topology.smt_shift);
+		processor.core = field(topology.smt_shift, topology.core_shift);
+		processor.module = field(topology.core_shift, topology.module_shift);
+		processor.die = field(topology.module_shift, topology.die_shift);
+		processor.package = topology.package_shift < 32 ? apic_id >> topology.package_shift : 0;
+		processor.l2 = apic_id >> topology.l2_shift;
+		processor.l3 = apic_id >> topology.l3_shift;
+		processor.core_type = CoreTypeUnknown;
+		processor.native_model_id = 0;
+		processor.numa_node = _topology_numa_node(group, number);
+		if (hybrid) {
+			int cpu_info[4];
+			__cpuidex(cpu_info, 0x1A, 0);
+			processor.core_type = static_cast<CoreType>((cpu_info[0] >> 24) & 0xFF);
+			processor.native_model_id = cpu_info[0] & 0xFFFFFF;
+		}
+		topology.processors.push_back(processor);
+	});
+	topology.packages = _topology_count_distinct(topology, topology.package_shift);
+	topology.dies = _topology_count_distinct(topology, topology.die_shift);
+	topology.modules = _topology_count_distinct(topology, topology.module_shift);
+	topology.cores = _topology_count_distinct(topology, topology.smt_shift);
+	std::vector<unsigned int> nodes;
+	for (const LogicalProcessor& processor : topology.processors)
+		nodes.push_back(processor.numa_node);
+	std::sort(nodes.begin(), nodes.end());
+	topology.numa_nodes = static_cast<unsigned int>(std::unique(nodes.begin(), nodes.end()) - nodes.begin());
+	return topology;
+}
+
+// Indexes into topology.processors of the first SMT thread of each physical core, e.g. for
+// starting one worker thread per core.
+static inline std::vector<unsigned int> one_thread_per_core(const Topology& topology)
+{
+	std::vector<unsigned int> result;
+	std::vector<unsigned int> seen;
+	for (unsigned int i = 0; i < topology.processors.size(); ++i) {
+		const unsigned int core_id = topology.processors[i].apic_id >> topology.smt_shift;
+		if (std::find(seen.begin(), seen.end(), core_id) == seen.end()) {
+			seen.push_back(core_id);
+			result.push_back(i);
+		}
+	}
+	return result;
+}
+
+// Indexes into topology.processors of all logical processors sharing the cache at the given
+// level (2 or 3) with logical processor number index.
+static inline std::vector<unsigned int> processors_sharing_cache(const Topology& topology, unsigned int index, unsigned int level)
+{
+	std::vector<unsigned int> result;
+	if (index >= topology.processors.size())
+		return result;
+	const unsigned int id = level == 2 ? topology.processors[index].l2 : topology.processors[index].l3;
+	for (unsigned int i = 0; i < topology.processors.size(); ++i) {
+		if ((level == 2 ? topology.processors[i].l2 : topology.processors[i].l3) == id)
+			result.push_back(i);
+	}
+	return result;
+}
+
+// Indexes into topology.processors of the first SMT thread of each physical core sharing the
+// cache at the given level (2 or 3) with logical processor number index, including its own core.
+static inline std::vector<unsigned int> cores_sharing_cache(const Topology& topology, unsigned int index, unsigned int level)
+{
+	std::vector<unsigned int> result;
+	const std::vector<unsigned int> sharing = processors_sharing_cache(topology, index, level);
+	for (unsigned int i : one_thread_per_core(topology)) {
+		if (std::find(sharing.begin(), sharing.end(), i) != sharing.end())
+			result.push_back(i);
+	}
+	return result;
+}
+
+// Indexes into topology.processors of all logical processors of the given core type, e.g. for
+// pinning latency-critical threads to performance cores. On non-hybrid processors all logical
+// processors have core type CoreTypeUnknown.
+static inline std::vector<unsigned int> processors_of_core_type(const Topology& topology, CoreType core_type)
+{
+	std::vector<unsigned int> result;
+	for (unsigned int i = 0; i < topology.processors.size(); ++i) {
+		if (topology.processors[i].core_type == core_type)
+			result.push_back(i);
+	}
+	return result;
+}
+
+// Feature flags and cache parameters of one class of cores on a hybrid processor, captured
+// on the first logical processor of that core type. Non-hybrid processors have a single class.
+struct CoreClass {
+	CoreType core_type = CoreTypeUnknown;
+	unsigned int native_model_id = 0;
+	std::vector<unsigned int> processors; // Indexes into topology.processors
+	FeatureSnapshot features = {}; // Feature flags, see FeatureRegistry.h
+	CacheInfo cache_info;
+};
+
+// Group the logical processors by core type, and capture features and caches of each class.
+static inline std::vector<CoreClass> get_core_classes(const Topology& topology)
+{
+	std::vector<CoreClass> classes;
+	std::vector<unsigned int> first_processors; // Index of first logical processor of each class
+	for (unsigned int i = 0; i < topology.processors.size(); ++i) {
+		const LogicalProcessor& processor = topology.processors[i];
+		auto it = std::find_if(classes.begin(), classes.end(), [&processor](const CoreClass& c) { return c.core_type == processor.core_type; });
+		if (it == classes.end()) {
+			CoreClass core_class;
+			core_class.core_type = processor.core_type;
+			core_class.native_model_id = processor.native_model_id;
+			memset(&core_class.cache_info, 0, sizeof(core_class.cache_info));
+			classes.push_back(core_class);
+			first_processors.push_back(i);
+			it = classes.end() - 1;
+		}
+		it->processors.push_back(i);
+	}
+	for_each_logical_processor([&topology, &classes, &first_processors](unsigned int group, unsigned int number) {
+		for (size_t c = 0; c < classes.size(); ++c) {
+			const LogicalProcessor& first = topology.processors[first_processors[c]];
+			if (first.group != group || first.number != number)
+				continue;
+			CoreClass& core_class = classes[c];
+			core_class.features = get_feature_snapshot();
+			core_class.cache_info = get_cache_info();
+		}
+	});
+	return classes;
+}
@@ -0,0 +1,44 @@
+//
+// Portable wide character entry point, for the command line programs written with the
+// Microsoft-specific wmain and _wcsicmp.
+//
+// On Windows this does nothing. On other operating systems it defines main, which converts
+// the arguments from the multibyte encoding of the current locale and calls wmain, and maps
+// _wcsicmp to the POSIX equivalent wcscasecmp. Include it from the source file defining wmain.
+//
+#pragma once
+#ifndef _WIN32
+#include <wchar.h>
+#include <stdlib.h>
+#include <locale.h>
+#include <string>
+#include <vector>
+
+#define _wcsicmp wcscasecmp
+
+int wmain(int argc, wchar_t* argv[], wchar_t* envp[]);
+
+int main(int argc, char* argv[])
+{
+	setlocale(LC_ALL, "");
+	std::vector<std::wstring> arguments;
+	for (int i = 0; i < argc; ++i) {
+		const size_t length = mbstowcs(nullptr, argv[i], 0);
+		std::wstring argument;
+		if (length != static_cast<size_t>(-1)) {
+			argument.resize(length + 1);
+			mbstowcs(&argument[0], argv[i], length + 1);
+			argument.resize(length);
+		} else {
+			for (const char* c = argv[i]; *c; ++c) // Not valid in the current locale, just widen each byte
+				argument.push_back(static_cast<unsigned char>(*c));
+		}
+		arguments.push_back(argument);
+	}
+	std::vector<wchar_t*> wide_argv;
+	for (std::wstring& argument : arguments)
+		wide_argv.push_back(&argument[0]);
+	wide_argv.push_back(nullptr);
+	return wmain(argc, wide_argv.data(), nullptr);
+}
+#endif
@@ -0,0 +1,169 @@
+//
+// Decoding of the extended processor state (XSAVE) area of the executing processor: The state
+// components, their sizes and offsets, and the size of the area saved by the XSAVE family of
+// instructions.
+//
+// The XSAVE area is what the operating system saves on each context switch and signal delivery,
+// and what a user-mode runtime saving its own contexts (fibers, coroutines) must allocate per
+// context. It grows with the enabled state: About 1 KB with AVX, 2.7 KB with AVX-512, and more
+// than 11 KB with the AMX tile data.
+//
+// Function id 0xD enumerates the state components. Sub-function 0 reports the user state
+// components supported in XCR0 and the size of the standard format area, the layout written by
+// XSAVE and XSAVEOPT, for the currently enabled XCR0 and for all supported components.
+// Sub-function 1 reports the XSAVEOPT, XSAVEC, XGETBV with ECX=1, XSAVES and XFD instructions,
+// the supervisor state components supported in IA32_XSS, and the size of the compacted format
+// area for XCR0 | IA32_XSS. Each sub-function from 2 describes state component i: Its size, its
+// offset in the standard format, if it is a supervisor component, if it is aligned to 64 bytes in
+// the compacted format, and if it supports extended feature disable (XFD), which the operating
+// system uses to allocate the large AMX state only for threads that request it.
+//
+// The compacted format, written by XSAVEC and XSAVES, leaves out components not requested, and is
+// therefore the smallest area for a given set of components. Its size is not reported for user
+// state alone (IA32_XSS can only be read in kernel mode), but computed from the components:
+// The legacy area and header of 576 bytes, followed by each requested component in order, aligned
+// to 64 bytes when indicated.
+//
+// The decoding is done from a source of cpuid data (see CPUIDSource.h), the executing processor
+// with get_xsave_info, or a dump captured elsewhere with decode_xsave_info.
+//
+// Header-only, shared by the CPUFeatures application (-xsave mode) and the CPUFeaturesLibrary.
+//
+// Example, sizing a context buffer for XSAVEC of the enabled components except the AMX tile data:
+//
+//   const XSaveInfo info = get_xsave_info();
+//   const unsigned int size = xsave_compacted_size(info, info.xcr0 & ~XCR0_XTILEDATA);
+//
+// See also: https://software.intel.com/content/www/us/en/develop/articles/intel-sdm.html (Volume 1, Chapter 13)
+//
+#pragma once
+#include "Intrinsics.h"
+#include "OSSupport.h"
+#include "CPUIDSource.h"
+
+#define XSAVE_MAX_COMPONENTS 63
+#define XSAVE_LEGACY_SIZE 512 // x87 and SSE state, always at the start of the area
+#define XSAVE_HEADER_SIZE 64  // XSTATE_BV and XCOMP_BV, following the legacy area
+
+// Instructions reported in function id 0xD sub-function 1 EAX
+#define XSAVE_FEATURE_XSAVEOPT 0x1
+#define XSAVE_FEATURE_XSAVEC   0x2
+#define XSAVE_FEATURE_XGETBV1  0x4
+#define XSAVE_FEATURE_XSAVES   0x8
+#define XSAVE_FEATURE_XFD      0x10
+
+// Names of the state components by index, as in the Intel SDM
+static const char* const xsave_component_names[] = {
+	"x87", "SSE", "AVX", "BNDREGS", "BNDCSR", "opmask", "ZMM_Hi256", "Hi16_ZMM", "PT", "PKRU",
+	"PASID", "CET_U", "CET_S", "HDC", "UINTR", "LBR", "HWP", "XTILECFG", "XTILEDATA", "APX" };
+
+static inline const char* xsave_component_name(unsigned int index)
+{
+	return index < sizeof(xsave_component_names) / sizeof(xsave_component_names[0]) ? xsave_component_names[index] : "unknown";
+}
+
+struct XSaveComponent {
+	unsigned int index;  // Bit in XCR0 or IA32_XSS
+	unsigned int size;   // Size in bytes
+	unsigned int offset; // Offset in the standard format, 0 for supervisor components, which are only in the compacted format
+	bool supervisor;     // Enabled in IA32_XSS, saved only by XSAVES
+	bool aligned;        // Aligned to 64 bytes in the compacted format
+	bool xfd;            // Supports extended feature disable
+	bool enabled;        // Enabled in XCR0, unknown for supervisor components
+};
+
+struct XSaveInfo {
+	bool supported;                  // XSAVE reported by the processor
+	unsigned int features;           // XSAVE_FEATURE_*
+	unsigned long long xcr0;         // User state components enabled by the operating system, 0 if it has not enabled XSAVE
+	unsigned long long xcr0_supported; // User state components supported by the processor
+	unsigned long long xss_supported;  // Supervisor state components supported by the processor
+	unsigned int size;               // Standard format size for the enabled XCR0 components
+	unsigned int max_size;           // Standard format size for all supported XCR0 components
+	unsigned int system_size;        // Compacted format size for XCR0 | IA32_XSS as enabled by the operating system, 0 without XSAVES
+	unsigned int component_count;
+	XSaveComponent components[XSAVE_MAX_COMPONENTS];
+};
+
+// Size of the compacted format area (XSAVEC) for the state components in the mask, limited to
+// the components enabled in XCR0. 0 if XSAVEC is not supported.
+static inline unsigned int xsave_compacted_size(const XSaveInfo& info, unsigned long long components)
+{
+	if (!(info.features & XSAVE_FEATURE_XSAVEC) || !info.xcr0)
+		return 0;
+	components &= info.xcr0;
+	unsigned int size = XSAVE_LEGACY_SIZE + XSAVE_HEADER_SIZE;
+	for (unsigned int i = 0; i < info.component_count; ++i) {
+		const XSaveComponent& component = info.components[i];
+		if (component.index < 2 || component.supervisor || !(components & (1ULL << component.index)))
+			continue;
+		if (component.aligned)
+			size = (size + 63) & ~63u;
+		size += component.size;
+	}
+	return size;
+}
+
+// The state components supporting extended feature disable, e.g. the AMX tile data, which Linux only
+// allocates for threads that have requested them (arch_prctl ARCH_REQ_XCOMP_PERM).
+static inline unsigned long long xsave_xfd_components(const XSaveInfo& info)
+{
+	unsigned long long components = 0;
+	for (unsigned int i = 0; i < info.component_count; ++i) {
+		if (info.components[i].xfd)
+			components |= 1ULL << info.components[i].index;
+	}
+	return components;
+}
+
+template<typename Source>
+static inline XSaveInfo decode_xsave_info(const Source& source)
+{
+	XSaveInfo info = {};
+	int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
+	source.cpuid(cpu_info, 0x0);
+	if (static_cast<unsigned int>(cpu_info[0]) < 0xD)
+		return info;
+	source.cpuid(cpu_info, 0x1);
+	const unsigned int function1_ecx = static_cast<unsigned int>(cpu_info[2]);
+	info.supported = (function1_ecx & CPUID_1_ECX_XSAVE) != 0;
+	if (!info.supported)
+		return info;
+	info.xcr0 = source.xcr0(function1_ecx);
+
+	source.cpuid(cpu_info, 0xD, 0);
+	info.xcr0_supported = static_cast<unsigned int>(cpu_info[0]) | static_cast<unsigned long long>(static_cast<unsigned int>(cpu_info[3])) << 32;
+	info.size = static_cast<unsigned int>(cpu_info[1]);
+	info.max_size = static_cast<unsigned int>(cpu_info[2]);
+	source.cpuid(cpu_info, 0xD, 1);
+	info.features = static_cast<unsigned int>(cpu_info[0]);
+	info.system_size = info.features & XSAVE_FEATURE_XSAVES ? static_cast<unsigned int>(cpu_info[1]) : 0;
+	info.xss_supported = static_cast<unsigned int>(cpu_info[2]) | static_cast<unsigned long long>(static_cast<unsigned int>(cpu_info[3])) << 32;
+
+	// The legacy components are at fixed locations in the legacy area: x87 state, then the XMM registers and MXCSR
+	info.components[info.component_count++] = { 0, 160, 0, false, false, false, (info.xcr0 & XCR0_X87) != 0 };
+	info.components[info.component_count++] = { 1, 256, 160, false, false, false, (info.xcr0 & XCR0_SSE) != 0 };
+	const unsigned long long supported = info.xcr0_supported | info.xss_supported;
+	for (unsigned int i = 2; i < XSAVE_MAX_COMPONENTS && info.component_count < XSAVE_MAX_COMPONENTS; ++i) {
+		if (!(supported & (1ULL << i)))
+			continue;
+		source.cpuid(cpu_info, 0xD, i);
+		const unsigned int size = static_cast<unsigned int>(cpu_info[0]);
+		if (size == 0)
+			continue;
+		XSaveComponent& component = info.components[info.component_count++];
+		component.index = i;
+		component.size = size;
+		component.supervisor = (cpu_info[2] & 0x1) != 0;
+		component.offset = component.supervisor ? 0 : static_cast<unsigned int>(cpu_info[1]);
+		component.aligned = (cpu_info[2] & 0x2) != 0;
+		component.xfd = (cpu_info[2] & 0x4) != 0;
+		component.enabled = !component.supervisor && (info.xcr0 & (1ULL << i)) != 0;
+	}
+	return info;
+}
+
+static inline XSaveInfo get_xsave_info()
+{
+	return decode_xsave_info(CPUIDLiveSource());
+}
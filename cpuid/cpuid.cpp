@@ -12,6 +12,35 @@ checks if the bit is set. Return value is a nonzero signed integer if the bit is
 Exported functions:
   int cpuid(unsigned char function_id, unsigned char register_number, unsigned char bit_number)
   int cpuidex(unsigned char function_id, unsigned char subfunction_id, unsigned char register_number, unsigned char bit_number)
+  int xgetbv(unsigned char bit_number)
+  int cpuid_dump(CPUIDDumpDescriptor* descriptor, CPUIDRecord* records, int record_capacity)
+  int cpuid_counters(CallCounter* counters, int counter_capacity, int reset)
+
+The xgetbv function checks if the specified state component bit is set in the extended control
+register XCR0, meaning that the operating system has enabled it. The cpuid bits only tell about
+processor hardware support, to be able to use AVX the operating system must also have enabled
+the SSE and AVX state (bits 1 and 2), for AVX-512 additionally the opmask, ZMM_Hi256 and Hi16_ZMM
+state (bits 5, 6 and 7), and for AMX the XTILECFG and XTILEDATA state (bits 17 and 18).
+Returns zero if the operating system has not enabled XSAVE at all. XCR0 is read once, when the
+library is loaded, since it does not change while the process runs.
+
+The cpuid_dump function fills a caller-provided buffer with the raw registers of all valid function
+ids, including the sub-function ids of the function ids enumerated by sub-function (see
+../Common/CPUIDDump.h), so that the caller can decode everything locally from a single call instead
+of calling cpuid once for each feature. Each record is six 32-bit unsigned integers: Function id,
+sub-function id, EAX, EBX, ECX and EDX. The descriptor, which can be null, receives the version of
+the format, the size of the descriptor and of each record, the number of records, the maximum
+function ids and the value of XCR0. Returns the number of valid records, which is larger than
+record_capacity if the buffer was too small, in which case only record_capacity records are written.
+
+The cpuid_counters function reads the call counters of the exported functions, in a build with
+CPUFEATURES_INSTRUMENTED (see ../Common/CallCounters.h): For each function called so far, the
+number of calls, and the number of cpuid instructions executed with the ticks spent in them, e.g.
+to find a caller checking a feature with cpuid on a hot path. The instructions of cpuid_dump are
+not timed, only its calls are counted. The cpuid executed when the library is loaded, for the maximum
+function ids and XCR0, is counted as capture_processor_info. Resets the counters when reset is nonzero. Returns the
+number of functions called, which is larger than counter_capacity if the buffer was too small, and
+zero in a build without instrumentation.
 
 The interface are tried to be as generally simple to use as possible, for instance for
 loading the library into a managed environment such as C# and PowerShell using DllImport:
@@ -82,29 +111,72 @@ PowerShell example:
 	{
 		[cpuidlib]::cpuid(1, 2, 25) # Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 25 indicates AES.
 	}
+
+	# Fetching all registers in one call, requires also importing the cpuid_dump function:
+	#   [DllImport("cpuid64.dll")]
+	#   public static extern int cpuid_dump(uint[] descriptor, uint[] records, int record_capacity);
+	function GetCPUIDDump()
+	{
+		$descriptor = New-Object uint[] 8
+		$records = New-Object uint[] (6 * 512)
+		$count = [cpuidlib]::cpuid_dump($descriptor, $records, 512)
+		for ($i = 0; $i -lt [Math]::Min($count, 512); ++$i) {
+			[PSCustomObject]@{ Function = $records[6*$i]; Subfunction = $records[6*$i+1]; EAX = $records[6*$i+2]; EBX = $records[6*$i+3]; ECX = $records[6*$i+4]; EDX = $records[6*$i+5] }
+		}
+	}
+
+	# Checking both processor and operating system support, requires also importing the xgetbv function:
+	#   [DllImport("cpuid64.dll")]
+	#   [return: MarshalAs(UnmanagedType.Bool)]
+	#   public static extern bool xgetbv(byte bit_number);
+	function UsableAVX512()
+	{
+		[cpuidlib]::cpuid(7, 1, 16) -and (1, 2, 5, 6, 7 | ForEach-Object { [cpuidlib]::xgetbv($_) }) -notcontains $false # SSE, AVX, opmask, ZMM_Hi256 and Hi16_ZMM state enabled in XCR0.
+	}
 */
 
 #include "Targetver.h"
 #include "cpuid.h"
+#ifdef _WIN32
 #define STRICT // Enable STRICT Type Checking in Windows headers
 #define WIN32_LEAN_AND_MEAN // To speed the build process exclude rarely-used services from Windows headers
 #define NOMINMAX // Exclude min/max macros from Windows header
 #include <Windows.h>
-#include <intrin.h>
+#endif
+#include "../Common/Intrinsics.h"
+#include "../Common/OSSupport.h"
+#include "../Common/CPUIDDump.h"
+#include "../Common/CallCounters.h"
+
+#ifdef CPUFEATURES_INSTRUMENTED
+static CallCounters call_counters;
+#endif
 
 static int max_function_id; // The number of the highest valid regular function ID for current CPU
 static int max_extended_function_id; // The number of the highest valid extended function ID for the current CPU
+static unsigned long long xcr0; // Zero if the operating system has not enabled XSAVE
 
+static void capture_processor_info()
+{
+	CALL_COUNTED(call_counters);
+	int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
+	CALL_COUNTED_CPUID(call_counters, cpu_info, 0x0, 0); // Request function id 0 to get the number of the highest valid function ID
+	max_function_id = cpu_info[0];
+	if (max_function_id >= 1) {
+		CALL_COUNTED_CPUID(call_counters, cpu_info, 0x1, 0);
+		xcr0 = read_xcr0(static_cast<unsigned int>(cpu_info[2]));
+	}
+	CALL_COUNTED_CPUID(call_counters, cpu_info, 0x80000000, 0); // Request value at id 0x80000000 to get the highest valid extended function ID
+	max_extended_function_id = cpu_info[0];
+}
+
+#ifdef _WIN32
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReserved)
 {
 	switch (ul_reason_for_call)
 	{
 	case DLL_PROCESS_ATTACH:
-		int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
-		__cpuid(cpu_info, 0x0); // Request function id 0 to get the number of the highest valid function ID
-		max_function_id = cpu_info[0];
-		__cpuid(cpu_info, 0x80000000); // Request value at id 0x80000000 to get the highest valid extended function ID
-		max_extended_function_id = cpu_info[0];
+		capture_processor_info();
 		break;
 	case DLL_THREAD_ATTACH:
 	case DLL_THREAD_DETACH:
@@ -113,13 +185,21 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReser
 	}
 	return TRUE;
 }
+#else
+// Shared library on other operating systems: Constructor executed when the library is loaded, like DllMain on process attach
+__attribute__((constructor)) static void load_library()
+{
+	capture_processor_info();
+}
+#endif
 int __stdcall cpuid(int function_id, unsigned char register_number, unsigned char bit_number)
 {
+	CALL_COUNTED(call_counters);
 	int support = 0;
 	if ((function_id > 0 && function_id <= max_function_id) || (function_id < 0 && function_id <= max_extended_function_id)) { // Regular function ids are positive, extended function id have value above INT32_MAX (2147483647) and are therefore represented negative signed integers
 		if (register_number < 4) { // Four registers (EAX, EBX, ECX, and EDX), numbered 0,1,2,3.
 			int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
-			__cpuid(cpu_info, function_id);
+			CALL_COUNTED_CPUID(call_counters, cpu_info, function_id, 0);
 			support = (cpu_info[register_number] & 1 << bit_number); // Check specified bit in specified register
 		}
 	}
@@ -127,13 +207,40 @@ int __stdcall cpuid(int function_id, unsigned char register_number, unsigned cha
 }
 int __stdcall cpuidex(int function_id, int subfunction_id, unsigned char register_number, unsigned char bit_number)
 {
+	CALL_COUNTED(call_counters);
 	int support = 0;
 	if ((function_id > 0 && function_id <= max_function_id) || (function_id < 0 && function_id <= max_extended_function_id)) { // Regular function ids are positive, extended function id have value above INT32_MAX (2147483647) and are therefore represented negative signed integers
 		if (register_number < 4) { // Four registers (EAX, EBX, ECX, and EDX), numbered 0,1,2,3.
 			int cpu_info[4]; // Value of the four registers EAX, EBX, ECX, and EDX, each 32-bit integers
-			__cpuidex(cpu_info, function_id, subfunction_id);
+			CALL_COUNTED_CPUID(call_counters, cpu_info, function_id, subfunction_id);
 			support = (cpu_info[register_number] & 1 << bit_number); // Check specified bit in specified register
 		}
 	}
 	return support;
 }
+int __stdcall xgetbv(unsigned char bit_number)
+{
+	CALL_COUNTED(call_counters);
+	int support = 0;
+	if (bit_number < 64)
+		support = (xcr0 & 1ull << bit_number) != 0; // Check specified state component bit
+	return support;
+}
+int __stdcall cpuid_dump(CPUIDDumpDescriptor* descriptor, CPUIDRecord* records, int record_capacity)
+{
+	CALL_COUNTED(call_counters);
+	CPUIDDumpDescriptor dump_descriptor;
+	const unsigned int count = cpuid_capture(dump_descriptor, records, record_capacity > 0 ? static_cast<unsigned int>(record_capacity) : 0);
+	if (descriptor)
+		*descriptor = dump_descriptor;
+	return static_cast<int>(count);
+}
+int __stdcall cpuid_counters(CallCounter* counters, int counter_capacity, int reset)
+{
+#ifdef CPUFEATURES_INSTRUMENTED
+	const unsigned int count = call_counters.read(counters, counters && counter_capacity > 0 ? static_cast<unsigned int>(counter_capacity) : 0, reset != 0);
+	return static_cast<int>(count);
+#else
+	return 0;
+#endif
+}
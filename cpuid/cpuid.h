@@ -1,6 +1,10 @@
 #pragma once
 
-#ifdef CPUID_EXPORTS
+#ifndef _WIN32
+// Shared library on other operating systems, built with CMake, where the calling convention does not apply
+#define LIBRARY_API __attribute__((visibility("default")))
+#define __stdcall
+#elif defined(CPUID_EXPORTS)
 //Exporting using module-definition file instead of dllexport, to avoid any name mangling.
 //#define LIBRARY_API __declspec(dllexport)
 #define LIBRARY_API
@@ -10,3 +14,10 @@
 
 LIBRARY_API int __stdcall cpuid(int function_id, unsigned char register_number, unsigned char bit_number);
 LIBRARY_API int __stdcall cpuidex(int function_id, int subfunction_id, unsigned char register_number, unsigned char bit_number);
+LIBRARY_API int __stdcall xgetbv(unsigned char bit_number);
+
+#include "../Common/CPUIDDump.h"
+LIBRARY_API int __stdcall cpuid_dump(CPUIDDumpDescriptor* descriptor, CPUIDRecord* records, int record_capacity);
+
+#include "../Common/CallCounters.h"
+LIBRARY_API int __stdcall cpuid_counters(CallCounter* counters, int counter_capacity, int reset);
@@ -1,5 +1,6 @@
 #include "Targetver.h"
 #include "../cpuid/cpuid.h"
+#include "../Common/WMain.h"
 #include <iostream>
 
 bool SupportLongMode()
@@ -42,6 +43,14 @@ bool SupportAVX512()
 {
 	return cpuid(7, 1, 16); // Function id 7 contains bitset with flags for extended features, and in second register (EBX) bit 16 indicates AVX-512 Foundation - the core extension required by all imiplementations of AVX-512.
 }
+bool UsableAVX()
+{
+	return SupportAVX() && xgetbv(1) && xgetbv(2); // Also requires the operating system to have enabled SSE (bit 1) and AVX (bit 2) state in XCR0.
+}
+bool UsableAVX512()
+{
+	return SupportAVX512() && xgetbv(1) && xgetbv(2) && xgetbv(5) && xgetbv(6) && xgetbv(7); // Also requires the operating system to have enabled SSE, AVX, opmask, ZMM_Hi256 and Hi16_ZMM state in XCR0.
+}
 bool SupportAES()
 {
 	return cpuid(1, 2, 25); // Function id 1 contains bitset with flags for main features, and in third register (ECX) bit 25 indicates AES.
@@ -59,5 +68,18 @@ int wmain(int argc, wchar_t *argv[], wchar_t *envp[])
 	std::wcout << L"AVX " << (SupportAVX() ? L"supported" : L"not supported") << std::endl;
 	std::wcout << L"AVX2 " << (SupportAVX2() ? L"supported" : L"not supported") << std::endl;
 	std::wcout << L"AVX512 " << (SupportAVX512() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AVX (usable) " << (UsableAVX() ? L"supported" : L"not supported") << std::endl;
+	std::wcout << L"AVX512 (usable) " << (UsableAVX512() ? L"supported" : L"not supported") << std::endl;
 	std::wcout << L"AES " << (SupportAES() ? L"supported" : L"not supported") << std::endl;
-}
\ No newline at end of file
+	CPUIDDumpDescriptor descriptor;
+	CPUIDRecord records[512];
+	const int count = cpuid_dump(&descriptor, records, 512);
+	std::wcout << L"Dump version " << descriptor.version << L", " << count << L" records" << std::endl;
+	for (int i = 0; i < count && i < 512; ++i)
+		std::wcout << std::hex << records[i].function_id << L"." << records[i].subfunction_id << L": " << records[i].eax << L" " << records[i].ebx << L" " << records[i].ecx << L" " << records[i].edx << std::dec << std::endl;
+	CallCounter counters[8];
+	const int counter_count = cpuid_counters(counters, 8, 0); // Zero without instrumentation
+	for (int i = 0; i < counter_count && i < 8; ++i)
+		std::wcout << counters[i].name << L": " << counters[i].calls << L" calls, " << counters[i].cpuid_count << L" cpuid, " << counters[i].cpuid_ticks << L" ticks" << std::endl;
+	return 0;
+}